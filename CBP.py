@@ -2,7 +2,11 @@
 import click
 import scripts.print_results as print_results
 import scripts.runall as runall
+import scripts.fanout as fanout
 import scripts.cbp_vizier as vizier
+import scripts.trace_server as trace_server
+import scripts.trace_info as trace_info
+import scripts.check_tables as check_tables
 
 from scripts import myconstants as mc
 
@@ -16,8 +20,12 @@ def howto():
     print("TEXT")
 
 cli.add_command(runall.run_traces)
+cli.add_command(fanout.fanout)
 cli.add_command(print_results.print_results)
 cli.add_command(vizier.vizier)
+cli.add_command(trace_server.trace_server)
+cli.add_command(trace_info.trace_info)
+cli.add_command(check_tables.check_tables)
 cli.add_command(howto)
 
 if __name__ == '__main__':
@@ -0,0 +1,171 @@
+#!/usr/bin/env python3
+"""ctypes wrapper of the native trace reader libbt9.so (sim/src/bt9_capi.h)
+
+    from scripts import bt9
+
+    with bt9.Trace(path) as trace:
+        nodes = trace.nodes()                    # structured array, one row per node id
+        for block in trace.blocks():             # columns of up to 64 Ki branches
+            taken_pcs = block.pc[block.taken == 1]
+
+Branches are written by the library straight into NumPy arrays owned by Python, so streaming
+a trace costs no copies beyond the reader's own decoding.
+"""
+import ctypes
+import subprocess
+from collections import namedtuple
+
+import numpy as np
+
+from . import myconstants as mc
+
+# Must match BT9_CAPI_VERSION and the record layouts in bt9_capi.h
+CAPI_VERSION = 1
+
+NODE_DTYPE = np.dtype([
+    ('pc', np.uint64), ('phy_addr', np.uint64),
+    ('id', np.uint32), ('opcode', np.uint32), ('tgt_cnt', np.uint32), ('taken_cnt', np.uint32), ('untaken_cnt', np.uint32),
+    ('opcode_size', np.uint8), ('phy_addr_valid', np.uint8), ('op_type', np.uint8),
+    ('type', np.uint8), ('directness', np.uint8), ('conditionality', np.uint8), ('direction', np.uint8), ('indirectness', np.uint8),
+], align=True)
+
+EDGE_DTYPE = np.dtype([
+    ('target', np.uint64), ('phy_target', np.uint64), ('traverse_cnt', np.uint64),
+    ('id', np.uint32), ('src_node_id', np.uint32), ('dest_node_id', np.uint32), ('inst_cnt', np.uint32),
+    ('taken', np.uint8), ('phy_target_valid', np.uint8),
+], align=True)
+
+# OpType values of the op_type column (sim/src/utils.h)
+OP_TYPES = {
+    2: 'OP',
+    3: 'RET_UNCOND', 4: 'JMP_DIRECT_UNCOND', 5: 'JMP_INDIRECT_UNCOND', 6: 'CALL_DIRECT_UNCOND', 7: 'CALL_INDIRECT_UNCOND',
+    8: 'RET_COND', 9: 'JMP_DIRECT_COND', 10: 'JMP_INDIRECT_COND', 11: 'CALL_DIRECT_COND', 12: 'CALL_INDIRECT_COND',
+    13: 'ERROR',
+}
+
+BranchBlock = namedtuple('BranchBlock', ['pc', 'target', 'taken', 'op_type'])
+
+class TraceError(Exception):
+    """Raised when the library cannot open or decode a trace"""
+
+_lib = None
+
+def build_library():
+    # The predictor folder is only needed to satisfy the Taskfile include
+    task_cmd = "PREDICTOR_FOLDER=" + str(mc.DEFAULT_PREDICTOR_DIR) + " task -d " + str(mc.SIM_DIR) + " libbt9"
+    subprocess.run(task_cmd, capture_output=True, shell=True, check=True)
+
+def load_library(path=None, build=True):
+    """Load libbt9.so once, building it first unless a path is given or build is False"""
+    global _lib
+    if _lib is not None:
+        return _lib
+
+    if path is None:
+        if build:
+            build_library()
+        path = mc.BUILD_DIR.joinpath('libbt9.so')
+    lib = ctypes.CDLL(str(path))
+
+    u64_column = np.ctypeslib.ndpointer(np.uint64, flags='C_CONTIGUOUS')
+    u8_column = np.ctypeslib.ndpointer(np.uint8, flags='C_CONTIGUOUS')
+    signatures = {
+        'bt9_capi_version':  (ctypes.c_int, []),
+        'bt9_last_error':    (ctypes.c_char_p, []),
+        'bt9_open':          (ctypes.c_void_p, [ctypes.c_char_p, ctypes.c_int, ctypes.c_char_p]),
+        'bt9_close':         (None, [ctypes.c_void_p]),
+        'bt9_num_nodes':     (ctypes.c_int64, [ctypes.c_void_p]),
+        'bt9_num_edges':     (ctypes.c_int64, [ctypes.c_void_p]),
+        'bt9_get_nodes':     (ctypes.c_int64, [ctypes.c_void_p, np.ctypeslib.ndpointer(NODE_DTYPE, flags='C_CONTIGUOUS'), ctypes.c_int64]),
+        'bt9_get_edges':     (ctypes.c_int64, [ctypes.c_void_p, np.ctypeslib.ndpointer(EDGE_DTYPE, flags='C_CONTIGUOUS'), ctypes.c_int64]),
+        'bt9_header_field':  (ctypes.c_int64, [ctypes.c_void_p, ctypes.c_char_p, ctypes.c_char_p, ctypes.c_int64]),
+        'bt9_read_branches': (ctypes.c_int64, [ctypes.c_void_p, u64_column, u64_column, u8_column, u8_column, ctypes.c_int64]),
+        'bt9_seek':          (ctypes.c_int, [ctypes.c_void_p, ctypes.c_uint64]),
+    }
+    for name, (restype, argtypes) in signatures.items():
+        function = getattr(lib, name)
+        function.restype = restype
+        function.argtypes = argtypes
+
+    if lib.bt9_capi_version() != CAPI_VERSION:
+        raise TraceError(f"{path} implements C interface version {lib.bt9_capi_version()}, expected {CAPI_VERSION}")
+    _lib = lib
+    return lib
+
+def _last_error():
+    return _lib.bt9_last_error().decode()
+
+class Trace:
+    """An open trace; close it, or use it as a context manager"""
+
+    def __init__(self, path, pipelined=False, cache_dir=None):
+        load_library()
+        self.path = str(path)
+        self._handle = _lib.bt9_open(self.path.encode(), int(pipelined), cache_dir.encode() if cache_dir else None)
+        if not self._handle:
+            raise TraceError(_last_error())
+
+    def close(self):
+        if self._handle:
+            _lib.bt9_close(self._handle)
+            self._handle = None
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *exc):
+        self.close()
+
+    def __del__(self):
+        self.close()
+
+    @property
+    def num_nodes(self):
+        return _lib.bt9_num_nodes(self._handle)
+
+    @property
+    def num_edges(self):
+        return _lib.bt9_num_edges(self._handle)
+
+    def nodes(self):
+        """Node table as a structured array of NODE_DTYPE, indexed by node id"""
+        nodes = np.empty(self.num_nodes, dtype=NODE_DTYPE)
+        _lib.bt9_get_nodes(self._handle, nodes, len(nodes))
+        return nodes
+
+    def edges(self):
+        """Edge table as a structured array of EDGE_DTYPE, indexed by edge id"""
+        edges = np.empty(self.num_edges, dtype=EDGE_DTYPE)
+        _lib.bt9_get_edges(self._handle, edges, len(edges))
+        return edges
+
+    def header(self, key):
+        """Value of a header field as a string, or None if the trace has no such field"""
+        size = _lib.bt9_header_field(self._handle, key.encode(), None, 0)
+        if size < 0:
+            return None
+        value = ctypes.create_string_buffer(size + 1)
+        _lib.bt9_header_field(self._handle, key.encode(), value, len(value))
+        return value.value.decode().strip()
+
+    def seek(self, branch):
+        """Make the given branch the next one read"""
+        if _lib.bt9_seek(self._handle, branch) != 0:
+            raise TraceError(_last_error())
+
+    def read_into(self, block):
+        """Fill the columns of a BranchBlock with the next branches, return how many were read"""
+        count = _lib.bt9_read_branches(self._handle, block.pc, block.target, block.taken, block.op_type, len(block.pc))
+        if count < 0:
+            raise TraceError(_last_error())
+        return count
+
+    def blocks(self, block_size=64 * 1024):
+        """Iterate over the remaining branches in BranchBlocks of up to block_size branches
+
+        The arrays of one block are reused for the next, copy them to keep them.
+        """
+        block = BranchBlock(np.empty(block_size, np.uint64), np.empty(block_size, np.uint64),
+                            np.empty(block_size, np.uint8), np.empty(block_size, np.uint8))
+        while count := self.read_into(block):
+            yield BranchBlock(*(column[:count] for column in block))
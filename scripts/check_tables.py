@@ -0,0 +1,70 @@
+#!/usr/bin/env python3
+import sys
+import subprocess
+
+import cloup
+import yaml
+
+from . import myconstants as mc
+from . import runall
+
+# Configuration of a predictor with the largest tables the ranges of its config/predictor.yml allow
+MAX_CONFIG = 'config/predictor_max.yml'
+
+def synthetic_traces(print_commands):
+    """Two small synthetic traces from trace_generate, built once in the build folder"""
+
+    # The predictor folder is only needed to satisfy the Taskfile include
+    task_cmd = "PREDICTOR_FOLDER=" + str(mc.DEFAULT_PREDICTOR_DIR) + " task -d " + str(mc.SIM_DIR) + " trace_generate"
+    if print_commands:
+        print(task_cmd)
+    subprocess.run(task_cmd, capture_output=True, shell=True, check=True)
+
+    traces = []
+    for seed in [2, 3]:
+        trace = mc.BUILD_DIR.joinpath('synthetic_tables_' + str(seed) + '.bt9.trace.zst')
+        if not trace.exists():
+            subprocess.run([str(mc.BUILD_DIR.joinpath('trace_generate')), "-n", "1M", "-s", str(seed), str(trace)],
+                           capture_output=True, check=True)
+        traces.append(str(trace))
+    return traces
+
+def run_simulator(args, what, print_commands):
+    command = [str(mc.BUILD_DIR.joinpath('predictor'))] + args
+    if print_commands:
+        print(" ".join(command))
+    result = subprocess.run(command, capture_output=True, text=True)
+    if result.returncode != 0:
+        sys.exit("Error: " + what + " failed, return code " + str(result.returncode) + "\n" + result.stderr)
+
+@cloup.command(context_settings=mc.CLIC_CONTEXT_SETTINGS)
+@cloup.option("-p", "--predictor_folder", type=mc.CLICK_R_DIR, multiple=True,
+              help="Folder with predictor code and a " + MAX_CONFIG + ". Default: every predictor that has one")
+@cloup.option('-v', '--verbose', count=True)
+def check_tables(predictor_folder, verbose):
+    """Simulate predictors with their largest tables in batch mode, in chunks and resumed from a checkpoint"""
+
+    print_commands = verbose > 0
+    log_commands = verbose > 1
+
+    # Every trace of a batch and every chunk runs on a thread of its own, whose stack also holds the
+    # static TLS: tables kept in thread_local arrays overflow it at these sizes
+    if not predictor_folder:
+        predictor_folder = sorted(str(config.parents[1]) for config in mc.SIM_DIR.joinpath('cbp-predictors').glob('*/' + MAX_CONFIG))
+
+    try:
+        traces = synthetic_traces(print_commands)
+    except subprocess.CalledProcessError as generate_exception:
+        sys.exit("Error: trace_generate failed, return code " + str(generate_exception.returncode))
+
+    for folder in predictor_folder:
+        with open(folder + "/" + MAX_CONFIG, 'r') as f:
+            config_yaml = yaml.safe_load(f)
+        name = config_yaml['predictor']['name']
+
+        runall.compile_predictor(folder, config_yaml, print_commands, log_commands, False)
+        run_simulator(["--threads", "2", "--output", "/dev/null"] + traces, name + " batch run", print_commands)
+        run_simulator(["--chunks", "2", "--chunk-verify", traces[0]], name + " chunked run", print_commands)
+        run_simulator(["--checkpoint-verify", traces[0]], name + " resumed run", print_commands)
+
+        print(name + ": largest tables OK")
@@ -0,0 +1,123 @@
+#!/usr/bin/env python3
+import os
+import sys
+import json
+import shutil
+import subprocess
+import multiprocessing
+from functools import partial
+from pathlib import Path
+
+import cloup
+import yaml
+import click
+
+from . import myconstants as mc
+from . import runall
+from .utils import get_mpki, list_traces
+
+@cloup.command(context_settings=mc.CLIC_CONTEXT_SETTINGS)
+@cloup.option_group(
+    'Directories and config files',
+    cloup.option("-t", "--trace_dir",   type=mc.CLICK_R_DIR,  show_default=True, default=mc.DEFAULT_TRACE_DIR,   help="Trace directory"),
+    cloup.option("-r", "--result_dir",  type=mc.CLICK_W_DIR,  show_default=True, default=mc.DEFAULT_RESULT_DIR,  help="Where to create directories with simulation results"),
+    cloup.option("-p", "--predictor_folder", type=mc.CLICK_R_DIR, multiple=True, required=True, help="Folder with predictor code, once per predictor to simulate"),
+    cloup.option("-y", "--yml_file",    type=mc.CLICK_R_FILE, multiple=True, help="Override the .yml configuration file of the predictor given at the same position")
+)
+@cloup.option("-f", "--force",       is_flag=True, help="Overwrite result folders that already contain simulation results with matching hash")
+@cloup.option("-u", "--user_stats",  show_default=True, is_flag=True,            help="Whether to collect predictor defined statistics. If True, will define USER_STATS symbol")
+@cloup.option("-n", "--num_threads", show_default=True, default=os.cpu_count(),  help="How many traces to simulate in parallel. Default: number of threads")
+@cloup.option('-v', '--verbose',     count=True)
+def fanout(verbose, trace_dir, result_dir, predictor_folder, yml_file, force, user_stats, num_threads):
+    """Run several predictors side by side on all traces, decoding every trace once"""
+
+    if yml_file and len(yml_file) != len(predictor_folder):
+        sys.exit("Error: give either no -y/--yml_file or one per -p/--predictor_folder")
+
+    members = []
+    for index, folder in enumerate(predictor_folder):
+        with open(yml_file[index] if yml_file else folder + "/config/predictor.yml", 'r') as f:
+            config_yaml = yaml.safe_load(f)
+        config_yaml.pop("reproduction", None)
+
+        config_hash, param_hash = runall.generate_hashes(config_yaml)
+        name    = config_yaml['predictor']['name']
+        version = str(config_yaml['predictor']['version'])
+        result_directory = Path(result_dir).joinpath(name, version, str(config_hash))
+        if result_directory.exists() and not force:
+            sys.exit("Error: result directory \"" + str(result_directory) + "\" already contains simulation results "
+                     + "with the same configuration hash. Run with -f/--force to overwrite them.")
+
+        # Labels key the driver output, the same predictor may run in several configurations
+        label = name if all(member['name'] != name for member in members) else name + "-" + config_hash[:8]
+        members.append({ 'folder': folder, 'config': config_yaml, 'name': name, 'version': version, 'label': label,
+                         'config_hash': config_hash, 'param_hash': param_hash, 'result_directory': result_directory })
+
+    print("Running predictors " + ", ".join(member['label'] for member in members) + " ...")
+
+    compile_fanout(members, verbose > 0, verbose > 1, user_stats)
+    results = simulate_fanout(members, trace_dir, num_threads)
+
+    for member in members:
+        result_directory = member['result_directory']
+        if result_directory.exists():
+            shutil.rmtree(result_directory)
+        result_directory.mkdir(parents=True)
+        with open(str(result_directory.joinpath('result.json')), 'w') as f:
+            json.dump(results[member['label']], f, separators=(',', ':'))
+
+        num_traces, mpki = get_mpki(result_directory)
+        reproduction_dict = runall.generate_reproduction_dict(member['config_hash'], member['param_hash'], mpki, num_traces)
+        with open(str(result_directory.joinpath('predictor.yml')), 'w') as f:
+            yaml.dump({ **reproduction_dict, **member['config'] }, f, sort_keys=False)
+
+        print("MPKI for " + member['name'] + " version " + member['version'] + " configuration " + member['config_hash'] + " is " + f'{mpki:.3f}')
+
+def compile_fanout(members, print_commands, log_commands, user_stats):
+    """Build every predictor into its own namespace with its own parameters, then the driver over all of them"""
+
+    shutil.rmtree(mc.BUILD_DIR.joinpath('fanout'), ignore_errors=True)
+
+    members_string = ""
+    for index, member in enumerate(members):
+        # parameters.h and statistics.h are read by the member compiled next
+        runall.write_build_headers(member['folder'], member['config'], user_stats)
+        run_task("PREDICTOR_FOLDER=" + member['folder'] + " FANOUT_INDEX=" + str(index) + " task -d " + str(mc.SIM_DIR) + " fanout_member",
+                 member['label'], print_commands, log_commands)
+        members_string += "FANOUT_MEMBER(fanout_member_" + str(index) + ", \"" + member['label'] + "\")\n"
+
+    with open(str(mc.BUILD_DIR.joinpath('fanout_members.h')), "w") as f:
+        f.write(members_string)
+
+    # The predictor folder is only needed to satisfy the Taskfile include
+    run_task("PREDICTOR_FOLDER=" + members[0]['folder'] + " task -d " + str(mc.SIM_DIR) + " fanout", "the fan-out driver", print_commands, log_commands)
+
+def run_task(task_cmd, what, print_commands, log_commands):
+    if print_commands:
+        print(task_cmd)
+    try:
+        subprocess.run(task_cmd, capture_output=not log_commands, text=True, shell=True, check=True)
+    except subprocess.CalledProcessError as compile_exception:
+        sys.exit("Error: Failed to compile " + what + ", return code " + str(compile_exception.returncode))
+
+def simulate_fanout(members, trace_dir, num_threads):
+    """Stats of every trace keyed by predictor label, then by trace"""
+
+    sim_exe = mc.BUILD_DIR.joinpath('fanout', 'fanout')
+    results = { member['label']: {} for member in members }
+
+    traces = runall.order_longest_first(list_traces(trace_dir))
+    with multiprocessing.Pool(processes=num_threads) as pool:
+        sim_threads = pool.imap_unordered(partial(simulate_trace, sim_exe=sim_exe), traces)
+        with click.progressbar(sim_threads, length=len(traces)) as bar:
+            for trace, output in bar:
+                if output is None:
+                    sys.exit("Error: simulation of trace \"" + trace + "\" failed")
+                for label, trace_stats in output.items():
+                    results[label].update(trace_stats)
+
+    return results
+
+def simulate_trace(trace, sim_exe):
+    result = subprocess.run([str(sim_exe), trace], capture_output=True, text=True)
+    return trace, json.loads(result.stdout) if result.returncode == 0 else None
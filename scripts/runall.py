@@ -5,8 +5,6 @@ import hashlib
 from datetime import datetime
 from pathlib import Path
 import subprocess
-import multiprocessing
-from functools import partial
 import signal
 import shutil
 
@@ -14,10 +12,10 @@ import cloup
 from cloup.constraints import mutually_exclusive
 import yaml
 #import git
-import click
 
 from . import myconstants as mc
-from .utils import get_mpki
+from .utils import get_mpki, list_traces
+from .trace_info import load_trace_info
 
 @cloup.command(context_settings=mc.CLIC_CONTEXT_SETTINGS)
 @cloup.option_group(
@@ -35,13 +33,24 @@ from .utils import get_mpki
 )
 @cloup.option("-u", "--user_stats",  show_default=True, is_flag=True,            help="Whether to collect predictor defined statistics. If True, will define USER_STATS symbol")
 @cloup.option("-n", "--num_threads",       show_default=True, default=os.cpu_count(),  help="How many simulator threads to run in parallel. Default: number of threads")
+@cloup.option_group(
+    'Trace file reads',
+    cloup.option("--io_chunk_size", type=int, default=None, help="MiB per trace file read. Default: simulator default"),
+    cloup.option("--io_depth",      type=int, default=None, help="Trace file reads issued ahead of the decoder, 0 for synchronous reads. Default: simulator default")
+)
 @cloup.option('-v', '--verbose',        count=True)
-def run_traces(verbose, trace_dir, result_dir, yml_file, user_stats, num_threads, force, silence, predictor_folder):
+def run_traces(verbose, trace_dir, result_dir, yml_file, user_stats, num_threads, force, silence, predictor_folder, io_chunk_size, io_depth):
     """Run predictor with the given configuration file on all traces"""
 
     print_commands = verbose > 0
     log_commands = verbose > 1
 
+    # Passed to the simulator processes through their environment
+    if io_chunk_size is not None:
+        os.environ['BT9_IO_CHUNK_SIZE'] = str(io_chunk_size * 1024 * 1024)
+    if io_depth is not None:
+        os.environ['BT9_IO_DEPTH'] = str(io_depth)
+
     if yml_file == None:
         yml_file = predictor_folder + "/config/predictor.yml"
 
@@ -54,6 +63,9 @@ def run_traces(verbose, trace_dir, result_dir, yml_file, user_stats, num_threads
     predictor_name    = config_yaml['predictor']['name']
     predictor_version = str(config_yaml['predictor']['version'])
     result_directory  = Path(result_dir).joinpath(predictor_name, predictor_version, str(config_hash))
+    # Simulator checkpoints of an interrupted run, kept next to the results until the run completes;
+    # a USER_STATS build has other stats and keeps its own
+    checkpoint_directory = result_directory.with_name(str(config_hash) + (".user_stats" if user_stats else "") + ".checkpoints")
 
     skip_simulation = False
     if result_directory.exists():
@@ -72,7 +84,8 @@ def run_traces(verbose, trace_dir, result_dir, yml_file, user_stats, num_threads
         def exit_gracefuly(signum, frame):
             signal.signal(signum, signal.SIG_IGN)       # Ignore additional signals
             shutil.rmtree(result_directory)
-            sys.exit("SIGINT received. Directory \"" + str(result_directory) + "\" was removed to avoid incomplete simulation results")
+            sys.exit("SIGINT received. Directory \"" + str(result_directory) + "\" was removed to avoid incomplete simulation results."
+                     + " Run again to resume from the checkpoints in \"" + str(checkpoint_directory) + "\"")
 
         original_sigint_handler = signal.getsignal(signal.SIGINT)
         # Register function for cleanup in case of interrupt
@@ -81,7 +94,7 @@ def run_traces(verbose, trace_dir, result_dir, yml_file, user_stats, num_threads
         print("Running predictor " + predictor_name + " version " + predictor_version + " configuration " + config_hash + " ...")
 
         compile_predictor(predictor_folder, config_yaml, print_commands, log_commands, user_stats)
-        simulate_predictor(result_directory, config_yaml, print_commands, log_commands, trace_dir, num_threads, original_sigint_handler)
+        simulate_predictor(result_directory, checkpoint_directory, config_yaml, print_commands, log_commands, trace_dir, num_threads)
         simulator_num_traces, simulator_mpki = get_mpki(result_directory)
 
         reproduction_dict = generate_reproduction_dict(config_hash, param_hash, simulator_mpki, simulator_num_traces)
@@ -100,30 +113,47 @@ def run_traces(verbose, trace_dir, result_dir, yml_file, user_stats, num_threads
 
     return num_traces, mpki, str(result_directory)
 
-def simulate_predictor(result_directory, config_yaml, print_commands, log_commands, trace_dir, parallel, original_sigint_handler):
+def simulate_predictor(result_directory, checkpoint_directory, config_yaml, print_commands, log_commands, trace_dir, parallel):
     sim_exe = mc.BUILD_DIR.joinpath('predictor')
 
     result_directory.mkdir(parents=True, exist_ok=True)
 
-    # Weird code because multiprocessing function cannot handle output of scandir directly
-    traces = [entry.path for entry in os.scandir(trace_dir) if entry.is_file()]
-    with multiprocessing.Pool(processes=parallel) as pool:
-        partial_func = partial(simulate_trace, sim_exe=sim_exe, result_directory=result_directory, original_sigint_handler=original_sigint_handler)
-        sim_threads = pool.imap_unordered(partial_func, traces)
+    # The simulator runs the longest traces first by the estimates of their .info summaries,
+    # so bring those up to date; without them it goes by file size
+    try_load_trace_info(list_traces(trace_dir))
 
-        with click.progressbar(sim_threads, length=len(traces)) as bar:
-            for result in bar:
-                pass
+    # One simulator process runs all traces on its own threads and writes the merged results. It
+    # checkpoints every trace, so a run that was interrupted carries on where it stopped
+    result_file = result_directory.joinpath("result.json")
+    command = [str(sim_exe), "--threads", str(parallel), "--output", str(result_file), "--progress",
+               "--checkpoint", str(checkpoint_directory), "--resume", str(trace_dir)]
+    if print_commands:
+        print(" ".join(command))
+    try:
+        subprocess.run(command, check=True)
+    except subprocess.CalledProcessError as sim_exception:
+        sys.exit("Error: simulation failed, return code " + str(sim_exception.returncode))
 
-    result_file = os.path.join(result_directory, "result.json")
-    # Concatenate all result files
-    subprocess.run("jq -c -s add " + str(result_directory) + "/*.json > " + result_file, shell=True)
-    subprocess.run("find " + str(result_directory) + " ! -name 'result.json' -type f -exec rm -f {} +", shell=True)
+    shutil.rmtree(checkpoint_directory, ignore_errors=True)
 
-def simulate_trace(trace, sim_exe, result_directory, original_sigint_handler):
-    signal.signal(signal.SIGINT, original_sigint_handler)       # Restore signal handler
-    command = os.path.relpath(sim_exe) + " " + os.path.relpath(trace) + " > " + os.path.relpath(result_directory) + "/" + os.path.basename(trace) + ".json"
-    subprocess.run(command, shell=True)
+def try_load_trace_info(traces):
+    """Summaries of the traces, or None with a warning if the trace_info tool cannot be built or fails"""
+    try:
+        return load_trace_info(traces)
+    except (subprocess.CalledProcessError, OSError, ValueError) as info_exception:
+        detail = getattr(info_exception, 'stderr', None)
+        if isinstance(detail, bytes):
+            detail = detail.decode(errors='replace')
+        print("Warning: no trace summaries, ordering traces by file size: " + str(info_exception) +
+              ("\n" + detail.strip() if detail else ""), file=sys.stderr)
+        return None
+
+def order_longest_first(traces):
+    info = try_load_trace_info(traces)
+    if info is None:
+        # Without summaries the file size is the best guess
+        return sorted(traces, key=os.path.getsize, reverse=True)
+    return sorted(traces, key=lambda trace: info[trace]['est_sim_seconds'], reverse=True)
 
 def generate_hashes(dictionary):
 
@@ -145,6 +175,21 @@ def generate_hashes(dictionary):
 
 def compile_predictor(predictor_folder, dictionary, print_commands, log_commands, user_stats):
 
+    write_build_headers(predictor_folder, dictionary, user_stats)
+
+    task_cmd = "PREDICTOR_FOLDER=" + predictor_folder + " task -d " + str(mc.SIM_DIR)
+    if print_commands:
+        print("Generating ../sim/build/parameters.h")
+        print(task_cmd)
+
+    try:
+        subprocess.run(task_cmd, capture_output=not log_commands, text=True, shell=True, check=True)
+    except subprocess.CalledProcessError as compile_exception:
+        sys.exit("Error: Failed to compile, return code " + str(compile_exception.returncode))
+
+def write_build_headers(predictor_folder, dictionary, user_stats):
+    """Write parameters.h, statistics.h and paths.h of a predictor configuration into the build folder"""
+
     header_string = ""
 
     for param in dictionary['parameters'].items():
@@ -183,16 +228,6 @@ def compile_predictor(predictor_folder, dictionary, print_commands, log_commands
     with open(str(paths_file), "w") as f:
         f.write("#define PREDICTOR_H_PATH \"" + predictor_folder + "/src/predictor.h\"")
 
-    task_cmd = "PREDICTOR_FOLDER=" + predictor_folder + " task -d " + str(mc.SIM_DIR)
-    if print_commands:
-        print("Generating ../sim/build/parameters.h")
-        print(task_cmd)
-
-    try:
-        subprocess.run(task_cmd, capture_output=not log_commands, text=True, shell=True, check=True)
-    except subprocess.CalledProcessError as compile_exception:
-        sys.exit("Error: Failed to compile, return code " + str(compile_exception.returncode))
-
 def generate_reproduction_dict(config_hash, param_hash, mpki, num_traces):
 
     reproduction_dict = {}
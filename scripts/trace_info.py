@@ -0,0 +1,48 @@
+#!/usr/bin/env python3
+import os
+import sys
+import json
+import subprocess
+import multiprocessing
+
+import cloup
+
+from . import myconstants as mc
+from .utils import list_traces
+
+def build_trace_info():
+    # The predictor folder is only needed to satisfy the Taskfile include
+    task_cmd = "PREDICTOR_FOLDER=" + str(mc.DEFAULT_PREDICTOR_DIR) + " task -d " + str(mc.SIM_DIR) + " trace_info"
+    subprocess.run(task_cmd, capture_output=True, shell=True, check=True)
+
+def read_trace_info(trace, force=False):
+    command = [str(mc.BUILD_DIR.joinpath('trace_info'))] + (["-f"] if force else []) + [trace]
+    result = subprocess.run(command, capture_output=True, text=True, check=True)
+    return json.loads(result.stdout)[trace]
+
+def load_trace_info(traces, force=False, num_threads=os.cpu_count()):
+    """Summaries of the given traces keyed by path, read from their .info sidecars or built by the trace_info tool"""
+    build_trace_info()
+    with multiprocessing.Pool(processes=num_threads) as pool:
+        infos = pool.starmap(read_trace_info, [(trace, force) for trace in traces])
+    return dict(zip(traces, infos))
+
+@cloup.command(context_settings=mc.CLIC_CONTEXT_SETTINGS)
+@cloup.option("-t", "--trace_dir", type=mc.CLICK_R_DIR, show_default=True, default=mc.DEFAULT_TRACE_DIR, help="Trace directory")
+@cloup.option("-f", "--force", is_flag=True, help="Rebuild the summaries even if their .info files are up to date")
+@cloup.option("-n", "--num_threads", show_default=True, default=os.cpu_count(), help="How many traces to summarize in parallel. Default: number of threads")
+def trace_info(trace_dir, force, num_threads):
+    """Print header counts, table sizes and estimated simulation time of all traces"""
+
+    try:
+        info = load_trace_info(list_traces(trace_dir), force, num_threads)
+    except subprocess.CalledProcessError as info_exception:
+        sys.exit("Error: trace_info failed, return code " + str(info_exception.returncode))
+
+    print(f'{"trace":40} {"instructions":>14} {"branches":>12} {"nodes":>9} {"edges":>9} {"est. time [s]":>14}')
+    total = 0.0
+    for trace, summary in sorted(info.items(), key=lambda item: item[1]['est_sim_seconds'], reverse=True):
+        total += summary['est_sim_seconds']
+        print(f'{os.path.basename(trace):40} {summary["total_instruction_count"]:>14} {summary["branch_instruction_count"]:>12} '
+              f'{summary["num_nodes"]:>9} {summary["num_edges"]:>9} {summary["est_sim_seconds"]:>14.2f}')
+    print(f'{len(info)} traces, {total:.1f} s estimated simulation time on one thread')
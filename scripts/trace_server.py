@@ -0,0 +1,26 @@
+#!/usr/bin/env python3
+import os
+import subprocess
+
+import cloup
+
+from . import myconstants as mc
+from .utils import list_traces
+
+@cloup.command(context_settings=mc.CLIC_CONTEXT_SETTINGS)
+@cloup.option("-t", "--trace_dir", type=mc.CLICK_R_DIR, show_default=True, default=mc.DEFAULT_TRACE_DIR, help="Trace directory")
+@cloup.option("-n", "--num_threads", show_default=True, default=os.cpu_count(), help="How many traces to decode in parallel. Default: number of threads")
+def trace_server(trace_dir, num_threads):
+    """Decode all traces once into shared memory and serve them to simulator runs until Ctrl-C"""
+
+    # The predictor folder is only needed to satisfy the Taskfile include
+    task_cmd = "PREDICTOR_FOLDER=" + str(mc.DEFAULT_PREDICTOR_DIR) + " task -d " + str(mc.SIM_DIR) + " trace_server"
+    subprocess.run(task_cmd, shell=True, check=True)
+
+    traces = list_traces(trace_dir)
+    server = subprocess.Popen([str(mc.BUILD_DIR.joinpath('trace_server')), "-j", str(num_threads)] + traces)
+    try:
+        server.wait()
+    except KeyboardInterrupt:
+        # The server got the same SIGINT and removes its shared memory segments
+        server.wait()
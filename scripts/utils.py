@@ -1,5 +1,17 @@
 #!/usr/bin/env python3
+import array
 import json
+import os
+import re
+import struct
+
+# Files the simulator and trace tools write next to a trace: seek index, SimPoint set, trace
+# summary, and their temporary names while being written
+SIDECAR_PATTERN = re.compile(r'\.(bt10i|simpt|info)(\.tmp\.\d+)?$')
+
+def list_traces(trace_dir):
+    """Paths of all traces in trace_dir, skipping sidecar files"""
+    return [entry.path for entry in os.scandir(trace_dir) if entry.is_file() and not SIDECAR_PATTERN.search(entry.name)]
 
 def get_mpki(folder):
 
@@ -16,3 +28,26 @@ def get_mpki(folder):
         mpki = value / num_traces
 
         return num_traces, mpki
+
+# .intervals file of the simulator (sim/src/interval_stats.h): header, then its columns
+INTERVALS_HEADER = struct.Struct('<8sIIQQIIQ')
+INTERVALS_COLUMNS = ('end', 'instructions', 'cond_branches', 'mispredictions')
+
+def read_intervals(path):
+    """Columns of a .intervals file as a dict of arrays, one entry per interval, plus 'mpki'"""
+    with open(path, 'rb') as f:
+        data = f.read()
+
+    magic, version, _, _, _, _, _, num_intervals = INTERVALS_HEADER.unpack_from(data)
+    if magic != b'BT9INTVL' or version != 1:
+        raise ValueError(path + ": not an interval stats file of this version")
+
+    columns = {}
+    offset = INTERVALS_HEADER.size
+    for name, typecode in [(name, 'Q') for name in INTERVALS_COLUMNS] + [('mpki', 'f')]:
+        column = array.array(typecode)
+        column.frombytes(data[offset:offset + column.itemsize * num_intervals])
+        offset += column.itemsize * num_intervals
+        columns[name] = column
+
+    return columns
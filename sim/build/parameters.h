@@ -0,0 +1,4 @@
+#define BORNTICK 1024
+#define SC
+#define IMLI
+#define LOCALH
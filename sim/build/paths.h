@@ -0,0 +1 @@
+#define PREDICTOR_H_PATH "/root/repo/sim/cbp-predictors/tage-sc-l-64kb/src/predictor.h"
\ No newline at end of file
@@ -0,0 +1 @@
+#define USER_STATS
@@ -77,7 +77,7 @@ struct stats_t {
     }
 };
 
-stats_t stats;
+thread_local stats_t stats;
 
 #define UINT64 uint64_t
 #define ASSERT(cond) if (!(cond)) {fprintf(stderr,"file %s assert line %d\n",__FILE__,__LINE__); abort();}
@@ -114,20 +114,51 @@ history lengths optimized for the set of benchmarks at CBP
 #include <vector>
 
 
-static char GOG1[1 << (LOGPRED - G0G1_SIZE)];
+/* the tables are allocated by the PREDICTOR: with LOGPRED=22 they take 12 MB,
+   more than the static TLS of a thread can hold next to its stack */
+#define GOG1_ENTRIES (1 << (LOGPRED - G0G1_SIZE))
+#define BIMMETA_ENTRIES (1 << (LOGPRED - BIM_META_SIZE))
+#define HYST_ENTRIES (1 << (LOGPRED - HYST_SIZE))
+static thread_local char *GOG1;
 /* GOG1: shared prediction tables for G0 and G1*/
-static char BIMMETA[1 << (LOGPRED - BIM_META_SIZE)];
+static thread_local char *BIMMETA;
 /*BIMMETA: shared prediction tables for  BIM and META*/
-static char HYST[1 << (LOGPRED - HYST_SIZE)];
+static thread_local char *HYST;
 /* HYST: shared hysteresis tables */
-long long ghist;
+thread_local long long ghist;
 
 
 //static const int L_BIM = 10;
 //static const int L_G0 = 24;
 //static const int L_G1 = 64;
 //static const int L_META = 14;
-static int LOGSIZE;
+static thread_local int LOGSIZE;
+
+/* random() draws from one stream per process: every thread gets its own,
+   seeded like random() is by default, so that each trace sees the same sequence */
+static thread_local struct random_data RANDBUF;
+static thread_local char RANDSTATE[128];
+static thread_local bool RANDSEEDED = false;
+
+static void
+thread_random_seed ()
+{
+  if (!RANDSEEDED)
+    {
+      initstate_r (1, RANDSTATE, sizeof (RANDSTATE), &RANDBUF);
+      RANDSEEDED = true;
+    }
+}
+
+static long
+thread_random ()
+{
+  int32_t res;
+
+  thread_random_seed ();
+  random_r (&RANDBUF, &res);
+  return (res);
+}
 /*********************************************/
 /* for the index functions*/
 int
@@ -353,7 +384,7 @@ public:
     else
       outcome = 0;
     /*always easier to manipulate integers than booleans */
-    if ((prediction != taken) & ((random () & NR) == 0))
+    if ((prediction != taken) & ((thread_random () & NR) == 0))
       {
 	/* to break ping-pong phenomena*/
 	if (peskew == psmall)
@@ -457,11 +488,28 @@ class PREDICTOR {
  public:
 
   PREDICTOR(void);
+  ~PREDICTOR(void);
 
   bool    GetPrediction(UINT64 PC);
   void    UpdatePredictor(UINT64 PC, OpType opType, bool resolveDir, bool predDir, UINT64 branchTarget);
   void    TrackOtherInst(UINT64 PC, OpType opType, bool branchDir, UINT64 branchTarget);
 
+  /* tables, history and random stream, for simulator checkpoints (see sim/src/checkpoint.h) */
+  template<class Archive>
+  void serialize (Archive & ar)
+  {
+    int fptr, rptr;
+
+    thread_random_seed ();
+    fptr = RANDBUF.fptr - RANDBUF.state;
+    rptr = RANDBUF.rptr - RANDBUF.state;
+    ar (cereal::binary_data (GOG1, GOG1_ENTRIES), cereal::binary_data (BIMMETA, BIMMETA_ENTRIES),
+        cereal::binary_data (HYST, HYST_ENTRIES), ghist,
+        cereal::binary_data (RANDSTATE, sizeof (RANDSTATE)), fptr, rptr);
+    RANDBUF.fptr = RANDBUF.state + fptr;
+    RANDBUF.rptr = RANDBUF.state + rptr;
+  }
+
 
 };
 
@@ -469,8 +517,19 @@ class PREDICTOR {
 
 PREDICTOR::PREDICTOR(void)
 {
+  /* zeroed, as the static tables were */
+  GOG1 = new char[GOG1_ENTRIES] ();
+  BIMMETA = new char[BIMMETA_ENTRIES] ();
+  HYST = new char[HYST_ENTRIES] ();
+}
 
-
+/* the simulator creates a PREDICTOR per trace on each thread, so its tables must not outlive it */
+PREDICTOR::~PREDICTOR(void)
+{
+  delete[] GOG1;
+  delete[] BIMMETA;
+  delete[] HYST;
+  GOG1 = BIMMETA = HYST = nullptr;
 }
 
 
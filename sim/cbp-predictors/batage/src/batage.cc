@@ -17,11 +17,13 @@
 #endif
 
 
+thread_local uint32_t rando_state = 2463534242;
+
 uint32_t
 rando()
 {
   // Marsaglia's xorshift
-  static uint32_t x = 2463534242;
+  uint32_t & x = rando_state;
   x ^= x << 13;
   x ^= x >> 17;
   x ^= x << 5;
@@ -202,6 +204,13 @@ path_history::init(int hlen)
 }
 
 
+// the simulator creates a PREDICTOR per trace, so the tables must not outlive it
+path_history::~path_history()
+{
+  delete [] h;
+}
+
+
 void 
 path_history::insert(unsigned val)
 {
@@ -294,6 +303,16 @@ histories::histories()
       chtt[i].init(hist[i],TAGBITS-1,1);
     }
   }
+  delete [] hist;
+}
+
+
+histories::~histories()
+{
+  delete [] chg;
+  delete [] chgg;
+  delete [] cht;
+  delete [] chtt;
 }
 
 
@@ -429,6 +448,20 @@ batage::batage()
 }
 
 
+batage::~batage()
+{
+  for (int i=0; i<NUMG; i++) {
+    delete [] g[i];
+  }
+  delete [] g;
+  delete [] gi;
+#ifdef BANK_INTERLEAVING
+  delete [] bank;
+  delete [] check;
+#endif
+}
+
+
 #ifdef BANK_INTERLEAVING
 void
 batage::check_bank_conflicts()
@@ -7,6 +7,8 @@
 #include <stdint.h>
 #include <vector>
 
+#include <cereal/cereal.hpp>
+
 
 // ARM instructions are 4-byte aligned ==> shift PC by 2 bits
 #define PC_SHIFT 2
@@ -76,6 +78,10 @@
 using namespace std;
 
 
+// state of the pseudo-random generator rando()
+extern thread_local uint32_t rando_state;
+
+
 class dualcounter {
  public:
   static const int nmax = 7;
@@ -102,10 +108,17 @@ class path_history {
 public:
   int ptr;
   int hlength;
-  unsigned * h;
+  unsigned * h = nullptr;
+  path_history() = default;
+  path_history(const path_history &) = delete;
+  path_history & operator=(const path_history &) = delete;
+  ~path_history();
   void init(int hlen);
   void insert(unsigned val);
   unsigned & operator [] (int n);
+  template<class Archive> void serialize(Archive & ar) {
+    ar(ptr, cereal::binary_data(h, hlength * sizeof(unsigned)));
+  }
 };
 
 
@@ -125,6 +138,9 @@ public:
   void init(int original_length, int compressed_length, int injected_bits);
   uint32_t rotateleft(uint32_t x, int m);
   void update(path_history & ph);
+  template<class Archive> void serialize(Archive & ar) {
+    ar(fold);
+  }
 };
 
 
@@ -137,6 +153,9 @@ class histories {
   folded_history * cht;
   folded_history * chtt;
   histories();
+  histories(const histories &) = delete;
+  histories & operator=(const histories &) = delete;
+  ~histories();
   void update(uint32_t targetpc, bool taken);
   int gindex(uint32_t pc, int i);
   int gtag(uint32_t pc, int i);
@@ -146,6 +165,12 @@ class histories {
 #endif
   void printconfig();
   int size();
+  template<class Archive> void serialize(Archive & ar) {
+    ar(bh, ph);
+    for (int i=0; i<NUMG; i++) {
+      ar(chg[i], chgg[i], cht[i], chtt[i]);
+    }
+  }
 };
 
 
@@ -179,6 +204,9 @@ class batage {
   bool * check;
 #endif
   batage();
+  batage(const batage &) = delete;
+  batage & operator=(const batage &) = delete;
+  ~batage();
   tagged_entry & getg(int i);
   bool predict(uint32_t pc, histories & p);
   void update_bimodal(bool taken);
@@ -188,6 +216,17 @@ class batage {
 #ifdef BANK_INTERLEAVING
   void check_bank_conflicts();
 #endif
+  // tables and counters, for simulator checkpoints (the prediction in flight is not saved)
+  template<class Archive> void serialize(Archive & ar) {
+    ar(cereal::binary_data(b, sizeof(b)), cereal::binary_data(b2, sizeof(b2)));
+    for (int i=0; i<NUMG; i++) {
+      ar(cereal::binary_data(g[i], sizeof(tagged_entry) << LOGG));
+    }
+    ar(cat, meta, rando_state);
+#ifdef USE_CD
+    ar(cd);
+#endif
+  }
 };
 
 #endif
@@ -3,7 +3,7 @@
 
 //#define VERBOSE
 
-stats_t stats;
+thread_local stats_t stats;
 
 PREDICTOR::PREDICTOR(void)
 {
@@ -32,6 +32,13 @@ class PREDICTOR {
   void UpdatePredictor(UINT64 PC, OpType opType, bool resolveDir, bool predDir, UINT64 branchTarget);
   void TrackOtherInst(UINT64 PC, OpType opType, bool branchDir, UINT64 branchTarget);
 
+  // tables and histories, for simulator checkpoints (see sim/src/checkpoint.h)
+  template<class Archive>
+  void serialize(Archive & ar)
+  {
+    ar(pred, hist);
+  }
+
 };
 
 // Struct with statistics which will be serialized to json
@@ -93,7 +100,7 @@ struct stats_t {
     }
 };
 
-extern stats_t stats;
+extern thread_local stats_t stats;
 
 #endif
 
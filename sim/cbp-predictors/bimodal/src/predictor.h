@@ -21,10 +21,16 @@ class PREDICTOR{
         void UpdatePredictor(uint64_t PC, OpType opType, bool resolveDir, bool predDir, uint64_t branchTarget);
         void TrackOtherInst(uint64_t PC, OpType opType, bool branchDir, uint64_t branchTarget);
 
+        // Tables and histories, for simulator checkpoints (see sim/src/checkpoint.h)
+        template<class Archive>
+        void serialize(Archive & ar){
+            ar(pht);
+        }
+
     private:
         typedef sat_ctr<CTR_WIDTH> counter_t;
         const constinit static uint32_t numPhtEntries = (1 << PHT_SIZE);
-        ::pht<numPhtEntries, CTR_INIT, counter_t, 1, HYST> pht;
+        pht_table<numPhtEntries, CTR_INIT, counter_t, 1, HYST> pht;
 
         uint64_t index;
         counter_t counter;
@@ -90,5 +96,5 @@ struct stats_t {
     }
 };
 
-extern stats_t stats;
+extern thread_local stats_t stats;
 
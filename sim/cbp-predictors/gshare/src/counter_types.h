@@ -1,7 +1,9 @@
 
 #include <inttypes.h>
 #include <array>
+#include <memory>
 #include <boost/hana.hpp>
+#include <cereal/cereal.hpp>
 
 template <uint32_t size, uint32_t init_ctr, typename CTR_TYPE, uint32_t ...SharedBits>
 struct pht {
@@ -11,11 +13,13 @@ struct pht {
 
     static_assert(ctr_width == sizeof...(SharedBits), "Wrong number of shared bits!");
 
-    consteval static auto init_arrays(){
-        boost::hana::tuple<std::array<uint64_t, (size / 64) / SharedBits>...> tmp;
+    using arrays_t = boost::hana::tuple<std::array<uint64_t, (size / 64) / SharedBits>...>;
+
+    static std::unique_ptr<arrays_t> init_arrays(){
+        std::unique_ptr<arrays_t> tmp = std::make_unique<arrays_t>();
 
         uint32_t i = ctr_width - 1;
-        boost::hana::for_each(tmp, [&](auto& elem) {
+        boost::hana::for_each(*tmp, [&](auto& elem) {
             uint64_t init_val;
             if((init_ctr >> i) & 1){
                 init_val = 0xFFFFFFFFFFFFFFFF;
@@ -29,14 +33,15 @@ struct pht {
         return tmp;
     };
 
-    inline constinit static boost::hana::tuple<std::array<uint64_t, (size / 64) / SharedBits>...> arrays = init_arrays();
+    // On the heap, owned by the predictor: 2^22 counters would not fit in the static TLS of a thread
+    std::unique_ptr<arrays_t> arrays = init_arrays();
     std::array<uint32_t, sizeof...(SharedBits)> tmp_arr {SharedBits...};
 
-    constexpr CTR_TYPE get_counter(uint32_t i){
+    CTR_TYPE get_counter(uint32_t i){
         std::array<uint32_t, ctr_width> array;
 
         uint32_t iter = 0;
-        boost::hana::for_each(arrays, [&](auto& elem) {
+        boost::hana::for_each(*arrays, [&](auto& elem) {
             uint32_t index = i >> (tmp_arr[iter] - 1);
             uint32_t arr_index = index >> 6;
             uint32_t line_index = index & 0x3F;
@@ -49,12 +54,20 @@ struct pht {
         return CTR_TYPE(array);
     }
 
-    constexpr void save_counter(uint32_t i, CTR_TYPE counter){
+    // The counter bits, for simulator checkpoints (see sim/src/checkpoint.h)
+    template<class Archive>
+    void serialize(Archive & ar){
+        boost::hana::for_each(*arrays, [&](auto& elem) {
+            ar(cereal::binary_data(elem.data(), sizeof(elem)));
+        });
+    }
+
+    void save_counter(uint32_t i, CTR_TYPE counter){
 
         std::array array = counter.getArray();
 
         uint32_t iter = 0;
-        boost::hana::for_each(arrays, [&](auto& elem) {
+        boost::hana::for_each(*arrays, [&](auto& elem) {
             uint32_t index = i >> (tmp_arr[iter] - 1);
             uint32_t arr_index = index >> 6;
             uint32_t line_index = index & 0x3F;
@@ -69,6 +82,11 @@ struct pht {
 
 };
 
+// Lets a class declare a member named pht without the :: qualification, which would not
+// find the template once the predictor is wrapped in a namespace (fan-out driver)
+template <uint32_t size, uint32_t init_ctr, typename CTR_TYPE, uint32_t ...SharedBits>
+using pht_table = pht<size, init_ctr, CTR_TYPE, SharedBits...>;
+
 template <uint32_t CTR_WIDTH>
 struct sat_ctr {
     uint32_t Dir;
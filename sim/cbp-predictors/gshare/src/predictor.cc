@@ -1,6 +1,6 @@
 #include "predictor.h"
 
-stats_t stats;
+thread_local stats_t stats;
 
 PREDICTOR::PREDICTOR(void) {
 
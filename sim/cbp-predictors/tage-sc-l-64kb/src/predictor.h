@@ -45,11 +45,6 @@ struct stats_t {
     std::string TRACE;
 
 #ifdef USER_STATS
-    static constexpr uint32_t period = 10000;
-    uint32_t period_number = 0;
-    uint32_t period_tick = 0;
-    std::vector<float> MPKBr_periodic = {0.0};
-
     std::unordered_map<std::string, std::unordered_map<std::string, uint32_t>> size_map;
 #endif
 
@@ -73,7 +68,6 @@ struct stats_t {
 
 #ifdef USER_STATS
             CEREAL_NVP(size_map),
-            CEREAL_NVP(MPKBr_periodic),
 #endif
 
             CEREAL_NVP(NUM_INSTRUCTIONS),
@@ -86,14 +80,14 @@ struct stats_t {
     }
 };
 
-stats_t stats;
+thread_local stats_t stats;
 
 #define UINT64 uint64_t
 
 //To get the predictor storage budget on stderr  uncomment the next line
 // #define PRINTSIZE
 #include <vector>
-long long IMLIcount;		// use to monitor the iteration number
+thread_local long long IMLIcount;		// use to monitor the iteration number
 
 #ifdef LOCALH			// 2.7 %
 #define LOOPPREDICTOR		//loop predictor enable
@@ -110,12 +104,12 @@ long long IMLIcount;		// use to monitor the iteration number
 //The three BIAS tables in the SC component
 //We play with the TAGE  confidence here, with the number of the hitting bank
 #define LOGBIAS 8
-int8_t Bias[(1 << LOGBIAS)];
+thread_local int8_t Bias[(1 << LOGBIAS)];
 #define INDBIAS (((((PC ^(PC >>2))<<1)  ^  (LowConf &(LongestMatchPred!=alttaken))) <<1) +  pred_inter) & ((1<<LOGBIAS) -1)
-int8_t BiasSK[(1 << LOGBIAS)];
+thread_local int8_t BiasSK[(1 << LOGBIAS)];
 #define INDBIASSK (((((PC^(PC>>(LOGBIAS-2)))<<1) ^ (HighConf))<<1) +  pred_inter) & ((1<<LOGBIAS) -1)
 
-int8_t BiasBank[(1 << LOGBIAS)];
+thread_local int8_t BiasBank[(1 << LOGBIAS)];
 
 #define INDBIASBANK (pred_inter + (((HitBank+1)/4)<<4) + (HighConf<<1) + (LowConf <<2) +((AltBank!=0)<<3)+ ((PC^(PC>>2))<<7)) & ((1<<LOGBIAS) -1)
 
@@ -127,72 +121,72 @@ int8_t BiasBank[(1 << LOGBIAS)];
 #ifdef IMLI
 #define LOGINB 8		// 128-entry
 #define INB 1
-int Im[INB] = { 8 };
-int8_t IGEHLA[INB][(1 << LOGINB)] = { {0} };
+thread_local int Im[INB] = { 8 };
+thread_local int8_t IGEHLA[INB][(1 << LOGINB)] = { {0} };
 
-int8_t *IGEHL[INB];
+thread_local int8_t *IGEHL[INB];
 
 #define LOGIMNB 9		// 2* 256 -entry
 #define IMNB 2
 
-int IMm[IMNB] = { 10, 4 };
-int8_t IMGEHLA[IMNB][(1 << LOGIMNB)] = { {0} };
+thread_local int IMm[IMNB] = { 10, 4 };
+thread_local int8_t IMGEHLA[IMNB][(1 << LOGIMNB)] = { {0} };
 
-int8_t *IMGEHL[IMNB];
-long long IMHIST[256];
+thread_local int8_t *IMGEHL[IMNB];
+thread_local long long IMHIST[256];
 
 #endif
 
 //global branch GEHL
 #define LOGGNB 10		// 1 1K + 2 * 512-entry tables
 #define GNB 3
-int Gm[GNB] = { 40, 24, 10 };
-int8_t GGEHLA[GNB][(1 << LOGGNB)] = { {0} };
+thread_local int Gm[GNB] = { 40, 24, 10 };
+thread_local int8_t GGEHLA[GNB][(1 << LOGGNB)] = { {0} };
 
-int8_t *GGEHL[GNB];
+thread_local int8_t *GGEHL[GNB];
 
 //variation on global branch history
 #define PNB 3
 #define LOGPNB 9		// 1 1K + 2 * 512-entry tables
-int Pm[PNB] = { 25, 16, 9 };
-int8_t PGEHLA[PNB][(1 << LOGPNB)] = { {0} };
+thread_local int Pm[PNB] = { 25, 16, 9 };
+thread_local int8_t PGEHLA[PNB][(1 << LOGPNB)] = { {0} };
 
-int8_t *PGEHL[PNB];
+thread_local int8_t *PGEHL[PNB];
 
 //first local history
 #define LOGLNB  10		// 1 1K + 2 * 512-entry tables
 #define LNB 3
-int Lm[LNB] = { 11, 6, 3 };
-int8_t LGEHLA[LNB][(1 << LOGLNB)] = { {0} };
+thread_local int Lm[LNB] = { 11, 6, 3 };
+thread_local int8_t LGEHLA[LNB][(1 << LOGLNB)] = { {0} };
 
-int8_t *LGEHL[LNB];
+thread_local int8_t *LGEHL[LNB];
 #define  LOGLOCAL 8
 #define NLOCAL (1<<LOGLOCAL)
 #define INDLOCAL ((PC ^ (PC >>2)) & (NLOCAL-1))
-long long L_shist[NLOCAL];	//local histories
+thread_local long long L_shist[NLOCAL];	//local histories
 
 // second local history
 #define LOGSNB 9		// 1 1K + 2 * 512-entry tables
 #define SNB 3
-int Sm[SNB] = { 16, 11, 6 };
-int8_t SGEHLA[SNB][(1 << LOGSNB)] = { {0} };
+thread_local int Sm[SNB] = { 16, 11, 6 };
+thread_local int8_t SGEHLA[SNB][(1 << LOGSNB)] = { {0} };
 
-int8_t *SGEHL[SNB];
+thread_local int8_t *SGEHL[SNB];
 #define LOGSECLOCAL 4
 #define NSECLOCAL (1<<LOGSECLOCAL)	//Number of second local histories
 #define INDSLOCAL  (((PC ^ (PC >>5))) & (NSECLOCAL-1))
-long long S_slhist[NSECLOCAL];
+thread_local long long S_slhist[NSECLOCAL];
 
 //third local history
 #define LOGTNB 10		// 2 * 512-entry tables
 #define TNB 2
-int Tm[TNB] = { 9, 4 };
-int8_t TGEHLA[TNB][(1 << LOGTNB)] = { {0} };
+thread_local int Tm[TNB] = { 9, 4 };
+thread_local int8_t TGEHLA[TNB][(1 << LOGTNB)] = { {0} };
 
-int8_t *TGEHL[TNB];
+thread_local int8_t *TGEHL[TNB];
 #define NTLOCAL 16
 #define INDTLOCAL  (((PC ^ (PC >>(LOGTNB)))) & (NTLOCAL-1))	// different hash for the history
-long long T_slhist[NTLOCAL];
+thread_local long long T_slhist[NTLOCAL];
 
 
 
@@ -210,24 +204,24 @@ long long T_slhist[NTLOCAL];
 #define LOGSIZEUP 0
 #endif
 #define LOGSIZEUPS  (LOGSIZEUP/2)
-int updatethreshold;
-int Pupdatethreshold[(1 << LOGSIZEUP)];	//size is fixed by LOGSIZEUP
+thread_local int updatethreshold;
+thread_local int Pupdatethreshold[(1 << LOGSIZEUP)];	//size is fixed by LOGSIZEUP
 #define INDUPD (PC ^ (PC >>2)) & ((1 << LOGSIZEUP) - 1)
 #define INDUPDS ((PC ^ (PC >>2)) & ((1 << (LOGSIZEUPS)) - 1))
-int8_t WG[(1 << LOGSIZEUPS)];
-int8_t WL[(1 << LOGSIZEUPS)];
-int8_t WS[(1 << LOGSIZEUPS)];
-int8_t WT[(1 << LOGSIZEUPS)];
-int8_t WP[(1 << LOGSIZEUPS)];
-int8_t WI[(1 << LOGSIZEUPS)];
-int8_t WIM[(1 << LOGSIZEUPS)];
-int8_t WB[(1 << LOGSIZEUPS)];
+thread_local int8_t WG[(1 << LOGSIZEUPS)];
+thread_local int8_t WL[(1 << LOGSIZEUPS)];
+thread_local int8_t WS[(1 << LOGSIZEUPS)];
+thread_local int8_t WT[(1 << LOGSIZEUPS)];
+thread_local int8_t WP[(1 << LOGSIZEUPS)];
+thread_local int8_t WI[(1 << LOGSIZEUPS)];
+thread_local int8_t WIM[(1 << LOGSIZEUPS)];
+thread_local int8_t WB[(1 << LOGSIZEUPS)];
 #define EWIDTH 6
-int LSUM;
+thread_local int LSUM;
 
 // The two counters used to choose between TAGE and SC on Low Conf SC
-int8_t FirstH, SecondH;
-bool MedConf;			// is the TAGE prediction medium confidence
+thread_local int8_t FirstH, SecondH;
+thread_local bool MedConf;			// is the TAGE prediction medium confidence
 
 
 #define CONFWIDTH 7		//for the counters in the choser
@@ -319,7 +313,7 @@ public:
 #define NBANKLOW 10		// number of banks in the shared bank-interleaved for the low history lengths
 #define NBANKHIGH 20		// number of banks in the shared bank-interleaved for the  history lengths
 
-int SizeTable[NHIST + 1];
+thread_local int SizeTable[NHIST + 1];
 
 
 #define BORN 13			// below BORN in the table for low history lengths, >= BORN in the table for high history lengths,
@@ -338,9 +332,9 @@ int SizeTable[NHIST + 1];
 #define TBITS 8			//minimum width of the tags  (low history lengths), +4 for high history lengths
 
 
-bool NOSKIP[NHIST + 1];		// to manage the associativity for different history lengths
-bool LowConf;
-bool HighConf;
+thread_local bool NOSKIP[NHIST + 1];		// to manage the associativity for different history lengths
+thread_local bool LowConf;
+thread_local bool HighConf;
 
 
 
@@ -356,40 +350,40 @@ bool HighConf;
 
 //the counter(s) to chose between longest match and alternate prediction on TAGE when weak counters
 #define LOGSIZEUSEALT 4
-bool AltConf;			// Confidence on the alternate prediction
+thread_local bool AltConf;			// Confidence on the alternate prediction
 #define ALTWIDTH 5
 #define SIZEUSEALT  (1<<(LOGSIZEUSEALT))
 #define INDUSEALT (((((HitBank-1)/8)<<1)+AltConf) % (SIZEUSEALT-1))
-int8_t use_alt_on_na[SIZEUSEALT];
+thread_local int8_t use_alt_on_na[SIZEUSEALT];
 //very marginal benefit
-long long GHIST;
-int8_t BIM;
+thread_local long long GHIST;
+thread_local int8_t BIM;
 
-int TICK;			// for the reset of the u counter
-uint8_t ghist[HISTBUFFERLENGTH];
-int ptghist;
-long long phist;		//path history
-folded_history ch_i[NHIST + 1];	//utility for computing TAGE indices
-folded_history ch_t[2][NHIST + 1];	//utility for computing TAGE tags
+thread_local int TICK;			// for the reset of the u counter
+thread_local uint8_t ghist[HISTBUFFERLENGTH];
+thread_local int ptghist;
+thread_local long long phist;		//path history
+thread_local folded_history ch_i[NHIST + 1];	//utility for computing TAGE indices
+thread_local folded_history ch_t[2][NHIST + 1];	//utility for computing TAGE tags
 
 //For the TAGE predictor
-bentry *btable;			//bimodal TAGE table
-gentry *gtable[NHIST + 1];	// tagged TAGE tables
-int m[NHIST + 1];
-int TB[NHIST + 1];
-int logg[NHIST + 1];
-
-int GI[NHIST + 1];		// indexes to the different tables are computed only once
-uint GTAG[NHIST + 1];		// tags for the different tables are computed only once
-int BI;				// index of the bimodal table
-bool pred_taken;		// prediction
-bool alttaken;			// alternate  TAGEprediction
-bool tage_pred;			// TAGE prediction
-bool LongestMatchPred;
-int HitBank;			// longest matching bank
-int AltBank;			// alternate matching bank
-int Seed;			// for the pseudo-random number generator
-bool pred_inter;
+thread_local bentry *btable;			//bimodal TAGE table
+thread_local gentry *gtable[NHIST + 1];	// tagged TAGE tables
+thread_local int m[NHIST + 1];
+thread_local int TB[NHIST + 1];
+thread_local int logg[NHIST + 1];
+
+thread_local int GI[NHIST + 1];		// indexes to the different tables are computed only once
+thread_local uint GTAG[NHIST + 1];		// tags for the different tables are computed only once
+thread_local int BI;				// index of the bimodal table
+thread_local bool pred_taken;		// prediction
+thread_local bool alttaken;			// alternate  TAGEprediction
+thread_local bool tage_pred;			// TAGE prediction
+thread_local bool LongestMatchPred;
+thread_local int HitBank;			// longest matching bank
+thread_local int AltBank;			// alternate matching bank
+thread_local int Seed;			// for the pseudo-random number generator
+thread_local bool pred_inter;
 
 
 #ifdef LOOPPREDICTOR
@@ -425,15 +419,15 @@ public:
 
 };
 
-lentry *ltable;			//loop predictor table
+thread_local lentry *ltable;			//loop predictor table
 //variables for the loop predictor
-bool predloop;			// loop predictor prediction
-int LIB;
-int LI;
-int LHIT;			//hitting way in the loop predictor
-int LTAG;			//tag on the loop predictor
-bool LVALID;			// validity of the loop predictor prediction
-int8_t WITHLOOP;		// counter to monitor whether or not loop prediction is beneficial
+thread_local bool predloop;			// loop predictor prediction
+thread_local int LIB;
+thread_local int LI;
+thread_local int LHIT;			//hitting way in the loop predictor
+thread_local int LTAG;			//tag on the loop predictor
+thread_local bool LVALID;			// validity of the loop predictor prediction
+thread_local int8_t WITHLOOP;		// counter to monitor whether or not loop prediction is beneficial
 
 #endif
 
@@ -590,6 +584,21 @@ public:
     predictorsize ();
   }
 
+  PREDICTOR (const PREDICTOR &) = delete;
+  PREDICTOR & operator= (const PREDICTOR &) = delete;
+
+  // the simulator creates a PREDICTOR per trace on each thread, so the tables reinit() allocates
+  // must not outlive it
+  ~PREDICTOR (void)
+  {
+#ifdef LOOPPREDICTOR
+    delete[] ltable;
+#endif
+    delete[] gtable[1];
+    delete[] gtable[BORN];
+    delete[] btable;
+  }
+
 
   void reinit ()
   {
@@ -633,15 +642,21 @@ public:
       }
 
 
+    // gentry and lentry have padding, which the checkpoints store with the tables: clear it, so
+    // that a run resumed from a checkpoint holds the same bytes as an uninterrupted one.
+    // Their constructors set every field to 0 anyway.
 #ifdef LOOPPREDICTOR
     ltable = new lentry[1 << (LOGL)];
+    memset (ltable, 0, sizeof (lentry) << LOGL);
 #endif
 
 
     gtable[1] = new gentry[NBANKLOW * (1 << LOGG)];
+    memset (gtable[1], 0, sizeof (gentry) * NBANKLOW * (1 << LOGG));
     SizeTable[1] = NBANKLOW * (1 << LOGG);
 
     gtable[BORN] = new gentry[NBANKHIGH * (1 << LOGG)];
+    memset (gtable[BORN], 0, sizeof (gentry) * NBANKHIGH * (1 << LOGG));
     SizeTable[BORN] = NBANKHIGH * (1 << LOGG);
 
     for (int i = BORN + 1; i <= NHIST; i++)
@@ -1294,18 +1309,6 @@ int T = (PC ^ (phist & ((1 << m[BORN]) - 1))) % NBANKHIGH;
 			bool predDir, UINT64 branchTarget)
   {
 
-    // BUG: Last iteration is inexact!
-    uint32_t mispred = resolveDir != predDir;
-    stats.MPKBr_periodic[stats.period_number] += 1000.0*(double)(mispred)/(double)(stats.period);
-
-    stats.period_tick++;
-    if (stats.period_tick == stats.period) {
-        stats.period_tick = 0;
-        stats.period_number++;
-        stats.MPKBr_periodic.push_back(0.0);
-    }
-
-
 #ifdef SC
 #ifdef LOOPPREDICTOR
     if (LVALID)
@@ -1820,6 +1823,39 @@ int T = (PC ^ (phist & ((1 << m[BORN]) - 1))) % NBANKHIGH;
       }
   }
 #endif
+
+// Tables and histories, for simulator checkpoints (see sim/src/checkpoint.h)
+  template < class Archive > void serialize (Archive & ar)
+  {
+    using cereal::binary_data;
+    ar (THRES, IMLIcount, Seed, TICK, GHIST, phist, ptghist, updatethreshold);
+    ar (binary_data (ghist, sizeof (ghist)),
+	binary_data (ch_i, sizeof (ch_i)), binary_data (ch_t, sizeof (ch_t)));
+    ar (binary_data (btable, sizeof (bentry) << LOGB),
+	binary_data (gtable[1], sizeof (gentry) * NBANKLOW * (1 << LOGG)),
+	binary_data (gtable[BORN], sizeof (gentry) * NBANKHIGH * (1 << LOGG)),
+	binary_data (use_alt_on_na, sizeof (use_alt_on_na)));
+    ar (binary_data (Bias, sizeof (Bias)), binary_data (BiasSK, sizeof (BiasSK)),
+	binary_data (BiasBank, sizeof (BiasBank)),
+	binary_data (GGEHLA, sizeof (GGEHLA)), binary_data (PGEHLA, sizeof (PGEHLA)),
+	binary_data (LGEHLA, sizeof (LGEHLA)), binary_data (SGEHLA, sizeof (SGEHLA)),
+	binary_data (TGEHLA, sizeof (TGEHLA)),
+	binary_data (L_shist, sizeof (L_shist)), binary_data (S_slhist, sizeof (S_slhist)),
+	binary_data (T_slhist, sizeof (T_slhist)),
+	binary_data (Pupdatethreshold, sizeof (Pupdatethreshold)),
+	binary_data (WG, sizeof (WG)), binary_data (WL, sizeof (WL)),
+	binary_data (WS, sizeof (WS)), binary_data (WT, sizeof (WT)),
+	binary_data (WP, sizeof (WP)), binary_data (WI, sizeof (WI)),
+	binary_data (WIM, sizeof (WIM)), binary_data (WB, sizeof (WB)),
+	FirstH, SecondH);
+#ifdef IMLI
+    ar (binary_data (IGEHLA, sizeof (IGEHLA)), binary_data (IMGEHLA, sizeof (IMGEHLA)),
+	binary_data (IMHIST, sizeof (IMHIST)));
+#endif
+#ifdef LOOPPREDICTOR
+    ar (binary_data (ltable, sizeof (lentry) << LOGL), WITHLOOP);
+#endif
+  }
 };
 
 
@@ -0,0 +1,171 @@
+/*!
+ * \file    bt10_decoder.h
+ * \brief   Vectorized kernels widening the runs of 1-byte edge ids of the BT10 edge sequence.
+ *
+ * A BT10 edge sequence is mostly 1-byte edge ids, interrupted by 0xFF escapes carrying a
+ * 4-byte id. The kernels below copy such a run into the uint32_t edge id buffer, stopping
+ * at the first byte that is not a valid 1-byte id; BT9Reader::parser_BT10() decodes that
+ * record the slow way and calls the kernel again.
+ *
+ * The AVX2 and SSE4.1 versions are compiled with per-function target attributes and picked
+ * at runtime, so the simulator binary itself needs no -march flag.
+ */
+
+#pragma once
+
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define BT10_DECODER_X86
+#endif
+
+namespace bt9 {
+
+    /// BT10 run decoder implementations
+    enum class BT10Decoder {
+        SCALAR,
+        SSE4,
+        AVX2
+    };
+
+    /*!
+     * \brief Widen a run of 1-byte edge ids
+     * \param in BT10 bytes
+     * \param n Number of bytes available in `in` and of entries available in `out`
+     * \param out Destination edge ids; entries past the returned count may be overwritten
+     * \param max_id Largest valid 1-byte edge id, at most 254 so an escape byte always ends the run
+     * \return Number of leading bytes of `in` that are valid 1-byte ids, all written to `out`
+     */
+    using BT10WidenFunction = uint64_t (*)(const uint8_t * in, uint64_t n, uint32_t * out, uint8_t max_id);
+
+    /// Byte-at-a-time version, also used for the tails of the vector versions
+    inline uint64_t widenBT10Scalar(const uint8_t * in, uint64_t n, uint32_t * out, uint8_t max_id)
+    {
+        for (uint64_t i = 0; i < n; i++) {
+            if (in[i] > max_id) {
+                return i;
+            }
+            out[i] = in[i];
+        }
+
+        return n;
+    }
+
+#ifdef BT10_DECODER_X86
+    /// 16 ids per step: unsigned max-compare finds the run end, pmovzxbd widens
+    __attribute__((target("sse4.1")))
+    inline uint64_t widenBT10SSE4(const uint8_t * in, uint64_t n, uint32_t * out, uint8_t max_id)
+    {
+        const __m128i limit = _mm_set1_epi8(static_cast<char>(max_id));
+
+        uint64_t i = 0;
+        for (; i + 16 <= n; i += 16) {
+            const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + i));
+            const __m128i valid = _mm_cmpeq_epi8(_mm_max_epu8(v, limit), limit);
+
+            __m128i * dst = reinterpret_cast<__m128i *>(out + i);
+            _mm_storeu_si128(dst + 0, _mm_cvtepu8_epi32(v));
+            _mm_storeu_si128(dst + 1, _mm_cvtepu8_epi32(_mm_srli_si128(v, 4)));
+            _mm_storeu_si128(dst + 2, _mm_cvtepu8_epi32(_mm_srli_si128(v, 8)));
+            _mm_storeu_si128(dst + 3, _mm_cvtepu8_epi32(_mm_srli_si128(v, 12)));
+
+            const uint32_t stop = ~static_cast<uint32_t>(_mm_movemask_epi8(valid)) & 0xFFFF;
+            if (stop != 0) {
+                return i + __builtin_ctz(stop);
+            }
+        }
+
+        return i + widenBT10Scalar(in + i, n - i, out + i, max_id);
+    }
+
+    /// 32 ids per step, same scheme as widenBT10SSE4()
+    __attribute__((target("avx2")))
+    inline uint64_t widenBT10AVX2(const uint8_t * in, uint64_t n, uint32_t * out, uint8_t max_id)
+    {
+        const __m256i limit = _mm256_set1_epi8(static_cast<char>(max_id));
+
+        uint64_t i = 0;
+        for (; i + 32 <= n; i += 32) {
+            const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(in + i));
+            const __m256i valid = _mm256_cmpeq_epi8(_mm256_max_epu8(v, limit), limit);
+
+            const __m128i lo = _mm256_castsi256_si128(v);
+            const __m128i hi = _mm256_extracti128_si256(v, 1);
+
+            __m256i * dst = reinterpret_cast<__m256i *>(out + i);
+            _mm256_storeu_si256(dst + 0, _mm256_cvtepu8_epi32(lo));
+            _mm256_storeu_si256(dst + 1, _mm256_cvtepu8_epi32(_mm_srli_si128(lo, 8)));
+            _mm256_storeu_si256(dst + 2, _mm256_cvtepu8_epi32(hi));
+            _mm256_storeu_si256(dst + 3, _mm256_cvtepu8_epi32(_mm_srli_si128(hi, 8)));
+
+            const uint32_t stop = ~static_cast<uint32_t>(_mm256_movemask_epi8(valid));
+            if (stop != 0) {
+                return i + __builtin_ctz(stop);
+            }
+        }
+
+        return i + widenBT10Scalar(in + i, n - i, out + i, max_id);
+    }
+#endif
+
+    /// Printable decoder name
+    inline const char * bt10DecoderName(BT10Decoder decoder)
+    {
+        switch (decoder) {
+            case BT10Decoder::SSE4:
+                return "sse4";
+            case BT10Decoder::AVX2:
+                return "avx2";
+            default:
+                return "scalar";
+        }
+    }
+
+    /// Whether this CPU can run a decoder
+    inline bool bt10DecoderSupported(BT10Decoder decoder)
+    {
+#ifdef BT10_DECODER_X86
+        switch (decoder) {
+            case BT10Decoder::SSE4:
+                return __builtin_cpu_supports("sse4.1");
+            case BT10Decoder::AVX2:
+                return __builtin_cpu_supports("avx2");
+            default:
+                return true;
+        }
+#else
+        return (decoder == BT10Decoder::SCALAR);
+#endif
+    }
+
+    /// Fastest decoder this CPU supports
+    inline BT10Decoder bestBT10Decoder()
+    {
+        if (bt10DecoderSupported(BT10Decoder::AVX2)) {
+            return BT10Decoder::AVX2;
+        }
+        if (bt10DecoderSupported(BT10Decoder::SSE4)) {
+            return BT10Decoder::SSE4;
+        }
+
+        return BT10Decoder::SCALAR;
+    }
+
+    /// Kernel of a decoder, which must be supported by this CPU
+    inline BT10WidenFunction bt10WidenFunction(BT10Decoder decoder)
+    {
+#ifdef BT10_DECODER_X86
+        switch (decoder) {
+            case BT10Decoder::SSE4:
+                return widenBT10SSE4;
+            case BT10Decoder::AVX2:
+                return widenBT10AVX2;
+            default:
+                break;
+        }
+#endif
+        return widenBT10Scalar;
+    }
+
+}
@@ -10,8 +10,16 @@
 #pragma once
 
 #include <assert.h>
+#include <algorithm>
+#include <cstdint>
 #include <iostream>
 #include <iomanip>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_map>
 
 namespace bt9 {
     /*!
@@ -80,8 +88,8 @@ namespace bt9 {
         BrBehavior::Direction       direction       : 3;
         BrBehavior::Indirectness    indirectness    : 2;
 
-        inline void parseBrBehavior(const std::string &);
-        inline void parseBrClass(const std::string &);
+        inline void parseBrBehavior(std::string_view);
+        inline void parseBrClass(std::string_view);
     };
     
 
@@ -703,7 +711,7 @@ namespace bt9 {
      *       changes are made on BrBehavior::Direction
      */
     template<>
-    const EnumToStrMapType<BrBehavior::Direction> & StrEnumMap<BrBehavior::Direction>::getEnumToStrMap() 
+    inline const EnumToStrMapType<BrBehavior::Direction> & StrEnumMap<BrBehavior::Direction>::getEnumToStrMap() 
     {
         static const EnumToStrMapType<BrBehavior::Direction> map =
         {
@@ -721,7 +729,7 @@ namespace bt9 {
      *       changes are made on BrBehavior::Indirectness
      */
     template<>
-    const EnumToStrMapType<BrBehavior::Indirectness> & StrEnumMap<BrBehavior::Indirectness>::getEnumToStrMap()
+    inline const EnumToStrMapType<BrBehavior::Indirectness> & StrEnumMap<BrBehavior::Indirectness>::getEnumToStrMap()
     {
         static const EnumToStrMapType<BrBehavior::Indirectness> map =
         {
@@ -738,7 +746,7 @@ namespace bt9 {
      *       changes are made on BrClass::Type
      */
     template<>
-    const EnumToStrMapType<BrClass::Type> & StrEnumMap<BrClass::Type>::getEnumToStrMap()
+    inline const EnumToStrMapType<BrClass::Type> & StrEnumMap<BrClass::Type>::getEnumToStrMap()
     {
         static const EnumToStrMapType<BrClass::Type> map =
         {
@@ -757,7 +765,7 @@ namespace bt9 {
      *       changes are made on BrClass::Directness
      */
     template<>
-    const EnumToStrMapType<BrClass::Directness> & StrEnumMap<BrClass::Directness>::getEnumToStrMap()
+    inline const EnumToStrMapType<BrClass::Directness> & StrEnumMap<BrClass::Directness>::getEnumToStrMap()
     {
         static const EnumToStrMapType<BrClass::Directness> map =
         {
@@ -775,7 +783,7 @@ namespace bt9 {
      *       changes are made on BrClass::Conditionality
      */
     template<>
-    const EnumToStrMapType<BrClass::Conditionality> & StrEnumMap<BrClass::Conditionality>::getEnumToStrMap()
+    inline const EnumToStrMapType<BrClass::Conditionality> & StrEnumMap<BrClass::Conditionality>::getEnumToStrMap()
     {
         static const EnumToStrMapType<BrClass::Conditionality> map =
         {
@@ -787,19 +795,37 @@ namespace bt9 {
         return map;
     }
 
+    /*!
+     * \brief Pop the next non-empty '+' separated token (e.g. "CND" from "CND+DIR+JMP")
+     * \return Returns false once the string is exhausted
+     */
+    inline bool nextPlusSeparatedToken(std::string_view & str, std::string & token)
+    {
+        while (!str.empty()) {
+            const auto pos = str.find('+');
+            const auto piece = str.substr(0, pos);
+            str.remove_prefix((pos == std::string_view::npos) ? str.size() : pos + 1);
+
+            if (!piece.empty()) {
+                token.assign(piece);
+                return true;
+            }
+        }
+
+        return false;
+    }
+
     /*!
      * \brief Parse BrBehavior
      *
      * This is used by the BT9 reader library to parse the dynamic branch behavior
      * in the BT9 tracefile
      */
-    void BrClass_BrBehavior::parseBrBehavior(const std::string & str)
+    void BrClass_BrBehavior::parseBrBehavior(std::string_view str)
     {
-        std::string token = str;
-        std::replace(token.begin(), token.end(), '+', ' ');
-        std::stringstream ss(token);
-        
-        while (ss >> token) {
+        std::string token;
+
+        while (nextPlusSeparatedToken(str, token)) {
             auto it1 = StrEnumMap<BrBehavior::Direction>::getStrToEnumMap().find(token);
             if (it1 != StrEnumMap<BrBehavior::Direction>::getStrToEnumMap().end()) {
                 direction = it1->second;
@@ -824,13 +850,11 @@ namespace bt9 {
      * This is used by the BT9 reader library to parse the static branch categories
      * in the BT9 tracefile
      */
-    void BrClass_BrBehavior::parseBrClass(const std::string & str)
+    void BrClass_BrBehavior::parseBrClass(std::string_view str)
     {
-        std::string token = str;
-        std::replace(token.begin(), token.end(), '+', ' ');
-        std::stringstream ss(token);
+        std::string token;
 
-        while (ss >> token) {
+        while (nextPlusSeparatedToken(str, token)) {
             auto it1 = StrEnumMap<BrClass::Type>::getStrToEnumMap().find(token);
             if (it1 != StrEnumMap<BrClass::Type>::getStrToEnumMap().end()) {
                 type = it1->second;
@@ -0,0 +1,184 @@
+/*!
+ * \file    bt9_capi.cc
+ * \brief   Implementation of the C interface in bt9_capi.h over bt9::BT9Reader.
+ */
+
+#include <algorithm>
+#include <cstring>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "bt9_capi.h"
+#include "bt9_reader.h"
+
+static_assert(sizeof(bt9_node) == 48, "bt9_node layout is part of the ABI");
+static_assert(sizeof(bt9_edge) == 48, "bt9_edge layout is part of the ABI");
+
+struct bt9_trace {
+  bt9_trace(const char* path, bool pipelined, const char* cache_dir) :
+    reader(path, pipelined, (cache_dir != nullptr) ? cache_dir : "")
+  {}
+
+  bt9::BT9Reader reader;
+  std::vector<bt9::BT9HotEdge> block = std::vector<bt9::BT9HotEdge>(BRANCH_BLOCK_SIZE);
+};
+
+namespace {
+
+thread_local std::string lastError;
+
+// Run a call, turning any exception into its error return value so none crosses the C interface
+template<typename Result, typename Call>
+Result Guard(Result error, Call&& call)
+{
+  try {
+    return call();
+  }
+  catch (const std::exception& ex) {
+    lastError = ex.what();
+  }
+  catch (...) {
+    lastError = "unknown error";
+  }
+  return error;
+}
+
+}  // namespace
+
+extern "C" {
+
+int bt9_capi_version(void)
+{
+  return BT9_CAPI_VERSION;
+}
+
+const char* bt9_last_error(void)
+{
+  return lastError.c_str();
+}
+
+bt9_trace* bt9_open(const char* path, int pipelined, const char* cache_dir)
+{
+  return Guard<bt9_trace*>(nullptr, [&] { return new bt9_trace(path, pipelined != 0, cache_dir); });
+}
+
+void bt9_close(bt9_trace* trace)
+{
+  delete trace;
+}
+
+int64_t bt9_num_nodes(const bt9_trace* trace)
+{
+  return static_cast<int64_t>(trace->reader.loadStats().num_nodes);
+}
+
+int64_t bt9_num_edges(const bt9_trace* trace)
+{
+  return static_cast<int64_t>(trace->reader.loadStats().num_edges);
+}
+
+int64_t bt9_get_nodes(const bt9_trace* trace, bt9_node* out, int64_t capacity)
+{
+  const int64_t count = std::min(capacity, bt9_num_nodes(trace));
+  for (int64_t i = 0; i < count; i++) {
+    const bt9::TraceCacheNode rec = trace->reader.nodeRecord_(static_cast<uint32_t>(i));
+    const bt9::BrClass_BrBehavior& br = rec.br_class_br_behavior;
+
+    bt9_node& node = out[i];
+    node.pc = rec.br_virtual_addr;
+    node.phy_addr = rec.br_phy_addr;
+    node.id = rec.id;
+    node.opcode = rec.opcode;
+    node.tgt_cnt = rec.br_tgt_cnt;
+    node.taken_cnt = rec.br_taken_cnt;
+    node.untaken_cnt = rec.br_untaken_cnt;
+    node.opcode_size = rec.opcode_size;
+    node.phy_addr_valid = rec.br_phy_addr_valid;
+    node.op_type = static_cast<uint8_t>(bt9::BT9Reader::classifyOpType_(br));
+    node.type = static_cast<uint8_t>(br.type);
+    node.directness = static_cast<uint8_t>(br.directness);
+    node.conditionality = static_cast<uint8_t>(br.conditionality);
+    node.direction = static_cast<uint8_t>(br.direction);
+    node.indirectness = static_cast<uint8_t>(br.indirectness);
+  }
+  return count;
+}
+
+int64_t bt9_get_edges(const bt9_trace* trace, bt9_edge* out, int64_t capacity)
+{
+  const int64_t count = std::min(capacity, bt9_num_edges(trace));
+  for (int64_t i = 0; i < count; i++) {
+    const bt9::TraceCacheEdge rec = trace->reader.edgeRecord_(static_cast<uint32_t>(i));
+
+    bt9_edge& edge = out[i];
+    edge.target = rec.br_virtual_tgt;
+    edge.phy_target = rec.br_phy_tgt;
+    edge.traverse_cnt = rec.observed_traverse_cnt;
+    edge.id = rec.id;
+    edge.src_node_id = rec.src_node_id;
+    edge.dest_node_id = rec.dest_node_id;
+    edge.inst_cnt = static_cast<uint32_t>(rec.inst_cnt);
+    edge.taken = rec.is_taken_path;
+    edge.phy_target_valid = rec.br_phy_tgt_valid;
+  }
+  return count;
+}
+
+int64_t bt9_header_field(const bt9_trace* trace, const char* key, char* buffer, int64_t size)
+{
+  // The reader keeps the keys as written in the trace, with their colon
+  std::string value;
+  const std::string name(key);
+  if (!trace->reader.header.getFieldValueStr(name, value) && !trace->reader.header.getFieldValueStr(name + ":", value)) {
+    return -1;
+  }
+
+  if (size > 0) {
+    const size_t length = std::min<size_t>(value.size(), static_cast<size_t>(size - 1));
+    memcpy(buffer, value.data(), length);
+    buffer[length] = '\0';
+  }
+  return static_cast<int64_t>(value.size());
+}
+
+int64_t bt9_read_branches(bt9_trace* trace, uint64_t* pc, uint64_t* target, uint8_t* taken,
+                          uint8_t* op_type, int64_t capacity)
+{
+  return Guard<int64_t>(-1, [&] {
+    int64_t count = 0;
+
+    // Branches come out of the reader as hot edge records and are split into the columns
+    while (count < capacity) {
+      const size_t wanted = static_cast<size_t>(std::min<int64_t>(capacity - count, BRANCH_BLOCK_SIZE));
+      const uint64_t blockSize = trace->reader.readBranchBlock(std::span(trace->block).first(wanted));
+
+      for (uint64_t i = 0; i < blockSize; i++) {
+        const bt9::BT9HotEdge& br = trace->block[i];
+        if (pc) pc[count + i] = br.pc;
+        if (target) target[count + i] = br.target;
+        if (taken) taken[count + i] = br.taken;
+        if (op_type) op_type[count + i] = br.op_type;
+      }
+
+      count += static_cast<int64_t>(blockSize);
+      if (blockSize < wanted) {
+        break;
+      }
+    }
+    return count;
+  });
+}
+
+int bt9_seek(bt9_trace* trace, uint64_t branch)
+{
+  return Guard<int>(-1, [&] {
+    if (!trace->reader.seekToBranch(branch)) {
+      lastError = "\'" + trace->reader.tracefile_name_ + "\' has fewer than " + std::to_string(branch) + " branches";
+      return -1;
+    }
+    return 0;
+  });
+}
+
+}  // extern "C"
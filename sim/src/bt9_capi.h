@@ -0,0 +1,137 @@
+/*!
+ * \file    bt9_capi.h
+ * \brief   C interface of the BT9 reader, built as the shared library libbt9.so (task libbt9).
+ *
+ * Lets other languages stream traces at native speed; scripts/bt9.py wraps it with ctypes and
+ * NumPy. A trace is opened with bt9_open(), its node and edge tables are copied out as arrays
+ * of bt9_node/bt9_edge records, and its branches are read in blocks into caller-provided
+ * column arrays, so no memory crosses the interface that the caller did not allocate.
+ *
+ * No function throws. Failing functions return NULL or -1 and leave a message for
+ * bt9_last_error(). A trace handle must only be used by one thread at a time.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// Only the functions below are exported, libbt9.so is built with -fvisibility=hidden
+#define BT9_CAPI_EXPORT __attribute__((visibility("default")))
+
+/// Bumped whenever a record layout or a function signature changes
+#define BT9_CAPI_VERSION 1
+
+/// Opaque handle of an open trace
+typedef struct bt9_trace bt9_trace;
+
+/*!
+ * \struct bt9_node
+ * \brief Node table record, a static branch
+ * \note The class and behavior fields hold the values of the bt9::BrClass and bt9::BrBehavior enums
+ */
+typedef struct bt9_node {
+    uint64_t pc;                //!< Branch virtual address
+    uint64_t phy_addr;          //!< Branch physical address, valid if phy_addr_valid
+    uint32_t id;                //!< Node record id
+    uint32_t opcode;            //!< Instruction opcode
+    uint32_t tgt_cnt;           //!< Distinct targets observed
+    uint32_t taken_cnt;         //!< Times taken
+    uint32_t untaken_cnt;       //!< Times not taken
+    uint8_t opcode_size;        //!< Instruction size in bytes
+    uint8_t phy_addr_valid;     //!< The trace has a physical address for this branch
+    uint8_t op_type;            //!< OpType passed to the predictor (utils.h)
+    uint8_t type;               //!< BrClass::Type
+    uint8_t directness;         //!< BrClass::Directness
+    uint8_t conditionality;     //!< BrClass::Conditionality
+    uint8_t direction;          //!< BrBehavior::Direction
+    uint8_t indirectness;       //!< BrBehavior::Indirectness
+} bt9_node;
+
+/*!
+ * \struct bt9_edge
+ * \brief Edge table record, an outcome of a static branch
+ */
+typedef struct bt9_edge {
+    uint64_t target;            //!< Branch virtual target
+    uint64_t phy_target;        //!< Branch physical target, valid if phy_target_valid
+    uint64_t traverse_cnt;      //!< Times the edge was traversed
+    uint32_t id;                //!< Edge record id
+    uint32_t src_node_id;       //!< Node the branch is taken or not taken from
+    uint32_t dest_node_id;      //!< Next branch node
+    uint32_t inst_cnt;          //!< Non-branch instructions on this edge
+    uint8_t taken;              //!< The edge is the taken path
+    uint8_t phy_target_valid;   //!< The trace has a physical target for this edge
+} bt9_edge;
+
+/// Get BT9_CAPI_VERSION of the loaded library
+BT9_CAPI_EXPORT int bt9_capi_version(void);
+
+/*!
+ * \brief Message of the last failed call on this thread
+ * \return Returns an empty string if no call has failed yet
+ */
+BT9_CAPI_EXPORT const char * bt9_last_error(void);
+
+/*!
+ * \brief Open a trace and load its node and edge tables
+ * \param path Trace file: BT9 text (.zst compressed or not), columnar (.bt9c) or one published by a trace server
+ * \param pipelined Decode the edge sequence on a background thread
+ * \param cache_dir Directory of .bt10c trace caches, NULL or empty to always decode the trace
+ * \return Returns NULL on failure
+ */
+BT9_CAPI_EXPORT bt9_trace * bt9_open(const char * path, int pipelined, const char * cache_dir);
+
+/// Close a trace, NULL is ignored
+BT9_CAPI_EXPORT void bt9_close(bt9_trace * trace);
+
+/// Get the number of node table records
+BT9_CAPI_EXPORT int64_t bt9_num_nodes(const bt9_trace * trace);
+
+/// Get the number of edge table records
+BT9_CAPI_EXPORT int64_t bt9_num_edges(const bt9_trace * trace);
+
+/*!
+ * \brief Copy the node table, ordered by id
+ * \param out Array of at least capacity records
+ * \return Returns the number of records copied, at most capacity
+ */
+BT9_CAPI_EXPORT int64_t bt9_get_nodes(const bt9_trace * trace, bt9_node * out, int64_t capacity);
+
+/*!
+ * \brief Copy the edge table, ordered by id
+ * \param out Array of at least capacity records
+ * \return Returns the number of records copied, at most capacity
+ */
+BT9_CAPI_EXPORT int64_t bt9_get_edges(const bt9_trace * trace, bt9_edge * out, int64_t capacity);
+
+/*!
+ * \brief Look up a header field, such as "branch_instruction_count", the trailing colon is optional
+ * \param buffer Receives the value, NUL terminated and truncated to size bytes
+ * \return Returns the length of the whole value, or -1 if the header has no such field
+ */
+BT9_CAPI_EXPORT int64_t bt9_header_field(const bt9_trace * trace, const char * key, char * buffer, int64_t size);
+
+/*!
+ * \brief Read the next branches of the edge sequence list into column arrays
+ * \param pc, target, taken, op_type Arrays of at least capacity elements, any may be NULL
+ *        to skip that column
+ * \return Returns the number of branches read, less than capacity only at the end of the
+ *         trace and 0 once it is exhausted, or -1 if the edge sequence list is malformed
+ */
+BT9_CAPI_EXPORT int64_t bt9_read_branches(bt9_trace * trace, uint64_t * pc, uint64_t * target, uint8_t * taken,
+                                          uint8_t * op_type, int64_t capacity);
+
+/*!
+ * \brief Position the trace so that the next branch read is the given one
+ * \return Returns 0 on success, -1 if the trace has fewer branches or is malformed
+ */
+BT9_CAPI_EXPORT int bt9_seek(bt9_trace * trace, uint64_t branch);
+
+#ifdef __cplusplus
+}
+#endif
@@ -11,12 +11,26 @@
 
 #include "bt9_reader_defines.h"
 
-#include <boost/iostreams/device/file_descriptor.hpp>
-#include <boost/iostreams/stream.hpp>
-
+#include "bt10_decoder.h"
 #include "bt9.h"
-
-#include <coroutine>
+#include "columnar_trace.h"
+#include "decompress.h"
+#include "seek_index.h"
+#include "spsc_ring.h"
+#include "text_scanner.h"
+#include "trace_cache.h"
+#include "trace_error.h"
+#include "utils.h"
+
+#include <chrono>
+#include <cstring>
+#include <exception>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string_view>
+#include <thread>
+#include <vector>
 
 namespace bt9 {
 
@@ -81,11 +95,10 @@ namespace bt9 {
             if (br_class_br_behavior_.directness == BrClass::Directness::DIRECT &&
                 br_class_br_behavior_.indirectness == BrBehavior::Indirectness::INDIRECT) {
 
-                std::cerr << "BrClass:" << BrClass::Directness::DIRECT
-                    << " can never lead to BrBehavior: " << BrBehavior::Indirectness::INDIRECT
-                    << std::endl;
-
-                exit(-1);
+                std::ostringstream msg;
+                msg << "BrClass:" << BrClass::Directness::DIRECT
+                    << " can never lead to BrBehavior: " << BrBehavior::Indirectness::INDIRECT;
+                throw TraceError(msg.str());
             }
 
             // Print pre-defined key-value pairs
@@ -200,31 +213,175 @@ namespace bt9 {
         bool valid_ = false;
     };
 
+    /*!
+     * \struct BT9HotEdge
+     * \brief Edge record pre-joined with its source node, holding only what the simulation loop needs
+     * \note 32 bytes and 32-byte aligned, so every dynamic branch is a single load from one cache line
+     */
+    struct alignas(32) BT9HotEdge {
+        uint64_t pc = 0;                //!< Source branch virtual address
+        uint64_t target = 0;            //!< Branch virtual target
+        uint32_t inst_cnt = 0;          //!< Non-branch instruction count on this edge
+        uint32_t edge_id = 0;           //!< Edge record id
+        uint32_t src_node_id = 0;       //!< Source node record id
+        uint8_t op_type = OPTYPE_ERROR; //!< Precomputed OpType of the source branch
+        bool conditional = false;       //!< Source branch is conditional with a valid OpType
+        bool taken = false;             //!< Edge is the taken path
+
+        /// Get the precomputed OpType of the source branch
+        OpType opType() const { return static_cast<OpType>(op_type); }
+    };
+
+    static_assert(sizeof(BT9HotEdge) == 32, "BT9HotEdge must fill exactly half a cache line");
+
+    /*!
+     * \struct BT9NodeCore
+     * \brief Node fields joined into the hot edge table, without the vtable and cold fields of BT9ReaderNodeRecord
+     */
+    struct BT9NodeCore {
+        uint64_t br_virtual_addr = 0;
+        uint32_t opcode = 0;
+        BrClass_BrBehavior br_class_br_behavior = {
+            .type =             BrClass::Type::UNKNOWN,
+            .directness =       BrClass::Directness::UNKNOWN,
+            .conditionality =   BrClass::Conditionality::UNKNOWN,
+            .direction =        BrBehavior::Direction::UNKNOWN,
+            .indirectness =     BrBehavior::Indirectness::UNKNOWN
+        };
+        uint8_t opcode_size = 0;
+    };
+
+    /*!
+     * \struct BT9NodeCold
+     * \brief Diagnostic node fields, only read to build BT9ReaderNodeRecord and trace images
+     */
+    struct BT9NodeCold {
+        uint64_t br_phy_addr = 0;
+        uint32_t br_tgt_cnt = 0;
+        uint32_t br_taken_cnt = 0;
+        uint32_t br_untaken_cnt = 0;
+        bool br_phy_addr_valid = false;
+    };
+
+    /*!
+     * \struct BT9EdgeCold
+     * \brief Edge fields missing from BT9HotEdge, only read to build BT9ReaderEdgeRecord and trace images
+     */
+    struct BT9EdgeCold {
+        uint64_t observed_traverse_cnt = 0;
+        uint64_t br_phy_tgt = 0;
+        uint32_t dest_node_id = 0;
+        bool br_phy_tgt_valid = false;
+    };
+
+    /*!
+     * \struct BT9StageStats
+     * \brief Trace stream bytes consumed by one text section of a BT9 trace and the time spent on it
+     */
+    struct BT9StageStats {
+        uint64_t bytes = 0;             //!< Decompressed trace stream bytes of the section
+        uint64_t records = 0;           //!< Header lines, nodes or edges read
+        double seconds = 0.0;           //!< Wall time of the stage
+        double stream_seconds = 0.0;    //!< Part of seconds spent reading and decompressing the trace file
+
+        /// Time spent parsing, without reading and decompressing
+        double parseSeconds() const { return seconds - stream_seconds; }
+    };
+
+    /*!
+     * \struct BT9LoadStats
+     * \brief Table sizes and the time BT9Reader spent loading the header, node and edge tables
+     */
+    struct BT9LoadStats {
+        uint64_t num_nodes = 0;     //!< Node table entries
+        uint64_t num_edges = 0;     //!< Edge table entries
+        double load_seconds = 0.0;  //!< Wall time from opening the trace to a ready edge table
+        uint64_t table_bytes = 0;   //!< Node and edge tables as held by the reader
+        uint64_t hot_table_bytes = 0;       //!< Part of table_bytes read by the simulation loop
+        uint64_t legacy_table_bytes = 0;    //!< The same tables as BT9ReaderNodeRecord/BT9ReaderEdgeRecord plus the hot edge table
+
+        /// Parser stages of a BT9 text trace, all zero when the tables came from a trace cache or columnar trace
+        BT9StageStats header;
+        BT9StageStats node_table;
+        BT9StageStats edge_table;
+        double hot_table_seconds = 0.0;     //!< Joining the source nodes into the hot edge table
+
+        /// Edges whose source branch has no valid OpType, not counting the fake branch of node 0
+        uint64_t unclassified_edges = 0;
+    };
+
 
     /*!
      * \class BT9Reader
      * \brief This is the reader library for Branch Trace Version 9 (BT9) file.
+     * \note All decoding state lives in the instance, so any number of readers can be used in one
+     *       process as long as each instance is only driven by one thread at a time.
      */
     class BT9Reader {
     public:
         /*!
          * \brief Constructor
          * \param filename BT9 trace file name
-         * \param buffer_size BT9 edge (i.e. branch instance) sequence list access window size
+         * \param pipelined Decompress and decode the edge sequence on a background thread
+         * \param cache_dir Directory of pre-decoded .bt10c trace caches, empty to always decode
+         *        the trace. A missing cache is converted from the trace once and then mapped.
+         * \param io Chunk size and read-ahead depth of the trace file reads
+         * \note A trace published by a running trace server is attached before anything else.
+         *       Columnar traces (.bt9c, see columnar_trace.h) are recognized by their signature.
+         * \throw TraceError if the trace cannot be opened or is malformed; reading branches
+         *        later throws it too for errors in the edge sequence list
          */
-        BT9Reader(const std::string & name) :
+        BT9Reader(const std::string & name, bool pipelined = false, const std::string & cache_dir = "",
+                  const TraceIoOptions & io = TraceIoOptions()) :
             node_table(this),
             edge_table(this),
+            hot_branches(this),
             tracefile_name_(name),
-
-            fpstream_(openBT9TraceFile_(tracefile_name_), boost::iostreams::close_handle),
-
-            pinfile_(&fpstream_)
+            io_(io),
+            tracebuf_(tracefile_name_, io_),
+            pinfile_(&tracebuf_),
+            pipelined_(pipelined)
         {
-            readBT9Header_();
-            readBT9NodeTable_();
-            readBT9EdgeTable_();
-            initBT9EdgeSeqListAccessWindow_();
+            const auto start = std::chrono::steady_clock::now();
+
+            // Let TraceError thrown by the stream buffer through instead of only setting badbit
+            pinfile_.exceptions(std::ios::badbit);
+
+            const bool cached = attachTraceServer_() || (!cache_dir.empty() && openTraceCache_(cache_dir));
+            if (!cached && !openColumnarTrace_()) {
+                timeStage_(load_stats_.header, [this] { readBT9Header_(pinfile_); });
+                load_stats_.header.records = line_num_;
+                timeStage_(load_stats_.node_table, [this] { readBT9NodeTable_(); });
+                timeStage_(load_stats_.edge_table, [this] { readBT9EdgeTable_(); });
+                load_stats_.node_table.records = node_core_.size();
+                load_stats_.edge_table.records = hot_edge_table_.size();
+            }
+
+            const auto join_start = std::chrono::steady_clock::now();
+            buildHotEdgeTable_();
+            load_stats_.hot_table_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - join_start).count();
+
+            load_stats_.num_nodes = node_core_.size();
+            load_stats_.num_edges = hot_edge_table_.size();
+            load_stats_.hot_table_bytes = hot_edge_table_.size() * sizeof(BT9HotEdge);
+            load_stats_.table_bytes = load_stats_.hot_table_bytes +
+                                      node_core_.size() * (sizeof(BT9NodeCore) + sizeof(BT9NodeCold)) +
+                                      edge_cold_.size() * sizeof(BT9EdgeCold);
+            load_stats_.legacy_table_bytes = load_stats_.hot_table_bytes +
+                                             node_core_.size() * sizeof(BT9ReaderNodeRecord) +
+                                             hot_edge_table_.size() * sizeof(BT9ReaderEdgeRecord);
+            load_stats_.load_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+            if (!cached) {
+                // The destructor does not run when the constructor throws, stop the decode thread here
+                try {
+                    initBT9EdgeSeqListAccessWindow_();
+                }
+                catch (...) {
+                    stopDecoder_();
+                    throw;
+                }
+            }
         }
 
         BT9Reader() = delete;
@@ -234,10 +391,15 @@ namespace bt9 {
 
         ~BT9Reader()
         {
-            // free(buffIn);
-            // free(buffOut);
+            stopDecoder_();
         }
 
+        /// Table sizes and time spent loading the header, node and edge tables
+        const BT9LoadStats & loadStats() const { return load_stats_; }
+
+        /// Bytes read/decompressed and time spent decoding the trace file so far
+        const TraceStreamStats & streamStats() const { return columnar_ ? columnar_->stats() : tracebuf_.stats(); }
+
         class NodeTableIterator;
         friend class NodeTableIterator;
 
@@ -640,7 +802,8 @@ namespace bt9 {
         /*!
          * \class BranchInstanceIterator
          * \brief This is the iterator for internal branch edge sequence list.
-         * \note This is supposed to be a forward(input) iterator
+         * \note This is supposed to be a forward(input) iterator. It is a thin adapter over
+         *       readBranchBlock(), see moveToNextBranch_()
          */
         class BranchInstanceIterator {
         public:
@@ -662,7 +825,7 @@ namespace bt9 {
             BranchInstanceIterator(BT9Reader * rd,
                                    bool end = false) :
                 bt9_reader_(rd),
-                reach_end_(end)
+                reach_end_(end || rd->primeBranchBlock_())
             {
             }
 
@@ -709,15 +872,15 @@ namespace bt9 {
 
             /*!
              * \brief Pre-increment operator
-             * \note If the iterator access index goes beyond its current access window,
-             *       the window will be automatically shifted forward (half-buffer size stride)
-             *       by the BT9Reader library helper functions
+             * \note If the iterator goes beyond the reader's current branch block, the next
+             *       block is filled by the BT9Reader library helper functions
              */
             BranchInstanceIterator & operator++()
             {
                 br_inst_.invalidate_();
                 if (!reach_end_) {
-                    reach_end_ = bt9_reader_->moveToNextEdgeSeqListEntry_(index_);
+                    index_++;
+                    reach_end_ = bt9_reader_->moveToNextBranch_();
                 }
 
                 return *this;
@@ -725,9 +888,8 @@ namespace bt9 {
 
             /*!
              * \brief Post-increment operator
-             * \note If the iterator access index goes beyond its current access window,
-             *       the window will be automatically shifted forward (half-buffer size stride)
-             *       by the BT9Reader library helper functions
+             * \note If the iterator goes beyond the reader's current branch block, the next
+             *       block is filled by the BT9Reader library helper functions
              */
             BranchInstanceIterator operator++(int)
             {
@@ -735,7 +897,8 @@ namespace bt9 {
 
                 br_inst_.invalidate_();
                 if (!reach_end_) {
-                    reach_end_ = bt9_reader_->moveToNextEdgeSeqListEntry_(index_);
+                    index_++;
+                    reach_end_ = bt9_reader_->moveToNextBranch_();
                 }
 
                 return *this;
@@ -771,7 +934,7 @@ namespace bt9 {
             BT9BranchInstance & operator*()
             {
                 if (!br_inst_.isValid()) {
-                    bt9_reader_->loadBT9BranchInstance_(index_, br_inst_);
+                    bt9_reader_->loadBT9BranchInstance_(br_inst_);
                 }
 
                 return br_inst_;
@@ -784,7 +947,7 @@ namespace bt9 {
             BT9BranchInstance * operator->()
             {
                 if (!br_inst_.isValid()) {
-                    bt9_reader_->loadBT9BranchInstance_(index_, br_inst_);
+                    bt9_reader_->loadBT9BranchInstance_(br_inst_);
                 }
 
                 return &br_inst_;
@@ -800,72 +963,396 @@ namespace bt9 {
         BranchInstanceIterator begin() { return BranchInstanceIterator(this); }
         BranchInstanceIterator end() { return BranchInstanceIterator(this, true); }
 
+        class HotBranchIterator;
+        friend class HotBranchIterator;
 
-    public:
-        /// BT9 header
-        BT9ReaderHeader header;
+        /*!
+         * \class HotBranchIterator
+         * \brief Lean iterator over the edge sequence list yielding pre-joined BT9HotEdge records
+         * \note This is a forward(input) iterator and a thin adapter over readBranchBlock().
+         *       It shares the reader's branch block with BranchInstanceIterator, so the two
+         *       must not be mixed with direct readBranchBlock() calls on the same reader.
+         */
+        class HotBranchIterator {
+        public:
+            /*!
+             * \brief Constructor
+             * \param rd Pointer to its associated BT9 reader
+             * \param end Indicate if it points to the end of edge sequence list
+             */
+            HotBranchIterator(BT9Reader * rd, bool end = false) :
+                bt9_reader_(rd),
+                reach_end_(end || rd->primeBranchBlock_())
+            {}
 
-        /// Node table (wrapper class for the internal node table) that is visible to the user
-        NodeTable node_table;
+            /// Pre-increment operator
+            HotBranchIterator & operator++()
+            {
+                reach_end_ = bt9_reader_->moveToNextBranch_();
+                return *this;
+            }
 
-        /// Edge table (wrapper class for the internal edge table) that is visible to the user
-        EdgeTable edge_table;
+            /// Equal operator, only the end state is compared (input iterator)
+            bool operator==(const HotBranchIterator & rhs) const {
+                return (bt9_reader_ == rhs.bt9_reader_) && (reach_end_ == rhs.reach_end_);
+            }
 
+            /// Not-equal operator
+            bool operator!=(const HotBranchIterator & rhs) const {
+                return !this->operator==(rhs);
+            }
 
-    public:
+            /// Dereference operator
+            const BT9HotEdge & operator*() const {
+                return bt9_reader_->currentBranch_();
+            }
+
+            /// Dereference operator
+            const BT9HotEdge * operator->() const {
+                return &bt9_reader_->currentBranch_();
+            }
+
+        private:
+            BT9Reader * bt9_reader_ = nullptr;
+            bool reach_end_ = false;
+        };
+
+        /*!
+         * \class HotBranchList
+         * \brief This is a wrapper class providing HotBranchIterator begin/end to the user
+         */
+        class HotBranchList
+        {
+        public:
+            HotBranchIterator begin() const { return HotBranchIterator(bt9_reader_); }
+            HotBranchIterator end() const { return HotBranchIterator(bt9_reader_, true); }
+
+            friend class BT9Reader;
+
+        private:
+            HotBranchList(BT9Reader * rd) : bt9_reader_(rd) {};
+            HotBranchList(const HotBranchList &) = delete;
+            HotBranchList(HotBranchList &&) = delete;
+            HotBranchList & operator=(const HotBranchList &) = delete;
+
+            BT9Reader * bt9_reader_ = nullptr;
+        };
+
+        /// Get the pre-joined hot record of an edge
+        const BT9HotEdge & hotEdge(uint32_t edge_id) const {
+            assert(isValidEdgeIndex_(edge_id));
+            return hot_edge_table_[edge_id];
+        }
+
+        /*!
+         * \brief Fill a block of branch records straight from the decoded edge sequence list
+         * \param out Caller-provided records, filled from the front
+         * \return Number of records written, less than out.size() only at the end of the
+         *         trace and 0 once the trace is exhausted
+         * \note Consumes the same edge sequence list as the iterators, so a reader should be
+         *       drained either with this function or with one kind of iterator
+         */
+        uint64_t readBranchBlock(std::span<BT9HotEdge> out)
+        {
+            uint64_t count = 0;
+
+            while (count < out.size()) {
+
+                if (buffer_read_ptr_ >= buffer_write_ptr_) {
+                    if (reach_eof_) {
+                        break;
+                    }
+
+                    shiftBT9EdgeSeqListAccessWindow_();
+                    buffer_read_ptr_ = 0;
+                    continue;
+                }
+
+                const uint64_t n = std::min<uint64_t>(out.size() - count, buffer_write_ptr_ - buffer_read_ptr_);
+                const uint32_t * ids = buffer_ + buffer_read_ptr_;
+
+                if ((trace_cache_.data() != nullptr) && !server_image_) {
+                    checkCachedIds_(ids, n);
+                }
+
+                for (uint64_t i = 0; i < n; i++) {
+                    out[count + i] = hot_edge_table_[ids[i]];
+                }
+
+                count += n;
+                buffer_read_ptr_ += n;
+            }
+
+            return count;
+        }
+
+        /*!
+         * \brief Load the seek index sidecar of this trace, building and saving it if it is missing or stale
+         * \param interval Branches between two checkpoints when the index has to be built
+         * \param path Index file name, seekIndexPath() of the trace when empty
+         * \note Building decodes the whole trace once with a separate reader. An index that
+         *       cannot be saved is still used by this reader. Readers served from a trace
+         *       cache or the trace server seek in constant time and need no index.
+         * \return Returns false if the index could not be built
+         */
+        bool openSeekIndex(uint64_t interval = SEEK_INDEX_INTERVAL, const std::string & path = "")
+        {
+            if (trace_cache_.data() != nullptr) {
+                return true;
+            }
+
+            // Columnar traces have no BT10 stream to index, seekToBranch() decodes them from the start
+            if (columnar_) {
+                return false;
+            }
+
+            const std::string index_path = path.empty() ? seekIndexPath(tracefile_name_) : path;
+
+            uint64_t size = 0;
+            int64_t mtime_ns = 0;
+            if (!traceFileStamp(tracefile_name_, size, mtime_ns)) {
+                return false;
+            }
+
+            if (seek_index_.read(index_path, size, mtime_ns)) {
+                return true;
+            }
+
+            BT9Reader source(tracefile_name_, false, "", io_);
+            if ((source.trace_cache_.data() != nullptr) || !source.buildSeekIndex_(std::max<uint64_t>(interval, 1))) {
+                return false;
+            }
+            seek_index_ = std::move(source.seek_index_);
+
+            if (!seek_index_.write(index_path, size, mtime_ns)) {
+                std::cerr << "Failed to write seek index \'" << index_path << "\'\n";
+            }
+
+            return true;
+        }
+
+        /*!
+         * \brief Position the reader so that the next branch read is branch number `branch`
+         *        of the edge sequence list, counting from 0
+         * \note Decoding restarts from the closest seek index checkpoint before the branch, or
+         *       from the start of the edge sequence list without an index (see openSeekIndex()).
+         *       Iterators obtained before the call must not be used afterwards.
+         * \return Returns false (leaving the reader at the end of the trace) if the trace has
+         *         fewer branches
+         */
+        bool seekToBranch(uint64_t branch)
+        {
+            branch_block_read_ptr_ = 0;
+            branch_block_size_ = 0;
+
+            // The whole edge sequence list is mapped: only the read pointer moves
+            if (trace_cache_.data() != nullptr) {
+                buffer_read_ptr_ = std::min(branch, buffer_write_ptr_);
+                return (branch <= buffer_write_ptr_);
+            }
+
+            stopDecoder_();
+
+            if (columnar_) {
+                columnar_->rewind();
+                resetDecoder_(0, 0);
+                startDecoder_();
+                return (skipBranches(branch) == branch);
+            }
+
+            uint64_t first = 0;
+            SeekCheckpoint checkpoint = { bt10_stream_offset_, tracebuf_.anchorFor(bt10_stream_offset_) };
+            if (!seek_index_.empty()) {
+                const uint64_t i = std::min<uint64_t>(branch / seek_index_.interval, seek_index_.checkpoints.size() - 1);
+                first = i * seek_index_.interval;
+                checkpoint = seek_index_.checkpoints[i];
+            }
+
+            if (!tracebuf_.seekTo(checkpoint.anchor, checkpoint.stream_offset)) {
+                throw TraceError("\'" + tracefile_name_ + "\' cannot seek to branch " + std::to_string(branch));
+            }
+            pinfile_.clear();
+
+            resetDecoder_(checkpoint.stream_offset, first);
+            startDecoder_();
+
+            return (skipBranches(branch - first) == branch - first);
+        }
+
+        /*!
+         * \brief Drop branches without producing their records
+         * \param count Number of branches to drop, UINT64_MAX drains the trace
+         * \note Iterators obtained before the call must not be used afterwards
+         * \return Number of branches dropped, less than count only at the end of the trace
+         */
+        uint64_t skipBranches(uint64_t count)
+        {
+            branch_block_read_ptr_ = 0;
+            branch_block_size_ = 0;
+
+            uint64_t skipped = 0;
+            while (true) {
+                const uint64_t n = std::min(count - skipped, buffer_write_ptr_ - buffer_read_ptr_);
+                buffer_read_ptr_ += n;
+                skipped += n;
+
+                if ((skipped == count) || reach_eof_) {
+                    break;
+                }
+
+                shiftBT9EdgeSeqListAccessWindow_();
+                buffer_read_ptr_ = 0;
+            }
 
-        int openBT9TraceFile_(const std::string & name) {
-            std::string cmd = "/bin/cat " + name;
+            return skipped;
+        }
 
-            auto gzip_suffix_pos = name.find(".zst");
-            if (gzip_suffix_pos != std::string::npos) {
-                cmd = "zstd -dc " + name;
+        /*!
+         * \brief Select the BT10 run decoder, bestBT10Decoder() by default
+         * \note Takes effect when the access window is next refilled. It stops the decode
+         *       thread in pipelined mode, so there it must be followed by seekToBranch().
+         * \return Returns false (keeping the current decoder) if this CPU does not support it
+         */
+        bool setBT10Decoder(BT10Decoder decoder)
+        {
+            if (!bt10DecoderSupported(decoder)) {
+                return false;
             }
 
-            FILE * pipe = popen(cmd.c_str(), "r");
+            stopDecoder_();
+            widen_bt10_ = bt10WidenFunction(decoder);
+
+            return true;
+        }
+
+        /*!
+         * \brief Write the tables and the fully decoded edge sequence list as a .bt10c trace image
+         * \param fout Destination, positioned at its start; may be a file or a shared memory segment
+         * \param hash Content hash of the trace file, see hashTraceFile()
+         * \param size Size of the trace file in bytes
+         * \param mtime_ns Modification time of the trace file, see traceFileStamp()
+         * \note Consumes the whole edge sequence list, so it must be called before anything else
+         *       reads from it
+         * \return Returns false if writing failed
+         */
+        bool writeTraceImage(FILE * fout, uint64_t hash, uint64_t size, int64_t mtime_ns)
+        {
+            // The header is written zeroed first and completed last, so a reader mapping the
+            // image while it is still being written rejects it
+            TraceCacheHeader h = {};
+            h.version = TRACE_CACHE_VERSION;
+            h.node_record_size = sizeof(TraceCacheNode);
+            h.edge_record_size = sizeof(TraceCacheEdge);
+            h.source_hash = hash;
+            h.source_size = size;
+            h.source_mtime_ns = mtime_ns;
+
+            // Sections follow the header in order, each starting on an 8-byte boundary
+            uint64_t pos = 0;
+            auto write = [&](const void * ptr, uint64_t bytes) {
+                fwrite(ptr, 1, bytes, fout);
+                pos += bytes;
+            };
+            auto align = [&]() {
+                static const char zeros[8] = {};
+                write(zeros, (8 - pos % 8) % 8);
+                return pos;
+            };
+
+            write(&h, sizeof(h));
+
+            h.header_text_offset = align();
+            h.header_text_size = header_text_.size();
+            write(header_text_.data(), header_text_.size());
+
+            h.nodes_offset = align();
+            h.num_nodes = node_core_.size();
+            for (uint32_t id = 0; id < h.num_nodes; id++) {
+                const TraceCacheNode rec = nodeRecord_(id);
+                write(&rec, sizeof(rec));
+            }
+
+            h.edges_offset = align();
+            h.num_edges = hot_edge_table_.size();
+            for (uint32_t id = 0; id < h.num_edges; id++) {
+                const TraceCacheEdge rec = edgeRecord_(id);
+                write(&rec, sizeof(rec));
+            }
+
+            // Every id has been checked against the edge table once, by the decoder; readers of the
+            // image only recheck them block by block (checkCachedIds_())
+            h.ids_offset = align();
+            h.num_branches = 0;
+            while (true) {
+                const uint64_t count = buffer_write_ptr_ - buffer_read_ptr_;
+                write(buffer_ + buffer_read_ptr_, count * sizeof(uint32_t));
+                h.num_branches += count;
+                buffer_read_ptr_ = buffer_write_ptr_;
+
+                if (reach_eof_) {
+                    break;
+                }
 
-            if (!pipe) {
-                std::cerr << "Failed to open trace file \'"
-                          << name << "\' with pipe\n";
-                exit(-1);
+                shiftBT9EdgeSeqListAccessWindow_();
+                buffer_read_ptr_ = 0;
             }
 
-            return fileno(pipe);
+            fflush(fout);
+            memcpy(h.magic, TRACE_CACHE_MAGIC, sizeof(h.magic));
+            fseek(fout, 0, SEEK_SET);
+            fwrite(&h, 1, sizeof(h), fout);
+            fflush(fout);
+
+            return !ferror(fout);
         }
 
-        /// Read BT9 tracefile header with linux pipe
-        void readBT9Header_()
+
+    public:
+        /// BT9 header
+        BT9ReaderHeader header;
+
+        /// Node table (wrapper class for the internal node table) that is visible to the user
+        NodeTable node_table;
+
+        /// Edge table (wrapper class for the internal edge table) that is visible to the user
+        EdgeTable edge_table;
+
+        /// Edge sequence list as pre-joined hot edges (lean alternative to begin()/end())
+        HotBranchList hot_branches;
+
+
+    public:
+
+        /*!
+         * \brief Read BT9 tracefile header
+         * \param in The trace stream, or the header text saved in a trace cache
+         */
+        void readBT9Header_(std::istream & in)
         {
             std::string line;
-            std::string token;
+            std::string_view token;
 
             // Check BT9 header title line
-            std::getline(pinfile_, line, '\n');
+            std::getline(in, line, '\n');
             line_num_++;
+            header_text_ = line + '\n';
 
-            std::stringstream ss(line);
-            ss >> token;
+            TextScanner title(line);
+            title.next(token);
             if (token != "BT9_SPA_TRACE_FORMAT") {
-                std::cerr << "line:" << line_num_ << " \'" << tracefile_name_ << "\' is not BT9 file\n";
-                exit(-1);
+                fail_("is not BT9 file");
             }
 
             // Read BT9 header fields (each is a key-value string pair)
-            while (std::getline(pinfile_, line, '\n')) {
+            while (std::getline(in, line, '\n')) {
                 line_num_++;
+                header_text_ += line + '\n';
 
                 // Skip any comments at the end of line
-                auto pos = line.find_first_of('#');
-                if (pos != std::string::npos) {
-                    line.erase(pos, std::numeric_limits<std::string::size_type>::max());
-                }
-
-                std::stringstream ss(line);
-                std::string token;
-                ss >> token;
+                TextScanner ss(stripComments_(line));
 
                 // Skip if the whole line contains only comments
-                if (token.empty()) {
+                if (!ss.next(token)) {
                     continue;
                 }
 
@@ -874,86 +1361,103 @@ namespace bt9 {
                     break;
                 }
                 else {
-                    // Erase the key-string, get the following value-string
-                    line.erase(0, token.size());
-
-                    // Update header fields
-                    parseHeader_(ss, token, line);
+                    // Update header fields, the value-string is whatever follows the key-string
+                    parseHeader_(ss, token);
                 }
             }
         }
 
         /// Parse BT9 tracefile header
-        void parseHeader_(std::stringstream & ss,
-                          std::string & token,
-                          std::string & line)
+        void parseHeader_(TextScanner & ss,
+                          std::string_view key)
         {
-            if (token == "bt9_minor_version:") {
-                ss >> token;
-                try {
-                    header.version_num_ = static_cast<BasicHeader::BT9MinorVersionNum>(std::stoul(token, nullptr, 0));
-                }
-                catch (const std::invalid_argument & ex) {
-                    std::cerr << ex.what();
-                    std::cerr << "line:" << line_num_ << " bt9_minor_version: " << token << " is invalid!\n";
-                    exit(-1);
-                }
+            const std::string value(ss.rest());
+            std::string_view token;
+
+            if (key == "bt9_minor_version:") {
+                ss.next(token);
+                header.version_num_ = static_cast<BasicHeader::BT9MinorVersionNum>(parseIntegerField_(token, "bt9_minor_version"));
             }
-            else if (token == "has_physical_address:") {
-                ss >> token;
-                try {
-                    header.has_phy_addr_ = std::stoul(token, nullptr, 0);
-                }
-                catch (const std::invalid_argument & ex) {
-                    std::cerr << ex.what();
-                    std::cerr << "line:" << line_num_ << " has_physical_address: " << token << " is invalid!\n";
-                    exit(-1);
-                }
+            else if (key == "has_physical_address:") {
+                ss.next(token);
+                header.has_phy_addr_ = parseIntegerField_(token, "has_physical_address");
             }
-            else if (token == "md5_checksum:") {
-                header.md5sum_ = line;
+            else if (key == "md5_checksum:") {
+                header.md5sum_ = value;
             }
-            else if (token == "conversion_date:") {
-                header.date_ = line;
+            else if (key == "conversion_date:") {
+                header.date_ = value;
             }
-            else if (token == "original_stf_input_file:") {
-                header.original_tracefile_path_ = line;
+            else if (key == "original_stf_input_file:") {
+                header.original_tracefile_path_ = value;
             }
             else {
-                header.unclassified_fields_[token] = line;
+                header.unclassified_fields_[std::string(key)] = value;
+            }
+        }
+
+        /// Run one parser stage, recording the trace stream bytes it consumed and its time
+        template<typename Stage>
+        void timeStage_(BT9StageStats & stats, Stage && stage)
+        {
+            const uint64_t offset = tracebuf_.tell();
+            const double stream_seconds = tracebuf_.stats().decode_seconds;
+            const auto start = std::chrono::steady_clock::now();
+
+            stage();
+
+            stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            stats.stream_seconds = tracebuf_.stats().decode_seconds - stream_seconds;
+            stats.bytes = tracebuf_.tell() - offset;
+        }
+
+        /// Get the part of a line before its comments (start with # sign)
+        static std::string_view stripComments_(std::string_view line)
+        {
+            return line.substr(0, line.find('#'));
+        }
+
+        /*!
+         * \brief Parse an integer field of a header, node or edge record line
+         * \param token The field token, read as std::stoull(token, nullptr, 0) would
+         * \param field Field name for the error message
+         */
+        uint64_t parseIntegerField_(std::string_view token, const char * field) const
+        {
+            uint64_t value = 0;
+            if (!parseInteger(token, value)) {
+                fail_(std::string(field) + ": " + std::string(token) + " is invalid!");
             }
+
+            return value;
         }
 
-        /// Read BT9 tracefile node table with linux pipe
+        /// Read BT9 tracefile node table
         void readBT9NodeTable_()
         {
             std::string line;
-            std::string token;
-            std::vector<BT9ReaderNodeRecord> node_table_temp_;
+            std::string_view token;
 
             if (!reach_node_table_) {
-                std::cerr << "\'BT9_NODES\' is missing!\n";
-                exit(-1);
+                fail_("\'BT9_NODES\' is missing!");
             }
 
+            // Nodes are collected in file order, then placed by id once the table size is known
+            std::vector<BT9ReaderNodeRecord> node_table_temp_;
+
             uint32_t max_id = 0;
             while (std::getline(pinfile_, line, '\n')) {
                 line_num_++;
 
                 // Skip any comments at the end of line
-                std::string comments;
-                auto pos = line.find_first_of('#');
-                if (pos != std::string::npos) {
-                    comments = line.substr(pos+1);
-                    line.erase(pos, std::numeric_limits<std::string::size_type>::max());
-                }
+                const std::string_view content = stripComments_(line);
+                const std::string_view comments = (content.size() < line.size()) ?
+                    std::string_view(line).substr(content.size() + 1) : std::string_view();
 
-                std::stringstream ss(line);
-                std::string token;
-                ss >> token;
+                TextScanner ss(content);
 
                 // Skip if the whole line contains only comments
-                if (token.empty()) {
+                if (!ss.next(token)) {
                     continue;
                 }
 
@@ -962,28 +1466,32 @@ namespace bt9 {
                     break;
                 }
                 else if (token == "NODE") {
-                    BT9ReaderNodeRecord node_record;
+                    BT9ReaderNodeRecord & node_record = node_table_temp_.emplace_back();
 
-                    parseNodeRecordFixedFields_(node_record, ss, token);
-                    parseNodeRecordOptionalFields_(node_record, ss, token);
+                    parseNodeRecordFixedFields_(node_record, ss);
+                    parseNodeRecordOptionalFields_(node_record, ss);
                     parseNodeMnemonicsFromComments_(node_record, comments);
-                    node_table_temp_.push_back(node_record);
 
                     // Keep track of the maximum node id
                     max_id = std::max(max_id, node_record.id_);
                 }
                 else {
-                    std::cerr << "line:" << line_num_ << " \'NODE\' specifier is missing!\n";
-                    exit(-1);
+                    fail_("\'NODE\' specifier is missing!");
                 }
             }
 
-            // Update node_table_ vector
-            node_table_.resize(node_table_temp_.size());
+            // Ids index the tables directly, so they must be dense
+            if (max_id >= node_table_temp_.size()) {
+                fail_("node id " + std::to_string(max_id) + " is out of range for " +
+                      std::to_string(node_table_temp_.size()) + " nodes!");
+            }
+
+            // Split the records into the core and cold node tables
+            resizeNodeTables_(node_table_temp_.size());
             for (auto & node : node_table_temp_) {
-                // Check that the entry in node_table_ has not been used yet
-                if(node_table_[node.id_].br_class_br_behavior_.conditionality == BrClass::Conditionality::UNKNOWN){
-                    node_table_[node.id_] = node;
+                // Check that the entry in node_core_ has not been used yet
+                if(node_core_[node.id_].br_class_br_behavior.conditionality == BrClass::Conditionality::UNKNOWN){
+                    storeNode_(node.id_, flattenNode_(node));
                 }
                 else{
                     std::cerr << "line:" << line_num_ << " duplicated node: (" << std::hex << std::showbase
@@ -992,7 +1500,7 @@ namespace bt9 {
             }
 
 #ifdef PRINT_NODES_DEBUG
-            printf("node_table_ size %ld capacity %ld real size %ld KB\n", node_table_.size(), node_table_.capacity(), (node_table_.capacity() * sizeof(BT9ReaderNodeRecord))/1024);
+            printf("node_core_ size %ld real size %ld KB\n", node_core_.size(), (node_core_.size() * (sizeof(BT9NodeCore) + sizeof(BT9NodeCold)))/1024);
 #endif
 
         }
@@ -1003,37 +1511,23 @@ namespace bt9 {
          *       This function might be deprecated in the future when branch mnemonics no longer appear as part of comments
          */
         void parseNodeMnemonicsFromComments_(BT9ReaderNodeRecord & node_record,
-                                             std::string & comments)
+                                             std::string_view comments)
         {
-            std::stringstream ss(comments);
-            std::string token;
+            TextScanner ss(comments);
+            std::string_view token;
 
-            while (ss >> token) {
+            while (ss.next(token)) {
                 if (token == "mnemonic:") {
-                    ss >> token;
-
-                    if (token.at(0) != '\"') {
-                        std::cerr << "line:" << line_num_ << " missing \" at the beginning of branch mnemonic!\n";
-                        exit(-1);
-                    }
-
-                    std::string str = token.substr(1);
-                    bool end = false;
-                    while (ss >> token) {
-                        str += " ";
-                        if (token.back() == '\"') {
-                            str += token.substr(0, token.size()-1);
-                            end = true;
-                            break;
-                        }
+                    ss.next(token);
 
-                        str += token;
+                    if (token.empty() || (token.front() != '\"')) {
+                        fail_("missing \" at the beginning of branch mnemonic!");
                     }
 
-                    // Corner case
-                    if (str.back() == '\"') {
-                        end = true;
-                        str = str.substr(0, str.size()-1);
+                    // The mnemonic itself is not stored, only its quoting is checked
+                    bool end = (token.size() > 1) && (token.back() == '\"');
+                    while (!end && ss.next(token)) {
+                        end = (token.back() == '\"');
                     }
 
                     if (!end) {
@@ -1047,181 +1541,105 @@ namespace bt9 {
 
         /// Parse the fixed fields of BT9 node record
         void parseNodeRecordFixedFields_(BT9ReaderNodeRecord & node_record,
-                                         std::stringstream & ss,
-                                         std::string & token)
+                                         TextScanner & ss)
         {
+            std::string_view token;
+
             uint64_t index = 0;
-            while ((index < BT9ReaderNodeRecord::NUM_VALUE_FIELD_) && (ss >> token)) {
+            while ((index < BT9ReaderNodeRecord::NUM_VALUE_FIELD_) && ss.next(token)) {
                 switch (index) {
                     case 0: // id
-                        try {
-                            node_record.id_ = std::stoi(token, nullptr, 0);
-                            ++index;
-                        }
-                        catch (const std::invalid_argument & ex) {
-                            std::cerr << ex.what();
-                            std::cerr << "line:" << line_num_ << " node id: " << token << " is invalid!\n";
-                            exit(-1);
-                        }
+                        node_record.id_ = parseIntegerField_(token, "node id");
                         break;
                     case 1: // virtual_address
-                        try {
-                            node_record.br_virtual_addr_ = std::stoull(token, nullptr, 0);
-                            ++index;
-                        }
-                        catch (const std::invalid_argument & ex) {
-                            std::cerr << ex.what();
-                            std::cerr << "line:" << line_num_ << " virtual address: " << token << " is invalid!\n";
-                            exit(-1);
-                        }
+                        node_record.br_virtual_addr_ = parseIntegerField_(token, "virtual address");
                         break;
                     case 2: // physical_address
                         if (token == "-") {
                             node_record.br_phy_addr_ = std::numeric_limits<uint64_t>::max();
                             node_record.br_phy_addr_valid_ = false;
-                            ++index;
                         }
                         else {
-                            try {
-                                node_record.br_phy_addr_ = std::stoull(token, nullptr, 0);
-                                node_record.br_phy_addr_valid_ = true;
-                                ++index;
-                            }
-                            catch (const std::invalid_argument & ex) {
-                                std::cerr << ex.what();
-                                std::cerr << "line:" << line_num_ << " physical address: " << token << " is invalid!\n";
-                                exit(-1);
-                            }
+                            node_record.br_phy_addr_ = parseIntegerField_(token, "physical address");
+                            node_record.br_phy_addr_valid_ = true;
                         }
                         break;
                     case 3: // opcode
-                            try {
-                                node_record.opcode_ = std::stoull(token, nullptr, 0);
-                                ++index;
-                            }
-                            catch (const std::invalid_argument & ex) {
-                                std::cerr << ex.what();
-                                std::cerr << "line:" << line_num_ << " opcode: " << token << " is invalid!\n";
-                                exit(-1);
-                            }
-                            break;
+                        node_record.opcode_ = parseIntegerField_(token, "opcode");
+                        break;
                     case 4: // size
-                            try {
-                                node_record.opcode_size_ = std::stoi(token, nullptr, 0);
-                                ++index;
-                            }
-                            catch (const std::invalid_argument & ex) {
-                                std::cerr << ex.what();
-                                std::cerr << "line:" << line_num_ << " opcode size: " << token << " is invalid!\n";
-                                exit(-1);
-                            }
-                            break;
+                        node_record.opcode_size_ = parseIntegerField_(token, "opcode size");
+                        break;
                 }
+                ++index;
             }
         }
 
         /// Parse the optional fields of BT9 node record
         void parseNodeRecordOptionalFields_(BT9ReaderNodeRecord & node_record,
-                                            std::stringstream & ss,
-                                            std::string & token)
+                                            TextScanner & ss)
         {
-            while (ss >> token) {
-                if (token == "class:") {
-                    ss >> token;
+            std::string_view key;
+            std::string_view token;
+
+            while (ss.next(key)) {
+                ss.next(token);
+
+                if (key == "class:") {
                     try {
                         node_record.br_class_br_behavior_.parseBrClass(token);
                     }
                     catch (const std::invalid_argument & ex) {
-                        std::cerr << ex.what();
-                        std::cerr << "line:" << line_num_ << " BrClass: " << token << " is invalid!\n";
-                        exit(-1);
+                        fail_("BrClass: " + std::string(token) + " is invalid! (" + ex.what() + ")");
                     }
                 }
-                else if (token == "behavior:") {
-                    ss >> token;
+                else if (key == "behavior:") {
                     try {
                         node_record.br_class_br_behavior_.parseBrBehavior(token);
                     }
                     catch (const std::invalid_argument & ex) {
-                        std::cerr << ex.what();
-                        std::cerr << "line:" << line_num_ << " BrBehavior: " << token << " is invalid!\n";
-                        exit(-1);
+                        fail_("BrBehavior: " + std::string(token) + " is invalid! (" + ex.what() + ")");
                     }
                 }
-                else if (token == "taken_cnt:") {
-                        ss >> token;
-                        try {
-                        node_record.br_taken_cnt_ = std::stoul(token, nullptr, 0);
-                    }
-                    catch (const std::invalid_argument & ex) {
-                        std::cerr << ex.what();
-                        std::cerr << "line:" << line_num_ << " taken_cnt: " << token << " is invalid!\n";
-                        exit(-1);
-                    }
-                }
-                else if (token == "not_taken_cnt:") {
-                    ss >> token;
-                    try {
-                        node_record.br_untaken_cnt_ = std::stoul(token, nullptr, 0);
-                    }
-                    catch (const std::invalid_argument & ex) {
-                        std::cerr << ex.what();
-                        std::cerr << "line:" << line_num_ << " not_taken_cnt: " << token << " is invalid!\n";
-                        exit(-1);
-                    }
+                else if (key == "taken_cnt:") {
+                    node_record.br_taken_cnt_ = parseIntegerField_(token, "taken_cnt");
                 }
-                else if (token == "tgt_cnt:") {
-                    ss >> token;
-                    try {
-                        node_record.br_tgt_cnt_ = std::stoul(token, nullptr, 0);
-                    }
-                    catch (const std::invalid_argument & ex) {
-                        std::cerr << ex.what();
-                        std::cerr << "line:" << line_num_ << " tgt_cnt: " << token << " is invalid!\n";
-                        exit(-1);
-                    }
+                else if (key == "not_taken_cnt:") {
+                    node_record.br_untaken_cnt_ = parseIntegerField_(token, "not_taken_cnt");
                 }
-                else {
-                    std::string key = token;
-                    ss >> token;
+                else if (key == "tgt_cnt:") {
+                    node_record.br_tgt_cnt_ = parseIntegerField_(token, "tgt_cnt");
                 }
             }
         }
 
-        /// Read BT9 tracefile edge table with linux pipe
+        /// Read BT9 tracefile edge table
         void readBT9EdgeTable_()
         {
             std::string line;
-            std::string token;
-            std::vector<BT9ReaderEdgeRecord> edge_table_temp_;
+            std::string_view token;
 
             if (!reach_edge_table_) {
-                std::cerr << "\'BT9_EDGES\' is missing!\n";
-                exit(-1);
+                fail_("\'BT9_EDGES\' is missing!");
             }
 
+            // Edges are collected in file order, then placed by id once the table size is known
+            std::vector<BT9ReaderEdgeRecord> edge_table_temp_;
+
             uint32_t max_id = 0;
             while (std::getline(pinfile_, line, '\n')) {
                 line_num_++;
 
-                auto pos = line.find_first_of('#');
-                if (pos != std::string::npos) {
-                    line.erase(pos, std::numeric_limits<std::string::size_type>::max());
-                }
-
-                std::stringstream ss(line);
-                std::string token;
-                ss >> token;
+                TextScanner ss(stripComments_(line));
 
-                if (token.empty()) {
+                if (!ss.next(token)) {
                     continue;
                 }
                 if (token == "EDGE") {
-                    BT9ReaderEdgeRecord edge_record;
+                    BT9ReaderEdgeRecord & edge_record = edge_table_temp_.emplace_back();
 
-                    parseEdgeRecordFixedFields_(edge_record, ss, token);
-                    parseEdgeRecordOptionalFields_(edge_record, ss, token);
-                    edge_table_temp_.push_back(edge_record);
+                    parseEdgeRecordFixedFields_(edge_record, ss);
+                    parseEdgeRecordOptionalFields_(edge_record, ss);
 
                     max_id = std::max(max_id, edge_record.id_);
                 }
@@ -1233,17 +1651,21 @@ namespace bt9 {
                     break;
                 }
                 else {
-                    std::cerr << "line:" << line_num_ << " \'EDGE\' specifier is missing!\n";
-                    exit(-1);
+                    fail_("\'EDGE\' specifier is missing!");
                 }
             }
 
-            // Update edge_table_ vector
-            edge_table_.resize(edge_table_temp_.size());
+            if (max_id >= edge_table_temp_.size()) {
+                fail_("edge id " + std::to_string(max_id) + " is out of range for " +
+                      std::to_string(edge_table_temp_.size()) + " edges!");
+            }
+
+            // Split the records into the hot and cold edge tables
+            resizeEdgeTables_(edge_table_temp_.size());
             for (auto & edge : edge_table_temp_) {
                 // Add checking for duplicated edges
                 if(1){
-                    edge_table_[edge.id_] = edge;
+                    storeEdge_(edge.id_, flattenEdge_(edge));
                 }
                 else{
                     std::cerr << "line:" << line_num_ << " duplicated edge: (" << std::hex << std::showbase
@@ -1252,138 +1674,79 @@ namespace bt9 {
             }
 
 #ifdef PRINT_EDGES_DEBUG
-            printf("edge_table_ size %ld capacity %ld real size %ld KB\n", edge_table_.size(), edge_table_.capacity(), (edge_table_.capacity() * sizeof(BT9ReaderEdgeRecord))/1024);
+            printf("hot_edge_table_ size %ld real size %ld KB\n", hot_edge_table_.size(), (hot_edge_table_.size() * (sizeof(BT9HotEdge) + sizeof(BT9EdgeCold)))/1024);
 #endif
 
         }
 
         /// Parse the fixed fields of BT9 edge record
         void parseEdgeRecordFixedFields_(BT9ReaderEdgeRecord & edge_record,
-                                         std::stringstream & ss,
-                                         std::string & token)
+                                         TextScanner & ss)
         {
+            std::string_view token;
+
             uint64_t index = 0;
-            while ((index < BT9ReaderEdgeRecord::NUM_VALUE_FIELD_) && (ss >> token)) {
+            while ((index < BT9ReaderEdgeRecord::NUM_VALUE_FIELD_) && ss.next(token)) {
                 switch (index) {
                     case 0: // edge_id
-                        try {
-                            edge_record.id_ = std::stoi(token, nullptr, 0);
-                            ++index;
-                        }
-                        catch (const std::invalid_argument & ex) {
-                            std::cerr << ex.what();
-                            std::cerr << "line:" << line_num_ << " edge id: " << token << " is invalid!\n";
-                            exit(-1);
-                        }
+                        edge_record.id_ = parseIntegerField_(token, "edge id");
                         break;
                     case 1: // src_node_id
-                        try {
-                            edge_record.src_node_id_ = std::stoi(token, nullptr, 0);
-
-                            if (!isValidNodeIndex_(edge_record.src_node_id_)) {
-                                throw std::invalid_argument("Invalid token detected!\n");
-                            }
-                            ++index;
-                        }
-                        catch (const std::invalid_argument & ex) {
-                            std::cerr << ex.what();
-                            std::cerr << "line:" << line_num_ << " source node id: " << token << " is invalid!\n";
-                            exit(-1);
+                        edge_record.src_node_id_ = parseIntegerField_(token, "source node id");
+                        if (!isValidNodeIndex_(edge_record.src_node_id_)) {
+                            fail_("source node id: " + std::string(token) + " is invalid!");
                         }
                         break;
                     case 2: // dest_node_id
-                        try {
-                            edge_record.dest_node_id_ = std::stoi(token, nullptr, 0);
-                            if (!isValidNodeIndex_(edge_record.dest_node_id_)) {
-                                throw std::invalid_argument("Invalid token detected!\n");
-                            }
-                            ++index;
-                        }
-                        catch (const std::invalid_argument & ex) {
-                            std::cerr << ex.what();
-                            std::cerr << "line:" << line_num_ << " destination node id: " << token << " is invalid!\n";
-                            exit(-1);
+                        edge_record.dest_node_id_ = parseIntegerField_(token, "destination node id");
+                        if (!isValidNodeIndex_(edge_record.dest_node_id_)) {
+                            fail_("destination node id: " + std::string(token) + " is invalid!");
                         }
                         break;
                     case 3: // br_is_taken?
                         if (token == "T") {
                             edge_record.is_taken_path_ = true;
-                            ++index;
                         }
                         else if (token == "N") {
                             edge_record.is_taken_path_ = false;
-                            ++index;
                         }
                         else {
-                            std::cerr << "line:" << line_num_ << " branch taken indicator: " << token << " is invalid!\n";
-                            exit(-1);
+                            fail_("branch taken indicator: " + std::string(token) + " is invalid!");
                         }
                         break;
                     case 4: // br_virtual_target
-                        try {
-                            edge_record.br_virtual_tgt_ = std::stoull(token, nullptr, 0);
-                            ++index;
-                        }
-                        catch (const std::invalid_argument & ex) {
-                            std::cerr << ex.what();
-                            std::cerr << "line:" << line_num_ << " branch virtual target: " << token << " is invalid!\n";
-                            exit(-1);
-                        }
+                        edge_record.br_virtual_tgt_ = parseIntegerField_(token, "branch virtual target");
                         break;
                     case 5: // br_physical_target
                         if (token == "-") {
                             edge_record.br_phy_tgt_ = std::numeric_limits<uint64_t>::max();
                             edge_record.br_phy_tgt_valid_ = false;
-                            ++index;
                         }
                         else {
-                            try {
-                                edge_record.br_phy_tgt_ = std::stoull(token, nullptr, 0);
-                                edge_record.br_phy_tgt_valid_ = true;
-                                ++index;
-                            }
-                            catch (const std::invalid_argument & ex) {
-                                std::cerr << ex.what();
-                                std::cerr << "line:" << line_num_ << " branch physical target: " << token << " is invalid!\n";
-                                exit(-1);
-                            }
+                            edge_record.br_phy_tgt_ = parseIntegerField_(token, "branch physical target");
+                            edge_record.br_phy_tgt_valid_ = true;
                         }
                         break;
                     case 6: // non-branch instruction count
-                        try {
-                            edge_record.inst_cnt_ = std::stoull(token, nullptr, 0);
-                            ++index;
-                        }
-                        catch (const std::invalid_argument & ex) {
-                            std::cerr << ex.what();
-                            std::cerr << "line:" << line_num_ << " non-branch instruction count: " << token << " is invalid!\n";
-                            exit(-1);
-                        }
+                        edge_record.inst_cnt_ = parseIntegerField_(token, "non-branch instruction count");
                         break;
                 }
+                ++index;
             }
         }
 
         /// Parse the optional fields of BT9 edge record
         void parseEdgeRecordOptionalFields_(BT9ReaderEdgeRecord & edge_record,
-                                            std::stringstream & ss,
-                                            std::string & token)
+                                            TextScanner & ss)
         {
-            while (ss >> token) {
-                if (token == "traverse_cnt:") {
-                    ss >> token;
-                    try {
-                        edge_record.observed_traverse_cnt_ = std::stoul(token, nullptr, 0);
-                    }
-                    catch (const std::invalid_argument & ex) {
-                        std::cerr << ex.what();
-                        std::cerr << "line:" << line_num_ << " traverse_cnt: " << token << " is invalid!\n";
-                        exit(-1);
-                    }
-                }
-                else {
-                    std::string key = token;
-                    ss >> token;
+            std::string_view key;
+            std::string_view token;
+
+            while (ss.next(key)) {
+                ss.next(token);
+
+                if (key == "traverse_cnt:") {
+                    edge_record.observed_traverse_cnt_ = parseIntegerField_(token, "traverse_cnt");
                 }
             }
         }
@@ -1394,7 +1757,7 @@ namespace bt9 {
          * \return Returns false if the node referred to by idx doesn't exist in node table
          */
         bool isValidNodeIndex_(uint32_t idx) const {
-            return (idx < node_table_.size());
+            return (idx < node_core_.size());
         }
 
         /*!
@@ -1403,71 +1766,626 @@ namespace bt9 {
          * \return Returns false if the edge referred to by idx doesn't exist in edge table
          */
         bool isValidEdgeIndex_(uint32_t idx) const {
-            return (idx < edge_table_.size());
+            return (idx < hot_edge_table_.size());
         }
 
-        // Three optimization ideas:
-        // 1. Index from the end of array to get rid of initiliazed var
-        // 2. Instead of incrementing ptr and then conditionaly adding 4 do two separate additions
-        // 3. Have a temp var and assign ptr only once
-        void parser_BT10(){
+        /*!
+         * \brief Throw a TraceError if a block of edge ids used in place from a .bt10c file leaves the edge table
+         * \note The ids were valid when the cache was written, from the decoder; this catches a
+         *       damaged file before its ids index the edge table
+         */
+        void checkCachedIds_(const uint32_t * ids, uint64_t n) const
+        {
+            uint32_t max_id = 0;
+            for (uint64_t i = 0; i < n; i++) {
+                max_id = std::max(max_id, ids[i]);
+            }
+            if (max_id < hot_edge_table_.size()) {
+                return;
+            }
 
-            static uint8_t data[BT10_PARSER_BUFFER_SIZE];
-            static uint32_t initiliazed;
-            static uint32_t ptr;
+            // Damaged, find the id to report
+            for (uint64_t i = 0; i < n; i++) {
+                if (!isValidEdgeIndex_(ids[i])) {
+                    throw TraceError("\'" + tracefile_name_ + "\' damaged trace cache, delete it to rebuild it: edge id " +
+                                     std::to_string(ids[i]) + " at branch " + std::to_string(ids - buffer_ + i));
+                }
+            }
+        }
 
-            while(1){
+        /// Throw a TraceError for the line being parsed
+        [[noreturn]] void fail_(const std::string & what) const
+        {
+            throw TraceError("\'" + tracefile_name_ + "\' line:" + std::to_string(line_num_) + " " + what);
+        }
+
+        /*!
+         * \brief Throw a TraceError for an edge id of the BT10 stream outside the edge table
+         * \param branch Edge sequence list position of the record
+         * \param record_end Trace stream offset just past the record
+         */
+        [[noreturn]] void invalidEdgeIndex_(uint32_t edge, uint64_t branch, uint64_t record_end) const
+        {
+            if (record_end > parser_stream_end_) {
+                throw TraceError("\'" + tracefile_name_ + "\' edge sequence list ends without EOF marker after branch " +
+                                 std::to_string(branch));
+            }
 
-                uint32_t bytes_left = initiliazed ? (BT10_PARSER_BUFFER_SIZE - ptr) : 0;
+            throw TraceError("\'" + tracefile_name_ + "\' Invalid Edge Index! edge: " + std::to_string(edge) +
+                             " at branch " + std::to_string(branch));
+        }
 
-                if(bytes_left < 5){
-                    // printf("DEBUG-CPP: Refill buffer, bytes left: %d\n", bytes_left);
+        /*!
+         * \brief Classify a branch into the OpType passed to the predictor
+         * \return Returns OPTYPE_ERROR for combinations that should never appear
+         */
+        static OpType classifyOpType_(const BrClass_BrBehavior & br_class)
+        {
+            using Type = BrClass::Type;
+            using Directness = BrClass::Directness;
+            using Conditionality = BrClass::Conditionality;
 
-                    uint8_t* p = data + ptr;
-                    // printf("DEBUG-CPP: DATA BEFORE -> Raw=0x%02x 0x%02x 0x%02x 0x%02x\n",
-                        // p[0], p[1], p[2], p[3]);
+            const bool cond = (br_class.conditionality == Conditionality::CONDITIONAL);
+            const bool uncond = (br_class.conditionality == Conditionality::UNCONDITIONAL);
 
-                    memcpy(data, &data[ptr], bytes_left);
+            if (!cond && !uncond) {
+                return OPTYPE_ERROR;
+            }
+
+            if (br_class.type == Type::RET) {
+                return cond ? OPTYPE_RET_COND : OPTYPE_RET_UNCOND;
+            }
+            else if (br_class.directness == Directness::INDIRECT) {
+                if (br_class.type == Type::CALL) {
+                    return cond ? OPTYPE_CALL_INDIRECT_COND : OPTYPE_CALL_INDIRECT_UNCOND;
+                }
+                else if (br_class.type == Type::JMP) {
+                    return cond ? OPTYPE_JMP_INDIRECT_COND : OPTYPE_JMP_INDIRECT_UNCOND;
+                }
+            }
+            else if (br_class.directness == Directness::DIRECT) {
+                if (br_class.type == Type::CALL) {
+                    return cond ? OPTYPE_CALL_DIRECT_COND : OPTYPE_CALL_DIRECT_UNCOND;
+                }
+                else if (br_class.type == Type::JMP) {
+                    return cond ? OPTYPE_JMP_DIRECT_COND : OPTYPE_JMP_DIRECT_UNCOND;
+                }
+            }
+
+            return OPTYPE_ERROR;
+        }
+
+        /*!
+         * \brief Join the source node fields into the hot edge table
+         * \note Called once after the edge table is read, storeEdge_() filled in the edge fields.
+         *       Every node is classified once here, so the simulation loop only reads the result.
+         */
+        void buildHotEdgeTable_()
+        {
+            // OpType and conditionality per node, computed once however many edges leave it
+            std::vector<uint8_t> node_op_type(node_core_.size());
+            for (size_t id = 0; id < node_core_.size(); id++) {
+                node_op_type[id] = classifyOpType_(node_core_[id].br_class_br_behavior);
+            }
+
+            for (auto & hot : hot_edge_table_) {
+                const auto & src_node = node_core_[hot.src_node_id];
+
+                hot.pc = src_node.br_virtual_addr;
+                hot.op_type = node_op_type[hot.src_node_id];
+                hot.conditional = (hot.op_type != OPTYPE_ERROR) &&
+                                  (src_node.br_class_br_behavior.conditionality == BrClass::Conditionality::CONDITIONAL);
+
+                if ((hot.op_type == OPTYPE_ERROR) && (hot.src_node_id != 0)) {
+                    load_stats_.unclassified_edges++;
+                }
+            }
+        }
+
+        /*!
+         * \brief Decode BT10 edge ids from the trace stream
+         * \param out Destination array of edge ids
+         * \param capacity Number of entries available in out
+         * \return Number of edge ids written, sets decoder_eof_ when the EOF marker is reached
+         * \note Runs of 1-byte ids are widened by the selected BT10 run decoder (see
+         *       bt10_decoder.h); escaped and invalid ids go through the record loop
+         */
+        uint64_t parser_BT10(uint32_t * out, uint64_t capacity){
+
+            uint64_t count = 0;
+
+            uint8_t * data = parser_data_.data();
+
+            // Work on locals and write the members back on return, the stores to out could alias them
+            uint32_t ptr = parser_ptr_;
+            uint64_t decoded = decoded_branches_;
+            const uint8_t max_short_id = max_short_edge_id_;
+
+            auto finish = [&]() {
+                parser_ptr_ = ptr;
+                line_num_ += decoded - decoded_branches_;
+                decoded_branches_ = decoded;
+                return count;
+            };
+
+            while(1){
+
+                uint32_t bytes_left = BT10_PARSER_BUFFER_SIZE - ptr;
+
+                if(bytes_left < 5){
+                    // Keep the partial record at the front and refill the rest
+                    memmove(data, &data[ptr], bytes_left);
+                    parser_offset_ += ptr;
 
                     pinfile_.read((char*)(data + bytes_left), BT10_PARSER_BUFFER_SIZE - bytes_left);
+
+                    // Past the end of the stream the buffer reads as escaped ids no edge table can
+                    // hold, so a stream cut short of its EOF marker fails the edge index check
+                    const uint64_t filled = bytes_left + pinfile_.gcount();
+                    if(filled < BT10_PARSER_BUFFER_SIZE){
+                        memset(data + filled, 0xFF, BT10_PARSER_BUFFER_SIZE - filled);
+                        parser_stream_end_ = parser_offset_ + filled;
+                    }
                     ptr = 0;
-                    initiliazed = 1;
+                    bytes_left = BT10_PARSER_BUFFER_SIZE;
+                }
 
-                    uint8_t* p2 = data + ptr;
-                    // printf("DEBUG-CPP: DATA AFTER -> Raw=0x%02x 0x%02x 0x%02x 0x%02x\n",
-                        // p2[0], p2[1], p2[2], p2[3]);
+                // Only taken while building a seek index
+                if(decoded == next_checkpoint_){
+                    recordCheckpoint_(parser_offset_ + ptr);
+                }
+
+                // Widen 1-byte ids up to the next escape, the end of the buffer or the next checkpoint;
+                // single 1-byte ids between escapes are cheaper in the record loop below
+                if((data[ptr] <= max_short_id) && (data[ptr + 1] <= max_short_id)){
+                    const uint64_t limit = std::min<uint64_t>({ bytes_left, capacity - count, next_checkpoint_ - decoded });
+                    const uint64_t run = widen_bt10_(data + ptr, limit, out + count, max_short_id);
+                    ptr += run;
+                    count += run;
+                    decoded += run;
+
+                    if(count >= capacity) { return finish(); }
+
+                    // An escaped id needs all 5 bytes in the buffer
+                    if((run == limit) || (BT10_PARSER_BUFFER_SIZE - ptr < 5)) { continue; }
                 }
 
                 uint32_t new_edge = data[ptr];
-                // printf("DEBUG-CPP: Read 1 byte -> Raw=0x%02x\n", (uint8_t)data[ptr]);
                 ptr++;
 
                 if(new_edge == 255){
-                    // printf("DEBUG-CPP: It's an escape byte!\n");
-                    uint8_t* p = data + ptr;
-
                     memcpy(&new_edge, (data + ptr), 4);
                     ptr += 4;
 
-                    // printf("DEBUG-CPP: Read 4 bytes -> Raw=0x%02x 0x%02x 0x%02x 0x%02x -> Interpreted as ID=%u\n",
-                        // p[0], p[1], p[2], p[3], new_edge);
-
                     // EOF
                     if(new_edge == 0){
-                        // printf("DEBUG-CPP: EOF detected.\n");
-                        reach_eof_ = true;
-                        return;
+                        decoder_eof_ = true;
+                        return finish();
                     }
 
                 }
 
-                // printf("DEBUG-CPP: Final Edge ID -> %u\n\n", new_edge);
-                const int is_buffer_full = appendToBuffer(new_edge);
-                if(is_buffer_full) { return; }
+                // Check if the number is a valid edge index
+                if (!isValidEdgeIndex_(new_edge)) {
+                    invalidEdgeIndex_(new_edge, decoded, parser_offset_ + ptr);
+                }
+
+                out[count] = new_edge;
+                count++;
+                decoded++;
+
+                if(count >= capacity) { return finish(); }
             }
 
         }
 
+        /*!
+         * \brief Attach to the shared memory image of this trace published by the trace server
+         * \note Only the header is checked. The server decoded the trace itself and writes the
+         *       magic last, so its edge ids are trusted, unlike those of a .bt10c file on disk
+         * \return Returns false if there is no server, it does not serve this trace or the image
+         *         is stale (the trace file size or modification time changed) or still being written
+         */
+        bool attachTraceServer_()
+        {
+            uint64_t size = 0;
+            int64_t mtime_ns = 0;
+            if (!traceFileStamp(tracefile_name_, size, mtime_ns) || !trace_cache_.mapSharedMemory(traceSegmentName(tracefile_name_))) {
+                return false;
+            }
+
+            if (!loadTraceCache_(size, mtime_ns)) {
+                closeTraceCache_();
+                return false;
+            }
+
+            server_image_ = true;
+            return true;
+        }
+
+        /*!
+         * \brief Map the trace cache of this trace, converting the trace first if it is missing or invalid
+         * \param cache_dir Directory holding .bt10c files, created if missing
+         * \return Returns false if no usable cache could be mapped; nothing has been read
+         *         from the trace stream then
+         */
+        bool openTraceCache_(const std::string & cache_dir)
+        {
+            uint64_t size = 0;
+            int64_t mtime_ns = 0;
+            if (!traceFileStamp(tracefile_name_, size, mtime_ns)) {
+                return false;
+            }
+
+            const std::string path = traceCachePath(cache_dir, tracefile_name_);
+
+            if (trace_cache_.map(path)) {
+                if (loadTraceCache_(size, mtime_ns)) {
+                    return true;
+                }
+                closeTraceCache_();
+
+                // Only a trace that was rewritten or touched is hashed, to keep a cache of the same contents
+                if (restampTraceCache(path, tracefile_name_, size, mtime_ns) && trace_cache_.map(path)) {
+                    if (loadTraceCache_(size, mtime_ns)) {
+                        return true;
+                    }
+                    closeTraceCache_();
+                }
+
+                std::cerr << "Rebuilding invalid trace cache \'" << path << "\'\n";
+            }
+
+            uint64_t hash = 0;
+            uint64_t hashed_size = 0;
+            if (!hashTraceFile(tracefile_name_, hash, hashed_size) || (hashed_size != size)) {
+                return false;
+            }
+
+            // Convert with a separate reader so this one's stream is still untouched on failure
+            BT9Reader source(tracefile_name_, true, "", io_);
+            if (!source.writeTraceCache_(cache_dir, path, hash, size, mtime_ns) || !trace_cache_.map(path)) {
+                return false;
+            }
+
+            if (!loadTraceCache_(size, mtime_ns)) {
+                closeTraceCache_();
+                return false;
+            }
+
+            return true;
+        }
+
+        /*!
+         * \brief Fill the header, node and edge tables from a columnar trace
+         * \note The BT10 parser is replaced by the column decoder, the trace stream is not read
+         * \return Returns false if the trace is not a columnar trace
+         */
+        bool openColumnarTrace_()
+        {
+            if (!isColumnarTrace(tracefile_name_)) {
+                return false;
+            }
+
+            columnar_ = std::make_unique<ColumnarTraceDecoder>();
+            if (!columnar_->open(tracefile_name_)) {
+                throw TraceError("Invalid or incompatible columnar trace \'" + tracefile_name_ + "\'");
+            }
+
+            std::istringstream header_text(columnar_->headerText());
+            readBT9Header_(header_text);
+
+            resizeNodeTables_(columnar_->nodes().size());
+            for (uint32_t id = 0; id < node_core_.size(); id++) {
+                storeNode_(id, columnar_->nodes()[id]);
+            }
+
+            resizeEdgeTables_(columnar_->edges().size());
+            for (uint32_t id = 0; id < hot_edge_table_.size(); id++) {
+                storeEdge_(id, columnar_->edges()[id]);
+            }
+
+            reach_edge_table_ = true;
+            reach_edge_seq_list_ = true;
+
+            return true;
+        }
+
+        /// Drop a mapped trace cache and whatever loadTraceCache_() filled in from it
+        void closeTraceCache_()
+        {
+            header = BT9ReaderHeader();
+            header_text_.clear();
+            line_num_ = 0;
+            reach_node_table_ = false;
+            reach_edge_table_ = false;
+            reach_edge_seq_list_ = false;
+            resizeNodeTables_(0);
+            resizeEdgeTables_(0);
+            trace_cache_.unmap();
+            server_image_ = false;
+        }
+
+        /*!
+         * \brief Fill the header, node and edge tables from the mapped trace cache
+         * \note The edge sequence list is used in place: the access window covers the whole
+         *       mapped edge id array and no decoding takes place
+         * \param size Expected trace file size
+         * \param mtime_ns Expected trace modification time
+         * \note The edge ids are not scanned here, that would read 4 bytes per branch of the trace
+         *       on every start; readBranchBlock() checks them block by block instead
+         * \return Returns false if the cache does not match the trace or this build
+         */
+        bool loadTraceCache_(uint64_t size, int64_t mtime_ns)
+        {
+            const uint8_t * data = trace_cache_.data();
+            const uint64_t file_size = trace_cache_.size();
+
+            TraceCacheHeader h;
+            if (file_size < sizeof(h)) {
+                return false;
+            }
+            memcpy(&h, data, sizeof(h));
+
+            auto fits = [file_size](uint64_t offset, uint64_t count, uint64_t record_size) {
+                return (offset <= file_size) && (count <= (file_size - offset) / record_size);
+            };
+
+            if ((memcmp(h.magic, TRACE_CACHE_MAGIC, sizeof(h.magic)) != 0) ||
+                (h.version != TRACE_CACHE_VERSION) ||
+                (h.node_record_size != sizeof(TraceCacheNode)) ||
+                (h.edge_record_size != sizeof(TraceCacheEdge)) ||
+                (h.source_mtime_ns != mtime_ns) || (h.source_size != size) ||
+                !fits(h.header_text_offset, h.header_text_size, 1) ||
+                !fits(h.nodes_offset, h.num_nodes, sizeof(TraceCacheNode)) ||
+                !fits(h.edges_offset, h.num_edges, sizeof(TraceCacheEdge)) ||
+                !fits(h.ids_offset, h.num_branches, sizeof(uint32_t)) ||
+                (h.ids_offset % alignof(uint32_t) != 0)) {
+                return false;
+            }
+
+            std::istringstream header_text(std::string(reinterpret_cast<const char *>(data + h.header_text_offset), h.header_text_size));
+            readBT9Header_(header_text);
+
+            resizeNodeTables_(h.num_nodes);
+            for (uint64_t i = 0; i < h.num_nodes; i++) {
+                TraceCacheNode rec;
+                memcpy(&rec, data + h.nodes_offset + i * sizeof(rec), sizeof(rec));
+
+                storeNode_(i, rec);
+            }
+
+            resizeEdgeTables_(h.num_edges);
+            for (uint64_t i = 0; i < h.num_edges; i++) {
+                TraceCacheEdge rec;
+                memcpy(&rec, data + h.edges_offset + i * sizeof(rec), sizeof(rec));
+
+                if ((rec.src_node_id >= h.num_nodes) || (rec.dest_node_id >= h.num_nodes)) {
+                    return false;
+                }
+
+                if (rec.inst_cnt > std::numeric_limits<uint32_t>::max()) {
+                    return false;
+                }
+
+                storeEdge_(i, rec);
+            }
+
+            const uint32_t * ids = reinterpret_cast<const uint32_t *>(data + h.ids_offset);
+
+            reach_edge_table_ = true;
+            reach_edge_seq_list_ = true;
+
+            buffer_ = ids;
+            buffer_read_ptr_ = 0;
+            buffer_write_ptr_ = h.num_branches;
+            reach_eof_ = true;
+            decoder_eof_ = true;
+
+            return true;
+        }
+
+        /// Size the core and cold node tables, entries are filled by storeNode_()
+        void resizeNodeTables_(uint64_t num_nodes)
+        {
+            node_core_.assign(num_nodes, BT9NodeCore());
+            node_cold_.assign(num_nodes, BT9NodeCold());
+            node_table_.clear();
+        }
+
+        /// Size the hot and cold edge tables, entries are filled by storeEdge_()
+        void resizeEdgeTables_(uint64_t num_edges)
+        {
+            hot_edge_table_.assign(num_edges, BT9HotEdge());
+            edge_cold_.assign(num_edges, BT9EdgeCold());
+            edge_table_.clear();
+        }
+
+        /// Split a node record into the core and cold node tables
+        void storeNode_(uint32_t id, const TraceCacheNode & rec)
+        {
+            auto & core = node_core_[id];
+            core.br_virtual_addr = rec.br_virtual_addr;
+            core.opcode = rec.opcode;
+            core.br_class_br_behavior = rec.br_class_br_behavior;
+            core.opcode_size = rec.opcode_size;
+
+            auto & cold = node_cold_[id];
+            cold.br_phy_addr = rec.br_phy_addr;
+            cold.br_tgt_cnt = rec.br_tgt_cnt;
+            cold.br_taken_cnt = rec.br_taken_cnt;
+            cold.br_untaken_cnt = rec.br_untaken_cnt;
+            cold.br_phy_addr_valid = rec.br_phy_addr_valid;
+        }
+
+        /*!
+         * \brief Split an edge record into the hot and cold edge tables
+         * \note The source node fields of the hot record are joined by buildHotEdgeTable_()
+         */
+        void storeEdge_(uint32_t id, const TraceCacheEdge & rec)
+        {
+            if (rec.inst_cnt > std::numeric_limits<uint32_t>::max()) {
+                throw TraceError("\'" + tracefile_name_ + "\' edge: " + std::to_string(id) + " non-branch instruction count " +
+                                 std::to_string(rec.inst_cnt) + " is too large!");
+            }
+
+            auto & hot = hot_edge_table_[id];
+            hot.target = rec.br_virtual_tgt;
+            hot.inst_cnt = static_cast<uint32_t>(rec.inst_cnt);
+            hot.edge_id = id;
+            hot.src_node_id = rec.src_node_id;
+            hot.taken = rec.is_taken_path;
+
+            auto & cold = edge_cold_[id];
+            cold.observed_traverse_cnt = rec.observed_traverse_cnt;
+            cold.br_phy_tgt = rec.br_phy_tgt;
+            cold.dest_node_id = rec.dest_node_id;
+            cold.br_phy_tgt_valid = rec.br_phy_tgt_valid;
+        }
+
+        /// Node record in the trace cache record layout, joined from the core and cold tables
+        TraceCacheNode nodeRecord_(uint32_t id) const
+        {
+            const auto & core = node_core_[id];
+            const auto & cold = node_cold_[id];
+
+            TraceCacheNode rec = {};
+            rec.br_virtual_addr = core.br_virtual_addr;
+            rec.br_phy_addr = cold.br_phy_addr;
+            rec.id = id;
+            rec.opcode = core.opcode;
+            rec.br_tgt_cnt = cold.br_tgt_cnt;
+            rec.br_taken_cnt = cold.br_taken_cnt;
+            rec.br_untaken_cnt = cold.br_untaken_cnt;
+            rec.br_class_br_behavior = core.br_class_br_behavior;
+            rec.opcode_size = core.opcode_size;
+            rec.br_phy_addr_valid = cold.br_phy_addr_valid;
+            return rec;
+        }
+
+        /// Edge record in the trace cache record layout, joined from the hot and cold tables
+        TraceCacheEdge edgeRecord_(uint32_t id) const
+        {
+            const auto & hot = hot_edge_table_[id];
+            const auto & cold = edge_cold_[id];
+
+            TraceCacheEdge rec = {};
+            rec.observed_traverse_cnt = cold.observed_traverse_cnt;
+            rec.br_virtual_tgt = hot.target;
+            rec.br_phy_tgt = cold.br_phy_tgt;
+            rec.inst_cnt = hot.inst_cnt;
+            rec.id = id;
+            rec.src_node_id = hot.src_node_id;
+            rec.dest_node_id = cold.dest_node_id;
+            rec.is_taken_path = hot.taken;
+            rec.br_phy_tgt_valid = cold.br_phy_tgt_valid;
+            return rec;
+        }
+
+        /// Parsed node record in the trace cache record layout
+        static TraceCacheNode flattenNode_(const BT9ReaderNodeRecord & node)
+        {
+            TraceCacheNode rec = {};
+            rec.br_virtual_addr = node.br_virtual_addr_;
+            rec.br_phy_addr = node.br_phy_addr_;
+            rec.id = node.id_;
+            rec.opcode = node.opcode_;
+            rec.br_tgt_cnt = node.br_tgt_cnt_;
+            rec.br_taken_cnt = node.br_taken_cnt_;
+            rec.br_untaken_cnt = node.br_untaken_cnt_;
+            rec.br_class_br_behavior = node.br_class_br_behavior_;
+            rec.opcode_size = node.opcode_size_;
+            rec.br_phy_addr_valid = node.br_phy_addr_valid_;
+            return rec;
+        }
+
+        /// Parsed edge record in the trace cache record layout
+        static TraceCacheEdge flattenEdge_(const BT9ReaderEdgeRecord & edge)
+        {
+            TraceCacheEdge rec = {};
+            rec.observed_traverse_cnt = edge.observed_traverse_cnt_;
+            rec.br_virtual_tgt = edge.br_virtual_tgt_;
+            rec.br_phy_tgt = edge.br_phy_tgt_;
+            rec.inst_cnt = edge.inst_cnt_;
+            rec.id = edge.id_;
+            rec.src_node_id = edge.src_node_id_;
+            rec.dest_node_id = edge.dest_node_id_;
+            rec.is_taken_path = edge.is_taken_path_;
+            rec.br_phy_tgt_valid = edge.br_phy_tgt_valid_;
+            return rec;
+        }
+
+        /*!
+         * \brief Build the BT9ReaderNodeRecord and BT9ReaderEdgeRecord tables on first use
+         * \note Only BT9BranchInstance needs them, the simulation loop reads the hot edge table
+         */
+        void buildLegacyTables_() const
+        {
+            if ((node_table_.size() == node_core_.size()) && (edge_table_.size() == hot_edge_table_.size())) {
+                return;
+            }
+
+            node_table_.resize(node_core_.size());
+            for (uint32_t id = 0; id < node_core_.size(); id++) {
+                const TraceCacheNode rec = nodeRecord_(id);
+                auto & node = node_table_[id];
+                node.br_virtual_addr_ = rec.br_virtual_addr;
+                node.br_phy_addr_ = rec.br_phy_addr;
+                node.id_ = rec.id;
+                node.opcode_ = rec.opcode;
+                node.br_tgt_cnt_ = rec.br_tgt_cnt;
+                node.br_taken_cnt_ = rec.br_taken_cnt;
+                node.br_untaken_cnt_ = rec.br_untaken_cnt;
+                node.br_class_br_behavior_ = rec.br_class_br_behavior;
+                node.opcode_size_ = rec.opcode_size;
+                node.br_phy_addr_valid_ = rec.br_phy_addr_valid;
+            }
+
+            edge_table_.resize(hot_edge_table_.size());
+            for (uint32_t id = 0; id < hot_edge_table_.size(); id++) {
+                const TraceCacheEdge rec = edgeRecord_(id);
+                auto & edge = edge_table_[id];
+                edge.observed_traverse_cnt_ = rec.observed_traverse_cnt;
+                edge.br_virtual_tgt_ = rec.br_virtual_tgt;
+                edge.br_phy_tgt_ = rec.br_phy_tgt;
+                edge.inst_cnt_ = rec.inst_cnt;
+                edge.id_ = rec.id;
+                edge.src_node_id_ = rec.src_node_id;
+                edge.dest_node_id_ = rec.dest_node_id;
+                edge.is_taken_path_ = rec.is_taken_path;
+                edge.br_phy_tgt_valid_ = rec.br_phy_tgt_valid;
+            }
+        }
+
+        /*!
+         * \brief Write the trace cache file of this reader
+         * \note The file is written under a temporary name and renamed into place, so concurrent
+         *       conversions of the same trace never expose a partial cache.
+         * \return Returns false (with a warning) if the cache could not be written
+         */
+        bool writeTraceCache_(const std::string & cache_dir, const std::string & path, uint64_t hash, uint64_t size, int64_t mtime_ns)
+        {
+            mkdir(cache_dir.c_str(), 0777);
+
+            const std::string tmp_path = path + ".tmp." + std::to_string(getpid());
+            FILE * fout = fopen(tmp_path.c_str(), "wb");
+            if (fout == nullptr) {
+                std::cerr << "Failed to create trace cache \'" << tmp_path << "\'\n";
+                return false;
+            }
+
+            std::cerr << "Writing trace cache \'" << path << "\' for \'" << tracefile_name_ << "\'\n";
+
+            const bool ok = writeTraceImage(fout, hash, size, mtime_ns);
+            if ((fclose(fout) != 0) || !ok || (rename(tmp_path.c_str(), path.c_str()) != 0)) {
+                std::cerr << "Failed to write trace cache \'" << path << "\'\n";
+                remove(tmp_path.c_str());
+                return false;
+            }
+
+            return true;
+        }
+
         /*!
          * \brief Initialize BT9 edge sequence list access window
          * \note The window size can be configured when BT9Reader instance is constructed.
@@ -1475,99 +2393,206 @@ namespace bt9 {
         void initBT9EdgeSeqListAccessWindow_()
         {
             if (!reach_edge_seq_list_) {
-                std::cerr << "\'BT9_EDGE_SEQUENCE\' is missing!\n";
-                exit(-1);
+                fail_("\'BT9_EDGE_SEQUENCE\' is missing!");
             }
 
-            shiftBT9EdgeSeqListAccessWindow_();
+            // Every edge sequence list starts with the dummy edge leaving node 0
+            if (hot_edge_table_.empty()) {
+                fail_("edge table is empty!");
+            }
+
+            // Escape bytes (255) always end a run of 1-byte ids, and so do ids beyond the edge table
+            max_short_edge_id_ = static_cast<uint8_t>(std::min<size_t>(hot_edge_table_.size(), 255) - 1);
+
+            bt10_stream_offset_ = tracebuf_.tell();
+            resetDecoder_(bt10_stream_offset_, 0);
+            startDecoder_();
 
         }
 
         /*!
-         * \brief Shift BT9 edge sequence list access window foward
-         * \note Forward shifting stride is half buffer size
+         * \brief Reset the BT10 decoder and the access window to a record boundary
+         * \param stream_offset Trace stream offset of the next BT10 record, the stream must be positioned there
+         * \param branch Edge sequence list position of that record
          */
-        void shiftBT9EdgeSeqListAccessWindow_()
+        void resetDecoder_(uint64_t stream_offset, uint64_t branch)
         {
-            assert(!reach_eof_);
-
+            // parser_offset_ + parser_ptr_ is the stream offset of the next record; the
+            // subtraction wraps around and is undone by the first refill
+            parser_ptr_ = BT10_PARSER_BUFFER_SIZE;
+            parser_offset_ = stream_offset - BT10_PARSER_BUFFER_SIZE;
+            parser_stream_end_ = UINT64_MAX;
+            decoded_branches_ = branch;
+            decoder_eof_ = false;
+
+            buffer_ = local_buffer_;
+            buffer_read_ptr_ = 0;
             buffer_write_ptr_ = 0;
-            parser_BT10();
+            reach_eof_ = false;
+        }
 
-            assert(buffer_write_ptr_ <= EDGE_SEQUENCE_BUFFER_SIZE);
+        /// Start the decode thread in pipelined mode and fill the first access window
+        void startDecoder_()
+        {
+            if (pipelined_) {
+                ring_ = std::make_unique<SpscRing<EdgeBlock>>(PIPELINE_NUM_BLOCKS, EdgeBlock(PIPELINE_BLOCK_SIZE));
+                holding_block_ = false;
+                decode_thread_ = std::thread(&BT9Reader::decodeThread_, this);
+            }
 
+            shiftBT9EdgeSeqListAccessWindow_();
         }
 
-        int appendToBuffer(uint32_t edge_id)
+        /// Stop the decode thread, if running; the access window is invalid afterwards
+        void stopDecoder_()
         {
-            // Check if the number is a valid edge index
-            if (!isValidEdgeIndex_(edge_id)) {
-                std::cout << "\nInvalid Edge Index! edge: " << edge_id << '\n';
-                exit(1);
+            if (decode_thread_.joinable()) {
+                ring_->cancel();
+                decode_thread_.join();
             }
+        }
 
-#ifdef DEBUG_PRINTS
-            printf("edge_id: %d\n", line_num_, edge_id);
-#endif
+        /*!
+         * \brief Decode the whole edge sequence list, recording a checkpoint every interval branches
+         * \note Runs the decoder inline and leaves the reader at the end of the trace
+         * \return Returns false in pipelined mode
+         */
+        bool buildSeekIndex_(uint64_t interval)
+        {
+            if (pipelined_) {
+                return false;
+            }
 
-            buffer_[buffer_write_ptr_] = edge_id;
-            buffer_write_ptr_++;
-            line_num_++;
+            // The first window is already decoded, start over from the first record
+            seek_index_ = SeekIndex();
+            seek_index_.interval = interval;
+            next_checkpoint_ = 0;
+            seekToBranch(0);
 
-            const int is_buffer_full = buffer_write_ptr_ >= EDGE_SEQUENCE_BUFFER_SIZE;
+            while (!reach_eof_) {
+                shiftBT9EdgeSeqListAccessWindow_();
+            }
 
-            return is_buffer_full;
+            next_checkpoint_ = UINT64_MAX;
+            seek_index_.num_branches = decoded_branches_;
 
+            return true;
+        }
+
+        /// Record the trace stream offset of the next BT10 record as a seek index checkpoint
+        void recordCheckpoint_(uint64_t offset)
+        {
+            seek_index_.checkpoints.push_back({ offset, tracebuf_.anchorFor(offset) });
+            next_checkpoint_ += seek_index_.interval;
+        }
+
+        /// Decode the next edge ids from the BT10 stream, or from the columns of a columnar trace
+        uint64_t decodeEdgeIds_(uint32_t * out, uint64_t capacity)
+        {
+            if (columnar_) {
+                return columnar_->decode(out, capacity, decoder_eof_);
+            }
+
+            return parser_BT10(out, capacity);
         }
 
         /*!
-         * \brief Helper function provided by BT9Reader to increment BranchInstanceIterator
-         * \param idx The iterator access index
-         * \return Returns true if the iterator reaches the end of file
+         * \brief Body of the background decode thread used in pipelined mode
+         * \note Fills ring blocks until the EOF marker is decoded or the ring is cancelled
          */
-        bool moveToNextEdgeSeqListEntry_(uint64_t & idx) {
-            idx++;
-
-            if (buffer_read_ptr_ >= buffer_write_ptr_) {
+        void decodeThread_()
+        {
+            while (!decoder_eof_) {
+                EdgeBlock * block = ring_->acquireWrite();
+                if (block == nullptr) {
+                    return;
+                }
 
-                if (reach_eof_) {
-                    return true;
+                // A decode error ends the stream here and is rethrown on the reader side
+                try {
+                    block->count = decodeEdgeIds_(block->ids.data(), block->ids.size());
+                    block->eof = decoder_eof_;
                 }
+                catch (...) {
+                    decoder_eof_ = true;
+                    block->count = 0;
+                    block->eof = true;
+                    block->error = std::current_exception();
+                }
+                ring_->publishWrite();
+            }
+        }
 
-                shiftBT9EdgeSeqListAccessWindow_();
+        /*!
+         * \brief Shift BT9 edge sequence list access window foward
+         * \note Forward shifting stride is half buffer size
+         */
+        void shiftBT9EdgeSeqListAccessWindow_()
+        {
+            assert(!reach_eof_);
 
-                if (reach_eof_ & (buffer_write_ptr_ == 0)) {
-                    return true;
+            if (pipelined_) {
+                // Hand the drained block back to the decode thread and take the next one
+                if (holding_block_) {
+                    ring_->releaseRead();
                 }
 
-                buffer_read_ptr_ = 0;
+                const EdgeBlock & block = ring_->acquireRead();
+                holding_block_ = true;
+                if (block.error) {
+                    std::rethrow_exception(block.error);
+                }
 
+                buffer_ = block.ids.data();
+                buffer_write_ptr_ = block.count;
+                reach_eof_ = block.eof;
+            }
+            else {
+                buffer_write_ptr_ = decodeEdgeIds_(local_buffer_, EDGE_SEQUENCE_BUFFER_SIZE);
+                reach_eof_ = decoder_eof_;
             }
 
-            return false;
         }
 
         /*!
-         * \brief Helper function provided by BT9Reader to get the edge sequence list entry
-         * \param idx The iterator access index
+         * \brief Helper function provided by BT9Reader to construct a begin iterator
+         * \note Fills the iterator branch block if it is empty
+         * \return Returns true if there is no branch left
          */
-        const uint32_t & getEdgeSeqListEntry_(const uint64_t & idx) {
+        bool primeBranchBlock_() {
+            if (branch_block_read_ptr_ >= branch_block_size_) {
+                branch_block_size_ = readBranchBlock(branch_block_);
+                branch_block_read_ptr_ = 0;
+            }
 
-            assert(buffer_read_ptr_ < buffer_write_ptr_);
+            return (branch_block_size_ == 0);
+        }
 
-            return buffer_[buffer_read_ptr_++];
+        /*!
+         * \brief Helper function provided by BT9Reader to increment the iterators
+         * \return Returns true if the iterator reaches the end of file
+         */
+        bool moveToNextBranch_() {
+            branch_block_read_ptr_++;
+            return primeBranchBlock_();
+        }
 
+        /// Helper function provided by BT9Reader to dereference the iterators
+        const BT9HotEdge & currentBranch_() const {
+            assert(branch_block_read_ptr_ < branch_block_size_);
+            return branch_block_[branch_block_read_ptr_];
         }
 
         /*!
          * \brief Helper function provided by BT9Reader to load branch instance if it's the
          *        first access by the iterator.
-         * \param idx The iterator access index
          * \param br_inst The branch instance bufferred inside the iterator
          */
-        void loadBT9BranchInstance_(const uint64_t & idx, BT9BranchInstance & br_inst)
+        void loadBT9BranchInstance_(BT9BranchInstance & br_inst)
         {
-            const auto & edge_id = getEdgeSeqListEntry_(idx);
+            buildLegacyTables_();
+
+            const auto & edge_id = currentBranch_().edge_id;
             const auto & edge_rec_ptr = &edge_table_[edge_id];
             const auto & src_node_rec_ptr = &node_table_[edge_rec_ptr->src_node_id_];
             const auto & dest_node_rec_ptr = &node_table_[edge_rec_ptr->dest_node_id_];
@@ -1588,7 +2613,7 @@ namespace bt9 {
          * \note This is for internal use by the BT9Reader only
          */
         NodeTableIterator nodeTableEnd_() const {
-            return NodeTableIterator(this, node_table_.size());
+            return NodeTableIterator(this, node_core_.size());
         }
 
         /*!
@@ -1604,7 +2629,7 @@ namespace bt9 {
          * \note This is for internal use by the BT9Reader only
          */
         EdgeTableIterator edgeTableEnd_() const {
-            return EdgeTableIterator(this, edge_table_.size());
+            return EdgeTableIterator(this, hot_edge_table_.size());
         }
 
         /// BT9 trace file name
@@ -1616,14 +2641,39 @@ namespace bt9 {
         /// BT9 trace file line number
         uint64_t line_num_ = 0;
 
-        /// BT9 internal node look-up table
-        std::vector<BT9ReaderNodeRecord> node_table_;
+        /// Node fields needed to build the hot edge table, indexed by node id
+        std::vector<BT9NodeCore> node_core_;
+
+        /// Diagnostic node fields, indexed by node id
+        std::vector<BT9NodeCold> node_cold_;
 
         /// Indicate if reading stream reaches node table
         bool reach_node_table_ = false;
 
-        /// BT9 internal edge look-up table
-        std::vector<BT9ReaderEdgeRecord> edge_table_;
+        /// Pre-joined hot edge table, indexed by edge id
+        std::vector<BT9HotEdge> hot_edge_table_;
+
+        /// Edge fields not in the hot edge table, indexed by edge id
+        std::vector<BT9EdgeCold> edge_cold_;
+
+        /// BT9ReaderNodeRecord and BT9ReaderEdgeRecord tables, empty until buildLegacyTables_()
+        mutable std::vector<BT9ReaderNodeRecord> node_table_;
+        mutable std::vector<BT9ReaderEdgeRecord> edge_table_;
+
+        /// Table sizes and load time, filled by the constructor
+        BT9LoadStats load_stats_;
+
+        /// Raw header lines, kept for the trace cache
+        std::string header_text_;
+
+        /// Mapped trace cache, the edge sequence list access window points into it when used
+        MappedFile trace_cache_;
+
+        /// Indicate if trace_cache_ is the image of the trace server, whose edge ids are not rechecked
+        bool server_image_ = false;
+
+        /// Column decoder replacing the BT10 parser for columnar traces, nullptr otherwise
+        std::unique_ptr<ColumnarTraceDecoder> columnar_;
 
         /// Indicate if reading stream reaches edge table
         bool reach_edge_table_ = false;
@@ -1631,22 +2681,83 @@ namespace bt9 {
         /// Indicate if reading stream reaches edge sequence list
         bool reach_edge_seq_list_ = false;
 
-        /// Indicate if reading stream reaches end of file
+        /// Indicate if the consumer side reaches end of file
         bool reach_eof_ = false;
 
-        /// Boost iostreams stream buffer that could be constructed from a file descriptor
-        boost::iostreams::stream_buffer<boost::iostreams::file_descriptor_source> fpstream_;
+        /// Indicate if the BT10 decoder reaches the EOF marker (owned by the decode thread in pipelined mode)
+        bool decoder_eof_ = false;
+
+        /// How the trace file is read, also used by the readers building seek indexes and trace caches
+        TraceIoOptions io_;
+
+        /// Trace file stream buffer, decompresses .zst traces in-process
+        TraceStreamBuf tracebuf_;
 
         /// BT9 reader istream handle
         std::istream pinfile_;
 
-        /// BT9 reader edge sequence list access window
-        uint32_t buffer_[EDGE_SEQUENCE_BUFFER_SIZE];
+        /// BT10 decoder input bytes and read position, starting at the end so the first call refills
+        std::vector<uint8_t> parser_data_ = std::vector<uint8_t>(BT10_PARSER_BUFFER_SIZE);
+        uint32_t parser_ptr_ = BT10_PARSER_BUFFER_SIZE;
+
+        /// Trace stream offset of parser_data_[0]
+        uint64_t parser_offset_ = 0;
+
+        /// Trace stream offset of the end of the stream once the BT10 decoder has read it, UINT64_MAX before
+        uint64_t parser_stream_end_ = UINT64_MAX;
+
+        /// Trace stream offset of the first BT10 record
+        uint64_t bt10_stream_offset_ = 0;
+
+        /// Edge sequence list position of the next record the BT10 decoder reads
+        uint64_t decoded_branches_ = 0;
+
+        /// Branch at which the BT10 decoder records the next seek index checkpoint, only while building one
+        uint64_t next_checkpoint_ = UINT64_MAX;
+
+        /// Seek index checkpoints, empty until openSeekIndex()
+        SeekIndex seek_index_;
+
+        /// BT10 run decoder and the largest edge id it may widen
+        BT10WidenFunction widen_bt10_ = bt10WidenFunction(bestBT10Decoder());
+        uint8_t max_short_edge_id_ = 0;
+
+        /// Edge sequence list storage used when decoding inline
+        uint32_t local_buffer_[EDGE_SEQUENCE_BUFFER_SIZE];
+
+        /// BT9 reader edge sequence list access window (local_buffer_ or the current ring block)
+        const uint32_t * buffer_ = local_buffer_;
 
         /// Read and write pointers for the buffer
         uint64_t buffer_read_ptr_ = 0;
         uint64_t buffer_write_ptr_ = 0;
 
+        /// Branch block shared by the iterators, refilled through readBranchBlock()
+        std::vector<BT9HotEdge> branch_block_ = std::vector<BT9HotEdge>(BRANCH_BLOCK_SIZE);
+        uint64_t branch_block_read_ptr_ = 0;
+        uint64_t branch_block_size_ = 0;
+
+        /*!
+         * \struct EdgeBlock
+         * \brief Block of decoded edge ids passed from the decode thread to the reader
+         */
+        struct EdgeBlock {
+            EdgeBlock(uint64_t size) : ids(size) {}
+
+            std::vector<uint32_t> ids;
+            uint64_t count = 0;
+            bool eof = false;
+            std::exception_ptr error;
+        };
+
+        /// Decode edge ids on a background thread
+        bool pipelined_ = false;
+
+        /// Ring of decoded blocks, decode thread and whether the reader currently holds a block
+        std::unique_ptr<SpscRing<EdgeBlock>> ring_;
+        std::thread decode_thread_;
+        bool holding_block_ = false;
+
     };
 
     /*!
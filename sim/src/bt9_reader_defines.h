@@ -1,5 +1,57 @@
 #define EDGE_SEQUENCE_BUFFER_SIZE 1024
-#define BT10_PARSER_BUFFER_SIZE 128
+#define BT10_PARSER_BUFFER_SIZE 65536
+
+// Trace file stream buffers (file hashing input, decompressed output)
+#define TRACE_STREAM_IN_BUFFER_SIZE (1 << 20)
+#define TRACE_STREAM_OUT_BUFFER_SIZE (4 << 20)
+
+// Trace file reads (readahead_file.h): default bytes per read, default chunks read ahead of the
+// decoder, and the alignment of the read buffers and chunk size
+#define TRACE_IO_CHUNK_SIZE (4 << 20)
+#define TRACE_IO_DEPTH 4
+#define TRACE_IO_ALIGNMENT 4096
+
+// zstd level used by the trace tools when writing .zst traces
+#define TRACE_WRITER_DEFAULT_LEVEL 19
+
+// Pipelined mode: edge ids per block handed from the decode thread, and blocks in the ring
+#define PIPELINE_BLOCK_SIZE (64 * 1024)
+#define PIPELINE_NUM_BLOCKS 8
+
+// Branch records per block filled by BT9Reader::readBranchBlock() for the driver and iterators
+#define BRANCH_BLOCK_SIZE 4096
+
+// Branches between two checkpoints of a seek index (.bt10i)
+#define SEEK_INDEX_INTERVAL (1 << 20)
+
+// Columnar traces (.bt9c): bytes buffered per column when writing and reading
+#define COLUMNAR_CHUNK_SIZE (256 * 1024)
+
+// Sampled simulation (simpoint.h): branches per interval, signature dimensions, largest number
+// of clusters, k-means iteration limit, seed, and branches simulated ahead of each interval
+#define SIMPOINT_INTERVAL (1 << 20)
+#define SIMPOINT_DIMS 15
+#define SIMPOINT_MAX_K 10
+#define SIMPOINT_KMEANS_ITERATIONS 100
+#define SIMPOINT_SEED 1
+#define SIMPOINT_WARMUP (1 << 20)
+
+// Chunked simulation (--chunks): branches simulated uncounted ahead of each chunk
+#define CHUNK_WARMUP (1 << 20)
+
+// Simulator checkpoints (--checkpoint): branches between two checkpoints of a run
+#define CHECKPOINT_INTERVAL (1 << 26)
+
+// Interval statistics (interval_stats.h): branches per interval with fixed spacing; with log
+// spacing the end of the first interval and the number of intervals per power of ten
+#define INTERVAL_PERIOD (1 << 20)
+#define INTERVAL_LOG_FIRST 1000
+#define INTERVAL_LOG_STEPS 10
+
+// Trace summaries (trace_info): cost model of the simulation time estimate, in ns per byte of
+// decompressed edge sequence and ns per branch of a gshare-class predictor
+#define TRACE_INFO_DECODE_NS_PER_BYTE 1.5
+#define TRACE_INFO_SIM_NS_PER_BRANCH 30.0
 
 //#define PRINT_EDGES_DEBUG
 //#define PRINT_NODES_DEBUG
@@ -0,0 +1,178 @@
+/*!
+ * \file    checkpoint.h
+ * \brief   Simulator checkpoints: binary cereal snapshots of a predictor and the run around it.
+ *
+ * A checkpoint file starts with a fixed CheckpointFileHeader, followed by a cereal binary
+ * archive of the CheckpointInfo and then of the state objects the simulator passes in: its
+ * counters, the stats struct, the interval stats sampled so far and the PREDICTOR, whose
+ * serialize() writes all tables and histories. The info names the predictor build and the trace, and records how many branches
+ * of the trace were read, which is where the reader resumes.
+ *
+ * Predictor snapshots are raw tables: they only load into a simulator built from the same
+ * predictor with the same parameters. The predictor path is checked, and a snapshot that does
+ * not fill the state exactly is rejected.
+ */
+
+#pragma once
+
+#include "seek_index.h"
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <type_traits>
+
+#include <unistd.h>
+
+#include <cereal/archives/binary.hpp>
+#include <cereal/types/string.hpp>
+#include <cereal/types/vector.hpp>
+
+namespace bt9 {
+
+    /// Bump whenever the layout of a checkpoint changes
+    static constexpr uint32_t CHECKPOINT_VERSION = 2;
+
+    /// File signature, first 8 bytes of every checkpoint
+    static constexpr char CHECKPOINT_MAGIC[8] = {'B', 'T', '9', 'C', 'K', 'P', 'N', 'T'};
+
+    /*!
+     * \struct CheckpointFileHeader
+     * \brief Fixed header at offset 0 of a checkpoint, followed by the cereal archive
+     */
+    struct CheckpointFileHeader {
+        char magic[8];
+        uint32_t version;
+        uint32_t reserved;
+    };
+
+    static_assert(std::is_trivially_copyable_v<CheckpointFileHeader>);
+
+    /*!
+     * \struct CheckpointInfo
+     * \brief What a checkpoint was taken of
+     */
+    struct CheckpointInfo {
+        std::string predictor;          //!< PREDICTOR_H_PATH of the simulator that wrote it
+        std::string trace;              //!< Trace file name without directories
+        uint64_t trace_size = 0;        //!< Size of the trace file in bytes
+        int64_t trace_mtime_ns = 0;     //!< Modification time of the trace file
+        uint64_t branch = 0;            //!< Branches of the edge sequence list read so far
+
+        template <class Archive>
+        void serialize(Archive & archive)
+        {
+            archive(predictor, trace, trace_size, trace_mtime_ns, branch);
+        }
+
+        /// Whether the checkpoint was taken of the trace file `path`, as it is now
+        bool matchesTrace(const std::string & path) const
+        {
+            uint64_t size = 0;
+            int64_t mtime_ns = 0;
+            return traceFileStamp(path, size, mtime_ns) && (size == trace_size) && (mtime_ns == trace_mtime_ns) &&
+                   (path.substr(path.find_last_of("/\\") + 1) == trace);
+        }
+    };
+
+    /// Info of a checkpoint taken after `branch` branches of the trace file `path`
+    inline CheckpointInfo checkpointInfo(const std::string & predictor, const std::string & path, uint64_t branch)
+    {
+        CheckpointInfo info;
+        info.predictor = predictor;
+        info.trace = path.substr(path.find_last_of("/\\") + 1);
+        traceFileStamp(path, info.trace_size, info.trace_mtime_ns);
+        info.branch = branch;
+        return info;
+    }
+
+    /*!
+     * \brief Write a checkpoint
+     * \param state Objects with a cereal serialize(), written in this order
+     * \note Written under a temporary name and renamed into place like the seek index, so an
+     *       interrupted write leaves the previous checkpoint intact
+     * \return Returns false if the file could not be written
+     */
+    template <class... State>
+    bool writeCheckpoint(const std::string & path, const CheckpointInfo & info, State & ... state)
+    {
+        const std::string tmp_path = path + ".tmp." + std::to_string(getpid());
+        bool ok = false;
+        {
+            std::ofstream fout(tmp_path, std::ios::binary);
+            if (fout) {
+                CheckpointFileHeader h = {};
+                memcpy(h.magic, CHECKPOINT_MAGIC, sizeof(h.magic));
+                h.version = CHECKPOINT_VERSION;
+                fout.write(reinterpret_cast<const char *>(&h), sizeof(h));
+                {
+                    cereal::BinaryOutputArchive archive(fout);
+                    archive(info, state...);
+                }
+                ok = static_cast<bool>(fout.flush());
+            }
+        }
+
+        if (!ok || (rename(tmp_path.c_str(), path.c_str()) != 0)) {
+            remove(tmp_path.c_str());
+            return false;
+        }
+
+        return true;
+    }
+
+    /*!
+     * \brief Load the info of a checkpoint, leaving the state it holds alone
+     * \return Returns false if the file is missing or not a checkpoint of this layout
+     */
+    inline bool readCheckpointInfo(const std::string & path, CheckpointInfo & info)
+    {
+        std::ifstream fin(path, std::ios::binary);
+        CheckpointFileHeader h = {};
+        if (!fin.read(reinterpret_cast<char *>(&h), sizeof(h)) ||
+            (memcmp(h.magic, CHECKPOINT_MAGIC, sizeof(h.magic)) != 0) || (h.version != CHECKPOINT_VERSION)) {
+            return false;
+        }
+
+        try {
+            cereal::BinaryInputArchive archive(fin);
+            archive(info);
+        }
+        catch (const std::exception &) {
+            return false;
+        }
+
+        return true;
+    }
+
+    /*!
+     * \brief Load a checkpoint into the given state objects
+     * \param predictor PREDICTOR_H_PATH the checkpoint must have been written with
+     * \param state Objects with a cereal serialize(), in the order they were written
+     * \note Check the info with readCheckpointInfo() first: state is overwritten even when
+     *       the snapshot turns out not to fit it
+     * \return Returns false if the checkpoint is unreadable, of another predictor, or does not
+     *         fill the state exactly
+     */
+    template <class... State>
+    bool readCheckpoint(const std::string & path, const std::string & predictor, CheckpointInfo & info, State & ... state)
+    {
+        if (!readCheckpointInfo(path, info) || (info.predictor != predictor)) {
+            return false;
+        }
+
+        std::ifstream fin(path, std::ios::binary);
+        fin.seekg(sizeof(CheckpointFileHeader));
+        try {
+            cereal::BinaryInputArchive archive(fin);
+            archive(info, state...);
+        }
+        catch (const std::exception &) {
+            return false;
+        }
+
+        return fin && (fin.peek() == std::char_traits<char>::eof());
+    }
+
+}
@@ -0,0 +1,691 @@
+/*!
+ * \file    columnar_trace.h
+ * \brief   Columnar trace container (.bt9c): layout, column coders and edge resolution.
+ *
+ * A BT10 edge id folds the source branch, its direction, its target and the next branch
+ * into one number. A .bt9c file splits the edge sequence into separately zstd-compressed
+ * columns instead:
+ *
+ *  - node ids:   the source node of every branch, as fixed-width little-endian integers
+ *                of 1 to 4 bytes depending on the node table size
+ *  - directions: one bit per branch whose source node has edges in both directions
+ *  - targets:    the 64-bit target of a branch, only where the source node, direction and
+ *                next branch leave more than one candidate edge (indirect branches)
+ *
+ * The destination of a branch is the source of the next one, so edge ids are recovered
+ * by looking up (source, direction, next source[, target]) in a ColumnarEdgeIndex built
+ * from the edge table. Header text and the node and edge tables are stored in the
+ * .bt10c record layout (see trace_cache.h), each compressed on its own.
+ */
+
+#pragma once
+
+#include "bt9_reader_defines.h"
+
+#include "decompress.h"
+#include "trace_cache.h"
+#include "trace_error.h"
+
+#include <zstd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+namespace bt9 {
+
+    /// Bump whenever the layout of any structure below or the column encoding changes
+    static constexpr uint32_t COLUMNAR_TRACE_VERSION = 1;
+
+    /// File signature, first 8 bytes of every .bt9c file
+    static constexpr char COLUMNAR_TRACE_MAGIC[8] = {'B', 'T', '9', 'C', 'O', 'L', 'M', 'N'};
+
+    /*!
+     * \struct ColumnarSection
+     * \brief One zstd-compressed section of a .bt9c file
+     */
+    struct ColumnarSection {
+        uint64_t offset;        //!< Bytes from the file start
+        uint64_t size;          //!< Compressed size
+        uint64_t raw_size;      //!< Decompressed size
+    };
+
+    /*!
+     * \struct ColumnarTraceHeader
+     * \brief Fixed header at offset 0 of a .bt9c file
+     */
+    struct ColumnarTraceHeader {
+        char magic[8];
+        uint32_t version;
+        uint32_t node_record_size;      //!< sizeof(TraceCacheNode), guards against layout changes
+        uint32_t edge_record_size;      //!< sizeof(TraceCacheEdge)
+        uint32_t node_id_bytes;         //!< Width of a node id column entry
+        uint64_t num_nodes;
+        uint64_t num_edges;
+        uint64_t num_branches;
+        uint32_t last_dest_node_id;     //!< Destination of the last branch, which has no successor
+        uint32_t reserved;
+        ColumnarSection header_text;    //!< Raw BT9 header lines
+        ColumnarSection nodes;          //!< num_nodes TraceCacheNode records
+        ColumnarSection edges;          //!< num_edges TraceCacheEdge records
+        ColumnarSection node_ids;
+        ColumnarSection directions;     //!< 64-bit little-endian words, filled from the least significant bit
+        ColumnarSection targets;
+    };
+
+    static_assert(std::is_trivially_copyable_v<ColumnarTraceHeader>);
+
+    /// Check the file signature
+    inline bool isColumnarTrace(const std::string & name)
+    {
+        FILE * fin = fopen(name.c_str(), "rb");
+        if (fin == nullptr) {
+            return false;
+        }
+
+        char magic[sizeof(COLUMNAR_TRACE_MAGIC)];
+        const bool ok = (fread(magic, 1, sizeof(magic), fin) == sizeof(magic)) &&
+                        (memcmp(magic, COLUMNAR_TRACE_MAGIC, sizeof(magic)) == 0);
+        fclose(fin);
+
+        return ok;
+    }
+
+    /// Width of a node id column entry for a node table of the given size
+    inline uint32_t columnarNodeIdBytes(uint64_t num_nodes)
+    {
+        if (num_nodes <= (1ull << 8)) {
+            return 1;
+        }
+        if (num_nodes <= (1ull << 16)) {
+            return 2;
+        }
+        if (num_nodes <= (1ull << 24)) {
+            return 3;
+        }
+
+        return 4;
+    }
+
+    /*!
+     * \class ColumnarEdgeIndex
+     * \brief Maps (source, direction, destination[, target]) back to edge ids
+     *
+     * Edges are grouped by source node and direction, and sorted by destination and target
+     * within a group. Writer and reader build it from the same edge table, so both agree on
+     * which branches carry a direction bit and which carry a target.
+     */
+    class ColumnarEdgeIndex
+    {
+    public:
+        /// uniqueEdge() result for a source and direction with several edges
+        static constexpr uint32_t NO_UNIQUE_EDGE = UINT32_MAX;
+
+        /// direction() flag of a node whose branches carry a direction bit
+        static constexpr uint8_t DYNAMIC_DIRECTION = 2;
+
+        /// Sorted edge entry
+        struct Entry {
+            uint64_t target;
+            uint32_t dest;
+            uint32_t edge_id;
+        };
+
+        /*!
+         * \brief Build the index
+         * \return Returns false if two edges cannot be told apart by the columns
+         */
+        bool build(uint64_t num_nodes, const std::vector<TraceCacheEdge> & edges)
+        {
+            // Counting sort by (source, direction)
+            groups_.assign(2 * num_nodes, {0, 0});
+            for (const auto & edge : edges) {
+                groups_[groupIndex_(edge.src_node_id, edge.is_taken_path)].count++;
+            }
+            uint32_t begin = 0;
+            for (auto & group : groups_) {
+                group.begin = begin;
+                begin += group.count;
+            }
+
+            entries_.resize(edges.size());
+            std::vector<uint32_t> fill(groups_.size());
+            for (const auto & edge : edges) {
+                const uint64_t g = groupIndex_(edge.src_node_id, edge.is_taken_path);
+                entries_[groups_[g].begin + fill[g]++] = { edge.br_virtual_tgt, edge.dest_node_id, edge.id };
+            }
+
+            for (const auto & group : groups_) {
+                Entry * first = entries_.data() + group.begin;
+                Entry * last = first + group.count;
+                std::sort(first, last, [](const Entry & a, const Entry & b) {
+                    return std::tie(a.dest, a.target) < std::tie(b.dest, b.target);
+                });
+
+                for (Entry * e = first; (e != last) && (e + 1 != last); e++) {
+                    if ((e->dest == (e + 1)->dest) && (e->target == (e + 1)->target)) {
+                        return false;
+                    }
+                }
+            }
+
+            direction_.resize(num_nodes);
+            unique_edge_.resize(groups_.size());
+            for (uint64_t node = 0; node < num_nodes; node++) {
+                const Group & not_taken = groups_[groupIndex_(node, false)];
+                const Group & taken = groups_[groupIndex_(node, true)];
+                direction_[node] = ((not_taken.count != 0) && (taken.count != 0)) ? DYNAMIC_DIRECTION : (taken.count != 0);
+            }
+            for (uint64_t g = 0; g < groups_.size(); g++) {
+                unique_edge_[g] = (groups_[g].count == 1) ? entries_[groups_[g].begin].edge_id : NO_UNIQUE_EDGE;
+            }
+
+            return true;
+        }
+
+        /// DYNAMIC_DIRECTION if branches of a node carry a direction bit, otherwise their direction
+        uint8_t direction(uint32_t node) const { return direction_[node]; }
+
+        /// Whether branches of a node carry a direction bit
+        bool needsDirection(uint32_t node) const { return direction_[node] == DYNAMIC_DIRECTION; }
+
+        /*!
+         * \brief The only edge of a source node in a direction
+         * \note Such an edge is implied by source and direction alone, the destination is not checked
+         * \return Returns NO_UNIQUE_EDGE if there are several, see candidates()
+         */
+        uint32_t uniqueEdge(uint32_t src, bool taken) const { return unique_edge_[groupIndex_(src, taken)]; }
+
+        /*!
+         * \brief Candidate edges for a branch
+         * \return Pointers to the first and past the last candidate; more than one candidate
+         *         means the branch carries a target
+         */
+        std::pair<const Entry *, const Entry *> candidates(uint32_t src, bool taken, uint32_t dest) const
+        {
+            const Group group = groups_[groupIndex_(src, taken)];
+            const Entry * first = entries_.data() + group.begin;
+            const Entry * last = first + group.count;
+
+            // Groups are tiny except for returns and indirect branches
+            if (group.count > 8) {
+                first = std::lower_bound(first, last, dest, [](const Entry & e, uint32_t d) { return e.dest < d; });
+            }
+            while ((first != last) && (first->dest < dest)) {
+                first++;
+            }
+
+            const Entry * end = first;
+            while ((end != last) && (end->dest == dest)) {
+                end++;
+            }
+
+            return { first, end };
+        }
+
+    private:
+        /// Entries of one source node and direction
+        struct Group {
+            uint32_t begin;
+            uint32_t count;
+        };
+
+        static uint64_t groupIndex_(uint32_t node, bool taken) { return 2 * static_cast<uint64_t>(node) + taken; }
+
+        std::vector<Group> groups_;
+        std::vector<Entry> entries_;
+
+        /// Lookup tables of the decoder's fast path, per node and per group
+        std::vector<uint8_t> direction_;
+        std::vector<uint32_t> unique_edge_;
+    };
+
+    /*!
+     * \class ColumnWriter
+     * \brief Streams one column through a zstd compressor into memory
+     */
+    class ColumnWriter
+    {
+    public:
+        explicit ColumnWriter(int level) :
+            pending_(COLUMNAR_CHUNK_SIZE)
+        {
+            cctx_ = ZSTD_createCCtx();
+            if ((cctx_ == nullptr) || ZSTD_isError(ZSTD_CCtx_setParameter(cctx_, ZSTD_c_compressionLevel, level)) ||
+                ZSTD_isError(ZSTD_CCtx_setParameter(cctx_, ZSTD_c_checksumFlag, 1))) {
+                std::cerr << "Failed to set up zstd compression\n";
+                exit(-1);
+            }
+        }
+
+        ColumnWriter(const ColumnWriter &) = delete;
+        ColumnWriter & operator=(const ColumnWriter &) = delete;
+
+        ~ColumnWriter() { ZSTD_freeCCtx(cctx_); }
+
+        void write(const void * data, size_t size)
+        {
+            const char * ptr = static_cast<const char *>(data);
+            while (size > 0) {
+                const size_t n = std::min(size, pending_.size() - pending_used_);
+                memcpy(pending_.data() + pending_used_, ptr, n);
+                pending_used_ += n;
+                raw_size_ += n;
+                ptr += n;
+                size -= n;
+
+                if (pending_used_ == pending_.size()) {
+                    flush_(ZSTD_e_continue);
+                }
+            }
+        }
+
+        /// End the zstd frame, after which compressed() is complete
+        void finish() { flush_(ZSTD_e_end); }
+
+        const std::vector<char> & compressed() const { return compressed_; }
+        uint64_t rawSize() const { return raw_size_; }
+
+    private:
+        void flush_(ZSTD_EndDirective mode)
+        {
+            ZSTD_inBuffer input = { pending_.data(), pending_used_, 0 };
+            while (true) {
+                const size_t offset = compressed_.size();
+                compressed_.resize(offset + ZSTD_CStreamOutSize());
+
+                ZSTD_outBuffer output = { compressed_.data() + offset, ZSTD_CStreamOutSize(), 0 };
+                const size_t remaining = ZSTD_compressStream2(cctx_, &output, &input, mode);
+                if (ZSTD_isError(remaining)) {
+                    std::cerr << "zstd error: " << ZSTD_getErrorName(remaining) << '\n';
+                    exit(-1);
+                }
+                compressed_.resize(offset + output.pos);
+
+                if ((mode == ZSTD_e_continue) ? (input.pos == input.size) : (remaining == 0)) {
+                    break;
+                }
+            }
+            pending_used_ = 0;
+        }
+
+        ZSTD_CCtx * cctx_ = nullptr;
+        std::vector<char> pending_;
+        size_t pending_used_ = 0;
+        std::vector<char> compressed_;
+        uint64_t raw_size_ = 0;
+    };
+
+    /*!
+     * \class BitColumnWriter
+     * \brief Packs bits into 64-bit little-endian words of a column
+     */
+    class BitColumnWriter
+    {
+    public:
+        explicit BitColumnWriter(int level) : column_(level) {}
+
+        void write(bool bit)
+        {
+            word_ |= static_cast<uint64_t>(bit) << num_bits_;
+            if (++num_bits_ == 64) {
+                column_.write(&word_, sizeof(word_));
+                word_ = 0;
+                num_bits_ = 0;
+            }
+        }
+
+        void finish()
+        {
+            if (num_bits_ != 0) {
+                column_.write(&word_, sizeof(word_));
+            }
+            column_.finish();
+        }
+
+        const ColumnWriter & column() const { return column_; }
+
+    private:
+        ColumnWriter column_;
+        uint64_t word_ = 0;
+        unsigned num_bits_ = 0;
+    };
+
+    /*!
+     * \class ColumnReader
+     * \brief Streams one column out of a mapped .bt9c file through a zstd decompressor
+     */
+    class ColumnReader
+    {
+    public:
+        ColumnReader() :
+            buf_(COLUMNAR_CHUNK_SIZE)
+        {
+            dctx_ = ZSTD_createDCtx();
+            if (dctx_ == nullptr) {
+                throw TraceError("Failed to create zstd decompression context");
+            }
+        }
+
+        ColumnReader(const ColumnReader &) = delete;
+        ColumnReader & operator=(const ColumnReader &) = delete;
+
+        ~ColumnReader() { ZSTD_freeDCtx(dctx_); }
+
+        /// Attach to a compressed column, stats collects the bytes and time spent decompressing
+        void open(const uint8_t * data, uint64_t size, TraceStreamStats * stats)
+        {
+            data_ = data;
+            size_ = size;
+            stats_ = stats;
+            rewind();
+        }
+
+        /// Restart from the first byte of the column
+        void rewind()
+        {
+            ZSTD_DCtx_reset(dctx_, ZSTD_reset_session_only);
+            in_pos_ = 0;
+            buf_pos_ = 0;
+            buf_size_ = 0;
+        }
+
+        /*!
+         * \brief Copy the next bytes of the column
+         * \return Number of bytes copied, less than size only at the end of the column
+         */
+        size_t read(void * dst, size_t size)
+        {
+            char * out = static_cast<char *>(dst);
+            size_t copied = 0;
+
+            while (copied < size) {
+                if ((buf_pos_ == buf_size_) && !refill_()) {
+                    break;
+                }
+
+                const size_t n = std::min(size - copied, buf_size_ - buf_pos_);
+                memcpy(out + copied, buf_.data() + buf_pos_, n);
+                buf_pos_ += n;
+                copied += n;
+            }
+
+            return copied;
+        }
+
+    private:
+        bool refill_()
+        {
+            const auto start = std::chrono::steady_clock::now();
+
+            ZSTD_inBuffer input = { data_, size_, in_pos_ };
+            ZSTD_outBuffer output = { buf_.data(), buf_.size(), 0 };
+            while ((output.pos == 0) && (input.pos < input.size)) {
+                const size_t ret = ZSTD_decompressStream(dctx_, &output, &input);
+                if (ZSTD_isError(ret)) {
+                    throw TraceError(std::string("Columnar trace zstd error: ") + ZSTD_getErrorName(ret));
+                }
+            }
+
+            stats_->file_bytes += input.pos - in_pos_;
+            stats_->stream_bytes += output.pos;
+            stats_->decode_seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+            in_pos_ = input.pos;
+            buf_pos_ = 0;
+            buf_size_ = output.pos;
+
+            return (buf_size_ != 0);
+        }
+
+        ZSTD_DCtx * dctx_ = nullptr;
+        const uint8_t * data_ = nullptr;
+        uint64_t size_ = 0;
+        uint64_t in_pos_ = 0;
+        std::vector<char> buf_;
+        size_t buf_pos_ = 0;
+        size_t buf_size_ = 0;
+        TraceStreamStats * stats_ = nullptr;
+    };
+
+    /*!
+     * \class ColumnarTraceDecoder
+     * \brief Rebuilds the edge sequence list of a .bt9c file from its columns
+     */
+    class ColumnarTraceDecoder
+    {
+    public:
+        ColumnarTraceDecoder() = default;
+        ColumnarTraceDecoder(const ColumnarTraceDecoder &) = delete;
+        ColumnarTraceDecoder & operator=(const ColumnarTraceDecoder &) = delete;
+
+        /*!
+         * \brief Map a .bt9c file and decompress its header text, node and edge tables
+         * \return Returns false if the file is not a valid columnar trace for this build
+         */
+        bool open(const std::string & name)
+        {
+            if (!file_.map(name) || (file_.size() < sizeof(h_))) {
+                return false;
+            }
+            memcpy(&h_, file_.data(), sizeof(h_));
+
+            const uint64_t file_size = file_.size();
+            auto fits = [file_size](const ColumnarSection & s) {
+                return (s.offset <= file_size) && (s.size <= file_size - s.offset);
+            };
+
+            if ((memcmp(h_.magic, COLUMNAR_TRACE_MAGIC, sizeof(h_.magic)) != 0) ||
+                (h_.version != COLUMNAR_TRACE_VERSION) ||
+                (h_.node_record_size != sizeof(TraceCacheNode)) ||
+                (h_.edge_record_size != sizeof(TraceCacheEdge)) ||
+                (h_.node_id_bytes != columnarNodeIdBytes(h_.num_nodes)) ||
+                (h_.nodes.raw_size / sizeof(TraceCacheNode) != h_.num_nodes) ||
+                (h_.nodes.raw_size % sizeof(TraceCacheNode) != 0) ||
+                (h_.edges.raw_size / sizeof(TraceCacheEdge) != h_.num_edges) ||
+                (h_.edges.raw_size % sizeof(TraceCacheEdge) != 0) ||
+                (h_.node_ids.raw_size / h_.node_id_bytes != h_.num_branches) ||
+                (h_.node_ids.raw_size % h_.node_id_bytes != 0) ||
+                (h_.last_dest_node_id >= h_.num_nodes) ||
+                !fits(h_.header_text) || !fits(h_.nodes) || !fits(h_.edges) ||
+                !fits(h_.node_ids) || !fits(h_.directions) || !fits(h_.targets)) {
+                return false;
+            }
+
+            header_text_.resize(h_.header_text.raw_size);
+            nodes_.resize(h_.num_nodes);
+            edges_.resize(h_.num_edges);
+            if (!decompressSection_(h_.header_text, header_text_.data()) ||
+                !decompressSection_(h_.nodes, nodes_.data()) ||
+                !decompressSection_(h_.edges, edges_.data())) {
+                return false;
+            }
+
+            for (const auto & edge : edges_) {
+                if ((edge.src_node_id >= h_.num_nodes) || (edge.dest_node_id >= h_.num_nodes)) {
+                    return false;
+                }
+            }
+
+            if (!index_.build(h_.num_nodes, edges_)) {
+                return false;
+            }
+
+            node_id_column_.open(file_.data() + h_.node_ids.offset, h_.node_ids.size, &stats_);
+            direction_column_.open(file_.data() + h_.directions.offset, h_.directions.size, &stats_);
+            target_column_.open(file_.data() + h_.targets.offset, h_.targets.size, &stats_);
+            node_id_bytes_.resize(COLUMNAR_CHUNK_SIZE);
+            node_ids_.resize(COLUMNAR_CHUNK_SIZE / h_.node_id_bytes);
+            rewind();
+
+            return true;
+        }
+
+        /// Raw BT9 header lines
+        const std::string & headerText() const { return header_text_; }
+
+        /// Node and edge tables in the .bt10c record layout
+        const std::vector<TraceCacheNode> & nodes() const { return nodes_; }
+        const std::vector<TraceCacheEdge> & edges() const { return edges_; }
+
+        /// Bytes and time spent decompressing the columns so far
+        const TraceStreamStats & stats() const { return stats_; }
+
+        /// Restart from the first branch
+        void rewind()
+        {
+            node_id_column_.rewind();
+            direction_column_.rewind();
+            target_column_.rewind();
+            node_ids_pos_ = 0;
+            node_ids_size_ = 0;
+            direction_bits_left_ = 0;
+            remaining_ = h_.num_branches;
+            next_src_ = 0;
+            if (remaining_ != 0) {
+                next_src_ = nextNodeId_();
+            }
+        }
+
+        /*!
+         * \brief Decode edge ids
+         * \param out Destination array of edge ids
+         * \param capacity Number of entries available in out
+         * \param eof Set once the last branch has been decoded
+         * \return Number of edge ids written
+         */
+        uint64_t decode(uint32_t * out, uint64_t capacity, bool & eof)
+        {
+            uint64_t count = 0;
+
+            while ((count < capacity) && (remaining_ != 0)) {
+                const uint32_t src = next_src_;
+                const uint32_t dest = (remaining_ > 1) ? nextNodeId_() : h_.last_dest_node_id;
+
+                // Branchless on the direction: nodes without a direction bit consume none
+                const uint8_t direction = index_.direction(src);
+                const unsigned needs_bit = direction >> 1;
+                if (direction_bits_left_ < needs_bit) {
+                    refillDirections_();
+                }
+                const bool taken = (direction & 1) | (direction_word_ & needs_bit);
+                direction_word_ >>= needs_bit;
+                direction_bits_left_ -= needs_bit;
+
+                uint32_t edge_id = index_.uniqueEdge(src, taken);
+                if (edge_id == ColumnarEdgeIndex::NO_UNIQUE_EDGE) {
+                    edge_id = resolveEdge_(src, taken, dest);
+                }
+
+                out[count++] = edge_id;
+                next_src_ = dest;
+                remaining_--;
+            }
+
+            eof = (remaining_ == 0);
+            return count;
+        }
+
+    private:
+        bool decompressSection_(const ColumnarSection & s, void * dst)
+        {
+            const size_t ret = ZSTD_decompress(dst, s.raw_size, file_.data() + s.offset, s.size);
+            return !ZSTD_isError(ret) && (ret == s.raw_size);
+        }
+
+        /// Next entry of the node id column, widened a chunk at a time
+        uint32_t nextNodeId_()
+        {
+            if (node_ids_pos_ == node_ids_size_) {
+                const uint32_t width = h_.node_id_bytes;
+                const size_t bytes = node_id_column_.read(node_id_bytes_.data(), node_ids_.size() * width);
+                node_ids_size_ = bytes / width;
+                node_ids_pos_ = 0;
+                if (node_ids_size_ == 0) {
+                    corrupt_();
+                }
+
+                const uint8_t * in = node_id_bytes_.data();
+                for (size_t i = 0; i < node_ids_size_; i++, in += width) {
+                    uint32_t id = 0;
+                    memcpy(&id, in, width);
+                    node_ids_[i] = id;
+                }
+            }
+
+            const uint32_t id = node_ids_[node_ids_pos_++];
+            if (id >= h_.num_nodes) {
+                corrupt_();
+            }
+            return id;
+        }
+
+        /// Load the next word of the direction column
+        void refillDirections_()
+        {
+            if (direction_column_.read(&direction_word_, sizeof(direction_word_)) != sizeof(direction_word_)) {
+                corrupt_();
+            }
+            direction_bits_left_ = 64;
+        }
+
+        /// Slow path of decode(): pick among several edges by destination, then by target
+        uint32_t resolveEdge_(uint32_t src, bool taken, uint32_t dest)
+        {
+            auto [first, last] = index_.candidates(src, taken, dest);
+            if (last - first > 1) {
+                uint64_t target = 0;
+                if (target_column_.read(&target, sizeof(target)) != sizeof(target)) {
+                    corrupt_();
+                }
+                while ((first != last) && (first->target != target)) {
+                    first++;
+                }
+            }
+            if (first == last) {
+                corrupt_();
+            }
+
+            return first->edge_id;
+        }
+
+        [[noreturn]] void corrupt_() const
+        {
+            throw TraceError("Corrupt columnar trace: " + std::to_string(h_.num_branches - remaining_) + " branches decoded");
+        }
+
+        MappedFile file_;
+        ColumnarTraceHeader h_ = {};
+
+        std::string header_text_;
+        std::vector<TraceCacheNode> nodes_;
+        std::vector<TraceCacheEdge> edges_;
+        ColumnarEdgeIndex index_;
+
+        ColumnReader node_id_column_;
+        ColumnReader direction_column_;
+        ColumnReader target_column_;
+        TraceStreamStats stats_;
+
+        /// Widened node ids of the current chunk
+        std::vector<uint8_t> node_id_bytes_;
+        std::vector<uint32_t> node_ids_;
+        size_t node_ids_pos_ = 0;
+        size_t node_ids_size_ = 0;
+
+        uint64_t direction_word_ = 0;
+        unsigned direction_bits_left_ = 0;
+
+        /// Branches left to decode and the source node of the next one
+        uint64_t remaining_ = 0;
+        uint32_t next_src_ = 0;
+    };
+
+}
@@ -1,88 +1,266 @@
+/*!
+ * \file    decompress.h
+ * \brief   In-process trace file input stream with streaming zstd decompression.
+ */
 
-struct ReturnObject {
-    struct promise_type {
-        unsigned return_value_;
+#pragma once
 
-        ReturnObject get_return_object() {
-            return {.h_ = std::coroutine_handle<promise_type>::from_promise(*this)};
+#include "bt9_reader_defines.h"
+#include "readahead_file.h"
+#include "trace_error.h"
+
+#include <zstd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <streambuf>
+#include <string>
+#include <vector>
+
+namespace bt9 {
+
+    /*!
+     * \struct TraceStreamStats
+     * \brief Byte and time counters collected by TraceStreamBuf
+     */
+    struct TraceStreamStats {
+        /// Bytes read from the trace file
+        uint64_t file_bytes = 0;
+
+        /// Bytes handed to the reader (equal to file_bytes for uncompressed traces)
+        uint64_t stream_bytes = 0;
+
+        /// Time spent reading the file and decompressing it, in seconds
+        double decode_seconds = 0.0;
+
+        /// Part of decode_seconds spent waiting for file reads
+        double io_wait_seconds = 0.0;
+
+        /// Time the reads of the file took, mostly overlapped with decoding by the read-ahead thread
+        double io_read_seconds = 0.0;
+    };
+
+    /*!
+     * \struct TraceStreamAnchor
+     * \brief A point decoding can restart from: the start of a zstd frame, or any byte of an uncompressed trace
+     */
+    struct TraceStreamAnchor {
+        /// Offset in the trace file
+        uint64_t file_offset = 0;
+
+        /// Offset in the decompressed stream
+        uint64_t stream_offset = 0;
+    };
+
+    /*!
+     * \class TraceStreamBuf
+     * \brief std::streambuf reading a trace file, decompressed in-process when it ends with ".zst"
+     *
+     * Replaces the former popen("zstd -dc") pipe. The file is read through a ReadAheadFile,
+     * whose chunks are decompressed in place. Errors are thrown as TraceError; an istream
+     * reading through this buffer must have badbit in its exception mask to pass them on.
+     * The zstd context and the output buffer are allocated once and reused for every refill.
+     *
+     * zstd frame boundaries met while decompressing are remembered as anchors, so traces
+     * compressed as many independent frames (e.g. the zstd seekable format) can be
+     * repositioned without decompressing from the start.
+     */
+    class TraceStreamBuf : public std::streambuf
+    {
+    public:
+        /*!
+         * \brief Constructor
+         * \param name Trace file name, decompressed with zstd if it contains ".zst"
+         * \param io How the file is read
+         */
+        TraceStreamBuf(const std::string & name, const TraceIoOptions & io = TraceIoOptions()) :
+            name_(name),
+            file_(name, io),
+            out_buf_(TRACE_STREAM_OUT_BUFFER_SIZE)
+        {
+            if (name.find(".zst") != std::string::npos) {
+                dctx_ = ZSTD_createDCtx();
+                if (dctx_ == nullptr) {
+                    throw TraceError("ZSTD_createDCtx() failed for \'" + name + "\'");
+                }
+                frames_.push_back(TraceStreamAnchor());
+            }
+
+            setg(out_buf_.data(), out_buf_.data(), out_buf_.data());
         }
 
-        std::suspend_never initial_suspend() { return {}; }
-        std::suspend_never final_suspend() noexcept { return {}; }
-        void unhandled_exception() {}
+        TraceStreamBuf() = delete;
+        TraceStreamBuf(const TraceStreamBuf &) = delete;
+        TraceStreamBuf & operator=(const TraceStreamBuf &) = delete;
 
-        std::suspend_always yield_value(unsigned value) {
-            return_value_ = value;
-            return {};
+        ~TraceStreamBuf()
+        {
+            if (dctx_ != nullptr) {
+                ZSTD_freeDCtx(dctx_);
+            }
         }
-        unsigned int return_value(unsigned value) {
-            return_value_ = value;
-            return {};
+
+        /// Byte and time counters accumulated so far
+        const TraceStreamStats & stats() const
+        {
+            stats_.io_wait_seconds = file_.ioWaitSeconds();
+            stats_.io_read_seconds = file_.readSeconds();
+            return stats_;
         }
-    };
-    std::coroutine_handle<promise_type> h_;
-};
 
-ReturnObject zstd_decompress(const char* path_to_trace_file, size_t buffInSize, void* buffIn, size_t buffOutSize, void* buffOut) {
+        /// Offset of the next byte handed out, in the decompressed stream
+        uint64_t tell() const { return stream_pos_ - (egptr() - gptr()); }
 
-    FILE* const fin  = fopen_orDie(path_to_trace_file, "rb");
+        /// Closest point at or before a decompressed stream offset that decoding can restart from
+        TraceStreamAnchor anchorFor(uint64_t stream_offset) const
+        {
+            if (dctx_ == nullptr) {
+                return { stream_offset, stream_offset };
+            }
 
-    ZSTD_DCtx* const dctx = ZSTD_createDCtx();
-    CHECK(dctx != NULL, "ZSTD_createDCtx() failed!");
+            // Frames are recorded in stream order and the first one starts at offset 0
+            auto it = std::upper_bound(frames_.begin(), frames_.end(), stream_offset,
+                                       [](uint64_t offset, const TraceStreamAnchor & frame) { return offset < frame.stream_offset; });
+            return *(it - 1);
+        }
 
-    /* This loop assumes that the input file is one or more concatenated zstd
-     * streams. This example won't work if there is trailing non-zstd data at
-     * the end, but streaming decompression in general handles this case.
-     * ZSTD_decompressStream() returns 0 exactly when the frame is completed,
-     * and doesn't consume input after the frame.
-     */
-    size_t const toRead = buffInSize;
-    size_t read;
-    size_t lastRet = 0;
+        /*!
+         * \brief Reposition the stream
+         * \param anchor Restart point at or before stream_offset, from anchorFor()
+         * \param stream_offset Decompressed offset of the next byte to hand out
+         * \return Returns false if the stream ends before stream_offset
+         */
+        bool seekTo(const TraceStreamAnchor & anchor, uint64_t stream_offset)
+        {
+            file_.seek(anchor.file_offset);
 
-    int isEmpty = 1;
+            file_pos_ = anchor.file_offset;
+            stream_pos_ = anchor.stream_offset;
+            in_ = {};
+            in_pos_ = 0;
+            last_ret_ = 0;
+            if (dctx_ != nullptr) {
+                ZSTD_DCtx_reset(dctx_, ZSTD_reset_session_only);
+            }
+            setg(out_buf_.data(), out_buf_.data(), out_buf_.data());
 
-    while ( (read = fread_orDie(buffIn, toRead, fin)) ) {
+            // Decompress and drop whatever lies between the anchor and the target
+            while (stream_pos_ < stream_offset) {
+                setg(egptr(), egptr(), egptr());
+                if (underflow() == traits_type::eof()) {
+                    return false;
+                }
+            }
+            setg(out_buf_.data(), egptr() - (stream_pos_ - stream_offset), egptr());
 
-        isEmpty = 0;
-        ZSTD_inBuffer input = { buffIn, read, 0 };
-        /* Given a valid frame, zstd won't consume the last byte of the frame
-         * until it has flushed all of the decompressed data of the frame.
-         * Therefore, instead of checking if the return code is 0, we can
-         * decompress just check if input.pos < input.size.
-         */
-        while (input.pos < input.size) {
-            ZSTD_outBuffer output = { buffOut, buffOutSize, 0 };
-            /* The return code is zero if the frame is complete, but there may
-             * be multiple frames concatenated together. Zstd will automatically
-             * reset the context when a frame is complete. Still, calling
-             * ZSTD_DCtx_reset() can be useful to reset the context to a clean
-             * state, for instance if the last decompression call returned an
-             * error.
-             */
-            size_t const ret = ZSTD_decompressStream(dctx, &output , &input);
-            CHECK_ZSTD(ret);
-            lastRet = ret;
-            co_yield ret;
+            return true;
         }
-    }
 
-    if (isEmpty) {
-        fprintf(stderr, "input is empty\n");
-        exit(1);
-    }
+    protected:
+        int_type underflow() override
+        {
+            if (gptr() < egptr()) {
+                return traits_type::to_int_type(*gptr());
+            }
 
-    if (lastRet != 0) {
-        /* The last return value from ZSTD_decompressStream did not end on a
-         * frame, but we reached the end of the file! We assume this is an
-         * error, and the input was truncated.
-         */
-        fprintf(stderr, "EOF before end of stream: %zu\n", lastRet);
-        exit(1);
-    }
+            const auto start = std::chrono::steady_clock::now();
+            const size_t produced = (dctx_ != nullptr) ? decompress_() : readPlain_();
+            stats_.decode_seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            stats_.stream_bytes += produced;
+            stream_pos_ += produced;
 
-    ZSTD_freeDCtx(dctx);        // TODO: This never gets called
-    fclose_orDie(fin);
+            setg(out_buf_.data(), out_buf_.data(), out_buf_.data() + produced);
+            if (produced == 0) {
+                return traits_type::eof();
+            }
+
+            return traits_type::to_int_type(*gptr());
+        }
+
+    private:
+        /// Take the next chunk of the file once the current one is consumed
+        void refillInput_()
+        {
+            if (in_pos_ == in_.size()) {
+                in_ = file_.next();
+                in_pos_ = 0;
+                stats_.file_bytes += in_.size();
+                file_pos_ += in_.size();
+            }
+        }
+
+        /// Fill the output buffer straight from an uncompressed file
+        size_t readPlain_()
+        {
+            refillInput_();
+
+            const size_t size = std::min(out_buf_.size(), in_.size() - in_pos_);
+            std::copy_n(in_.data() + in_pos_, size, out_buf_.data());
+            in_pos_ += size;
+            return size;
+        }
+
+        /// Fill the output buffer with decompressed data, reading more input as needed
+        size_t decompress_()
+        {
+            ZSTD_outBuffer output = { out_buf_.data(), out_buf_.size(), 0 };
+
+            while (output.pos == 0) {
+                refillInput_();
+                if (in_.empty()) {
+                    if (last_ret_ != 0) {
+                        throw TraceError("\'" + name_ + "\' EOF before end of zstd stream");
+                    }
+                    break;
+                }
+
+                ZSTD_inBuffer input = { in_.data(), in_.size(), in_pos_ };
+                last_ret_ = ZSTD_decompressStream(dctx_, &output, &input);
+                if (ZSTD_isError(last_ret_)) {
+                    throw TraceError("\'" + name_ + "\' zstd error: " + ZSTD_getErrorName(last_ret_));
+                }
+                in_pos_ = input.pos;
+
+                // A finished frame: the next one starts at the current input position
+                if ((last_ret_ == 0) && (stream_pos_ + output.pos > frames_.back().stream_offset)) {
+                    frames_.push_back({ file_pos_ - in_.size() + in_pos_, stream_pos_ + output.pos });
+                }
+            }
+
+            return output.pos;
+        }
+
+        /// Trace file name, for error messages
+        std::string name_;
+
+        /// Trace file, read ahead in chunks
+        ReadAheadFile file_;
+
+        /// zstd decompression context, nullptr for uncompressed traces
+        ZSTD_DCtx * dctx_ = nullptr;
+
+        /// Chunk of the file being consumed and the consume position in it
+        std::span<const char> in_;
+        size_t in_pos_ = 0;
+
+        /// Decompressed output buffer, exposed as the get area
+        std::vector<char> out_buf_;
+
+        /// Last ZSTD_decompressStream() return value, non-zero while a frame is incomplete
+        size_t last_ret_ = 0;
+
+        /// File offset of the end of the current chunk
+        uint64_t file_pos_ = 0;
+
+        /// Decompressed stream offset of the end of the get area
+        uint64_t stream_pos_ = 0;
+
+        /// Start of every zstd frame met so far, in stream order
+        std::vector<TraceStreamAnchor> frames_;
+
+        /// I/O times are filled in from file_ when the stats are read
+        mutable TraceStreamStats stats_;
+    };
 
-    co_return 0;
 }
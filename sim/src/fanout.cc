@@ -0,0 +1,196 @@
+/*!
+ * \file    fanout.cc
+ * \brief   Fan-out driver: simulates every predictor of build/fanout_members.h over one decoded trace.
+ *
+ * usage: fanout [options] <trace>
+ *
+ * Prints { "<label>": { "<trace>": stats_t }, ... } with one entry per predictor, each holding
+ * what the single-predictor simulator would print for it. See fanout.h.
+ */
+
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <span>
+#include <string>
+#include <vector>
+
+#include <getopt.h>
+
+#include "bt9_reader.h"
+#include "fanout.h"
+
+#include <cereal/archives/json.hpp>
+
+// The compile-time list of predictors, each built from fanout_member.cc into its namespace
+#define FANOUT_MEMBER(ns, label) namespace ns { std::unique_ptr<fanout::Member> makeMember(); }
+#include "../build/fanout_members.h"
+#undef FANOUT_MEMBER
+
+namespace {
+
+struct MemberInfo {
+  const char* label;
+  std::unique_ptr<fanout::Member> (*make)();
+};
+
+const MemberInfo members[] = {
+#define FANOUT_MEMBER(ns, label) { label, &ns::makeMember },
+#include "../build/fanout_members.h"
+#undef FANOUT_MEMBER
+};
+
+void PrintUsage(const char* prog)
+{
+  printf("usage: %s [options] <trace>\n", prog);
+  printf("  -p, --pipelined     decompress and decode the trace on a background thread\n");
+  printf("  -t, --throughput    print decode throughput and the time of each predictor to stderr\n");
+  printf("  -c, --cache-dir DIR use (and create) pre-decoded .bt10c trace caches in DIR\n");
+  printf("                      (default: $BT9_TRACE_CACHE_DIR, no caching if unset)\n");
+  printf("  -C, --io-chunk-size N  bytes per trace file read (default: $BT9_IO_CHUNK_SIZE or %d)\n", TRACE_IO_CHUNK_SIZE);
+  printf("  -Q, --io-depth N       trace file reads issued ahead of the decoder, 0 to read synchronously\n");
+  printf("                         (default: $BT9_IO_DEPTH or %d)\n", TRACE_IO_DEPTH);
+  printf("predictors:");
+  for (const MemberInfo& member : members) {
+    printf(" %s", member.label);
+  }
+  printf("\n");
+}
+
+double SecondsSince(std::chrono::steady_clock::time_point start)
+{
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+int Simulate(int argc, char* argv[])
+{
+  bool printThroughput = false;
+  bool pipelined = false;
+  std::string cacheDir = getenv("BT9_TRACE_CACHE_DIR") ? getenv("BT9_TRACE_CACHE_DIR") : "";
+  bt9::TraceIoOptions io;
+  if (getenv("BT9_IO_CHUNK_SIZE")) {
+    io.chunk_size = strtoull(getenv("BT9_IO_CHUNK_SIZE"), nullptr, 0);
+  }
+  if (getenv("BT9_IO_DEPTH")) {
+    io.depth = std::max(atoi(getenv("BT9_IO_DEPTH")), 0);
+  }
+
+  static const struct option longOptions[] = {
+    {"pipelined",  no_argument, nullptr, 'p'},
+    {"throughput", no_argument, nullptr, 't'},
+    {"cache-dir",  required_argument, nullptr, 'c'},
+    {"io-chunk-size", required_argument, nullptr, 'C'},
+    {"io-depth",   required_argument, nullptr, 'Q'},
+    {"help",       no_argument, nullptr, 'h'},
+    {nullptr,      0,           nullptr,  0 }
+  };
+
+  int opt;
+  while ((opt = getopt_long(argc, argv, "ptc:C:Q:h", longOptions, nullptr)) != -1) {
+    switch (opt) {
+      case 'p':
+        pipelined = true;
+        break;
+      case 't':
+        printThroughput = true;
+        break;
+      case 'c':
+        cacheDir = optarg;
+        break;
+      case 'C':
+        io.chunk_size = strtoull(optarg, nullptr, 0);
+        break;
+      case 'Q':
+        io.depth = std::max(atoi(optarg), 0);
+        break;
+      default:
+        PrintUsage(argv[0]);
+        exit(-1);
+    }
+  }
+
+  if (optind != argc - 1) {
+    PrintUsage(argv[0]);
+    exit(-1);
+  }
+
+  const auto startTime = std::chrono::steady_clock::now();
+
+  const std::string trace_path = argv[optind];
+  bt9::BT9Reader bt9_reader(trace_path, pipelined, cacheDir, io);
+  if (bt9_reader.loadStats().unclassified_edges != 0) {
+    fprintf(stderr, "OPTYPE_ERROR\n");
+    printf("OPTYPE_ERROR\n");
+    exit(-1);
+  }
+
+  fanout::TraceTotals totals;
+  std::string value;
+  bt9_reader.header.getFieldValueStr("total_instruction_count:", value);
+  totals.instructions = std::stoull(value, nullptr, 0);
+  bt9_reader.header.getFieldValueStr("branch_instruction_count:", value);
+  totals.branches = std::stoull(value, nullptr, 0);
+
+  const std::string filename = trace_path.substr(trace_path.find_last_of("/\\") + 1);
+  totals.trace = filename.substr(0, filename.find_first_of('.'));
+
+  std::vector<std::unique_ptr<fanout::Member>> predictors;
+  for (const MemberInfo& member : members) {
+    predictors.push_back(member.make());
+  }
+
+  // Each block is decoded once and run through all predictors while it is still in cache. Blocks
+  // end at the next interval sample of any predictor.
+  std::vector<bt9::BT9HotEdge> block(BRANCH_BLOCK_SIZE);
+  std::vector<double> predictorSeconds(predictors.size(), 0.0);
+  uint64_t numBranches = 0;
+  while (true) {
+    uint64_t nextBoundary = UINT64_MAX;
+    for (const std::unique_ptr<fanout::Member>& predictor : predictors) {
+      nextBoundary = std::min(nextBoundary, predictor->nextBoundary());
+    }
+    const uint64_t blockSize = bt9_reader.readBranchBlock(std::span(block).first(std::min<uint64_t>(block.size(), nextBoundary - numBranches)));
+    if (blockSize == 0) {
+      break;
+    }
+    const std::span<const bt9::BT9HotEdge> branches = std::span(block).first(blockSize);
+    for (size_t i = 0; i < predictors.size(); i++) {
+      const auto blockStart = std::chrono::steady_clock::now();
+      predictors[i]->simulateBlock(branches);
+      predictorSeconds[i] += SecondsSince(blockStart);
+    }
+    numBranches += blockSize;
+  }
+
+  if (printThroughput) {
+    const double seconds = SecondsSince(startTime);
+    double simulateSeconds = 0.0;
+    for (size_t i = 0; i < predictors.size(); i++) {
+      fprintf(stderr, "%s: %-24s %.3f s\n", trace_path.c_str(), members[i].label, predictorSeconds[i]);
+      simulateSeconds += predictorSeconds[i];
+    }
+    fprintf(stderr, "%s: %llu branches in %.3f s, %.3f s of it loading and decoding the trace once for %zu predictors\n",
+            trace_path.c_str(), (unsigned long long)numBranches, seconds, seconds - simulateSeconds, predictors.size());
+  }
+
+  cereal::JSONOutputArchive archive(std::cout);
+  for (size_t i = 0; i < predictors.size(); i++) {
+    predictors[i]->writeStats(archive, members[i].label, totals);
+  }
+
+  return 0;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[])
+{
+  // The reader throws on unreadable or malformed traces instead of exiting
+  try {
+    return Simulate(argc, argv);
+  }
+  catch (const bt9::TraceError& ex) {
+    fprintf(stderr, "%s\n", ex.what());
+    exit(-1);
+  }
+}
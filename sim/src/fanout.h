@@ -0,0 +1,57 @@
+/*!
+ * \file    fanout.h
+ * \brief   Interface between the fan-out driver (fanout.cc) and the predictors it simulates side by side.
+ *
+ * The fan-out driver decodes a trace once and hands every block of branches to several
+ * predictors in turn, while the block is still in cache. Predictors are written for a build
+ * of their own: each defines a global class PREDICTOR, a global stats_t stats and macros from
+ * its parameters.h. So every predictor is compiled in its own translation unit
+ * (fanout_member.cc) inside a namespace of its own, fanout_member_<i>, and only a Member
+ * object crosses into the driver.
+ *
+ * The list of predictors is fixed when the driver is built: build/fanout_members.h, written
+ * by scripts/fanout.py, holds one FANOUT_MEMBER(namespace, "label") line per predictor.
+ */
+
+#pragma once
+
+#include "bt9_reader.h"
+
+#include <memory>
+#include <span>
+#include <string>
+
+#include <cereal/archives/json.hpp>
+
+namespace fanout {
+
+    /*!
+     * \struct TraceTotals
+     * \brief Trace-wide counts from the header, the same for every predictor
+     */
+    struct TraceTotals {
+        std::string trace;              //!< Trace file name without extension, key of the stats
+        uint64_t instructions = 0;      //!< total_instruction_count of the header
+        uint64_t branches = 0;          //!< branch_instruction_count of the header
+    };
+
+    /*!
+     * \class Member
+     * \brief One predictor of the fan-out, simulating blocks of branches like main.cc does
+     */
+    class Member
+    {
+    public:
+        virtual ~Member() = default;
+
+        /// Simulate the next block of branches of the trace
+        virtual void simulateBlock(std::span<const bt9::BT9HotEdge> block) = 0;
+
+        /// Branches of the trace simulated at the next interval sample, no block may run past it
+        virtual uint64_t nextBoundary() const = 0;
+
+        /// Write the stats of the predictor as "<label>": { "<trace>": stats_t }
+        virtual void writeStats(cereal::JSONOutputArchive & archive, const char * label, const TraceTotals & totals) = 0;
+    };
+
+}
@@ -0,0 +1,118 @@
+/*!
+ * \file    fanout_member.cc
+ * \brief   One predictor of the fan-out driver, wrapped in the namespace FANOUT_NAMESPACE.
+ *
+ * Compiled once per predictor by the fanout_member task, with the parameters.h and statistics.h
+ * of that predictor in build/ and FANOUT_NAMESPACE, PREDICTOR_H_PATH and PREDICTOR_CC_PATH
+ * defined on the command line. See fanout.h.
+ */
+
+// Everything the predictors include from outside their folder, so that their own includes of
+// it are no-ops inside the namespace
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <limits>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <assert.h>
+#include <inttypes.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <boost/hana.hpp>
+
+#include <cereal/archives/json.hpp>
+#include <cereal/types/array.hpp>
+#include <cereal/types/unordered_map.hpp>
+#include <cereal/types/vector.hpp>
+
+#include "utils.h"
+
+#include "fanout.h"
+#include "interval_stats.h"
+
+namespace FANOUT_NAMESPACE {
+
+#include PREDICTOR_H_PATH
+#if __has_include(PREDICTOR_CC_PATH)
+#include PREDICTOR_CC_PATH
+#endif
+
+// stats of this predictor, keyed by the trace name
+struct TraceStats {
+  const std::string& trace;
+  stats_t& stats;
+
+  template<class Archive>
+  void serialize(Archive& ar)
+  {
+    ar(cereal::make_nvp(trace.c_str(), stats));
+  }
+};
+
+// The simulation loop of main.cc over this namespace's PREDICTOR and stats
+class PredictorMember : public fanout::Member
+{
+ public:
+  void simulateBlock(std::span<const bt9::BT9HotEdge> block) override
+  {
+    for (const bt9::BT9HotEdge& br : block) {
+      const OpType opType = br.opType();
+      if (br.conditional) {
+        const bool predDir = brpred_.GetPrediction(br.pc);
+        brpred_.UpdatePredictor(br.pc, opType, br.taken, predDir, br.target);
+        numMispred_ += (predDir != br.taken);
+        condBranches_++;
+      }
+      else if (opType != OPTYPE_ERROR) { // OPTYPE_ERROR is only left on the fake branch of node 0
+        uncondBranches_++;
+        brpred_.TrackOtherInst(br.pc, opType, br.taken, br.target);
+      }
+    }
+
+    numIter_ += block.size();
+    if (numIter_ == intervals_.nextBoundary()) {
+      intervals_.sample(stats, {numIter_, 0, condBranches_, numMispred_});
+    }
+  }
+
+  uint64_t nextBoundary() const override
+  {
+    return intervals_.nextBoundary();
+  }
+
+  void writeStats(cereal::JSONOutputArchive& archive, const char* label, const fanout::TraceTotals& totals) override
+  {
+    stats.NUM_INSTRUCTIONS = totals.instructions;
+    stats.NUM_BR = totals.branches - 1; //JD2_2_2016 NOTE there is a dummy branch at the beginning of the trace...
+    stats.NUM_UNCOND_BR = uncondBranches_;
+    stats.NUM_CONDITIONAL_BR = condBranches_;
+    stats.NUM_MISPREDICTIONS = numMispred_;
+    stats.MISPRED_PER_1K_INST = 1000.0*(double)(numMispred_)/(double)(totals.instructions);
+    stats.TRACE = totals.trace;
+
+    archive(cereal::make_nvp(label, TraceStats{totals.trace, stats}));
+  }
+
+ private:
+  PREDICTOR brpred_;
+  bt9::IntervalStats intervals_;  // MPKBr_* milestones only
+  uint64_t numIter_ = 0;
+  uint64_t numMispred_ = 0;
+  uint64_t condBranches_ = 0;
+  uint64_t uncondBranches_ = 0;
+};
+
+std::unique_ptr<fanout::Member> makeMember()
+{
+  return std::make_unique<PredictorMember>();
+}
+
+}  // namespace FANOUT_NAMESPACE
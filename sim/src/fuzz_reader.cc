@@ -0,0 +1,166 @@
+/*!
+ * \file    fuzz_reader.cc
+ * \brief   libFuzzer harness for the BT9 header, node table, edge table and BT10 stream parsers.
+ *
+ * The first input byte selects what the rest of the input is, so every parser stage is reached
+ * with valid surroundings instead of behind a mutated header:
+ *
+ *  - 0: a whole text trace
+ *  - 1: the header lines of a small valid trace
+ *  - 2: its node table lines
+ *  - 3: its edge table lines
+ *  - 4: its BT10 edge sequence bytes
+ *  - 5: a whole .zst trace
+ *
+ * The trace is written to a temporary file, read to the end inline and again pipelined,
+ * then sought into and walked with the BT9BranchInstance iterators. bt9::TraceError is the
+ * expected outcome for malformed input; crashes, sanitizer reports, other exceptions and
+ * hangs are findings.
+ *
+ * Build with clang++ -fsanitize=fuzzer,address,undefined (task fuzz_reader). Defining
+ * BT9_FUZZ_STANDALONE instead adds a main() that runs the inputs named on the command line,
+ * for compilers without libFuzzer and for replaying crashes.
+ */
+
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+#include "bt9_reader.h"
+
+namespace {
+
+enum FuzzStage : uint8_t {
+  FUZZ_WHOLE_TRACE,
+  FUZZ_HEADER,
+  FUZZ_NODE_TABLE,
+  FUZZ_EDGE_TABLE,
+  FUZZ_EDGE_SEQUENCE,
+  FUZZ_ZSTD_TRACE,
+  FUZZ_NUM_STAGES
+};
+
+// Sections of the small valid trace the stages splice the input into
+const char SEED_HEADER[] =
+  "BT9_SPA_TRACE_FORMAT\n"
+  "bt9_minor_version: 0\n"
+  "has_physical_address: 0\n"
+  "total_instruction_count: 20\n"
+  "branch_instruction_count: 7\n";
+
+const char SEED_NODES[] =
+  "BT9_NODES\n"
+  "NODE 0 0 - 0 0\n"
+  "NODE 1 0x1000 - 0x75 4 class: JMP+DIR+CND behavior: DYN+DIR taken_cnt: 3 not_taken_cnt: 2 tgt_cnt: 1 # mnemonic: \"jz 0x1000\"\n"
+  "NODE 2 0x1040 - 0x76 4 class: RET+UCD behavior: AT+IND taken_cnt: 1 not_taken_cnt: 0 tgt_cnt: 1\n";
+
+const char SEED_EDGES[] =
+  "BT9_EDGES\n"
+  "EDGE 0 0 1 N 0x0 - 0 traverse_cnt: 1\n"
+  "EDGE 1 1 1 T 0x1000 - 3 traverse_cnt: 3\n"
+  "EDGE 2 1 2 N 0x1004 - 5 traverse_cnt: 2\n"
+  "EDGE 3 2 1 T 0x1000 - 1 traverse_cnt: 1\n"
+  "BT10_SMALL_INDEX_SIZE_8\n"
+  "BT10_BIG_INDEX_SIZE_32\n";
+
+const uint8_t SEED_EDGE_SEQUENCE[] = {
+  0x00, 0x01, 0x01, 0x02, 0xff, 0x03, 0x00, 0x00, 0x00, 0x01, 0x02,
+  0xff, 0x00, 0x00, 0x00, 0x00
+};
+
+// Assemble the trace file of an input, the stage byte already removed
+std::string BuildTrace(FuzzStage stage, const uint8_t* data, size_t size)
+{
+  const std::string input(reinterpret_cast<const char*>(data), size);
+  if ((stage == FUZZ_WHOLE_TRACE) || (stage == FUZZ_ZSTD_TRACE)) {
+    return input;
+  }
+
+  std::string trace;
+  trace += (stage == FUZZ_HEADER) ? input : SEED_HEADER;
+  trace += (stage == FUZZ_NODE_TABLE) ? input : SEED_NODES;
+  trace += (stage == FUZZ_EDGE_TABLE) ? input : SEED_EDGES;
+  trace += (stage == FUZZ_EDGE_SEQUENCE) ? input : std::string(reinterpret_cast<const char*>(SEED_EDGE_SEQUENCE), sizeof(SEED_EDGE_SEQUENCE));
+  return trace;
+}
+
+// Everything a simulator or trace tool does with a reader, in one or the other mode
+void ExerciseReader(const std::string& path, bool pipelined)
+{
+  bt9::BT9Reader reader(path, pipelined);
+
+  std::vector<bt9::BT9HotEdge> block(64);
+  uint64_t numBranches = 0;
+  while (const uint64_t count = reader.readBranchBlock(block)) {
+    numBranches += count;
+  }
+
+  // The legacy iterators join node and edge records per branch
+  reader.seekToBranch(numBranches / 2);
+  uint64_t sum = 0;
+  for (auto it = reader.begin(); it != reader.end(); ++it) {
+    sum += it->getSrcNode()->brVirtualAddr() + it->getEdge()->brVirtualTarget();
+  }
+
+  std::ostringstream tables;
+  tables << reader.node_table << reader.edge_table << sum;
+}
+
+}  // namespace
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size)
+{
+  if (size == 0) {
+    return 0;
+  }
+
+  const FuzzStage stage = static_cast<FuzzStage>(data[0] % FUZZ_NUM_STAGES);
+  const std::string trace = BuildTrace(stage, data + 1, size - 1);
+
+  // The reader picks zstd by the file name
+  const char* dir = getenv("TMPDIR") ? getenv("TMPDIR") : "/tmp";
+  std::string path = std::string(dir) + "/fuzz_reader_XXXXXX" + ((stage == FUZZ_ZSTD_TRACE) ? ".bt9.trace.zst" : ".bt9.trace");
+  const int suffix = (stage == FUZZ_ZSTD_TRACE) ? 14 : 10;
+  const int fd = mkstemps(path.data(), suffix);
+  if (fd < 0) {
+    perror("mkstemps");
+    abort();
+  }
+  const bool written = (write(fd, trace.data(), trace.size()) == static_cast<ssize_t>(trace.size()));
+  close(fd);
+
+  if (written) {
+    for (bool pipelined : {false, true}) {
+      try {
+        ExerciseReader(path, pipelined);
+      }
+      catch (const bt9::TraceError&) {
+      }
+    }
+  }
+
+  unlink(path.c_str());
+  return 0;
+}
+
+#ifdef BT9_FUZZ_STANDALONE
+
+// usage: fuzz_reader <input>...
+int main(int argc, char* argv[])
+{
+  for (int i = 1; i < argc; i++) {
+    std::ifstream fin(argv[i], std::ios::binary);
+    const std::vector<uint8_t> input((std::istreambuf_iterator<char>(fin)), std::istreambuf_iterator<char>());
+    LLVMFuzzerTestOneInput(input.data(), input.size());
+  }
+  printf("%d inputs run\n", argc - 1);
+
+  return 0;
+}
+
+#endif
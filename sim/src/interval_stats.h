@@ -0,0 +1,325 @@
+/*!
+ * \file    interval_stats.h
+ * \brief   Interval statistics of a simulation run: the MPKBr_* milestones of the stats struct and
+ *          an optional time series of per-interval counts (.intervals).
+ *
+ * The simulation loop reads its blocks of branches up to nextBoundary() and calls sample() when
+ * it gets there, so sampling happens between blocks and the loop over the branches of a block
+ * does no bookkeeping for it. Milestones are always taken; the time series is recorded with
+ * fixed spacing (an interval every `period` branches) or log spacing (`per_decade` intervals per
+ * power of ten of branches, the first ending at `first`).
+ *
+ * A .intervals file is columnar: a fixed IntervalFileHeader, then num_intervals uint64_t of each
+ * of the end branch, instruction, conditional branch and misprediction columns, and finally
+ * num_intervals float MPKI of the intervals. Counts are per interval, the end branch is the
+ * number of branches of the trace read when the interval ended.
+ */
+
+#pragma once
+
+#include "bt9_reader_defines.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iterator>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include <unistd.h>
+
+namespace bt9 {
+
+    /// Bump whenever the layout of a .intervals file changes
+    static constexpr uint32_t INTERVAL_STATS_VERSION = 1;
+
+    /// File signature, first 8 bytes of every .intervals file
+    static constexpr char INTERVAL_STATS_MAGIC[8] = {'B', 'T', '9', 'I', 'N', 'T', 'V', 'L'};
+
+    /// Branch counts of the MPKBr_1K ... MPKBr_10B fields of the stats struct
+    static constexpr uint64_t MPKBR_MILESTONES[] = {
+        1000, 10000, 100000, 1000000, 10000000, 30000000, 60000000,
+        100000000, 300000000, 600000000, 1000000000, 10000000000
+    };
+
+    /// MPKBr_* field of the stats struct of milestone i
+    template <typename Stats>
+    double & mpkbrField(Stats & stats, size_t i)
+    {
+        double * const fields[] = {
+            &stats.MPKBr_1K, &stats.MPKBr_10K, &stats.MPKBr_100K, &stats.MPKBr_1M, &stats.MPKBr_10M, &stats.MPKBr_30M,
+            &stats.MPKBr_60M, &stats.MPKBr_100M, &stats.MPKBr_300M, &stats.MPKBr_600M, &stats.MPKBr_1B, &stats.MPKBr_10B
+        };
+        static_assert(std::size(fields) == std::size(MPKBR_MILESTONES));
+        return *fields[i];
+    }
+
+    enum class IntervalSpacing : uint32_t {
+        NONE,                           //!< Milestones only
+        FIXED,
+        LOG
+    };
+
+    /*!
+     * \struct IntervalOptions
+     * \brief Spacing of the time series, all of it is recorded in the .intervals file
+     */
+    struct IntervalOptions {
+        IntervalSpacing spacing = IntervalSpacing::NONE;
+        uint64_t period = INTERVAL_PERIOD;      //!< Branches per interval with FIXED spacing
+        uint64_t first = INTERVAL_LOG_FIRST;    //!< End of the first interval with LOG spacing
+        uint32_t per_decade = INTERVAL_LOG_STEPS;   //!< Intervals per power of ten with LOG spacing
+
+        template <class Archive>
+        void serialize(Archive & archive)
+        {
+            archive(spacing, period, first, per_decade);
+        }
+    };
+
+    /*!
+     * \struct IntervalFileHeader
+     * \brief Fixed header at offset 0 of a .intervals file, followed by the columns
+     */
+    struct IntervalFileHeader {
+        char magic[8];
+        uint32_t version;
+        uint32_t spacing;               //!< IntervalSpacing
+        uint64_t period;
+        uint64_t first;
+        uint32_t per_decade;
+        uint32_t reserved;
+        uint64_t num_intervals;
+    };
+
+    static_assert(std::is_trivially_copyable_v<IntervalFileHeader>);
+
+    /*!
+     * \struct IntervalCounts
+     * \brief Running counts of a simulation, as of branch `branches` of the trace
+     */
+    struct IntervalCounts {
+        uint64_t branches = 0;
+        uint64_t instructions = 0;      //!< Only counted while a time series is recorded
+        uint64_t cond_branches = 0;
+        uint64_t mispredictions = 0;
+    };
+
+    /*!
+     * \class IntervalStats
+     * \brief Samples a simulation run at the milestones and at the ends of its intervals
+     */
+    class IntervalStats
+    {
+    public:
+        explicit IntervalStats(const IntervalOptions & options = IntervalOptions()) : options_(options)
+        {
+            if ((options_.spacing == IntervalSpacing::FIXED) && (options_.period == 0)) {
+                options_.period = 1;
+            }
+            if (options_.spacing == IntervalSpacing::LOG) {
+                options_.first = std::max<uint64_t>(options_.first, 1);
+                options_.per_decade = std::max<uint32_t>(options_.per_decade, 1);
+            }
+            seriesEnd_ = intervalEnd(0);
+            updateBoundary();
+        }
+
+        /// Whether a time series is recorded, which needs the instruction count
+        bool recording() const { return options_.spacing != IntervalSpacing::NONE; }
+
+        /// Branches of the trace read at the next sample, always past the last one
+        uint64_t nextBoundary() const { return boundary_; }
+
+        /*!
+         * \brief Take the samples due at counts.branches == nextBoundary()
+         * \note MPKBr_* milestones are taken as the heartbeat of the simulator always took them,
+         *       ahead of the branch they are named after: MPKBr_1K holds the mispredictions of
+         *       the first 999 branches per 1000 branches
+         */
+        template <typename Stats>
+        void sample(Stats & stats, const IntervalCounts & counts)
+        {
+            while ((milestone_ < std::size(MPKBR_MILESTONES)) && (MPKBR_MILESTONES[milestone_] - 1 <= counts.branches)) {
+                mpkbrField(stats, milestone_) = 1000.0 * (double)(counts.mispredictions) / (double)(MPKBR_MILESTONES[milestone_]);
+                milestone_++;
+            }
+
+            if (recording() && (seriesEnd_ <= counts.branches)) {
+                endInterval(counts);
+                // Rounding can give log spaced intervals the same end, the later ones are pushed back
+                while (seriesEnd_ <= counts.branches) {
+                    seriesEnd_ = std::max(intervalEnd(++interval_), seriesEnd_ + 1);
+                }
+            }
+
+            updateBoundary();
+        }
+
+        /// End the last, partial interval of the time series at the end of the trace
+        void finish(const IntervalCounts & counts)
+        {
+            if (recording() && (counts.branches > last_.branches)) {
+                endInterval(counts);
+            }
+        }
+
+        size_t numIntervals() const { return ends_.size(); }
+
+        /*!
+         * \brief Write the time series as a .intervals file
+         * \note Written under a temporary name and renamed into place like the seek index
+         * \return Returns false if the file could not be written
+         */
+        bool write(const std::string & path) const
+        {
+            const std::string tmp_path = path + ".tmp." + std::to_string(getpid());
+            FILE * fout = fopen(tmp_path.c_str(), "wb");
+            if (fout == nullptr) {
+                return false;
+            }
+
+            IntervalFileHeader h = {};
+            memcpy(h.magic, INTERVAL_STATS_MAGIC, sizeof(h.magic));
+            h.version = INTERVAL_STATS_VERSION;
+            h.spacing = static_cast<uint32_t>(options_.spacing);
+            h.period = options_.period;
+            h.first = options_.first;
+            h.per_decade = options_.per_decade;
+            h.num_intervals = ends_.size();
+
+            std::vector<float> mpki(ends_.size());
+            for (size_t i = 0; i < mpki.size(); i++) {
+                mpki[i] = (instructions_[i] != 0) ? 1000.0f * mispredictions_[i] / instructions_[i] : 0.0f;
+            }
+
+            fwrite(&h, sizeof(h), 1, fout);
+            for (const std::vector<uint64_t> * column : {&ends_, &instructions_, &cond_branches_, &mispredictions_}) {
+                fwrite(column->data(), sizeof(uint64_t), column->size(), fout);
+            }
+            fwrite(mpki.data(), sizeof(float), mpki.size(), fout);
+
+            const bool ok = !ferror(fout);
+            if ((fclose(fout) != 0) || !ok || (rename(tmp_path.c_str(), path.c_str()) != 0)) {
+                remove(tmp_path.c_str());
+                return false;
+            }
+
+            return true;
+        }
+
+        /*!
+         * \brief Read back a .intervals file written by write(): its spacing and time series
+         * \note The milestones are not in the file, they are left as they are
+         * \return Returns false if it is not a .intervals file of this version
+         */
+        bool read(const std::string & path)
+        {
+            FILE * fin = fopen(path.c_str(), "rb");
+            if (fin == nullptr) {
+                return false;
+            }
+
+            IntervalFileHeader h;
+            bool ok = (fread(&h, sizeof(h), 1, fin) == 1) && (memcmp(h.magic, INTERVAL_STATS_MAGIC, sizeof(h.magic)) == 0) &&
+                      (h.version == INTERVAL_STATS_VERSION) && (h.spacing <= static_cast<uint32_t>(IntervalSpacing::LOG));
+            if (ok) {
+                // The float MPKI column follows the counts and is derived from them
+                ok = (fseek(fin, 0, SEEK_END) == 0) &&
+                     ((uint64_t)ftell(fin) == sizeof(h) + h.num_intervals * (4 * sizeof(uint64_t) + sizeof(float))) &&
+                     (fseek(fin, sizeof(h), SEEK_SET) == 0);
+            }
+            for (std::vector<uint64_t> * column : {&ends_, &instructions_, &cond_branches_, &mispredictions_}) {
+                column->resize(ok ? h.num_intervals : 0);
+                ok = ok && (fread(column->data(), sizeof(uint64_t), column->size(), fin) == column->size());
+            }
+            fclose(fin);
+
+            if (ok) {
+                options_.spacing = static_cast<IntervalSpacing>(h.spacing);
+                options_.period = h.period;
+                options_.first = h.first;
+                options_.per_decade = h.per_decade;
+            }
+            return ok;
+        }
+
+        /// Counts of all intervals of the time series added up, branches is the end of the last one
+        IntervalCounts totals() const
+        {
+            IntervalCounts sum;
+            sum.branches = ends_.empty() ? 0 : ends_.back();
+            for (size_t i = 0; i < ends_.size(); i++) {
+                sum.instructions += instructions_[i];
+                sum.cond_branches += cond_branches_[i];
+                sum.mispredictions += mispredictions_[i];
+            }
+            return sum;
+        }
+
+        /// Whether other records its time series with the same spacing and has the same intervals
+        bool sameSeries(const IntervalStats & other) const
+        {
+            return (options_.spacing == other.options_.spacing) && (options_.period == other.options_.period) &&
+                   (options_.first == other.options_.first) && (options_.per_decade == other.options_.per_decade) &&
+                   (ends_ == other.ends_) && (instructions_ == other.instructions_) &&
+                   (cond_branches_ == other.cond_branches_) && (mispredictions_ == other.mispredictions_);
+        }
+
+        /// Everything sampled so far, for simulator checkpoints (see checkpoint.h)
+        template <class Archive>
+        void serialize(Archive & archive)
+        {
+            archive(options_, milestone_, interval_, seriesEnd_, boundary_,
+                    last_.branches, last_.instructions, last_.cond_branches, last_.mispredictions,
+                    ends_, instructions_, cond_branches_, mispredictions_);
+        }
+
+    private:
+        /// Branches of the trace read at the end of interval i of the time series
+        uint64_t intervalEnd(uint64_t i) const
+        {
+            switch (options_.spacing) {
+                case IntervalSpacing::FIXED:
+                    return (i + 1) * options_.period;
+                case IntervalSpacing::LOG:
+                    return (uint64_t)std::ceil(options_.first * std::pow(10.0, (double)i / options_.per_decade));
+                default:
+                    return UINT64_MAX;
+            }
+        }
+
+        void endInterval(const IntervalCounts & counts)
+        {
+            ends_.push_back(counts.branches);
+            instructions_.push_back(counts.instructions - last_.instructions);
+            cond_branches_.push_back(counts.cond_branches - last_.cond_branches);
+            mispredictions_.push_back(counts.mispredictions - last_.mispredictions);
+            last_ = counts;
+        }
+
+        void updateBoundary()
+        {
+            boundary_ = recording() ? seriesEnd_ : UINT64_MAX;
+            if (milestone_ < std::size(MPKBR_MILESTONES)) {
+                boundary_ = std::min(boundary_, MPKBR_MILESTONES[milestone_] - 1);
+            }
+        }
+
+        IntervalOptions options_;
+        size_t milestone_ = 0;          //!< Next MPKBr_* milestone
+        uint64_t interval_ = 0;         //!< Interval of the time series in progress
+        uint64_t seriesEnd_ = 0;        //!< Its end
+        uint64_t boundary_ = 0;
+        IntervalCounts last_;           //!< Counts at the end of the last interval
+
+        std::vector<uint64_t> ends_;
+        std::vector<uint64_t> instructions_;
+        std::vector<uint64_t> cond_branches_;
+        std::vector<uint64_t> mispredictions_;
+    };
+
+}
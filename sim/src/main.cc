@@ -3,10 +3,29 @@
 ///////////////////////////////////////////////////////////////////////
 
 #include <map>
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#include <getopt.h>
+#include <sys/wait.h>
+#include <unistd.h>
 
 #include "utils.h"
 
 #include "bt9_reader.h"
+#include "simpoint.h"
+#include "checkpoint.h"
+#include "interval_stats.h"
+#include "trace_scheduler.h"
 
 #include "../build/paths.h"
 #include PREDICTOR_H_PATH
@@ -16,114 +35,1018 @@
 #include <cereal/archives/json.hpp>
 #include <cereal/types/array.hpp>
 
-void CheckHeartBeat(uint64_t numIter, uint64_t numMispred)
+void PrintUsage(const char* prog)
+{
+  printf("usage: %s [options] <trace>\n", prog);
+  printf("       %s [options] -j N [-o FILE] <trace or trace directory>...\n", prog);
+  printf("  -p, --pipelined     decompress and decode the trace on a background thread\n");
+  printf("  -t, --throughput    print trace decode throughput to stderr\n");
+  printf("  -l, --load-only     load the header, node and edge tables, print the load time and exit\n");
+  printf("  -c, --cache-dir DIR use (and create) pre-decoded .bt10c trace caches in DIR\n");
+  printf("                      (default: $BT9_TRACE_CACHE_DIR, no caching if unset)\n");
+  printf("  -C, --io-chunk-size N  bytes per trace file read (default: $BT9_IO_CHUNK_SIZE or %d)\n", TRACE_IO_CHUNK_SIZE);
+  printf("  -Q, --io-depth N       trace file reads issued ahead of the decoder, 0 to read synchronously\n");
+  printf("                         (default: $BT9_IO_DEPTH or %d)\n", TRACE_IO_DEPTH);
+  printf("  -b, --bench-decoder compare the BT10 edge sequence decoders on the trace and exit\n");
+  printf("  -s, --sample        simulate only SimPoint intervals and report their weighted MPKI\n");
+  printf("                      (phase analysis cached next to the trace in a .simpt file)\n");
+  printf("  -I, --sample-interval N  branches per interval (default: %d)\n", SIMPOINT_INTERVAL);
+  printf("  -W, --sample-warmup N    branches simulated uncounted ahead of each interval (default: %d)\n", SIMPOINT_WARMUP);
+  printf("  -K, --sample-max-k N     largest number of phases tried (default: %d)\n", SIMPOINT_MAX_K);
+  printf("  -v, --sample-verify      also run the full trace in a child process and report the sampling error\n");
+  printf("  -k, --chunks N      cut the trace into N chunks simulated in parallel, each by a fresh predictor,\n");
+  printf("                      and report their merged MPKI (approximate); with -j N, on N threads at most\n");
+  printf("  -w, --chunk-warmup N     branches simulated uncounted ahead of each chunk (default: %d)\n", CHUNK_WARMUP);
+  printf("      --chunk-verify       also run the full trace serially and report the error of every chunk; fail if a chunk\n");
+  printf("                           has other branches than the serial run, or other mispredictions after a warm-up\n");
+  printf("                           from the start of the trace\n");
+  printf("      --checkpoint PATH    write the predictor, its stats and the trace position to PATH every few branches\n");
+  printf("                           and at the end of the trace (batch mode: a directory, one <trace>.ckpt per trace)\n");
+  printf("      --checkpoint-interval N  branches between two checkpoints (default: %d)\n", CHECKPOINT_INTERVAL);
+  printf("      --resume             carry on from the --checkpoint of the trace, if it has one\n");
+  printf("      --warm-start FILE    load the predictor tables and histories of the checkpoint FILE before simulating\n");
+  printf("      --checkpoint-verify  also run the trace again, stopped halfway at a checkpoint and resumed from it,\n");
+  printf("                           and check that it ends with the same stats and interval stats\n");
+  printf("      --intervals PATH     write the instructions, conditional branches, mispredictions and MPKI of every\n");
+  printf("                           interval of the run to PATH (batch mode: a directory, one <trace>.intervals per trace)\n");
+  printf("      --interval-period N  intervals of N branches (default: %d)\n", INTERVAL_PERIOD);
+  printf("      --interval-log N     log spaced intervals instead, N per power of ten of branches from %d\n", INTERVAL_LOG_FIRST);
+  printf("      --intervals-verify   read the --intervals file back and check that it holds the intervals of the run\n");
+  printf("                           and that their counts add up to those of the whole run\n");
+  printf("batch mode, with several traces, a trace directory, -j (without -k) or -o:\n");
+  printf("  -j, --threads N     traces simulated in parallel, longest first, each with a fresh predictor\n");
+  printf("                      (default: number of hardware threads)\n");
+  printf("  -o, --output FILE   write the stats of all traces as one JSON object to FILE (default: stdout)\n");
+  printf("      --progress      print a line to stderr whenever a trace is done\n");
+}
+
+// Node/edge table load time of the trace reader, printed with --throughput and --load-only
+void PrintLoadTime(const std::string& trace, const bt9::BT9LoadStats& load)
 {
+  fprintf(stderr, "%s: %llu nodes, %llu edges loaded in %.3f s\n",
+          trace.c_str(), (unsigned long long)load.num_nodes, (unsigned long long)load.num_edges, load.load_seconds);
+  fprintf(stderr, "%s: tables %.1f KB (%.1f KB hot), %.1f KB as node/edge records\n",
+          trace.c_str(), load.table_bytes / 1024.0, load.hot_table_bytes / 1024.0, load.legacy_table_bytes / 1024.0);
+}
+
+// Decode throughput of the trace reader, printed with --throughput
+void PrintThroughput(const std::string& trace, const bt9::TraceStreamStats& stream, uint64_t numBranches, double seconds)
+{
+  const double MB = 1024.0 * 1024.0;
+  if (stream.stream_bytes == 0) {
+    fprintf(stderr, "%s: edge sequence served from the trace cache\n", trace.c_str());
+  }
+  else {
+    fprintf(stderr, "%s: file %.1f MB, decompressed %.1f MB, decode %.3f s (%.1f MB/s)\n",
+            trace.c_str(), (double)stream.file_bytes / MB, (double)stream.stream_bytes / MB,
+            stream.decode_seconds, (double)stream.stream_bytes / MB / stream.decode_seconds);
+    fprintf(stderr, "%s: I/O wait %.3f s, compute %.3f s (file reads took %.3f s, overlapped by read-ahead)\n",
+            trace.c_str(), stream.io_wait_seconds, seconds - stream.io_wait_seconds, stream.io_read_seconds);
+  }
+  fprintf(stderr, "%s: %llu branches in %.3f s (%.2f M branches/s)\n",
+          trace.c_str(), (unsigned long long)numBranches, seconds, (double)numBranches / seconds / 1e6);
+}
+
+// Decode the whole edge sequence once per BT10 decoder the CPU supports, printed with --bench-decoder
+void BenchDecoder(const std::string& trace)
+{
+  bt9::BT9Reader reader(trace);
+  uint64_t reference = 0;
+
+  if (reader.columnar_ != nullptr) {
+    fprintf(stderr, "%s: columnar trace, no BT10 edge sequence to decode\n", trace.c_str());
+    return;
+  }
+
+  for (bt9::BT10Decoder decoder : {bt9::BT10Decoder::SCALAR, bt9::BT10Decoder::SSE4, bt9::BT10Decoder::AVX2}) {
+    const char* name = bt9::bt10DecoderName(decoder);
+    if (!reader.setBT10Decoder(decoder)) {
+      fprintf(stderr, "%s: %-6s decoder not supported by this CPU\n", trace.c_str(), name);
+      continue;
+    }
 
-  const uint64_t d1K   =1000;
-  const uint64_t d10K  =10000;
-  const uint64_t d100K =100000;
-  const uint64_t d1M   =1000000;
-  const uint64_t d10M  =10000000;
-  const uint64_t d30M  =30000000;
-  const uint64_t d60M  =60000000;
-  const uint64_t d100M =100000000;
-  const uint64_t d300M =300000000;
-  const uint64_t d600M =600000000;
-  const uint64_t d1B   =1000000000;
-  const uint64_t d10B  =10000000000;
+    // Best of a few passes; reading and decompressing the file is timed by the stream buffer and left out
+    uint64_t numBranches = 0;
+    double decodeSeconds = 0.0;
+    for (int pass = 0; pass < 3; pass++) {
+      reader.seekToBranch(0);
+      const bt9::TraceStreamStats before = reader.streamStats();
+      const auto start = std::chrono::steady_clock::now();
+      numBranches = reader.skipBranches(UINT64_MAX);
+      const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+      const bt9::TraceStreamStats& after = reader.streamStats();
 
-  if(numIter == d1K){
-    stats.MPKBr_1K = 1000.0*(double)(numMispred)/(double)(numIter);
+      if (after.stream_bytes == 0) {
+        fprintf(stderr, "%s: edge sequence served from the trace cache, nothing to decode\n", trace.c_str());
+        return;
+      }
+
+      const double passSeconds = seconds - (after.decode_seconds - before.decode_seconds);
+      decodeSeconds = (pass == 0) ? passSeconds : std::min(decodeSeconds, passSeconds);
+    }
+
+    fprintf(stderr, "%s: %-6s decoder %llu branches in %.4f s (%.1f M branches/s)\n",
+            trace.c_str(), name, (unsigned long long)numBranches, decodeSeconds, (double)numBranches / decodeSeconds / 1e6);
+
+    if (reference == 0) {
+      reference = numBranches;
+    }
+    else if (numBranches != reference) {
+      fprintf(stderr, "%s: %s decoder read %llu branches, expected %llu\n",
+              trace.c_str(), name, (unsigned long long)numBranches, (unsigned long long)reference);
+      exit(-1);
+    }
   }
+}
 
-  if(numIter == d10K){
-    stats.MPKBr_10K = 1000.0*(double)(numMispred)/(double)(numIter);
+// Counts of one simulated stretch of the trace
+struct SampleCounters {
+  uint64_t instructions = 0;
+  uint64_t condBranches = 0;
+  uint64_t uncondBranches = 0;
+  uint64_t mispredictions = 0;
+
+  template<class Archive>
+  void serialize(Archive& ar)
+  {
+    ar(instructions, condBranches, uncondBranches, mispredictions);
   }
+};
+
+// Simulate the next numBranches branches of the reader like the main loop does
+uint64_t SimulateBranches(PREDICTOR& brpred, bt9::BT9Reader& reader, uint64_t numBranches, SampleCounters& counters)
+{
+  std::vector<bt9::BT9HotEdge> block(BRANCH_BLOCK_SIZE);
+  uint64_t simulated = 0;
+
+  while (simulated < numBranches) {
+    const uint64_t blockSize = reader.readBranchBlock(std::span(block).first(std::min<uint64_t>(block.size(), numBranches - simulated)));
+    if (blockSize == 0) {
+      break;
+    }
+
+    for (const bt9::BT9HotEdge& br : std::span(block).first(blockSize)) {
+      const OpType opType = br.opType();
+      counters.instructions += (uint64_t)br.inst_cnt + 1;
+
+      if (br.conditional) {
+        const bool predDir = brpred.GetPrediction(br.pc);
+        brpred.UpdatePredictor(br.pc, opType, br.taken, predDir, br.target);
+        counters.mispredictions += (predDir != br.taken);
+        counters.condBranches++;
+      }
+      else if (opType != OPTYPE_ERROR) { // OPTYPE_ERROR is only left on the fake branch of node 0
+        counters.uncondBranches++;
+        brpred.TrackOtherInst(br.pc, opType, br.taken, br.target);
+      }
+    }
+    simulated += blockSize;
+  }
+
+  return simulated;
+}
+
+// Counts the interval stats are sampled from
+bt9::IntervalCounts IntervalCountsOf(uint64_t numIter, const SampleCounters& counters)
+{
+  return {numIter, counters.instructions, counters.condBranches, counters.mispredictions};
+}
+
+// Simulate the reader to the end of the trace, the main loop of the simulator; returns the number
+// of branches read. counters.instructions is left to the header unless intervals records a time
+// series. Blocks of branches end at the samples of intervals, which are taken between them. A run
+// resumed from a checkpoint starts at numIter branches, and checkpoint is called between two
+// blocks whenever another checkpointInterval branches were read (never if 0). The run stops
+// there if checkpoint returns false.
+uint64_t SimulateTrace(PREDICTOR& brpred, bt9::BT9Reader& bt9_reader, SampleCounters& counters, bt9::IntervalStats& intervals,
+                       uint64_t numIter = 0, uint64_t checkpointInterval = 0, const std::function<bool(uint64_t)>& checkpoint = {})
+{
+      OpType opType;
+      uint64_t PC;
+      bool branchTaken;
+      uint64_t branchTarget;
+
+      uint64_t nextCheckpoint = numIter + checkpointInterval;
+
+
+      // The branch classification (JD2_2_2016 break down of branch instructions into all possible types)
+      // is precomputed per edge by the reader, see bt9::BT9Reader::classifyOpType_()
+      std::vector<bt9::BT9HotEdge> block(BRANCH_BLOCK_SIZE);
+
+        while (const uint64_t blockSize = bt9_reader.readBranchBlock(std::span(block).first(std::min<uint64_t>(block.size(), intervals.nextBoundary() - numIter)))) {
+          const std::span<const bt9::BT9HotEdge> branches = std::span(block).first(blockSize);
+          if (intervals.recording()) {
+            for (const bt9::BT9HotEdge & br : branches) {
+              counters.instructions += (uint64_t)br.inst_cnt + 1;
+            }
+          }
+
+          for (const bt9::BT9HotEdge & br : branches) {
+            numIter++;
+
+            opType = br.opType();
+            PC = br.pc;
+
+            branchTaken = br.taken;
+            branchTarget = br.target;
+
+            //printf("PC: %llx type: %x outcome: %d", PC, (uint32_t)opType, branchTaken);
+
+  /************************************************************************************************************/
+
+            if (br.conditional) { //JD2_17_2016 call UpdatePredictor() for all branches that decode as conditional
+              //printf("COND ");
+
+              bool predDir = false;
+
+              predDir = brpred.GetPrediction(PC);
+              brpred.UpdatePredictor(PC, opType, branchTaken, predDir, branchTarget);
+
+              if(predDir != branchTaken){
+                counters.mispredictions++; // update mispred stats
+              }
+              counters.condBranches++;
+            }
+            else if (opType != OPTYPE_ERROR) { // for predictors that want to track unconditional branches
+              counters.uncondBranches++;
+              brpred.TrackOtherInst(PC, opType, branchTaken, branchTarget);
+            }
+
+  /************************************************************************************************************/
+          } //for (const bt9::BT9HotEdge & br : block)
+
+          if (numIter == intervals.nextBoundary()) {
+            intervals.sample(stats, IntervalCountsOf(numIter, counters));
+          }
+
+          if ((checkpointInterval != 0) && (numIter >= nextCheckpoint)) {
+            if (!checkpoint(numIter)) {
+              break;
+            }
+            nextCheckpoint = numIter + checkpointInterval;
+          }
+        } //while (bt9_reader.readBranchBlock(block))
+
+      intervals.finish(IntervalCountsOf(numIter, counters));
+      return numIter;
+}
+
+// Trace name the stats are keyed by: the file name without extension
+std::string TraceName(const std::string& trace_path)
+{
+    std::string filename = trace_path.substr(trace_path.find_last_of("/\\") + 1);
+
+    std::string::size_type const first_dot = filename.find_first_of('.');
+    return filename.substr(0, first_dot);
+}
+
+// Fill the global stats from the counts of a whole trace
+void FillStats(const std::string& trace_path, const bt9::BT9Reader& bt9_reader, const SampleCounters& counters)
+{
+    const uint64_t total_instruction_counter = HeaderCount(bt9_reader, "total_instruction_count:");
+
+    stats.NUM_INSTRUCTIONS = total_instruction_counter;
+    stats.NUM_BR = HeaderCount(bt9_reader, "branch_instruction_count:")-1; //JD2_2_2016 NOTE there is a dummy branch at the beginning of the trace...
+    stats.NUM_UNCOND_BR = counters.uncondBranches;
+    stats.NUM_CONDITIONAL_BR = counters.condBranches;
+    stats.NUM_MISPREDICTIONS = counters.mispredictions;
+    stats.MISPRED_PER_1K_INST = 1000.0*(double)(counters.mispredictions)/(double)(total_instruction_counter);
+    stats.TRACE = TraceName(trace_path);
+}
+
+// Checkpoints of the runs, set with --checkpoint, --checkpoint-interval, --resume and --warm-start
+struct CheckpointOptions {
+  std::string path;           // checkpoint file, or directory of them in batch mode; empty for none
+  uint64_t interval = CHECKPOINT_INTERVAL;
+  bool resume = false;
+  std::string warmStart;      // checkpoint the predictor state is loaded from, empty for none
+};
+
+// Interval stats time series of the runs, set with --intervals, --interval-period and --interval-log
+struct IntervalOutput {
+  std::string path;           // .intervals file, or directory of them in batch mode; empty for none
+  bt9::IntervalOptions options;
+};
+
+// File of a trace in a --checkpoint or --intervals directory of batch mode
+std::string BatchTraceFile(const std::string& dir, const std::string& trace_path, const char* extension)
+{
+  return (std::filesystem::path(dir) / (trace_path.substr(trace_path.find_last_of("/\\") + 1) + extension)).string();
+}
+
+// Load the predictor state of a checkpoint, whatever trace it was taken of, for --warm-start
+void WarmStart(PREDICTOR& brpred, const std::string& path)
+{
+  bt9::CheckpointInfo info;
+  SampleCounters counters;
+  stats_t checkpointStats;
+  bt9::IntervalStats checkpointIntervals;
+  if (!bt9::readCheckpoint(path, PREDICTOR_H_PATH, info, counters, checkpointStats, checkpointIntervals, brpred)) {
+    throw bt9::TraceError(path + ": not a checkpoint of this predictor");
+  }
+}
+
+// Simulate a whole trace like SimulateTrace, with the checkpoints of ckpt written to checkpointPath.
+// With ckpt.resume, a checkpoint of this trace found there restores the predictor, the counters, the
+// stats and the intervals sampled so far, and the run carries on from its branch with the interval
+// spacing of the checkpoint; other checkpoints are overwritten. The last checkpoint is taken at the
+// end of the trace, from which a resumed run only reproduces the stats.
+uint64_t SimulateTraceCheckpointed(PREDICTOR& brpred, bt9::BT9Reader& bt9_reader, const std::string& trace_path,
+                                   const CheckpointOptions& ckpt, const std::string& checkpointPath, SampleCounters& counters,
+                                   bt9::IntervalStats& intervals)
+{
+  uint64_t numIter = 0;
+  bt9::CheckpointInfo info;
+  if (ckpt.resume && bt9::readCheckpointInfo(checkpointPath, info) && (info.predictor == PREDICTOR_H_PATH) && info.matchesTrace(trace_path)) {
+    // Only a damaged file fails here, and it has overwritten part of the state already
+    if (!bt9::readCheckpoint(checkpointPath, PREDICTOR_H_PATH, info, counters, stats, intervals, brpred) ||
+        (bt9_reader.skipBranches(info.branch) != info.branch)) {
+      throw bt9::TraceError(checkpointPath + ": damaged checkpoint, remove it to start over");
+    }
+    numIter = info.branch;
+  }
+
+  auto save = [&](uint64_t branch) {
+    if (!bt9::writeCheckpoint(checkpointPath, bt9::checkpointInfo(PREDICTOR_H_PATH, trace_path, branch), counters, stats, intervals, brpred)) {
+      fprintf(stderr, "%s: cannot write the checkpoint\n", checkpointPath.c_str());
+    }
+    return true;
+  };
+
+  numIter = SimulateTrace(brpred, bt9_reader, counters, intervals, numIter, ckpt.interval, save);
+  save(numIter);
+  return numIter;
+}
+
+// Outcome of a run as compared by --checkpoint-verify: the stats the simulator fills in, the interval
+// stats and the predictor state. Stats defined by the predictor are left out, they may be held in
+// unordered containers that a resumed run iterates in another order.
+std::string RunState(PREDICTOR& brpred, bt9::IntervalStats& intervals)
+{
+  std::ostringstream out;
+  {
+    cereal::BinaryOutputArchive archive(out);
+    archive(stats.TRACE, stats.NUM_INSTRUCTIONS, stats.NUM_BR, stats.NUM_UNCOND_BR, stats.NUM_CONDITIONAL_BR,
+            stats.NUM_MISPREDICTIONS, stats.MISPRED_PER_1K_INST);
+    for (size_t i = 0; i < std::size(bt9::MPKBR_MILESTONES); i++) {
+      archive(bt9::mpkbrField(stats, i));
+    }
+    archive(intervals, brpred);
+  }
+  return out.str();
+}
+
+// Run of --checkpoint-verify, against the RunState() of the uninterrupted run. The
+// trace is simulated again on a thread of its own, which starts from the untrained predictor
+// (see bt9::TraceScheduler), and stopped at a checkpoint halfway through. Another thread resumes
+// from that checkpoint like --resume does and runs to the end of the trace.
+// Returns an empty string if it ends in the same state, else what went wrong.
+std::string VerifyResume(const std::string& trace_path, const std::string& expected, const CheckpointOptions& ckpt,
+                         const IntervalOutput& intervalOutput, bool pipelined, const std::string& cacheDir, const bt9::TraceIoOptions& io)
+{
+  const std::string checkpointPath = (std::filesystem::temp_directory_path() /
+                                      (trace_path.substr(trace_path.find_last_of("/\\") + 1) + "." + std::to_string(getpid()) + ".ckpt")).string();
+  std::string error;
+  uint64_t stoppedAt = 0;
+
+  std::thread([&]() {
+    try {
+      bt9::BT9Reader reader(trace_path, pipelined, cacheDir, io);
+      const std::unique_ptr<PREDICTOR> brpred = std::make_unique<PREDICTOR>();
+      if (!ckpt.warmStart.empty()) {
+        WarmStart(*brpred, ckpt.warmStart);
+      }
+
+      SampleCounters counters;
+      bt9::IntervalStats intervals(intervalOutput.options);
+      const uint64_t half = std::max<uint64_t>(HeaderCount(reader, "branch_instruction_count:") / 2, 1);
+      SimulateTrace(*brpred, reader, counters, intervals, 0, half, [&](uint64_t branch) {
+        if (!bt9::writeCheckpoint(checkpointPath, bt9::checkpointInfo(PREDICTOR_H_PATH, trace_path, branch), counters, stats, intervals, *brpred)) {
+          error = checkpointPath + ": cannot write the checkpoint";
+        }
+        stoppedAt = branch;
+        return false;
+      });
+    }
+    catch (const std::exception& ex) {
+      error = ex.what();
+    }
+  }).join();
+
+  if (error.empty() && (stoppedAt == 0)) {
+    error = "the trace ended before the checkpoint";
+  }
+
+  if (error.empty()) {
+    std::thread([&]() {
+      try {
+        bt9::BT9Reader reader(trace_path, pipelined, cacheDir, io);
+        const std::unique_ptr<PREDICTOR> brpred = std::make_unique<PREDICTOR>();
+
+        CheckpointOptions resume;
+        resume.interval = UINT64_MAX;
+        resume.resume = true;
+        SampleCounters counters;
+        bt9::IntervalStats intervals(intervalOutput.options);
+        SimulateTraceCheckpointed(*brpred, reader, trace_path, resume, checkpointPath, counters, intervals);
+        FillStats(trace_path, reader, counters);
+
+        if (RunState(*brpred, intervals) != expected) {
+          error = "resumed at branch " + std::to_string(stoppedAt) + ", the run ends in another state";
+        }
+      }
+      catch (const std::exception& ex) {
+        error = ex.what();
+      }
+    }).join();
+  }
+
+  std::error_code ec;
+  std::filesystem::remove(checkpointPath, ec);
+  return error;
+}
+
+// Check of --intervals-verify on the .intervals file written for a run of numIter branches that
+// ended with counters. Returns an empty string if the file matches the run, else what differs.
+std::string VerifyIntervals(const std::string& path, const bt9::IntervalStats& intervals, uint64_t numIter, const SampleCounters& counters)
+{
+  bt9::IntervalStats written;
+  if (!written.read(path)) {
+    return "cannot read the interval stats back";
+  }
+  if (!written.sameSeries(intervals)) {
+    return "the file holds other intervals than the run";
+  }
+
+  const bt9::IntervalCounts sum = written.totals();
+  const bt9::IntervalCounts run = IntervalCountsOf(numIter, counters);
+  if ((sum.branches != run.branches) || (sum.instructions != run.instructions) || (sum.cond_branches != run.cond_branches) ||
+      (sum.mispredictions != run.mispredictions)) {
+    char buf[256];
+    snprintf(buf, sizeof(buf), "the intervals add up to %llu/%llu/%llu/%llu branches/instructions/conditional/mispredictions, the run to %llu/%llu/%llu/%llu",
+             (unsigned long long)sum.branches, (unsigned long long)sum.instructions, (unsigned long long)sum.cond_branches,
+             (unsigned long long)sum.mispredictions, (unsigned long long)run.branches, (unsigned long long)run.instructions,
+             (unsigned long long)run.cond_branches, (unsigned long long)run.mispredictions);
+    return buf;
+  }
+  return "";
+}
+
+// Whole trace counts estimated from the simulation points, weighted by the instruction share of their phase
+struct SampleEstimate {
+  double mpki = 0.0;
+  double condPerInst = 0.0;
+  double uncondPerInst = 0.0;
+  uint64_t simulatedBranches = 0;
+  uint64_t warmupBranches = 0;
+};
+
+// Sampled simulation, run with --sample: every simulation point is preceded by up to `warmup`
+// branches that train the predictor without being counted. Points are visited in trace order
+// and the predictor state carries over from one to the next.
+SampleEstimate RunSampled(PREDICTOR& brpred, bt9::BT9Reader& reader, const bt9::SimPointSet& simpoints, uint64_t warmup)
+{
+  // Seek through the trace cache or a seek index, columnar traces are decoded forward instead
+  const bool canSeek = reader.openSeekIndex();
 
-  if(numIter == d100K){
-    stats.MPKBr_100K = 1000.0*(double)(numMispred)/(double)(numIter);
+  SampleEstimate est;
+  uint64_t position = 0;
+  for (const bt9::SimPoint& point : simpoints.points) {
+    const uint64_t begin = simpoints.intervalBegin(point.interval);
+    const uint64_t start = std::max(position, begin - std::min(warmup, begin));
+    if (canSeek) {
+      reader.seekToBranch(start);
+    }
+    else {
+      reader.skipBranches(start - position);
+    }
+
+    SampleCounters warm, counted;
+    est.warmupBranches += SimulateBranches(brpred, reader, begin - start, warm);
+    est.simulatedBranches += SimulateBranches(brpred, reader, simpoints.intervalLength(point.interval), counted);
+    position = begin + simpoints.intervalLength(point.interval);
+
+    const double instructions = std::max<double>(counted.instructions, 1);
+    est.mpki += point.weight * 1000.0 * counted.mispredictions / instructions;
+    est.condPerInst += point.weight * counted.condBranches / instructions;
+    est.uncondPerInst += point.weight * counted.uncondBranches / instructions;
   }
 
-  if(numIter == d1M){
-    stats.MPKBr_1M = 1000.0*(double)(numMispred)/(double)(numIter);
+  return est;
+}
+
+// Phases, simulated share of the trace and estimated MPKI, printed with --sample; fullMpki < 0 when not verified
+void PrintSampleReport(const std::string& trace, const bt9::SimPointSet& simpoints, const SampleEstimate& est, double fullMpki)
+{
+  const double branches = std::max<double>(simpoints.num_branches, 1);
+  fprintf(stderr, "%s: %llu intervals of %llu branches, %zu simulation points\n", trace.c_str(),
+          (unsigned long long)simpoints.numIntervals(), (unsigned long long)simpoints.options.interval, simpoints.points.size());
+  for (const bt9::SimPoint& point : simpoints.points) {
+    fprintf(stderr, "%s:   interval %6llu  weight %.4f  (%u intervals)\n", trace.c_str(),
+            (unsigned long long)point.interval, point.weight, point.cluster_size);
+  }
+  fprintf(stderr, "%s: simulated %.2f%% of the branches, plus %.2f%% as warm-up\n", trace.c_str(),
+          100.0 * est.simulatedBranches / branches, 100.0 * est.warmupBranches / branches);
+  fprintf(stderr, "%s: sampled MPKI %.4f\n", trace.c_str(), est.mpki);
+  if (fullMpki >= 0.0) {
+    fprintf(stderr, "%s: full MPKI %.4f, error %+.4f (%+.2f%%)\n", trace.c_str(),
+            fullMpki, est.mpki - fullMpki, (fullMpki > 0.0) ? 100.0 * (est.mpki - fullMpki) / fullMpki : 0.0);
   }
+}
+
+// Chunk of a chunked run, with the counts of its branches; warmup branches ahead of it train the predictor uncounted
+struct ChunkResult {
+  uint64_t begin = 0;
+  uint64_t end = 0;
+  uint64_t warmupBranches = 0;
+  SampleCounters counted;
+  SampleCounters serial;      // counts of the same branches in the serial run of --chunk-verify
+};
 
-  if(numIter == d10M){
-    stats.MPKBr_10M = 1000.0*(double)(numMispred)/(double)(numIter);
+// Chunked simulation, run with --chunks: the trace is cut into numChunks contiguous chunks that run
+// in parallel, each on a thread of its own with a fresh predictor trained on up to `warmup` branches
+// ahead of the chunk. With verify the whole trace also runs serially on another thread and every
+// chunk gets the counts of its branches in that run. At most numThreads of them run at once.
+std::vector<ChunkResult> RunChunked(const std::string& trace_path, uint64_t numBranches, unsigned numChunks, uint64_t warmup, bool verify,
+                                    unsigned numThreads, bool pipelined, const std::string& cacheDir, const bt9::TraceIoOptions& io)
+{
+  // The last chunk runs to the end of the trace, whatever the header says
+  std::vector<uint64_t> bounds;
+  for (unsigned i = 0; i < numChunks; i++) {
+    bounds.push_back(numBranches * i / numChunks);
   }
+  bounds.push_back(UINT64_MAX);
 
-  if(numIter == d30M){
-    stats.MPKBr_30M = 1000.0*(double)(numMispred)/(double)(numIter);
+  std::vector<ChunkResult> chunks(numChunks);
+  std::vector<double> costs;
+  for (unsigned i = 0; i < numChunks; i++) {
+    chunks[i].begin = bounds[i];
+    costs.push_back((double)(std::min(bounds[i + 1], numBranches) - bounds[i] + std::min(warmup, bounds[i])));
+  }
+  if (verify) {
+    costs.push_back((double)numBranches);
   }
 
-  if(numIter == d60M){
-    stats.MPKBr_60M = 1000.0*(double)(numMispred)/(double)(numIter);
+  // Every job runs on a fresh thread of its worker, whose untrained predictor state is what every chunk starts from
+  bt9::TraceScheduler scheduler(costs, numThreads);
+  scheduler.run([&](size_t job) {
+    bt9::BT9Reader reader(trace_path, pipelined, cacheDir, io);
+    const std::unique_ptr<PREDICTOR> brpred = std::make_unique<PREDICTOR>();
+
+    if (job == numChunks) {
+      for (unsigned i = 0; i < numChunks; i++) {
+        SimulateBranches(*brpred, reader, bounds[i + 1] - bounds[i], chunks[i].serial);
+      }
+      return;
+    }
+
+    // Seek through the trace cache or the seek index opened by the caller, columnar traces are decoded forward instead
+    ChunkResult& chunk = chunks[job];
+    const uint64_t start = chunk.begin - std::min(warmup, chunk.begin);
+    if (reader.openSeekIndex()) {
+      reader.seekToBranch(start);
+    }
+    else {
+      reader.skipBranches(start);
+    }
+
+    SampleCounters warm;
+    chunk.warmupBranches = SimulateBranches(*brpred, reader, chunk.begin - start, warm);
+    chunk.end = chunk.begin + SimulateBranches(*brpred, reader, bounds[job + 1] - chunk.begin, chunk.counted);
+  });
+
+  return chunks;
+}
+
+// Chunks, their warm-up and MPKI, printed with --chunks; with --chunk-verify also the error against the serial run
+void PrintChunkReport(const std::string& trace, const std::vector<ChunkResult>& chunks, bool verified)
+{
+  auto mpki = [](const SampleCounters& counters) { return 1000.0 * counters.mispredictions / std::max<double>(counters.instructions, 1); };
+  auto error = [](double approx, double exact) { return (exact > 0.0) ? 100.0 * (approx - exact) / exact : 0.0; };
+
+  SampleCounters counted, serial;
+  uint64_t warmupBranches = 0;
+  for (const ChunkResult& chunk : chunks) {
+    if (verified) {
+      fprintf(stderr, "%s:   chunk [%llu, %llu)  warm-up %llu  MPKI %.4f  serial %.4f  error %+.2f%%\n", trace.c_str(),
+              (unsigned long long)chunk.begin, (unsigned long long)chunk.end, (unsigned long long)chunk.warmupBranches,
+              mpki(chunk.counted), mpki(chunk.serial), error(mpki(chunk.counted), mpki(chunk.serial)));
+    }
+    else {
+      fprintf(stderr, "%s:   chunk [%llu, %llu)  warm-up %llu  MPKI %.4f\n", trace.c_str(),
+              (unsigned long long)chunk.begin, (unsigned long long)chunk.end, (unsigned long long)chunk.warmupBranches, mpki(chunk.counted));
+    }
+    counted.instructions += chunk.counted.instructions;
+    counted.mispredictions += chunk.counted.mispredictions;
+    serial.instructions += chunk.serial.instructions;
+    serial.mispredictions += chunk.serial.mispredictions;
+    warmupBranches += chunk.warmupBranches;
   }
 
-  if(numIter == d100M){
-    stats.MPKBr_100M = 1000.0*(double)(numMispred)/(double)(numIter);
+  const double branches = std::max<double>(chunks.back().end, 1);
+  fprintf(stderr, "%s: %zu chunks, %.2f%% of the branches simulated again as warm-up\n", trace.c_str(),
+          chunks.size(), 100.0 * warmupBranches / branches);
+  fprintf(stderr, "%s: chunked MPKI %.4f\n", trace.c_str(), mpki(counted));
+  if (verified) {
+    fprintf(stderr, "%s: serial MPKI %.4f, error %+.4f (%+.2f%%)\n", trace.c_str(),
+            mpki(serial), mpki(counted) - mpki(serial), error(mpki(counted), mpki(serial)));
   }
+}
 
-  if(numIter == d300M){
-    stats.MPKBr_300M = 1000.0*(double)(numMispred)/(double)(numIter);
+// Check of --chunk-verify: the chunks must cover the branches of the serial run, each with the
+// same counts. Mispredictions only have to match where the warm-up reaches back to the start of
+// the trace, the chunk then starts from the same predictor state as in the serial run.
+// Returns an empty string if they do, else the first chunk that does not.
+std::string VerifyChunks(const std::vector<ChunkResult>& chunks)
+{
+  for (size_t i = 0; i < chunks.size(); i++) {
+    const ChunkResult& chunk = chunks[i];
+    const std::string name = "chunk [" + std::to_string(chunk.begin) + ", " + std::to_string(chunk.end) + ")";
+    if ((i + 1 < chunks.size()) && (chunk.end != chunks[i + 1].begin)) {
+      return name + " does not end where the next chunk begins";
+    }
+    if ((chunk.counted.instructions != chunk.serial.instructions) || (chunk.counted.condBranches != chunk.serial.condBranches) ||
+        (chunk.counted.uncondBranches != chunk.serial.uncondBranches)) {
+      return name + " has other branches than in the serial run";
+    }
+    if ((chunk.warmupBranches == chunk.begin) && (chunk.counted.mispredictions != chunk.serial.mispredictions)) {
+      return name + " is warmed up from the start of the trace, but has " + std::to_string(chunk.counted.mispredictions) +
+             " mispredictions against " + std::to_string(chunk.serial.mispredictions) + " in the serial run";
+    }
   }
+  return "";
+}
 
-  if(numIter == d600M){
-    stats.MPKBr_600M = 1000.0*(double)(numMispred)/(double)(numIter);
+// Batch mode: every trace runs on a thread of its own with a fresh predictor, scheduled longest
+// first on numThreads workers, and the stats of all traces are written as one JSON object keyed
+// by trace name, as the single trace runs merged with jq would be
+int SimulateBatch(const std::vector<std::string>& traces, unsigned numThreads, const std::string& output, bool progress,
+                  const CheckpointOptions& ckpt, const IntervalOutput& intervalOutput, bool pipelined, const std::string& cacheDir,
+                  const bt9::TraceIoOptions& io)
+{
+  for (const std::string& dir : {ckpt.path, intervalOutput.path}) {
+    if (!dir.empty()) {
+      std::error_code ec;
+      std::filesystem::create_directories(dir, ec);
+    }
   }
 
-  if(numIter == d1B){
-    stats.MPKBr_1B = 1000.0*(double)(numMispred)/(double)(numIter);
+  std::vector<stats_t> results(traces.size());
+  std::vector<char> failed(traces.size(), 0);
+  std::atomic<size_t> numDone{0};
+  std::mutex logMutex;
+
+  bt9::TraceScheduler scheduler(bt9::estimateTraceCosts(traces), numThreads);
+  scheduler.run([&](size_t i) {
+    const std::string& trace_path = traces[i];
+    try {
+      bt9::BT9Reader bt9_reader(trace_path, pipelined, cacheDir, io);
+      if (bt9_reader.loadStats().unclassified_edges != 0) {
+        throw bt9::TraceError(trace_path + ": OPTYPE_ERROR");
+      }
+
+      // The predictor state of this thread starts out untrained, see bt9::TraceScheduler
+      const std::unique_ptr<PREDICTOR> brpred = std::make_unique<PREDICTOR>();
+      if (!ckpt.warmStart.empty()) {
+        WarmStart(*brpred, ckpt.warmStart);
+      }
+
+      SampleCounters counters;
+      bt9::IntervalStats intervals(intervalOutput.options);
+      if (ckpt.path.empty()) {
+        SimulateTrace(*brpred, bt9_reader, counters, intervals);
+      }
+      else {
+        SimulateTraceCheckpointed(*brpred, bt9_reader, trace_path, ckpt, BatchTraceFile(ckpt.path, trace_path, ".ckpt"), counters, intervals);
+      }
+      FillStats(trace_path, bt9_reader, counters);
+
+      const std::string intervalsPath = intervalOutput.path.empty() ? "" : BatchTraceFile(intervalOutput.path, trace_path, ".intervals");
+      if (!intervalsPath.empty() && !intervals.write(intervalsPath)) {
+        throw bt9::TraceError(intervalsPath + ": cannot write the interval stats");
+      }
+      results[i] = stats;
+    }
+    catch (const std::exception& ex) {
+      std::lock_guard<std::mutex> lock(logMutex);
+      fprintf(stderr, "%s\n", ex.what());
+      failed[i] = 1;
+    }
+
+    if (progress) {
+      std::lock_guard<std::mutex> lock(logMutex);
+      fprintf(stderr, "[%zu/%zu] %s\n", ++numDone, traces.size(), trace_path.c_str());
+    }
+  });
+
+  std::ofstream fout;
+  if (!output.empty()) {
+    fout.open(output);
+    if (!fout) {
+      fprintf(stderr, "%s: cannot write the results\n", output.c_str());
+      return -1;
+    }
   }
 
-  if(numIter == d10B){
-    stats.MPKBr_10B = 1000.0*(double)(numMispred)/(double)(numIter);
+  size_t numFailed = 0;
+  {
+    cereal::JSONOutputArchive archive(output.empty() ? std::cout : fout);
+    for (size_t i = 0; i < traces.size(); i++) {
+      if (failed[i]) {
+        numFailed++;
+        continue;
+      }
+      archive(cereal::make_nvp(results[i].TRACE.c_str(), results[i]));
+    }
   }
 
+  if (numFailed != 0) {
+    fprintf(stderr, "%zu of %zu traces failed\n", numFailed, traces.size());
+    return -1;
+  }
+  return 0;
 }
 
-// usage: predictor <trace>
+// usage: predictor [options] <trace>
 
-int main(int argc, char* argv[]){
+int Simulate(int argc, char* argv[]){
 
-  if (argc != 2) {
-    printf("usage: %s <trace>\n", argv[0]);
+  bool printThroughput = false;
+  bool pipelined = false;
+  bool loadOnly = false;
+  bool benchDecoder = false;
+  bool sample = false;
+  bool sampleVerify = false;
+  bool batch = false;
+  bool threadsSet = false;
+  bool progress = false;
+  unsigned numThreads = std::max(std::thread::hardware_concurrency(), 1u);
+  std::string output;
+  bt9::SimPointOptions sampleOptions;
+  uint64_t sampleWarmup = SIMPOINT_WARMUP;
+  unsigned numChunks = 0;
+  uint64_t chunkWarmup = CHUNK_WARMUP;
+  bool chunkVerify = false;
+  CheckpointOptions ckpt;
+  bool checkpointVerify = false;
+  bool intervalsVerify = false;
+  IntervalOutput intervalOutput;
+  std::string cacheDir = getenv("BT9_TRACE_CACHE_DIR") ? getenv("BT9_TRACE_CACHE_DIR") : "";
+  bt9::TraceIoOptions io;
+  if (getenv("BT9_IO_CHUNK_SIZE")) {
+    io.chunk_size = strtoull(getenv("BT9_IO_CHUNK_SIZE"), nullptr, 0);
+  }
+  if (getenv("BT9_IO_DEPTH")) {
+    io.depth = std::max(atoi(getenv("BT9_IO_DEPTH")), 0);
+  }
+
+  static const struct option longOptions[] = {
+    {"pipelined",  no_argument, nullptr, 'p'},
+    {"throughput", no_argument, nullptr, 't'},
+    {"load-only",  no_argument, nullptr, 'l'},
+    {"cache-dir",  required_argument, nullptr, 'c'},
+    {"io-chunk-size", required_argument, nullptr, 'C'},
+    {"io-depth",   required_argument, nullptr, 'Q'},
+    {"bench-decoder", no_argument, nullptr, 'b'},
+    {"sample",     no_argument, nullptr, 's'},
+    {"sample-interval", required_argument, nullptr, 'I'},
+    {"sample-warmup",   required_argument, nullptr, 'W'},
+    {"sample-max-k",    required_argument, nullptr, 'K'},
+    {"sample-verify",   no_argument,       nullptr, 'v'},
+    {"chunks",     required_argument, nullptr, 'k'},
+    {"chunk-warmup",    required_argument, nullptr, 'w'},
+    {"chunk-verify",    no_argument,       nullptr, 'V'},
+    {"threads",    required_argument, nullptr, 'j'},
+    {"output",     required_argument, nullptr, 'o'},
+    {"progress",   no_argument, nullptr, 'P'},
+    {"checkpoint", required_argument, nullptr, 'X'},
+    {"checkpoint-interval", required_argument, nullptr, 'N'},
+    {"resume",     no_argument, nullptr, 'R'},
+    {"warm-start", required_argument, nullptr, 'M'},
+    {"checkpoint-verify", no_argument,   nullptr, 'U'},
+    {"intervals-verify", no_argument,    nullptr, 'Y'},
+    {"intervals",  required_argument, nullptr, 'A'},
+    {"interval-period", required_argument, nullptr, 'E'},
+    {"interval-log",    required_argument, nullptr, 'G'},
+    {"help",       no_argument, nullptr, 'h'},
+    {nullptr,      0,           nullptr,  0 }
+  };
+
+  int opt;
+  while ((opt = getopt_long(argc, argv, "ptlc:C:Q:bsI:W:K:vk:w:j:o:h", longOptions, nullptr)) != -1) {
+    switch (opt) {
+      case 'p':
+        pipelined = true;
+        break;
+      case 't':
+        printThroughput = true;
+        break;
+      case 'l':
+        loadOnly = true;
+        break;
+      case 'c':
+        cacheDir = optarg;
+        break;
+      case 'C':
+        io.chunk_size = strtoull(optarg, nullptr, 0);
+        break;
+      case 'Q':
+        io.depth = std::max(atoi(optarg), 0);
+        break;
+      case 'b':
+        benchDecoder = true;
+        break;
+      case 's':
+        sample = true;
+        break;
+      case 'I':
+        sampleOptions.interval = std::max<uint64_t>(strtoull(optarg, nullptr, 0), 1);
+        break;
+      case 'W':
+        sampleWarmup = strtoull(optarg, nullptr, 0);
+        break;
+      case 'K':
+        sampleOptions.max_k = std::max(atoi(optarg), 1);
+        break;
+      case 'v':
+        sampleVerify = true;
+        break;
+      case 'k':
+        numChunks = std::max(atoi(optarg), 1);
+        break;
+      case 'w':
+        chunkWarmup = strtoull(optarg, nullptr, 0);
+        break;
+      case 'V':
+        chunkVerify = true;
+        break;
+      case 'j':
+        numThreads = std::max(atoi(optarg), 1);
+        threadsSet = true;
+        break;
+      case 'o':
+        output = optarg;
+        batch = true;
+        break;
+      case 'P':
+        progress = true;
+        break;
+      case 'X':
+        ckpt.path = optarg;
+        break;
+      case 'N':
+        ckpt.interval = std::max<uint64_t>(strtoull(optarg, nullptr, 0), 1);
+        break;
+      case 'R':
+        ckpt.resume = true;
+        break;
+      case 'M':
+        ckpt.warmStart = optarg;
+        break;
+      case 'U':
+        checkpointVerify = true;
+        break;
+      case 'Y':
+        intervalsVerify = true;
+        break;
+      case 'A':
+        intervalOutput.path = optarg;
+        break;
+      case 'E':
+        intervalOutput.options.spacing = bt9::IntervalSpacing::FIXED;
+        intervalOutput.options.period = std::max<uint64_t>(strtoull(optarg, nullptr, 0), 1);
+        break;
+      case 'G':
+        intervalOutput.options.spacing = bt9::IntervalSpacing::LOG;
+        intervalOutput.options.per_decade = std::max(atoi(optarg), 1);
+        break;
+      default:
+        PrintUsage(argv[0]);
+        exit(-1);
+    }
+  }
+
+  if (optind == argc) {
+    PrintUsage(argv[0]);
+    exit(-1);
+  }
+
+  if (ckpt.resume && ckpt.path.empty()) {
+    fprintf(stderr, "--resume needs --checkpoint\n");
     exit(-1);
   }
 
+  if (intervalOutput.path.empty() && ((intervalOutput.options.spacing != bt9::IntervalSpacing::NONE) || intervalsVerify)) {
+    fprintf(stderr, "--interval-period, --interval-log and --intervals-verify need --intervals\n");
+    exit(-1);
+  }
+  if (!intervalOutput.path.empty() && (intervalOutput.options.spacing == bt9::IntervalSpacing::NONE)) {
+    intervalOutput.options.spacing = bt9::IntervalSpacing::FIXED;
+  }
+
+  // -j only sets the number of workers of a chunked run
+  if (threadsSet && (numChunks == 0)) {
+    batch = true;
+  }
+
+  if (batch || (optind != argc - 1) || std::filesystem::is_directory(argv[optind])) {
+    if (loadOnly || benchDecoder || sample || (numChunks > 0) || printThroughput || checkpointVerify || intervalsVerify) {
+      fprintf(stderr, "-t, -l, -b, -s, -k, --checkpoint-verify and --intervals-verify take a single trace\n");
+      exit(-1);
+    }
+
+    std::vector<std::string> traces;
+    for (int arg = optind; arg < argc; arg++) {
+      if (std::filesystem::is_directory(argv[arg])) {
+        const std::vector<std::string> dirTraces = bt9::listTraces(argv[arg]);
+        traces.insert(traces.end(), dirTraces.begin(), dirTraces.end());
+      }
+      else {
+        traces.push_back(argv[arg]);
+      }
+    }
+    return SimulateBatch(traces, numThreads, output, progress, ckpt, intervalOutput, pipelined, cacheDir, io);
+  }
+
+  if (sample && (numChunks > 0)) {
+    fprintf(stderr, "-s and -k cannot be combined\n");
+    exit(-1);
+  }
+
+  if ((sample || (numChunks > 0)) && (!ckpt.path.empty() || !ckpt.warmStart.empty() || checkpointVerify)) {
+    fprintf(stderr, "-s and -k cannot be combined with checkpoints\n");
+    exit(-1);
+  }
+
+  if ((sample || (numChunks > 0)) && !intervalOutput.path.empty()) {
+    fprintf(stderr, "-s and -k cannot be combined with --intervals\n");
+    exit(-1);
+  }
+
+  if (benchDecoder) {
+    BenchDecoder(argv[optind]);
+    return 0;
+  }
+
   ///////////////////////////////////////////////
   // Init variables
   ///////////////////////////////////////////////
 
     PREDICTOR  brpred = PREDICTOR();  // this instantiates the predictor code
+    if (!ckpt.warmStart.empty()) {
+      WarmStart(brpred, ckpt.warmStart);
+    }
+
+    // --sample-verify: the full run starts from the same untrained predictor in a child
+    // process, next to the sampled run, and sends back its MPKI
+    int verifyPipe[2] = {-1, -1};
+    pid_t verifyChild = -1;
+    if (sample && sampleVerify) {
+      if ((pipe(verifyPipe) != 0) || ((verifyChild = fork()) < 0)) {
+        fprintf(stderr, "Failed to start the full run for --sample-verify\n");
+        exit(-1);
+      }
+      if (verifyChild == 0) {
+        sample = false;
+        close(verifyPipe[0]);
+      }
+      else {
+        close(verifyPipe[1]);
+      }
+    }
   ///////////////////////////////////////////////
   // read each trace recrod, simulate until done
   ///////////////////////////////////////////////
 
+    const auto startTime = std::chrono::steady_clock::now();
+
     std::string trace_path;
-    trace_path = argv[1];
-    bt9::BT9Reader bt9_reader(trace_path);
-
-    std::string key = "total_instruction_count:";
-    std::string value;
-    bt9_reader.header.getFieldValueStr(key, value);
-    uint64_t     total_instruction_counter = std::stoull(value, nullptr, 0);
-    uint64_t current_instruction_counter = 0;
-    key = "branch_instruction_count:";
-    bt9_reader.header.getFieldValueStr(key, value);
-    uint64_t     branch_instruction_counter = std::stoull(value, nullptr, 0);
-    uint64_t     numMispred =0;
+    trace_path = argv[optind];
+    bt9::BT9Reader bt9_reader(trace_path, pipelined, cacheDir, io);
+
+    // Branches without a valid OpType are found when the tables are loaded, so the loops below
+    // only have to skip the fake branch of node 0 (the first node in the graph)
+    if (bt9_reader.loadStats().unclassified_edges != 0) {
+      fprintf(stderr, "OPTYPE_ERROR\n");
+      printf("OPTYPE_ERROR\n");
+      exit(-1); //this should never happen, if it does please email CBP org chair.
+    }
+
+    if (loadOnly) {
+      PrintLoadTime(trace_path, bt9_reader.loadStats());
+      return 0;
+    }
+
+    const uint64_t total_instruction_counter = HeaderCount(bt9_reader, "total_instruction_count:");
 //ver2    uint64_t     numMispred_btbMISS =0;
 //ver2    uint64_t     numMispred_btbANSF =0;
 //ver2    uint64_t     numMispred_btbATSF =0;
 //ver2    uint64_t     numMispred_btbDYN =0;
 
-    uint64_t cond_branch_instruction_counter=0;
 //ver2     uint64_t btb_ansf_cond_branch_instruction_counter=0;
 //ver2     uint64_t btb_atsf_cond_branch_instruction_counter=0;
 //ver2     uint64_t btb_dyn_cond_branch_instruction_counter=0;
 //ver2     uint64_t btb_miss_cond_branch_instruction_counter=0;
-           uint64_t uncond_branch_instruction_counter=0;
 
 //ver2    ///////////////////////////////////////////////
 //ver2    // model simple branch marking structure
@@ -137,222 +1060,107 @@ int main(int argc, char* argv[]){
   // read each trace record, simulate until done
   ///////////////////////////////////////////////
 
-      OpType opType;
-      uint64_t PC;
-      bool branchTaken;
-      uint64_t branchTarget;
-
       uint64_t numIter = 0;
-      uint64_t CheckHeartBeat_numIter = 0;
-      const uint64_t CheckHeartBeat_interval = 1000;
-
+      SampleCounters counters;
+      bt9::IntervalStats intervals(intervalOutput.options);
 
-      for (auto it = bt9_reader.begin(); it != bt9_reader.end(); ++it) {
-        numIter++;
-        CheckHeartBeat_numIter++;
-        if(CheckHeartBeat_numIter == CheckHeartBeat_interval){
-          CheckHeartBeat(numIter, numMispred); //Here numIter will be equal to number of branches read
-          CheckHeartBeat_numIter = 0;
+      if (sample) {
+        bt9::SimPointSet simpoints;
+        if (!simpoints.open(bt9_reader, sampleOptions)) {
+          fprintf(stderr, "%s: no branches to sample\n", trace_path.c_str());
+          exit(-1);
         }
 
-        try {
-          bt9::BrClass_BrBehavior BrClass_BrBehavior = it->getSrcNode()->brClass_brBehavior();
-
-//          bool dirDynamic = (it->getSrcNode()->brObservedTakenCnt() > 0) && (it->getSrcNode()->brObservedNotTakenCnt() > 0); //JD2_2_2016
-//          bool dirNeverTkn = (it->getSrcNode()->brObservedTakenCnt() == 0) && (it->getSrcNode()->brObservedNotTakenCnt() > 0); //JD2_2_2016
-
-//JD2_2_2016 break down branch instructions into all possible types
-          opType = OPTYPE_ERROR;
-
-          if ((BrClass_BrBehavior.type == bt9::BrClass::Type::UNKNOWN) && (it->getSrcNode()->brNodeIndex())) { //only fault if it isn't the first node in the graph (fake branch)
-            opType = OPTYPE_ERROR; //sanity check
-          }
-//NOTE unconditional could be part of an IT block that is resolved not-taken
-//          else if (dirNeverTkn && (br_class.conditionality == bt9::BrClass::Conditionality::UNCONDITIONAL)) {
-//            opType = OPTYPE_ERROR; //sanity check
-//          }
-//JD_2_22 There is a bug in the instruction decoder used to generate the traces
-//          else if (dirDynamic && (br_class.conditionality == bt9::BrClass::Conditionality::UNCONDITIONAL)) {
-//            opType = OPTYPE_ERROR; //sanity check
-//          }
-          else if (BrClass_BrBehavior.type == bt9::BrClass::Type::RET) {
-            if (BrClass_BrBehavior.conditionality == bt9::BrClass::Conditionality::CONDITIONAL)
-              opType = OPTYPE_RET_COND;
-            else if (BrClass_BrBehavior.conditionality == bt9::BrClass::Conditionality::UNCONDITIONAL)
-              opType = OPTYPE_RET_UNCOND;
-            else {
-              opType = OPTYPE_ERROR;
-            }
-          }
-          else if (BrClass_BrBehavior.directness == bt9::BrClass::Directness::INDIRECT) {
-            if (BrClass_BrBehavior.type == bt9::BrClass::Type::CALL) {
-              if (BrClass_BrBehavior.conditionality == bt9::BrClass::Conditionality::CONDITIONAL)
-                opType = OPTYPE_CALL_INDIRECT_COND;
-              else if (BrClass_BrBehavior.conditionality == bt9::BrClass::Conditionality::UNCONDITIONAL)
-                opType = OPTYPE_CALL_INDIRECT_UNCOND;
-              else {
-                opType = OPTYPE_ERROR;
-              }
-            }
-            else if (BrClass_BrBehavior.type == bt9::BrClass::Type::JMP) {
-              if (BrClass_BrBehavior.conditionality == bt9::BrClass::Conditionality::CONDITIONAL)
-                opType = OPTYPE_JMP_INDIRECT_COND;
-              else if (BrClass_BrBehavior.conditionality == bt9::BrClass::Conditionality::UNCONDITIONAL)
-                opType = OPTYPE_JMP_INDIRECT_UNCOND;
-              else {
-                opType = OPTYPE_ERROR;
-              }
-            }
-            else {
-              opType = OPTYPE_ERROR;
-            }
-          }
-          else if (BrClass_BrBehavior.directness == bt9::BrClass::Directness::DIRECT) {
-            if (BrClass_BrBehavior.type == bt9::BrClass::Type::CALL) {
-              if (BrClass_BrBehavior.conditionality == bt9::BrClass::Conditionality::CONDITIONAL) {
-                opType = OPTYPE_CALL_DIRECT_COND;
-              }
-              else if (BrClass_BrBehavior.conditionality == bt9::BrClass::Conditionality::UNCONDITIONAL) {
-                opType = OPTYPE_CALL_DIRECT_UNCOND;
-              }
-              else {
-                opType = OPTYPE_ERROR;
-              }
-            }
-            else if (BrClass_BrBehavior.type == bt9::BrClass::Type::JMP) {
-              if (BrClass_BrBehavior.conditionality == bt9::BrClass::Conditionality::CONDITIONAL) {
-                opType = OPTYPE_JMP_DIRECT_COND;
-              }
-              else if (BrClass_BrBehavior.conditionality == bt9::BrClass::Conditionality::UNCONDITIONAL) {
-                opType = OPTYPE_JMP_DIRECT_UNCOND;
-              }
-              else {
-                opType = OPTYPE_ERROR;
-              }
-            }
-            else {
-              opType = OPTYPE_ERROR;
-            }
-          }
-          else {
-            opType = OPTYPE_ERROR;
-          }
-
-
-          PC = it->getSrcNode()->brVirtualAddr();
-
-          branchTaken = it->getEdge()->isTakenPath();
-          branchTarget = it->getEdge()->brVirtualTarget();
-
-          //printf("PC: %llx type: %x T %d N %d outcome: %d", PC, (uint32_t)opType, it->getSrcNode()->brObservedTakenCnt(), it->getSrcNode()->brObservedNotTakenCnt(), branchTaken);
+        const SampleEstimate est = RunSampled(brpred, bt9_reader, simpoints, sampleWarmup);
+        numIter = est.simulatedBranches + est.warmupBranches;
+        counters.mispredictions = llround(est.mpki * total_instruction_counter / 1000.0);
+        counters.condBranches = llround(est.condPerInst * total_instruction_counter);
+        counters.uncondBranches = llround(est.uncondPerInst * total_instruction_counter);
 
-/************************************************************************************************************/
-
-          if (opType == OPTYPE_ERROR) {
-            if (it->getSrcNode()->brNodeIndex()) { //only fault if it isn't the first node in the graph (fake branch)
-              fprintf(stderr, "OPTYPE_ERROR\n");
-              printf("OPTYPE_ERROR\n");
-              exit(-1); //this should never happen, if it does please email CBP org chair.
-            }
-          }
-          else if (BrClass_BrBehavior.conditionality == bt9::BrClass::Conditionality::CONDITIONAL) { //JD2_17_2016 call UpdatePredictor() for all branches that decode as conditional
-            //printf("COND ");
-
-//NOTE: contestants are NOT allowed to use the btb* information from ver2 of the infrastructure below:
-//ver2             myBtbIterator = myBtb.find(PC); //check BTB for a hit
-//ver2            bool btbATSF = false;
-//ver2            bool btbANSF = false;
-//ver2            bool btbDYN = false;
-//ver2
-//ver2            if (myBtbIterator == myBtb.end()) { //miss -> we have no history for the branch in the marking structure
-//ver2              //printf("BTB miss ");
-//ver2              myBtb.insert(pair<uint64_t, uint32_t>(PC, (uint32_t)branchTaken)); //on a miss insert with outcome (N->btbANSF, T->btbATSF)
-//ver2              predDir = brpred->GetPrediction(PC, btbANSF, btbATSF, btbDYN);
-//ver2              brpred->UpdatePredictor(PC, opType, branchTaken, predDir, branchTarget, btbANSF, btbATSF, btbDYN);
-//ver2            }
-//ver2            else {
-//ver2              btbANSF = (myBtbIterator->second == 0);
-//ver2              btbATSF = (myBtbIterator->second == 1);
-//ver2              btbDYN = (myBtbIterator->second == 2);
-//ver2              //printf("BTB hit ANSF: %d ATSF: %d DYN: %d ", btbANSF, btbATSF, btbDYN);
-//ver2
-//ver2              predDir = brpred->GetPrediction(PC, btbANSF, btbATSF, btbDYN);
-//ver2              brpred->UpdatePredictor(PC, opType, branchTaken, predDir, branchTarget, btbANSF, btbATSF, btbDYN);
-//ver2
-//ver2              if (  (btbANSF && branchTaken)   // only exhibited N until now and we just got a T -> upgrade to dynamic conditional
-//ver2                 || (btbATSF && !branchTaken)  // only exhibited T until now and we just got a N -> upgrade to dynamic conditional
-//ver2                 ) {
-//ver2                myBtbIterator->second = 2; //2-> dynamic conditional (has exhibited both taken and not-taken in the past)
-//ver2              }
-//ver2            }
-//ver2            //puts("");
-
-            bool predDir = false;
-
-            predDir = brpred.GetPrediction(PC);
-            brpred.UpdatePredictor(PC, opType, branchTaken, predDir, branchTarget);
-
-            if(predDir != branchTaken){
-              numMispred++; // update mispred stats
-//ver2              if(btbATSF)
-//ver2                numMispred_btbATSF++; // update mispred stats
-//ver2              else if(btbANSF)
-//ver2                numMispred_btbANSF++; // update mispred stats
-//ver2              else if(btbDYN)
-//ver2                numMispred_btbDYN++; // update mispred stats
-//ver2              else
-//ver2                numMispred_btbMISS++; // update mispred stats
-            }
-            cond_branch_instruction_counter++;
-
-//ver2            if (btbDYN)
-//ver2              btb_dyn_cond_branch_instruction_counter++; //number of branches that have been N at least once after being T at least once
-//ver2            else if (btbATSF)
-//ver2              btb_atsf_cond_branch_instruction_counter++; //number of branches that have been T at least once, but have not yet seen a N after the first T
-//ver2            else if (btbANSF)
-//ver2              btb_ansf_cond_branch_instruction_counter++; //number of cond branches that have not yet been observed T
-//ver2            else
-//ver2              btb_miss_cond_branch_instruction_counter++; //number of cond branches that have not yet been observed T
-          }
-          else if (BrClass_BrBehavior.conditionality == bt9::BrClass::Conditionality::UNCONDITIONAL) { // for predictors that want to track unconditional branches
-            uncond_branch_instruction_counter++;
-            brpred.TrackOtherInst(PC, opType, branchTaken, branchTarget);
-          }
-          else {
-            fprintf(stderr, "CONDITIONALITY ERROR\n");
-            printf("CONDITIONALITY ERROR\n");
-            exit(-1); //this should never happen, if it does please email CBP org chair.
+        double fullMpki = -1.0;
+        if (verifyChild > 0) {
+          int status = 0;
+          const bool ok = (read(verifyPipe[0], &fullMpki, sizeof(fullMpki)) == sizeof(fullMpki));
+          waitpid(verifyChild, &status, 0);
+          if (!ok || !WIFEXITED(status) || (WEXITSTATUS(status) != 0)) {
+            fprintf(stderr, "%s: the full run for --sample-verify failed\n", trace_path.c_str());
+            exit(-1);
           }
+        }
+        PrintSampleReport(trace_path, simpoints, est, fullMpki);
+      }
+      else if (numChunks > 0) {
+        // Builds the seek index once, for the readers of all chunks to load
+        bt9_reader.openSeekIndex();
 
-/************************************************************************************************************/
+        const std::vector<ChunkResult> chunks = RunChunked(trace_path, HeaderCount(bt9_reader, "branch_instruction_count:"), numChunks,
+                                                           chunkWarmup, chunkVerify, numThreads, pipelined, cacheDir, io);
+        for (const ChunkResult& chunk : chunks) {
+          numIter += chunk.end - chunk.begin + chunk.warmupBranches;
+          counters.mispredictions += chunk.counted.mispredictions;
+          counters.condBranches += chunk.counted.condBranches;
+          counters.uncondBranches += chunk.counted.uncondBranches;
         }
-        catch (const std::out_of_range & ex) {
-          std::cout << ex.what() << '\n';
-          break;
+        PrintChunkReport(trace_path, chunks, chunkVerify);
+        if (chunkVerify) {
+          const std::string error = VerifyChunks(chunks);
+          if (!error.empty()) {
+            fprintf(stderr, "%s: --chunk-verify: %s\n", trace_path.c_str(), error.c_str());
+            exit(-1);
+          }
         }
+      }
+      else if (!ckpt.path.empty()) {
+        numIter = SimulateTraceCheckpointed(brpred, bt9_reader, trace_path, ckpt, ckpt.path, counters, intervals);
+      }
+      else {
+        numIter = SimulateTrace(brpred, bt9_reader, counters, intervals);
+      }
 
-      } //for (auto it = bt9_reader.begin(); it != bt9_reader.end(); ++it)
+      if (!intervalOutput.path.empty() && !intervals.write(intervalOutput.path)) {
+        fprintf(stderr, "%s: cannot write the interval stats\n", intervalOutput.path.c_str());
+        exit(-1);
+      }
+      if (intervalsVerify) {
+        const std::string error = VerifyIntervals(intervalOutput.path, intervals, numIter, counters);
+        if (!error.empty()) {
+          fprintf(stderr, "%s: --intervals-verify: %s\n", intervalOutput.path.c_str(), error.c_str());
+          exit(-1);
+        }
+        fprintf(stderr, "%s: %zu intervals read back, they add up to the run\n", intervalOutput.path.c_str(), intervals.numIntervals());
+      }
 
+    if (printThroughput) {
+      const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+      PrintLoadTime(trace_path, bt9_reader.loadStats());
+      PrintThroughput(trace_path, bt9_reader.streamStats(), numIter, seconds);
+    }
 
     ///////////////////////////////////////////
     //print_stats
     ///////////////////////////////////////////
 
-    std::string filename = trace_path.substr(trace_path.find_last_of("/\\") + 1);
+    FillStats(trace_path, bt9_reader, counters);
 
-    std::string::size_type const first_dot = filename.find_first_of('.');
-    std::string filename_without_extension = filename.substr(0, first_dot);
+    if (checkpointVerify) {
+      const std::string error = VerifyResume(trace_path, RunState(brpred, intervals), ckpt, intervalOutput, pipelined, cacheDir, io);
+      if (!error.empty()) {
+        fprintf(stderr, "%s: --checkpoint-verify: %s\n", trace_path.c_str(), error.c_str());
+        exit(-1);
+      }
+      fprintf(stderr, "%s: a run resumed from a checkpoint halfway ends in the same state\n", trace_path.c_str());
+    }
 
-    stats.NUM_INSTRUCTIONS = total_instruction_counter;
-    stats.NUM_BR = branch_instruction_counter-1; //JD2_2_2016 NOTE there is a dummy branch at the beginning of the trace...
-    stats.NUM_UNCOND_BR = uncond_branch_instruction_counter;
-    stats.NUM_CONDITIONAL_BR = cond_branch_instruction_counter;
-    stats.NUM_MISPREDICTIONS = numMispred;
-    stats.MISPRED_PER_1K_INST = 1000.0*(double)(numMispred)/(double)(total_instruction_counter);
-    stats.TRACE = filename_without_extension;
+    // Full run of --sample-verify: hand the MPKI to the sampled run instead of printing it
+    if (verifyChild == 0) {
+      const bool sent = (write(verifyPipe[1], &stats.MISPRED_PER_1K_INST, sizeof(stats.MISPRED_PER_1K_INST)) == sizeof(stats.MISPRED_PER_1K_INST));
+      _exit(sent ? 0 : -1);
+    }
 
     cereal::JSONOutputArchive archive(std::cout);
-    archive(cereal::make_nvp(filename_without_extension.c_str(), stats));
+    archive(cereal::make_nvp(stats.TRACE.c_str(), stats));
+
+    return 0;
 
  /*
         uint64_t bimodalUsed, bimodalCorrect;
@@ -380,3 +1188,14 @@ int main(int argc, char* argv[]){
 //ver2      printf("  MISPRED_PER_1K_INST_BTB_DYN \t : %10.4f",   1000.0*(double)(numMispred_btbDYN)/(double)(total_instruction_counter));
 }
 
+int main(int argc, char* argv[])
+{
+  // The reader throws on unreadable or malformed traces instead of exiting
+  try {
+    return Simulate(argc, argv);
+  }
+  catch (const bt9::TraceError& ex) {
+    fprintf(stderr, "%s\n", ex.what());
+    exit(-1);
+  }
+}
@@ -0,0 +1,270 @@
+/*!
+ * \file    readahead_file.h
+ * \brief   Trace file input with large reads issued ahead of the decoder on a background thread.
+ */
+
+#pragma once
+
+#include "bt9_reader_defines.h"
+#include "spsc_ring.h"
+#include "trace_error.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <memory>
+#include <span>
+#include <string>
+#include <thread>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace bt9 {
+
+    /*!
+     * \struct TraceIoOptions
+     * \brief How a trace file is read, see ReadAheadFile
+     */
+    struct TraceIoOptions {
+        /// Bytes per read, rounded up to TRACE_IO_ALIGNMENT
+        size_t chunk_size = TRACE_IO_CHUNK_SIZE;
+
+        /// Chunks read ahead of the decoder, 0 to read synchronously on the calling thread
+        unsigned depth = TRACE_IO_DEPTH;
+    };
+
+    /*!
+     * \class ReadAheadFile
+     * \brief Sequential file reader handing out whole chunks filled by a read-ahead thread
+     *
+     * A background thread pread()s the file in large aligned chunks into a ring of depth
+     * buffers, so reading from slow or network-mounted storage overlaps with decompression
+     * and parsing instead of stalling it one small fread() at a time. The kernel is told the
+     * file is read sequentially, and the range the ring will read next is prefetched with
+     * POSIX_FADV_WILLNEED.
+     *
+     * Time the consumer spends blocked on a chunk that is not read yet is counted as I/O wait.
+     */
+    class ReadAheadFile
+    {
+    public:
+        /*!
+         * \brief Constructor
+         * \param name File name
+         * \param io Chunk size and read-ahead depth
+         * \throw TraceError if the file cannot be opened
+         */
+        ReadAheadFile(const std::string & name, const TraceIoOptions & io = TraceIoOptions()) :
+            name_(name),
+            chunk_size_(roundUp_(std::max<size_t>(io.chunk_size, 1))),
+            depth_(io.depth)
+        {
+            fd_ = ::open(name.c_str(), O_RDONLY | O_CLOEXEC);
+            if (fd_ < 0) {
+                throw TraceError("Failed to open trace file \'" + name + "\'");
+            }
+            posix_fadvise(fd_, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+            // One buffer per ring slot, or a single one for synchronous reads
+            const size_t num_buffers = std::max(depth_, 1u);
+            buffers_.reset(static_cast<char *>(std::aligned_alloc(TRACE_IO_ALIGNMENT, num_buffers * chunk_size_)));
+            if (!buffers_) {
+                ::close(fd_);
+                throw TraceError("Failed to allocate read buffers for \'" + name + "\'");
+            }
+
+            seek(0);
+        }
+
+        ReadAheadFile() = delete;
+        ReadAheadFile(const ReadAheadFile &) = delete;
+        ReadAheadFile & operator=(const ReadAheadFile &) = delete;
+
+        ~ReadAheadFile()
+        {
+            stop_();
+            ::close(fd_);
+        }
+
+        /*!
+         * \brief Get the next chunk of the file, giving the previous one back to the read-ahead thread
+         * \return Returns an empty span at the end of the file. The span stays valid until the
+         *         next call of next() or seek().
+         * \throw TraceError if the file cannot be read
+         */
+        std::span<const char> next()
+        {
+            const auto start = std::chrono::steady_clock::now();
+
+            if (depth_ == 0) {
+                const size_t size = readChunk_(buffers_.get(), offset_);
+                offset_ += size;
+                io_wait_seconds_ += secondsSince_(start);
+                read_seconds_ += secondsSince_(start);
+                return { buffers_.get(), size };
+            }
+
+            // The read-ahead thread has stopped after the last chunk
+            if (end_) {
+                return {};
+            }
+
+            // Nothing is read before the first call, traces served from a cache never are
+            if (!read_thread_.joinable()) {
+                ring_ = std::make_unique<SpscRing<Chunk>>(depth_, Chunk());
+                holding_chunk_ = false;
+                read_thread_ = std::thread(&ReadAheadFile::readThread_, this, offset_);
+            }
+
+            if (holding_chunk_) {
+                ring_->releaseRead();
+            }
+
+            const Chunk & chunk = ring_->acquireRead();
+            holding_chunk_ = true;
+            io_wait_seconds_ += secondsSince_(start);
+            read_seconds_ += chunk.read_seconds;
+            end_ = (chunk.size < chunk_size_) || chunk.error;
+
+            if (chunk.error) {
+                std::rethrow_exception(chunk.error);
+            }
+
+            return { chunk.data, chunk.size };
+        }
+
+        /*!
+         * \brief Continue reading at a file offset
+         * \note Chunks read ahead from the old position are dropped
+         */
+        void seek(uint64_t offset)
+        {
+            stop_();
+            offset_ = offset;
+            end_ = false;
+        }
+
+        /// Time spent waiting for chunks not read yet, in seconds
+        double ioWaitSeconds() const { return io_wait_seconds_; }
+
+        /// Time the chunks handed out so far took to read, in seconds, overlapped with decoding unless depth is 0
+        double readSeconds() const { return read_seconds_; }
+
+    private:
+        /*!
+         * \struct Chunk
+         * \brief Ring slot describing one read chunk; the data lives in the buffer of the slot
+         */
+        struct Chunk {
+            const char * data = nullptr;
+            size_t size = 0;                //!< Less than the chunk size only at the end of the file
+            double read_seconds = 0.0;
+            std::exception_ptr error;       //!< Read failure, rethrown by next()
+        };
+
+        /// Stop the read-ahead thread, if running
+        void stop_()
+        {
+            if (read_thread_.joinable()) {
+                ring_->cancel();
+                read_thread_.join();
+            }
+        }
+
+        /*!
+         * \brief Body of the read-ahead thread
+         * \note The n-th chunk is read into buffer n % depth, which is the buffer of its ring slot.
+         *       Stops after the first short chunk, an error, or when the ring is cancelled.
+         */
+        void readThread_(uint64_t offset)
+        {
+            for (uint64_t n = 0; ; n++) {
+                Chunk * chunk = ring_->acquireWrite();
+                if (chunk == nullptr) {
+                    return;
+                }
+
+                // The kernel can fetch the rest of the window while this chunk is read
+                posix_fadvise(fd_, offset + chunk_size_, depth_ * chunk_size_, POSIX_FADV_WILLNEED);
+
+                char * data = buffers_.get() + (n % depth_) * chunk_size_;
+                const auto start = std::chrono::steady_clock::now();
+                try {
+                    *chunk = { data, readChunk_(data, offset), 0.0, nullptr };
+                }
+                catch (...) {
+                    *chunk = { data, 0, 0.0, std::current_exception() };
+                }
+                chunk->read_seconds = secondsSince_(start);
+                offset += chunk->size;
+
+                const bool last = (chunk->size < chunk_size_) || chunk->error;
+                ring_->publishWrite();
+                if (last) {
+                    return;
+                }
+            }
+        }
+
+        /// Fill a buffer from a file offset, short only at the end of the file
+        size_t readChunk_(char * data, uint64_t offset) const
+        {
+            size_t size = 0;
+            while (size < chunk_size_) {
+                const ssize_t read = ::pread(fd_, data + size, chunk_size_ - size, static_cast<off_t>(offset + size));
+                if (read < 0) {
+                    if (errno == EINTR) {
+                        continue;
+                    }
+                    throw TraceError("\'" + name_ + "\' read error: " + strerror(errno));
+                }
+                if (read == 0) {
+                    break;
+                }
+                size += static_cast<size_t>(read);
+            }
+
+            return size;
+        }
+
+        static size_t roundUp_(size_t size)
+        {
+            return (size + TRACE_IO_ALIGNMENT - 1) / TRACE_IO_ALIGNMENT * TRACE_IO_ALIGNMENT;
+        }
+
+        static double secondsSince_(std::chrono::steady_clock::time_point start)
+        {
+            return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        }
+
+        /// File name, for error messages
+        std::string name_;
+
+        int fd_ = -1;
+        size_t chunk_size_;
+        unsigned depth_;
+
+        /// Chunk buffers, depth of them back to back (one when reading synchronously)
+        std::unique_ptr<char[], decltype(&std::free)> buffers_{nullptr, &std::free};
+
+        /// File offset of the next synchronous read, or where the read-ahead thread starts
+        uint64_t offset_ = 0;
+
+        std::unique_ptr<SpscRing<Chunk>> ring_;
+        std::thread read_thread_;
+
+        /// The consumer holds the last chunk returned by next() until the next call
+        bool holding_chunk_ = false;
+
+        /// The last chunk has been handed out
+        bool end_ = false;
+
+        double io_wait_seconds_ = 0.0;
+        double read_seconds_ = 0.0;
+    };
+
+}
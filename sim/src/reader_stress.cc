@@ -0,0 +1,186 @@
+/*!
+ * \file    reader_stress.cc
+ * \brief   Decodes several traces concurrently and checks every reader against a single-reader decode.
+ *
+ * usage: reader_stress [options] <trace>...
+ *
+ * Each trace is first decoded alone by an inline reader, keeping its edge id sequence and the
+ * branch record of every edge as the reference. Then, for a number of rounds, inline and
+ * pipelined readers of all the traces run at once, one per thread, each with its own block size,
+ * and every branch record they produce is compared with the reference. Each reader finally seeks
+ * back into the middle of its trace and checks the rest of the sequence again.
+ *
+ * A reader that shares decoder state with another instance (see BT9Reader) shows up here as a
+ * branch record that differs from the reference. task stress_reader runs it on synthetic traces
+ * from trace_generate, plus the traces given after --.
+ */
+
+#include <atomic>
+#include <span>
+#include <thread>
+#include <vector>
+
+#include <getopt.h>
+
+#include "bt9_reader.h"
+
+void PrintUsage(const char* prog)
+{
+  printf("usage: %s [options] <trace>...\n", prog);
+  printf("  -r, --rounds N    rounds of concurrent decodes (default: 3)\n");
+  printf("  -j, --readers N   readers per trace and mode in each round (default: 2)\n");
+}
+
+// Single-reader decode of a trace
+struct ReferenceDecode {
+  std::string trace;
+  std::vector<uint32_t> edgeIds;        //!< Edge id of every branch
+  std::vector<bt9::BT9HotEdge> records; //!< Branch record of every edge id
+};
+
+bool SameRecord(const bt9::BT9HotEdge& a, const bt9::BT9HotEdge& b)
+{
+  return (a.pc == b.pc) && (a.target == b.target) && (a.inst_cnt == b.inst_cnt) && (a.edge_id == b.edge_id) &&
+         (a.src_node_id == b.src_node_id) && (a.op_type == b.op_type) && (a.conditional == b.conditional) &&
+         (a.taken == b.taken);
+}
+
+ReferenceDecode DecodeReference(const std::string& trace)
+{
+  ReferenceDecode ref;
+  ref.trace = trace;
+
+  bt9::BT9Reader reader(trace);
+  ref.records.resize(reader.loadStats().num_edges);
+
+  std::vector<bt9::BT9HotEdge> block(BRANCH_BLOCK_SIZE);
+  while (const uint64_t blockSize = reader.readBranchBlock(block)) {
+    for (const bt9::BT9HotEdge& br : std::span(block).first(blockSize)) {
+      ref.edgeIds.push_back(br.edge_id);
+      ref.records[br.edge_id] = br;
+    }
+  }
+
+  return ref;
+}
+
+/*!
+ * \brief Compare the branches read from `first` on with the reference
+ * \return Returns an empty string if they are the same, else what differs
+ */
+std::string CompareBranches(bt9::BT9Reader& reader, const ReferenceDecode& ref, uint64_t first, uint64_t blockSize)
+{
+  std::vector<bt9::BT9HotEdge> block(blockSize);
+  uint64_t branch = first;
+  while (const uint64_t n = reader.readBranchBlock(block)) {
+    for (const bt9::BT9HotEdge& br : std::span(block).first(n)) {
+      if ((branch >= ref.edgeIds.size()) || (br.edge_id != ref.edgeIds[branch]) || !SameRecord(br, ref.records[br.edge_id])) {
+        return "branch " + std::to_string(branch) + " differs";
+      }
+      branch++;
+    }
+  }
+
+  if (branch != ref.edgeIds.size()) {
+    return "ends after " + std::to_string(branch) + " of " + std::to_string(ref.edgeIds.size()) + " branches";
+  }
+  return "";
+}
+
+// Read a whole trace, then its second half after a seek
+std::string StressReader(const ReferenceDecode& ref, bool pipelined, uint64_t blockSize)
+{
+  try {
+    bt9::BT9Reader reader(ref.trace, pipelined);
+    std::string error = CompareBranches(reader, ref, 0, blockSize);
+    if (!error.empty()) {
+      return error;
+    }
+
+    const uint64_t middle = ref.edgeIds.size() / 2;
+    if (!reader.seekToBranch(middle)) {
+      return "cannot seek to branch " + std::to_string(middle);
+    }
+    error = CompareBranches(reader, ref, middle, blockSize);
+    return error.empty() ? "" : "after seek, " + error;
+  }
+  catch (const bt9::TraceError& ex) {
+    return ex.what();
+  }
+}
+
+int main(int argc, char* argv[])
+{
+  int rounds = 3;
+  int readers = 2;
+
+  static const struct option longOptions[] = {
+    {"rounds",  required_argument, nullptr, 'r'},
+    {"readers", required_argument, nullptr, 'j'},
+    {"help",    no_argument,       nullptr, 'h'},
+    {nullptr,   0,                 nullptr,  0 }
+  };
+
+  int opt;
+  while ((opt = getopt_long(argc, argv, "r:j:h", longOptions, nullptr)) != -1) {
+    switch (opt) {
+      case 'r':
+        rounds = std::max(1, atoi(optarg));
+        break;
+      case 'j':
+        readers = std::max(1, atoi(optarg));
+        break;
+      default:
+        PrintUsage(argv[0]);
+        exit(-1);
+    }
+  }
+
+  if (optind == argc) {
+    PrintUsage(argv[0]);
+    exit(-1);
+  }
+
+  std::vector<ReferenceDecode> refs;
+  for (int i = optind; i < argc; i++) {
+    try {
+      refs.push_back(DecodeReference(argv[i]));
+    }
+    catch (const bt9::TraceError& ex) {
+      fprintf(stderr, "%s\n", ex.what());
+      exit(-1);
+    }
+  }
+
+  std::atomic<int> failed = 0;
+  for (int round = 0; round < rounds; round++) {
+    std::vector<std::thread> threads;
+    uint64_t blockSize = 1;
+    for (const ReferenceDecode& ref : refs) {
+      for (const bool pipelined : {false, true}) {
+        for (int r = 0; r < readers; r++) {
+          // Block sizes spread over 1..BRANCH_BLOCK_SIZE, so that block ends fall everywhere in the access window
+          blockSize = (blockSize * 7 + 2 * round + 1) % BRANCH_BLOCK_SIZE + 1;
+          threads.emplace_back([&ref, pipelined, blockSize, round, &failed]() {
+            const std::string error = StressReader(ref, pipelined, blockSize);
+            if (!error.empty()) {
+              fprintf(stderr, "%s: round %d, %s reader, block size %llu: %s\n", ref.trace.c_str(), round,
+                      pipelined ? "pipelined" : "inline", (unsigned long long)blockSize, error.c_str());
+              failed++;
+            }
+          });
+        }
+      }
+    }
+    for (std::thread& thread : threads) {
+      thread.join();
+    }
+  }
+
+  for (const ReferenceDecode& ref : refs) {
+    printf("%s: %llu branches\n", ref.trace.c_str(), (unsigned long long)ref.edgeIds.size());
+  }
+  printf("%d rounds of %zu concurrent readers, %d failed\n", rounds, refs.size() * 2 * readers, failed.load());
+
+  return (failed == 0) ? 0 : -1;
+}
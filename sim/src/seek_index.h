@@ -0,0 +1,174 @@
+/*!
+ * \file    seek_index.h
+ * \brief   On-disk layout and helpers for the seekable trace index sidecar (.bt10i).
+ *
+ * A .bt10i file sits next to its trace and records a checkpoint every `interval` branches
+ * of the edge sequence list. A checkpoint holds the decompressed stream offset of the BT10
+ * record of that branch plus the closest point the trace stream can restart decoding from
+ * (see TraceStreamAnchor). BT10 records are self-delimiting, so the byte offset is all the
+ * decoder state needed to resume.
+ *
+ * Uncompressed traces and traces compressed as many zstd frames are entered right at the
+ * checkpoint; a single-frame .zst trace is decompressed from its start but not decoded.
+ */
+
+#pragma once
+
+#include "decompress.h"
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace bt9 {
+
+    /// Bump whenever the layout of any structure below changes
+    static constexpr uint32_t SEEK_INDEX_VERSION = 1;
+
+    /// File signature, first 8 bytes of every .bt10i file
+    static constexpr char SEEK_INDEX_MAGIC[8] = {'B', 'T', '1', '0', 'S', 'I', 'D', 'X'};
+
+    /*!
+     * \struct SeekIndexHeader
+     * \brief Fixed header at offset 0 of a .bt10i file, followed by num_checkpoints SeekCheckpoint records
+     */
+    struct SeekIndexHeader {
+        char magic[8];
+        uint32_t version;
+        uint32_t checkpoint_size;       //!< sizeof(SeekCheckpoint), guards against layout changes
+        uint64_t source_size;           //!< Size of the trace file in bytes
+        int64_t source_mtime_ns;        //!< Modification time of the trace file
+        uint64_t interval;              //!< Branches between two checkpoints
+        uint64_t num_branches;          //!< Length of the edge sequence list
+        uint64_t num_checkpoints;
+    };
+
+    /*!
+     * \struct SeekCheckpoint
+     * \brief Where branch i * interval of the edge sequence list starts
+     */
+    struct SeekCheckpoint {
+        uint64_t stream_offset;         //!< Decompressed stream offset of the BT10 record
+        TraceStreamAnchor anchor;       //!< Restart point at or before stream_offset
+    };
+
+    static_assert(std::is_trivially_copyable_v<SeekIndexHeader>);
+    static_assert(std::is_trivially_copyable_v<SeekCheckpoint>);
+
+    /// Sidecar name used for a trace when none is given
+    inline std::string seekIndexPath(const std::string & trace_name)
+    {
+        return trace_name + ".bt10i";
+    }
+
+    /*!
+     * \brief Size and modification time of a trace file, which a .bt10i file must match
+     * \return Returns false if the file does not exist
+     */
+    inline bool traceFileStamp(const std::string & name, uint64_t & size, int64_t & mtime_ns)
+    {
+        struct stat st;
+        if (stat(name.c_str(), &st) != 0) {
+            return false;
+        }
+
+        size = st.st_size;
+        mtime_ns = st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+
+        return true;
+    }
+
+    /*!
+     * \struct SeekIndex
+     * \brief In-memory seek index, checkpoint i is the start of branch i * interval
+     */
+    struct SeekIndex {
+        uint64_t interval = 0;
+        uint64_t num_branches = 0;
+        std::vector<SeekCheckpoint> checkpoints;
+
+        bool empty() const { return checkpoints.empty(); }
+
+        /*!
+         * \brief Load a .bt10i file
+         * \param path Index file name
+         * \param size Expected trace file size
+         * \param mtime_ns Expected trace file modification time
+         * \return Returns false if the file is missing, stale or was written by another layout
+         */
+        bool read(const std::string & path, uint64_t size, int64_t mtime_ns)
+        {
+            FILE * fin = fopen(path.c_str(), "rb");
+            if (fin == nullptr) {
+                return false;
+            }
+
+            SeekIndexHeader h = {};
+            bool ok = (fread(&h, sizeof(h), 1, fin) == 1) &&
+                      (memcmp(h.magic, SEEK_INDEX_MAGIC, sizeof(h.magic)) == 0) &&
+                      (h.version == SEEK_INDEX_VERSION) &&
+                      (h.checkpoint_size == sizeof(SeekCheckpoint)) &&
+                      (h.source_size == size) && (h.source_mtime_ns == mtime_ns) &&
+                      (h.interval != 0) && (h.num_checkpoints != 0) &&
+                      (h.num_checkpoints == h.num_branches / h.interval + 1);
+
+            if (ok) {
+                checkpoints.resize(h.num_checkpoints);
+                ok = (fread(checkpoints.data(), sizeof(SeekCheckpoint), checkpoints.size(), fin) == checkpoints.size());
+            }
+            fclose(fin);
+
+            if (!ok) {
+                checkpoints.clear();
+                return false;
+            }
+
+            interval = h.interval;
+            num_branches = h.num_branches;
+
+            return true;
+        }
+
+        /*!
+         * \brief Write a .bt10i file
+         * \note Written under a temporary name and renamed into place like the trace cache
+         * \return Returns false if the file could not be written
+         */
+        bool write(const std::string & path, uint64_t size, int64_t mtime_ns) const
+        {
+            const std::string tmp_path = path + ".tmp." + std::to_string(getpid());
+            FILE * fout = fopen(tmp_path.c_str(), "wb");
+            if (fout == nullptr) {
+                return false;
+            }
+
+            SeekIndexHeader h = {};
+            memcpy(h.magic, SEEK_INDEX_MAGIC, sizeof(h.magic));
+            h.version = SEEK_INDEX_VERSION;
+            h.checkpoint_size = sizeof(SeekCheckpoint);
+            h.source_size = size;
+            h.source_mtime_ns = mtime_ns;
+            h.interval = interval;
+            h.num_branches = num_branches;
+            h.num_checkpoints = checkpoints.size();
+
+            fwrite(&h, sizeof(h), 1, fout);
+            fwrite(checkpoints.data(), sizeof(SeekCheckpoint), checkpoints.size(), fout);
+
+            const bool ok = !ferror(fout);
+            if ((fclose(fout) != 0) || !ok || (rename(tmp_path.c_str(), path.c_str()) != 0)) {
+                remove(tmp_path.c_str());
+                return false;
+            }
+
+            return true;
+        }
+    };
+
+}
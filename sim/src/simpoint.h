@@ -0,0 +1,522 @@
+/*!
+ * \file    simpoint.h
+ * \brief   SimPoint-style phase analysis of the edge sequence list and its sidecar cache (.simpt).
+ *
+ * The edge sequence list is cut into intervals of a fixed number of branches. Every interval
+ * is summarized by its edge histogram, each edge weighted by the instructions it retires
+ * (edges end basic blocks, so this is the basic block vector of the interval), normalized
+ * and randomly projected to a few dimensions. The signatures are clustered with k-means, k
+ * chosen by the Bayesian information criterion as in SimPoint, and the interval closest to
+ * the centre of each cluster represents it with the cluster's share of the instructions as
+ * its weight.
+ *
+ * A .simpt file sits next to its trace and holds the signatures and the chosen intervals,
+ * so sampled runs of the same trace pay for the analysis once. Changing only the number of
+ * clusters tried reuses the signatures.
+ */
+
+#pragma once
+
+#include "bt9_reader.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <random>
+#include <span>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace bt9 {
+
+    /// Bump whenever the layout of any structure below changes
+    static constexpr uint32_t SIMPOINT_VERSION = 1;
+
+    /// File signature, first 8 bytes of every .simpt file
+    static constexpr char SIMPOINT_MAGIC[8] = {'B', 'T', '9', 'S', 'M', 'P', 'N', 'T'};
+
+    /*!
+     * \struct SimPointOptions
+     * \brief Parameters of the phase analysis, all of them are recorded in the .simpt file
+     */
+    struct SimPointOptions {
+        uint64_t interval = SIMPOINT_INTERVAL;  //!< Branches per interval
+        uint32_t dims = SIMPOINT_DIMS;          //!< Dimensions of the projected signatures
+        uint32_t max_k = SIMPOINT_MAX_K;        //!< Largest number of clusters tried
+        uint64_t seed = SIMPOINT_SEED;          //!< Seed of the projection and of k-means
+    };
+
+    /*!
+     * \struct SimPointHeader
+     * \brief Fixed header at offset 0 of a .simpt file
+     *
+     * Followed by num_intervals uint64_t instruction counts, num_intervals * dims float
+     * signatures and num_points SimPoint records.
+     */
+    struct SimPointHeader {
+        char magic[8];
+        uint32_t version;
+        uint32_t point_size;            //!< sizeof(SimPoint), guards against layout changes
+        uint64_t source_size;           //!< Size of the trace file in bytes
+        int64_t source_mtime_ns;        //!< Modification time of the trace file
+        uint64_t interval;
+        uint32_t dims;
+        uint32_t max_k;
+        uint64_t seed;
+        uint64_t num_branches;          //!< Length of the edge sequence list
+        uint64_t num_intervals;
+        uint64_t num_points;
+    };
+
+    /*!
+     * \struct SimPoint
+     * \brief Interval chosen to represent one cluster
+     */
+    struct SimPoint {
+        uint64_t interval;              //!< Interval index, its first branch is interval * SimPointOptions::interval
+        double weight;                  //!< Share of the clustered instructions in the cluster
+        uint32_t cluster;
+        uint32_t cluster_size;          //!< Intervals in the cluster
+    };
+
+    static_assert(std::is_trivially_copyable_v<SimPointHeader>);
+    static_assert(std::is_trivially_copyable_v<SimPoint>);
+
+    /// Sidecar name used for a trace when none is given
+    inline std::string simPointPath(const std::string & trace_name)
+    {
+        return trace_name + ".simpt";
+    }
+
+    /*!
+     * \class SimPointSet
+     * \brief Interval signatures of a trace and the intervals chosen to represent it
+     */
+    class SimPointSet
+    {
+    public:
+        SimPointOptions options;
+        uint64_t num_branches = 0;              //!< Branches in the trace, a short tail may be in no interval
+        std::vector<uint64_t> instructions;     //!< Instructions retired by each interval
+        std::vector<float> signatures;          //!< dims values per interval
+        std::vector<SimPoint> points;           //!< Sorted by interval
+
+        uint64_t numIntervals() const { return instructions.size(); }
+
+        /// First branch of an interval
+        uint64_t intervalBegin(uint64_t i) const { return i * options.interval; }
+
+        /// Branches in an interval, only the last one can be short (by less than half an interval)
+        uint64_t intervalLength(uint64_t i) const
+        {
+            return std::min(options.interval, num_branches - intervalBegin(i));
+        }
+
+        /*!
+         * \brief Load the .simpt sidecar of the trace, computing and saving whatever is missing or stale
+         * \param reader Reader of the trace, left at branch 0 when the signatures have to be computed
+         * \param opt Analysis parameters; the signatures are reused if only max_k changed
+         * \param path Sidecar file name, simPointPath() of the trace when empty
+         * \note A sidecar that cannot be saved is still used.
+         * \return Returns false if the trace has no branches
+         */
+        bool open(BT9Reader & reader, const SimPointOptions & opt, const std::string & path = "")
+        {
+            const std::string simpt_path = path.empty() ? simPointPath(reader.tracefile_name_) : path;
+
+            uint64_t size = 0;
+            int64_t mtime_ns = 0;
+            const bool stamped = traceFileStamp(reader.tracefile_name_, size, mtime_ns);
+
+            const bool loaded = stamped && read(simpt_path, size, mtime_ns) &&
+                                (options.interval == opt.interval) && (options.dims == opt.dims) &&
+                                (options.seed == opt.seed);
+            if (loaded && (options.max_k == opt.max_k)) {
+                return !points.empty();
+            }
+
+            if (!loaded) {
+                options = opt;
+                computeSignatures(reader);
+                reader.seekToBranch(0);
+            }
+            options.max_k = opt.max_k;
+            cluster();
+
+            if (stamped && !write(simpt_path, size, mtime_ns)) {
+                std::cerr << "Failed to write SimPoint file \'" << simpt_path << "\'\n";
+            }
+
+            return !points.empty();
+        }
+
+        /*!
+         * \brief Compute the interval signatures from the edge sequence list
+         * \param reader Reader positioned at branch 0, left at the end of the trace
+         */
+        void computeSignatures(BT9Reader & reader)
+        {
+            const uint32_t dims = options.dims;
+            const uint64_t num_edges = reader.loadStats().num_edges;
+
+            // Random projection of the per edge basic block vector entries, one row per edge
+            std::vector<float> projection(num_edges * dims);
+            for (uint64_t i = 0; i < projection.size(); i++) {
+                projection[i] = static_cast<float>(unitHash_(options.seed ^ (i * 0x9e3779b97f4a7c15ull)) * 2.0 - 1.0);
+            }
+
+            std::vector<uint64_t> edge_weight(num_edges, 0);
+            std::vector<uint32_t> touched;
+            std::vector<double> signature(dims);
+
+            instructions.clear();
+            signatures.clear();
+            num_branches = 0;
+
+            uint64_t interval_instructions = 0;
+            auto finishInterval = [&]() {
+                std::fill(signature.begin(), signature.end(), 0.0);
+                for (const uint32_t id : touched) {
+                    const double w = static_cast<double>(edge_weight[id]) / interval_instructions;
+                    for (uint32_t d = 0; d < dims; d++) {
+                        signature[d] += w * static_cast<double>(projection[id * dims + d]);
+                    }
+                    edge_weight[id] = 0;
+                }
+                touched.clear();
+
+                instructions.push_back(interval_instructions);
+                signatures.insert(signatures.end(), signature.begin(), signature.end());
+                interval_instructions = 0;
+            };
+
+            std::vector<BT9HotEdge> block(BRANCH_BLOCK_SIZE);
+            while (const uint64_t block_size = reader.readBranchBlock(block)) {
+                for (const BT9HotEdge & br : std::span(block).first(block_size)) {
+                    const uint64_t w = static_cast<uint64_t>(br.inst_cnt) + 1;
+                    if (edge_weight[br.edge_id] == 0) {
+                        touched.push_back(br.edge_id);
+                    }
+                    edge_weight[br.edge_id] += w;
+                    interval_instructions += w;
+
+                    if (++num_branches % options.interval == 0) {
+                        finishInterval();
+                    }
+                }
+            }
+
+            // A tail shorter than half an interval would form a phase of its own, it is left out
+            // unless it is all there is
+            const uint64_t tail = num_branches % options.interval;
+            if ((tail != 0) && ((2 * tail >= options.interval) || instructions.empty())) {
+                finishInterval();
+            }
+        }
+
+        /*!
+         * \brief Cluster the signatures and choose one interval per cluster
+         * \note k-means is run for every k up to max_k; the smallest k whose BIC score reaches
+         *       90% of the range of scores seen wins, as in SimPoint.
+         */
+        void cluster()
+        {
+            points.clear();
+            const uint64_t n = numIntervals();
+            if (n == 0) {
+                return;
+            }
+
+            const uint32_t max_k = static_cast<uint32_t>(std::clamp<uint64_t>(options.max_k, 1, n));
+            std::vector<std::vector<uint32_t>> assignments(max_k + 1);
+            std::vector<double> scores(max_k + 1, 0.0);
+
+            for (uint32_t k = 1; k <= max_k; k++) {
+                std::mt19937_64 rng(options.seed + k);
+                std::vector<double> centers;
+                const double distortion = kMeans_(k, rng, assignments[k], centers);
+                scores[k] = bicScore_(k, distortion, assignments[k]);
+            }
+
+            const auto [min_it, max_it] = std::minmax_element(scores.begin() + 1, scores.end());
+            const double threshold = *min_it + 0.9 * (*max_it - *min_it);
+            uint32_t best_k = 1;
+            while (scores[best_k] < threshold) {
+                best_k++;
+            }
+
+            const std::vector<uint32_t> & assign = assignments[best_k];
+            std::vector<double> centers(best_k * options.dims, 0.0);
+            updateCenters_(best_k, assign, centers);
+
+            // The member closest to the centre represents the cluster
+            std::vector<double> best_dist(best_k, std::numeric_limits<double>::max());
+            std::vector<uint64_t> cluster_instructions(best_k, 0);
+            std::vector<uint32_t> cluster_size(best_k, 0);
+            std::vector<uint64_t> representative(best_k, 0);
+            uint64_t total_instructions = 0;
+
+            for (uint64_t i = 0; i < n; i++) {
+                const uint32_t c = assign[i];
+                const double dist = distance_(i, &centers[c * options.dims]);
+                if (dist < best_dist[c]) {
+                    best_dist[c] = dist;
+                    representative[c] = i;
+                }
+                cluster_instructions[c] += instructions[i];
+                cluster_size[c]++;
+                total_instructions += instructions[i];
+            }
+
+            for (uint32_t c = 0; c < best_k; c++) {
+                if (cluster_size[c] == 0) {
+                    continue;
+                }
+                SimPoint & point = points.emplace_back();
+                point.interval = representative[c];
+                point.weight = static_cast<double>(cluster_instructions[c]) / std::max<uint64_t>(total_instructions, 1);
+                point.cluster = c;
+                point.cluster_size = cluster_size[c];
+            }
+
+            std::sort(points.begin(), points.end(), [](const SimPoint & a, const SimPoint & b) { return a.interval < b.interval; });
+        }
+
+        /*!
+         * \brief Load a .simpt file
+         * \param path SimPoint file name
+         * \param size Expected trace file size
+         * \param mtime_ns Expected trace file modification time
+         * \return Returns false if the file is missing, stale or was written by another layout
+         */
+        bool read(const std::string & path, uint64_t size, int64_t mtime_ns)
+        {
+            FILE * fin = fopen(path.c_str(), "rb");
+            if (fin == nullptr) {
+                return false;
+            }
+
+            SimPointHeader h = {};
+            bool ok = (fread(&h, sizeof(h), 1, fin) == 1) &&
+                      (memcmp(h.magic, SIMPOINT_MAGIC, sizeof(h.magic)) == 0) &&
+                      (h.version == SIMPOINT_VERSION) &&
+                      (h.point_size == sizeof(SimPoint)) &&
+                      (h.source_size == size) && (h.source_mtime_ns == mtime_ns) &&
+                      (h.interval != 0) && (h.dims != 0) &&
+                      (h.num_intervals <= (h.num_branches + h.interval - 1) / h.interval) &&
+                      (h.num_points <= h.num_intervals);
+
+            if (ok) {
+                instructions.resize(h.num_intervals);
+                signatures.resize(h.num_intervals * h.dims);
+                points.resize(h.num_points);
+                ok = (fread(instructions.data(), sizeof(uint64_t), instructions.size(), fin) == instructions.size()) &&
+                     (fread(signatures.data(), sizeof(float), signatures.size(), fin) == signatures.size()) &&
+                     (fread(points.data(), sizeof(SimPoint), points.size(), fin) == points.size()) &&
+                     std::all_of(points.begin(), points.end(), [&](const SimPoint & p) { return p.interval < h.num_intervals; });
+            }
+            fclose(fin);
+
+            if (!ok) {
+                instructions.clear();
+                signatures.clear();
+                points.clear();
+                return false;
+            }
+
+            options.interval = h.interval;
+            options.dims = h.dims;
+            options.max_k = h.max_k;
+            options.seed = h.seed;
+            num_branches = h.num_branches;
+
+            return true;
+        }
+
+        /*!
+         * \brief Write a .simpt file
+         * \note Written under a temporary name and renamed into place like the seek index
+         * \return Returns false if the file could not be written
+         */
+        bool write(const std::string & path, uint64_t size, int64_t mtime_ns) const
+        {
+            const std::string tmp_path = path + ".tmp." + std::to_string(getpid());
+            FILE * fout = fopen(tmp_path.c_str(), "wb");
+            if (fout == nullptr) {
+                return false;
+            }
+
+            SimPointHeader h = {};
+            memcpy(h.magic, SIMPOINT_MAGIC, sizeof(h.magic));
+            h.version = SIMPOINT_VERSION;
+            h.point_size = sizeof(SimPoint);
+            h.source_size = size;
+            h.source_mtime_ns = mtime_ns;
+            h.interval = options.interval;
+            h.dims = options.dims;
+            h.max_k = options.max_k;
+            h.seed = options.seed;
+            h.num_branches = num_branches;
+            h.num_intervals = numIntervals();
+            h.num_points = points.size();
+
+            fwrite(&h, sizeof(h), 1, fout);
+            fwrite(instructions.data(), sizeof(uint64_t), instructions.size(), fout);
+            fwrite(signatures.data(), sizeof(float), signatures.size(), fout);
+            fwrite(points.data(), sizeof(SimPoint), points.size(), fout);
+
+            const bool ok = !ferror(fout);
+            if ((fclose(fout) != 0) || !ok || (rename(tmp_path.c_str(), path.c_str()) != 0)) {
+                remove(tmp_path.c_str());
+                return false;
+            }
+
+            return true;
+        }
+
+    private:
+        /// splitmix64 of x mapped to [0, 1)
+        static double unitHash_(uint64_t x)
+        {
+            x += 0x9e3779b97f4a7c15ull;
+            x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+            x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+            x ^= (x >> 31);
+            return static_cast<double>(x >> 11) * 0x1.0p-53;
+        }
+
+        /// Squared distance between the signature of interval i and a point
+        double distance_(uint64_t i, const double * center) const
+        {
+            const float * sig = &signatures[i * options.dims];
+            double dist = 0.0;
+            for (uint32_t d = 0; d < options.dims; d++) {
+                const double diff = static_cast<double>(sig[d]) - center[d];
+                dist += diff * diff;
+            }
+            return dist;
+        }
+
+        /// Centres as the mean signature of their clusters, an empty cluster keeps its centre
+        void updateCenters_(uint32_t k, const std::vector<uint32_t> & assign, std::vector<double> & centers) const
+        {
+            const uint32_t dims = options.dims;
+            std::vector<double> sums(k * dims, 0.0);
+            std::vector<uint64_t> counts(k, 0);
+
+            for (uint64_t i = 0; i < assign.size(); i++) {
+                for (uint32_t d = 0; d < dims; d++) {
+                    sums[assign[i] * dims + d] += static_cast<double>(signatures[i * dims + d]);
+                }
+                counts[assign[i]]++;
+            }
+
+            for (uint32_t c = 0; c < k; c++) {
+                if (counts[c] == 0) {
+                    continue;
+                }
+                for (uint32_t d = 0; d < dims; d++) {
+                    centers[c * dims + d] = sums[c * dims + d] / counts[c];
+                }
+            }
+        }
+
+        /*!
+         * \brief k-means with k-means++ seeding
+         * \return Returns the sum of squared distances of the intervals to their centres
+         */
+        double kMeans_(uint32_t k, std::mt19937_64 & rng, std::vector<uint32_t> & assign, std::vector<double> & centers) const
+        {
+            const uint32_t dims = options.dims;
+            const uint64_t n = numIntervals();
+            std::uniform_real_distribution<double> uniform(0.0, 1.0);
+
+            centers.assign(k * dims, 0.0);
+            std::vector<double> nearest(n, std::numeric_limits<double>::max());
+            uint64_t pick = std::uniform_int_distribution<uint64_t>(0, n - 1)(rng);
+
+            for (uint32_t c = 0; c < k; c++) {
+                std::copy_n(&signatures[pick * dims], dims, &centers[c * dims]);
+
+                double total = 0.0;
+                for (uint64_t i = 0; i < n; i++) {
+                    nearest[i] = std::min(nearest[i], distance_(i, &centers[c * dims]));
+                    total += nearest[i];
+                }
+
+                // Next centre drawn with probability proportional to the squared distance
+                double r = uniform(rng) * total;
+                for (pick = 0; pick + 1 < n; pick++) {
+                    r -= nearest[pick];
+                    if (r < 0.0) {
+                        break;
+                    }
+                }
+            }
+
+            assign.assign(n, 0);
+            double distortion = 0.0;
+            for (uint32_t iter = 0; iter < SIMPOINT_KMEANS_ITERATIONS; iter++) {
+                bool changed = (iter == 0);
+                distortion = 0.0;
+
+                for (uint64_t i = 0; i < n; i++) {
+                    uint32_t best = 0;
+                    double best_dist = std::numeric_limits<double>::max();
+                    for (uint32_t c = 0; c < k; c++) {
+                        const double dist = distance_(i, &centers[c * dims]);
+                        if (dist < best_dist) {
+                            best_dist = dist;
+                            best = c;
+                        }
+                    }
+                    changed |= (assign[i] != best);
+                    assign[i] = best;
+                    distortion += best_dist;
+                }
+
+                if (!changed) {
+                    break;
+                }
+                updateCenters_(k, assign, centers);
+            }
+
+            return distortion;
+        }
+
+        /// BIC of a clustering under the identical spherical Gaussian model of X-means (Pelleg and Moore)
+        double bicScore_(uint32_t k, double distortion, const std::vector<uint32_t> & assign) const
+        {
+            const double r = static_cast<double>(assign.size());
+            const double m = options.dims;
+            if (r <= k) {
+                return 0.0;
+            }
+
+            const double variance = std::max(distortion / (m * (r - k)), std::numeric_limits<double>::min());
+
+            std::vector<uint64_t> sizes(k, 0);
+            for (const uint32_t c : assign) {
+                sizes[c]++;
+            }
+
+            double likelihood = 0.0;
+            for (const uint64_t size : sizes) {
+                if (size == 0) {
+                    continue;
+                }
+                const double rn = static_cast<double>(size);
+                likelihood += rn * std::log(rn) - rn * std::log(r) -
+                              rn * m / 2.0 * std::log(2.0 * M_PI * variance) - m * (rn - 1.0) / 2.0;
+            }
+
+            const double parameters = (k - 1) + m * k + 1;
+            return likelihood - parameters / 2.0 * std::log(r);
+        }
+    };
+
+}
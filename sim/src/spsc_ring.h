@@ -0,0 +1,111 @@
+/*!
+ * \file    spsc_ring.h
+ * \brief   Bounded single-producer/single-consumer ring of reusable slots.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+namespace bt9 {
+
+    /*!
+     * \class SpscRing
+     * \brief Lock-free ring handing large slots from one producer thread to one consumer thread
+     *
+     * Slots are filled in place and recycled, so nothing is allocated after construction.
+     * Head/tail are plain atomic counters; a thread that finds the ring full (or empty)
+     * sleeps in std::atomic::wait() until the other side moves its counter.
+     */
+    template<typename Slot>
+    class SpscRing
+    {
+    public:
+        /*!
+         * \brief Constructor
+         * \param num_slots Number of slots in the ring
+         * \param slot Prototype slot copied into every ring entry
+         */
+        SpscRing(size_t num_slots, const Slot & slot) :
+            slots_(num_slots, slot)
+        {}
+
+        SpscRing(const SpscRing &) = delete;
+        SpscRing & operator=(const SpscRing &) = delete;
+
+        /*!
+         * \brief Producer: get the next free slot, waiting while the ring is full
+         * \return Returns nullptr once the consumer has cancelled the ring
+         */
+        Slot * acquireWrite()
+        {
+            const uint64_t head = head_.load(std::memory_order_relaxed);
+            uint64_t tail = tail_.load(std::memory_order_acquire);
+
+            while (head - tail == slots_.size()) {
+                tail_.wait(tail, std::memory_order_acquire);
+                tail = tail_.load(std::memory_order_acquire);
+            }
+
+            if (cancelled_.load(std::memory_order_acquire)) {
+                return nullptr;
+            }
+
+            return &slots_[head % slots_.size()];
+        }
+
+        /// Producer: hand the slot returned by acquireWrite() to the consumer
+        void publishWrite()
+        {
+            head_.fetch_add(1, std::memory_order_release);
+            head_.notify_one();
+        }
+
+        /// Consumer: get the oldest published slot, waiting while the ring is empty
+        Slot & acquireRead()
+        {
+            const uint64_t tail = tail_.load(std::memory_order_relaxed);
+            uint64_t head = head_.load(std::memory_order_acquire);
+
+            while (head == tail) {
+                head_.wait(head, std::memory_order_acquire);
+                head = head_.load(std::memory_order_acquire);
+            }
+
+            return slots_[tail % slots_.size()];
+        }
+
+        /// Consumer: give the slot returned by acquireRead() back to the producer
+        void releaseRead()
+        {
+            tail_.fetch_add(1, std::memory_order_release);
+            tail_.notify_one();
+        }
+
+        /*!
+         * \brief Consumer: stop the producer early
+         * \note Bumps the tail counter so a producer sleeping on a full ring wakes up
+         *       and sees the cancellation
+         */
+        void cancel()
+        {
+            cancelled_.store(true, std::memory_order_release);
+            tail_.fetch_add(slots_.size(), std::memory_order_release);
+            tail_.notify_one();
+        }
+
+    private:
+        std::vector<Slot> slots_;
+
+        /// Number of slots published by the producer
+        alignas(64) std::atomic<uint64_t> head_{0};
+
+        /// Number of slots released by the consumer
+        alignas(64) std::atomic<uint64_t> tail_{0};
+
+        alignas(64) std::atomic<bool> cancelled_{false};
+    };
+
+}
@@ -0,0 +1,102 @@
+/*!
+ * \file    text_scanner.h
+ * \brief   Allocation-free tokenizer and integer parser for the BT9 text sections.
+ */
+
+#pragma once
+
+#include <charconv>
+#include <cstdint>
+#include <string_view>
+#include <system_error>
+
+namespace bt9 {
+
+    /*!
+     * \brief Parse an unsigned integer the way std::stoull(token, nullptr, 0) reads it
+     *
+     * Accepts an optional '+', then "0x"/"0X" for hex, a leading '0' for octal, decimal otherwise.
+     * Unlike std::stoull the whole token must be consumed and nothing is thrown.
+     *
+     * \return Returns false if the token is not a complete number or does not fit in T
+     */
+    template<typename T>
+    inline bool parseInteger(std::string_view token, T & value)
+    {
+        const char * first = token.data();
+        const char * last = first + token.size();
+
+        if ((first != last) && (*first == '+')) {
+            ++first;
+        }
+
+        int base = 10;
+        if ((last - first > 1) && (first[0] == '0')) {
+            if ((first[1] == 'x') || (first[1] == 'X')) {
+                first += 2;
+                base = 16;
+            }
+            else {
+                first += 1;
+                base = 8;
+            }
+        }
+
+        const auto [ptr, ec] = std::from_chars(first, last, value, base);
+        return (ec == std::errc()) && (ptr == last) && (first != last);
+    }
+
+    /*!
+     * \class TextScanner
+     * \brief Splits a line into whitespace separated tokens without copying it
+     * \note The tokens are views into the scanned line, which must outlive them
+     */
+    class TextScanner
+    {
+    public:
+        /*!
+         * \brief Constructor
+         * \param line The line to tokenize
+         */
+        explicit TextScanner(std::string_view line) :
+            line_(line)
+        {}
+
+        /*!
+         * \brief Get the next token
+         * \return Returns false (and an empty token) once the line is exhausted
+         */
+        bool next(std::string_view & token)
+        {
+            skipSpace_();
+
+            const size_t start = pos_;
+            while ((pos_ < line_.size()) && !isSpace_(line_[pos_])) {
+                ++pos_;
+            }
+
+            token = line_.substr(start, pos_ - start);
+            return !token.empty();
+        }
+
+        /// Everything after the last token returned, leading whitespace included
+        std::string_view rest() const { return line_.substr(pos_); }
+
+    private:
+        static bool isSpace_(char c)
+        {
+            return (c == ' ') || (c == '\t') || (c == '\r') || (c == '\n') || (c == '\v') || (c == '\f');
+        }
+
+        void skipSpace_()
+        {
+            while ((pos_ < line_.size()) && isSpace_(line_[pos_])) {
+                ++pos_;
+            }
+        }
+
+        std::string_view line_;
+        size_t pos_ = 0;
+    };
+
+}
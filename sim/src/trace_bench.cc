@@ -0,0 +1,178 @@
+/*!
+ * \file    trace_bench.cc
+ * \brief   Measures the throughput of every stage of the trace reader.
+ *
+ * usage: trace_bench [options] <trace>...
+ *
+ * For each trace the reader is timed stage by stage: the file reads of the read-ahead thread,
+ * reading and decompressing the file including the time spent waiting for those reads,
+ * parsing the header, node table and edge table, joining the hot edge table, decoding the
+ * edge sequence into edge ids and producing branch records from them, and finally a whole
+ * fresh load plus read as the simulator does it. Every stage is reported in MB/s of its
+ * input and records (lines, nodes, edges or branches) per second, with the time spent
+ * reading and decompressing the file taken out of the parser stages. Decode stages are
+ * the best of several passes.
+ *
+ * Run it on real traces and on synthetic ones from trace_generate (task bench_reader does
+ * both) to check that a reader change is not a regression.
+ */
+
+#include <chrono>
+#include <span>
+#include <vector>
+
+#include <getopt.h>
+
+#include "bt9_reader.h"
+
+void PrintUsage(const char* prog)
+{
+  printf("usage: %s [options] <trace>...\n", prog);
+  printf("  -n, --passes N   decode passes over the edge sequence, the best one is reported (default: 3)\n");
+}
+
+// One line of the report; bytes or records of 0 leave their columns empty
+void PrintStage(const char* stage, uint64_t bytes, uint64_t records, double seconds)
+{
+  const double MB = 1024.0 * 1024.0;
+  char size[32] = "", count[32] = "", bandwidth[32] = "", rate[32] = "";
+  if (bytes != 0) {
+    snprintf(size, sizeof(size), "%.2f", bytes / MB);
+    snprintf(bandwidth, sizeof(bandwidth), "%.1f", (seconds > 0.0) ? bytes / MB / seconds : 0.0);
+  }
+  if (records != 0) {
+    snprintf(count, sizeof(count), "%llu", (unsigned long long)records);
+    snprintf(rate, sizeof(rate), "%.2f", (seconds > 0.0) ? records / seconds / 1e6 : 0.0);
+  }
+  printf("  %-18s %10s %12s %10.4f %10s %12s\n", stage, size, count, seconds, bandwidth, rate);
+}
+
+// Seconds since start
+double Since(std::chrono::steady_clock::time_point start)
+{
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Drain the reader with readBranchBlock() like the simulator does
+uint64_t ReadAllBranches(bt9::BT9Reader& reader)
+{
+  std::vector<bt9::BT9HotEdge> block(BRANCH_BLOCK_SIZE);
+  uint64_t numBranches = 0;
+  uint64_t checksum = 0;
+  while (const uint64_t blockSize = reader.readBranchBlock(block)) {
+    for (const bt9::BT9HotEdge& br : std::span(block).first(blockSize)) {
+      checksum += br.pc ^ br.target;
+    }
+    numBranches += blockSize;
+  }
+
+  // Keeps the loop body from being optimized away
+  if (checksum == 1) {
+    printf(" ");
+  }
+  return numBranches;
+}
+
+void BenchTrace(const std::string& trace, int passes)
+{
+  // Load and first pass of a fresh reader: the only time the text sections are parsed
+  bt9::BT9Reader reader(trace);
+  const bt9::BT9LoadStats load = reader.loadStats();
+  const bt9::TraceStreamStats afterLoad = reader.streamStats();
+
+  auto start = std::chrono::steady_clock::now();
+  const uint64_t numBranches = reader.skipBranches(UINT64_MAX);
+  double decodeSeconds = Since(start) - (reader.streamStats().decode_seconds - afterLoad.decode_seconds);
+
+  const bt9::TraceStreamStats stream = reader.streamStats();
+  const uint64_t tableBytes = load.header.bytes + load.node_table.bytes + load.edge_table.bytes;
+  const uint64_t sequenceBytes = stream.stream_bytes - tableBytes;
+
+  // Later passes start over from the first branch; only the best pass counts
+  double recordSeconds = 0.0;
+  for (int pass = 0; pass < passes; pass++) {
+    reader.seekToBranch(0);
+    double streamBefore = reader.streamStats().decode_seconds;
+    start = std::chrono::steady_clock::now();
+    reader.skipBranches(UINT64_MAX);
+    decodeSeconds = std::min(decodeSeconds, Since(start) - (reader.streamStats().decode_seconds - streamBefore));
+
+    reader.seekToBranch(0);
+    streamBefore = reader.streamStats().decode_seconds;
+    start = std::chrono::steady_clock::now();
+    ReadAllBranches(reader);
+    const double seconds = Since(start) - (reader.streamStats().decode_seconds - streamBefore);
+    recordSeconds = (pass == 0) ? seconds : std::min(recordSeconds, seconds);
+  }
+
+  // What a simulator run sees, from opening the trace to the last branch record
+  start = std::chrono::steady_clock::now();
+  uint64_t fileBytes = 0;
+  {
+    bt9::BT9Reader fresh(trace);
+    ReadAllBranches(fresh);
+    fileBytes = fresh.streamStats().file_bytes;
+  }
+  const double endToEndSeconds = Since(start);
+
+  printf("%s: %.2f MB file, %.2f MB decompressed, %llu nodes, %llu edges, %llu branches\n", trace.c_str(),
+         stream.file_bytes / (1024.0 * 1024.0), stream.stream_bytes / (1024.0 * 1024.0),
+         (unsigned long long)load.num_nodes, (unsigned long long)load.num_edges, (unsigned long long)numBranches);
+  printf("  %-18s %10s %12s %10s %10s %12s\n", "stage", "MB", "records", "seconds", "MB/s", "M records/s");
+  PrintStage("file reads", stream.file_bytes, 0, stream.io_read_seconds);
+  PrintStage("read + decompress", stream.stream_bytes, 0, stream.decode_seconds);
+  PrintStage("  of it I/O wait", 0, 0, stream.io_wait_seconds);
+  if (load.header.seconds > 0.0) {
+    PrintStage("header", load.header.bytes, load.header.records, load.header.parseSeconds());
+    PrintStage("node table", load.node_table.bytes, load.node_table.records, load.node_table.parseSeconds());
+    PrintStage("edge table", load.edge_table.bytes, load.edge_table.records, load.edge_table.parseSeconds());
+  }
+  else {
+    PrintStage("tables (binary)", 0, load.num_nodes + load.num_edges, load.load_seconds);
+  }
+  PrintStage("hot table join", 0, load.num_edges, load.hot_table_seconds);
+  PrintStage("edge sequence", sequenceBytes, numBranches, decodeSeconds);
+  PrintStage("branch records", 0, numBranches, recordSeconds);
+  PrintStage("end to end", fileBytes, numBranches, endToEndSeconds);
+}
+
+int main(int argc, char* argv[])
+{
+  int passes = 3;
+
+  static const struct option longOptions[] = {
+    {"passes", required_argument, nullptr, 'n'},
+    {"help",   no_argument,       nullptr, 'h'},
+    {nullptr,  0,                 nullptr,  0 }
+  };
+
+  int opt;
+  while ((opt = getopt_long(argc, argv, "n:h", longOptions, nullptr)) != -1) {
+    switch (opt) {
+      case 'n':
+        passes = std::max(1, atoi(optarg));
+        break;
+      default:
+        PrintUsage(argv[0]);
+        exit(-1);
+    }
+  }
+
+  if (optind == argc) {
+    PrintUsage(argv[0]);
+    exit(-1);
+  }
+
+  int failed = 0;
+  for (int i = optind; i < argc; i++) {
+    try {
+      BenchTrace(argv[i], passes);
+    }
+    catch (const bt9::TraceError& ex) {
+      fprintf(stderr, "%s\n", ex.what());
+      failed++;
+    }
+  }
+
+  return (failed == 0) ? 0 : -1;
+}
@@ -0,0 +1,289 @@
+/*!
+ * \file    trace_cache.h
+ * \brief   On-disk layout and helpers for the pre-decoded native trace cache (.bt10c).
+ *
+ * A .bt10c file holds everything BT9Reader derives from a trace: the raw header text,
+ * the node and edge tables as fixed-size records and the whole edge sequence list as
+ * uint32_t edge ids. It is named after the canonical trace path and is mapped read-only,
+ * so concurrent simulator processes share it through the page cache.
+ *
+ * A cache is matched to its trace by the size and modification time of the trace file, which
+ * a stat() gives without reading the trace. The content hash it also records is only computed
+ * when a cache is written, or when a trace of the same size turns up with another modification
+ * time: if the contents did not change either, the cache is restamped instead of rebuilt.
+ *
+ * The trace server (trace_server.cc) places the same image in POSIX shared memory,
+ * in a segment named after the trace path (see traceSegmentName()).
+ */
+
+#pragma once
+
+#include "bt9_reader_defines.h"
+
+#include "bt9.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace bt9 {
+
+    /// Bump whenever the layout of any structure below changes
+    static constexpr uint32_t TRACE_CACHE_VERSION = 2;
+
+    /// File signature, first 8 bytes of every .bt10c file
+    static constexpr char TRACE_CACHE_MAGIC[8] = {'B', 'T', '1', '0', 'C', 'A', 'C', 'H'};
+
+    /*!
+     * \struct TraceCacheHeader
+     * \brief Fixed header at offset 0 of a .bt10c file, all offsets are in bytes from the file start
+     */
+    struct TraceCacheHeader {
+        char magic[8];
+        uint32_t version;
+        uint32_t node_record_size;      //!< sizeof(TraceCacheNode), guards against layout changes
+        uint32_t edge_record_size;      //!< sizeof(TraceCacheEdge)
+        uint32_t reserved;
+        uint64_t source_hash;           //!< Content hash of the trace file
+        uint64_t source_size;           //!< Size of the trace file in bytes
+        int64_t source_mtime_ns;        //!< Modification time of the trace file
+        uint64_t header_text_offset;    //!< Raw BT9 header lines, up to and including BT9_NODES
+        uint64_t header_text_size;
+        uint64_t nodes_offset;          //!< num_nodes TraceCacheNode records
+        uint64_t num_nodes;
+        uint64_t edges_offset;          //!< num_edges TraceCacheEdge records
+        uint64_t num_edges;
+        uint64_t ids_offset;            //!< num_branches uint32_t edge ids, 4-byte aligned
+        uint64_t num_branches;
+    };
+
+    /*!
+     * \struct TraceCacheNode
+     * \brief Flattened BT9ReaderNodeRecord
+     */
+    struct TraceCacheNode {
+        uint64_t br_virtual_addr;
+        uint64_t br_phy_addr;
+        uint32_t id;
+        uint32_t opcode;
+        uint32_t br_tgt_cnt;
+        uint32_t br_taken_cnt;
+        uint32_t br_untaken_cnt;
+        BrClass_BrBehavior br_class_br_behavior;
+        uint8_t opcode_size;
+        uint8_t br_phy_addr_valid;
+    };
+
+    /*!
+     * \struct TraceCacheEdge
+     * \brief Flattened BT9ReaderEdgeRecord
+     */
+    struct TraceCacheEdge {
+        uint64_t observed_traverse_cnt;
+        uint64_t br_virtual_tgt;
+        uint64_t br_phy_tgt;
+        uint64_t inst_cnt;
+        uint32_t id;
+        uint32_t src_node_id;
+        uint32_t dest_node_id;
+        uint8_t is_taken_path;
+        uint8_t br_phy_tgt_valid;
+    };
+
+    static_assert(std::is_trivially_copyable_v<TraceCacheHeader>);
+    static_assert(std::is_trivially_copyable_v<TraceCacheNode>);
+    static_assert(std::is_trivially_copyable_v<TraceCacheEdge>);
+
+    /*!
+     * \brief Hash the contents of a trace file
+     * \param name Trace file name
+     * \param hash Set to the content hash
+     * \param size Set to the file size in bytes
+     * \return Returns false if the file cannot be read
+     * \note Word-at-a-time multiply/xor-shift hash. It only names cache files, it is not
+     *       meant to resist deliberate collisions.
+     */
+    inline bool hashTraceFile(const std::string & name, uint64_t & hash, uint64_t & size)
+    {
+        FILE * fin = fopen(name.c_str(), "rb");
+        if (fin == nullptr) {
+            return false;
+        }
+
+        std::vector<uint64_t> words(TRACE_STREAM_IN_BUFFER_SIZE / sizeof(uint64_t));
+        hash = 0x9E3779B97F4A7C15ull;
+        size = 0;
+
+        while (true) {
+            const size_t read = fread(words.data(), 1, words.size() * sizeof(uint64_t), fin);
+            if (read == 0) {
+                break;
+            }
+
+            // Zero-pad the tail; the total size is mixed in at the end
+            memset(reinterpret_cast<char *>(words.data()) + read, 0, (sizeof(uint64_t) - read % sizeof(uint64_t)) % sizeof(uint64_t));
+
+            const size_t num_words = (read + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+            for (size_t i = 0; i < num_words; i++) {
+                hash = (hash ^ words[i]) * 0xFF51AFD7ED558CCDull;
+                hash ^= hash >> 32;
+            }
+
+            size += read;
+        }
+
+        const bool ok = !ferror(fin);
+        fclose(fin);
+
+        hash = (hash ^ size) * 0xC4CEB9FE1A85EC53ull;
+        hash ^= hash >> 29;
+
+        return ok;
+    }
+
+    /*!
+     * \brief Hash of the canonical path of a trace, which names its cache file and segment
+     * \note Every relative or symlinked spelling of the same file gets the same hash
+     */
+    inline uint64_t tracePathHash(const std::string & trace_name)
+    {
+        char resolved[PATH_MAX];
+        const char * path = (realpath(trace_name.c_str(), resolved) != nullptr) ? resolved : trace_name.c_str();
+
+        // FNV-1a
+        uint64_t hash = 0xCBF29CE484222325ull;
+        for (const char * c = path; *c != '\0'; c++) {
+            hash = (hash ^ static_cast<uint8_t>(*c)) * 0x100000001B3ull;
+        }
+
+        return hash;
+    }
+
+    /// Cache file name of a trace
+    inline std::string traceCachePath(const std::string & cache_dir, const std::string & trace_name)
+    {
+        char name[32];
+        snprintf(name, sizeof(name), "%016llx.bt10c", (unsigned long long)tracePathHash(trace_name));
+
+        return cache_dir + "/" + name;
+    }
+
+    /// Name of the shared memory segment the trace server publishes a trace under
+    inline std::string traceSegmentName(const std::string & trace_name)
+    {
+        char name[32];
+        snprintf(name, sizeof(name), "/bt9-%016llx", (unsigned long long)tracePathHash(trace_name));
+
+        return name;
+    }
+
+    /*!
+     * \brief Give the cache file of a trace the modification time of the trace, if the contents
+     *        it was written from are still those of the trace
+     * \param size Size of the trace file in bytes
+     * \param mtime_ns Modification time of the trace file
+     * \note Hashes the whole trace, so it is only worth it in place of a rebuild
+     * \return Returns false if the cache is not of this layout, of another trace or cannot be updated
+     */
+    inline bool restampTraceCache(const std::string & path, const std::string & trace_name, uint64_t size, int64_t mtime_ns)
+    {
+        const int fd = open(path.c_str(), O_RDWR);
+        if (fd < 0) {
+            return false;
+        }
+
+        TraceCacheHeader h;
+        uint64_t hash = 0;
+        uint64_t hashed_size = 0;
+        const bool ok = (pread(fd, &h, sizeof(h), 0) == sizeof(h)) &&
+                        (memcmp(h.magic, TRACE_CACHE_MAGIC, sizeof(h.magic)) == 0) && (h.version == TRACE_CACHE_VERSION) &&
+                        (h.source_size == size) && hashTraceFile(trace_name, hash, hashed_size) &&
+                        (hashed_size == size) && (h.source_hash == hash) &&
+                        (pwrite(fd, &mtime_ns, sizeof(mtime_ns), offsetof(TraceCacheHeader, source_mtime_ns)) == sizeof(mtime_ns));
+        close(fd);
+
+        return ok;
+    }
+
+    /*!
+     * \class MappedFile
+     * \brief Read-only shared mapping of a whole file or shared memory segment, unmapped on destruction
+     */
+    class MappedFile
+    {
+    public:
+        MappedFile() = default;
+        MappedFile(const MappedFile &) = delete;
+        MappedFile & operator=(const MappedFile &) = delete;
+
+        ~MappedFile() { unmap(); }
+
+        /// Map a file, returns false if it does not exist or cannot be mapped
+        bool map(const std::string & name)
+        {
+            unmap();
+            return mapFd_(open(name.c_str(), O_RDONLY));
+        }
+
+        /// Map a POSIX shared memory segment, returns false if it does not exist or cannot be mapped
+        bool mapSharedMemory(const std::string & name)
+        {
+            unmap();
+            return mapFd_(shm_open(name.c_str(), O_RDONLY, 0));
+        }
+
+        void unmap()
+        {
+            if (data_ != nullptr) {
+                munmap(const_cast<uint8_t *>(data_), size_);
+                data_ = nullptr;
+                size_ = 0;
+            }
+        }
+
+        const uint8_t * data() const { return data_; }
+        uint64_t size() const { return size_; }
+
+    private:
+        /// Map the whole object behind fd and close it
+        bool mapFd_(int fd)
+        {
+            if (fd < 0) {
+                return false;
+            }
+
+            struct stat st;
+            if ((fstat(fd, &st) != 0) || (st.st_size == 0)) {
+                close(fd);
+                return false;
+            }
+
+            void * addr = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+            close(fd);
+
+            if (addr == MAP_FAILED) {
+                return false;
+            }
+
+            data_ = static_cast<const uint8_t *>(addr);
+            size_ = st.st_size;
+
+            return true;
+        }
+
+        const uint8_t * data_ = nullptr;
+        uint64_t size_ = 0;
+    };
+
+}
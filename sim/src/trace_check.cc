@@ -0,0 +1,425 @@
+/*!
+ * \file    trace_check.cc
+ * \brief   Checks that every way of reading a trace replays the branch records of a plain decode.
+ *
+ * usage: trace_check [options] <trace>...
+ *
+ * Each trace is decoded once by a plain reader, keeping its edge id sequence and the branch
+ * record of every edge as the reference, and then read again:
+ *  - through a .bt10c trace cache (trace_cache.h), by the reader that writes the cache, by one
+ *    that maps it, and after a seek of the mapped reader. Then an edge id of the cache is
+ *    overwritten with one past the edge table, and reading its block has to fail; the source
+ *    node of an edge is overwritten likewise, and the reader has to rebuild the cache.
+ *  - with a .bt10i seek index (seek_index.h) of a few checkpoints, inline and pipelined, first
+ *    while the index is built and then with the index loaded from its file: after seeks to
+ *    both sides of checkpoints, to the ends of the trace and to spread out branches in no
+ *    particular order, a few blocks are compared, and the rest of the trace after one more seek.
+ *
+ * Every reader has to produce exactly the reference records. With --replays every trace also
+ * has to give the branch records of another one, edge ids included, which checks the round trip
+ * of a trace through a conversion such as trace_columnar. --renumbered allows the edges to be
+ * renumbered one to one, as trace_reencode does. task check_traces runs it on synthetic traces
+ * from trace_generate and their conversions, plus the traces given after --.
+ */
+
+#include <cstddef>
+#include <filesystem>
+#include <functional>
+#include <span>
+#include <vector>
+
+#include <fcntl.h>
+#include <getopt.h>
+#include <unistd.h>
+
+#include "bt9_reader.h"
+
+void PrintUsage(const char* prog)
+{
+  printf("usage: %s [options] <trace>...\n", prog);
+  printf("  -d, --dir DIR           directory of the trace caches and seek indexes written by the checks\n");
+  printf("                          (default: a temporary directory, removed afterwards)\n");
+  printf("  -e, --replays TRACE     also check that every trace replays the branch records of TRACE, edge ids\n");
+  printf("                          included, as a conversion of TRACE by trace_columnar does\n");
+  printf("  -n, --renumbered TRACE  the same, but with the edges of TRACE renumbered as trace_reencode does\n");
+}
+
+// Plain decode of a trace
+struct ReferenceDecode {
+  std::string trace;
+  std::vector<uint32_t> edgeIds;        //!< Edge id of every branch
+  std::vector<bt9::BT9HotEdge> records; //!< Branch record of every edge id
+};
+
+bool SameRecord(const bt9::BT9HotEdge& a, const bt9::BT9HotEdge& b)
+{
+  return (a.pc == b.pc) && (a.target == b.target) && (a.inst_cnt == b.inst_cnt) && (a.edge_id == b.edge_id) &&
+         (a.src_node_id == b.src_node_id) && (a.op_type == b.op_type) && (a.conditional == b.conditional) &&
+         (a.taken == b.taken);
+}
+
+ReferenceDecode DecodeReference(const std::string& trace)
+{
+  ReferenceDecode ref;
+  ref.trace = trace;
+
+  bt9::BT9Reader reader(trace);
+  ref.records.resize(reader.loadStats().num_edges);
+
+  std::vector<bt9::BT9HotEdge> block(BRANCH_BLOCK_SIZE);
+  while (const uint64_t blockSize = reader.readBranchBlock(block)) {
+    for (const bt9::BT9HotEdge& br : std::span(block).first(blockSize)) {
+      ref.edgeIds.push_back(br.edge_id);
+      ref.records[br.edge_id] = br;
+    }
+  }
+
+  return ref;
+}
+
+/*!
+ * \brief Compare `count` branches read from `first` on with the reference, all the rest of the trace by default
+ * \return Returns an empty string if they are the same, else what differs
+ */
+std::string CompareBranches(bt9::BT9Reader& reader, const ReferenceDecode& ref, uint64_t first, uint64_t count = UINT64_MAX)
+{
+  std::vector<bt9::BT9HotEdge> block(BRANCH_BLOCK_SIZE);
+  uint64_t branch = first;
+  while (const uint64_t n = reader.readBranchBlock(std::span(block).first(std::min<uint64_t>(block.size(), count - (branch - first))))) {
+    for (const bt9::BT9HotEdge& br : std::span(block).first(n)) {
+      if ((branch >= ref.edgeIds.size()) || (br.edge_id != ref.edgeIds[branch]) || !SameRecord(br, ref.records[br.edge_id])) {
+        return "branch " + std::to_string(branch) + " differs";
+      }
+      branch++;
+    }
+  }
+
+  if ((branch - first != count) && (branch != ref.edgeIds.size())) {
+    return "ends after " + std::to_string(branch) + " of " + std::to_string(ref.edgeIds.size()) + " branches";
+  }
+  return "";
+}
+
+// Read `size` bytes of a file at `offset`
+bool ReadAt(const std::string& path, uint64_t offset, void* data, size_t size)
+{
+  const int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return false;
+  }
+  const bool ok = (pread(fd, data, size, (off_t)offset) == (ssize_t)size);
+  close(fd);
+  return ok;
+}
+
+// Overwrite `size` bytes of a file at `offset`
+bool WriteAt(const std::string& path, uint64_t offset, const void* data, size_t size)
+{
+  const int fd = open(path.c_str(), O_RDWR);
+  if (fd < 0) {
+    return false;
+  }
+  const bool ok = (pwrite(fd, data, size, (off_t)offset) == (ssize_t)size);
+  close(fd);
+  return ok;
+}
+
+// Read the trace through a trace cache in cacheDir: written, mapped, seeked into, and after damage
+std::string CheckTraceCache(const ReferenceDecode& ref, const std::string& cacheDir)
+{
+  const std::string path = bt9::traceCachePath(cacheDir, ref.trace);
+  std::filesystem::remove(path);
+
+  std::string error;
+  {
+    bt9::BT9Reader writer(ref.trace, false, cacheDir);
+    if (!(error = CompareBranches(writer, ref, 0)).empty()) {
+      return "writing the cache, " + error;
+    }
+  }
+
+  bt9::TraceCacheHeader h;
+  if (!ReadAt(path, 0, &h, sizeof(h))) {
+    return "no cache written to " + path;
+  }
+
+  {
+    bt9::BT9Reader mapped(ref.trace, false, cacheDir);
+    if (!(error = CompareBranches(mapped, ref, 0)).empty()) {
+      return "from the cache, " + error;
+    }
+
+    const uint64_t middle = ref.edgeIds.size() / 2;
+    if (!mapped.seekToBranch(middle)) {
+      return "from the cache, cannot seek to branch " + std::to_string(middle);
+    }
+    if (!(error = CompareBranches(mapped, ref, middle)).empty()) {
+      return "from the cache after a seek, " + error;
+    }
+  }
+
+  // A damaged edge id is not looked for when the cache is mapped, reading its block has to fail
+  if (h.num_branches != 0) {
+    const uint64_t offset = h.ids_offset + h.num_branches / 2 * sizeof(uint32_t);
+    const uint32_t bad = (uint32_t)h.num_edges;
+    uint32_t good = 0;
+    if (!ReadAt(path, offset, &good, sizeof(good)) || !WriteAt(path, offset, &bad, sizeof(bad))) {
+      return "cannot damage the cache edge ids";
+    }
+
+    bool failed = false;
+    try {
+      bt9::BT9Reader damaged(ref.trace, false, cacheDir);
+      CompareBranches(damaged, ref, 0);
+    }
+    catch (const bt9::TraceError&) {
+      failed = true;
+    }
+
+    if (!WriteAt(path, offset, &good, sizeof(good))) {
+      return "cannot repair the cache edge ids";
+    }
+    if (!failed) {
+      return "a cache with a bad edge id was read without an error";
+    }
+  }
+
+  // A damaged edge table is found when the cache is mapped, the reader has to rebuild the cache
+  if (h.num_edges != 0) {
+    const uint64_t offset = h.edges_offset + offsetof(bt9::TraceCacheEdge, src_node_id);
+    const uint32_t bad = (uint32_t)h.num_nodes;
+    uint32_t good = 0;
+    if (!ReadAt(path, offset, &good, sizeof(good)) || !WriteAt(path, offset, &bad, sizeof(bad))) {
+      return "cannot damage the cache edge source node";
+    }
+
+    {
+      bt9::BT9Reader rebuilt(ref.trace, false, cacheDir);
+      if (!(error = CompareBranches(rebuilt, ref, 0)).empty()) {
+        return "from a cache with a bad edge source node, " + error;
+      }
+    }
+
+    uint32_t id = 0;
+    if (!ReadAt(path, offset, &id, sizeof(id)) || (id != good)) {
+      return "a cache with a bad edge source node was not rebuilt";
+    }
+  }
+
+  return "";
+}
+
+// Seek an indexed reader back and forth through the trace, then again with the index loaded from its .bt10i file
+std::string CheckSeekIndex(const ReferenceDecode& ref, const std::string& workDir)
+{
+  const uint64_t numBranches = ref.edgeIds.size();
+  const uint64_t interval = numBranches / 8 + 1;
+  const std::string path = workDir + "/" + std::to_string(bt9::tracePathHash(ref.trace)) + ".bt10i";
+  std::filesystem::remove(path);
+
+  // Both sides of the first checkpoints and the end, then spread out in no particular order
+  std::vector<uint64_t> targets = {0, 1, interval - 1, interval, interval + 1, 2 * interval, numBranches - 1, numBranches};
+  uint64_t x = 1;
+  for (int i = 0; i < 16; i++) {
+    x = x * 6364136223846793005ull + 1442695040888963407ull;
+    targets.push_back((x >> 17) % (numBranches + 1));
+  }
+
+  for (const bool pipelined : {false, true}) {
+    for (const bool written : {true, false}) {
+      bt9::BT9Reader reader(ref.trace, pipelined);
+
+      // Columnar traces have no index and are decoded forward from the start
+      const bool indexed = reader.openSeekIndex(interval, path);
+      if (indexed && written) {
+        bt9::SeekIndexHeader h;
+        if (!ReadAt(path, 0, &h, sizeof(h)) || (memcmp(h.magic, bt9::SEEK_INDEX_MAGIC, sizeof(h.magic)) != 0) ||
+            (h.interval != interval) || (h.num_branches != numBranches)) {
+          return "no index of " + std::to_string(numBranches) + " branches written to " + path;
+        }
+      }
+
+      const char* mode = pipelined ? (written ? "pipelined, building the index" : "pipelined, index loaded") :
+                                     (written ? "building the index" : "index loaded");
+      for (const uint64_t target : targets) {
+        if (target > numBranches) {
+          continue;
+        }
+        if (!reader.seekToBranch(target)) {
+          return std::string(mode) + ", cannot seek to branch " + std::to_string(target);
+        }
+        const std::string error = CompareBranches(reader, ref, target, 3 * BRANCH_BLOCK_SIZE);
+        if (!error.empty()) {
+          return std::string(mode) + ", after a seek to branch " + std::to_string(target) + ", " + error;
+        }
+      }
+
+      if (reader.seekToBranch(numBranches + 1)) {
+        return std::string(mode) + ", seeks past the end of the trace";
+      }
+      reader.seekToBranch(numBranches / 3);
+      const std::string error = CompareBranches(reader, ref, numBranches / 3);
+      if (!error.empty()) {
+        return std::string(mode) + ", to the end after a seek, " + error;
+      }
+
+      if (!indexed) {
+        break;
+      }
+    }
+  }
+
+  std::filesystem::remove(path);
+  return "";
+}
+
+// The trace has to replay the branch records of `expected` exactly, edge ids included
+std::string CheckReplays(const ReferenceDecode& ref, const ReferenceDecode& expected)
+{
+  if (ref.edgeIds.size() != expected.edgeIds.size()) {
+    return std::to_string(ref.edgeIds.size()) + " branches instead of " + std::to_string(expected.edgeIds.size());
+  }
+
+  for (uint64_t i = 0; i < ref.edgeIds.size(); i++) {
+    const uint32_t id = ref.edgeIds[i];
+    if ((id != expected.edgeIds[i]) || !SameRecord(ref.records[id], expected.records[id])) {
+      return "branch " + std::to_string(i) + " differs";
+    }
+  }
+
+  return "";
+}
+
+// The trace has to replay `expected` with every edge under one new id of its own, as trace_reencode renumbers them
+std::string CheckRenumbered(const ReferenceDecode& ref, const ReferenceDecode& expected)
+{
+  if (ref.edgeIds.size() != expected.edgeIds.size()) {
+    return std::to_string(ref.edgeIds.size()) + " branches instead of " + std::to_string(expected.edgeIds.size());
+  }
+
+  std::vector<uint32_t> newId(expected.records.size(), UINT32_MAX);
+  std::vector<uint32_t> oldId(ref.records.size(), UINT32_MAX);
+  for (uint64_t i = 0; i < ref.edgeIds.size(); i++) {
+    const uint32_t id = ref.edgeIds[i];
+    const uint32_t expectedId = expected.edgeIds[i];
+    if (newId[expectedId] == UINT32_MAX) {
+      newId[expectedId] = id;
+    }
+    if (oldId[id] == UINT32_MAX) {
+      oldId[id] = expectedId;
+    }
+    if ((newId[expectedId] != id) || (oldId[id] != expectedId)) {
+      return "branch " + std::to_string(i) + " is not renumbered consistently";
+    }
+
+    bt9::BT9HotEdge record = ref.records[id];
+    record.edge_id = expectedId;
+    if (!SameRecord(record, expected.records[expectedId])) {
+      return "branch " + std::to_string(i) + " differs";
+    }
+  }
+
+  return "";
+}
+
+int main(int argc, char* argv[])
+{
+  std::string workDir;
+  std::string expectedTrace;
+  bool renumbered = false;
+
+  static const struct option longOptions[] = {
+    {"dir",        required_argument, nullptr, 'd'},
+    {"replays",    required_argument, nullptr, 'e'},
+    {"renumbered", required_argument, nullptr, 'n'},
+    {"help",       no_argument,       nullptr, 'h'},
+    {nullptr,      0,                 nullptr,  0 }
+  };
+
+  int opt;
+  while ((opt = getopt_long(argc, argv, "d:e:n:h", longOptions, nullptr)) != -1) {
+    switch (opt) {
+      case 'd':
+        workDir = optarg;
+        break;
+      case 'e':
+        expectedTrace = optarg;
+        renumbered = false;
+        break;
+      case 'n':
+        expectedTrace = optarg;
+        renumbered = true;
+        break;
+      default:
+        PrintUsage(argv[0]);
+        exit(-1);
+    }
+  }
+
+  if (optind == argc) {
+    PrintUsage(argv[0]);
+    exit(-1);
+  }
+
+  const bool tempWorkDir = workDir.empty();
+  if (tempWorkDir) {
+    char dir[] = "/tmp/trace_check.XXXXXX";
+    if (mkdtemp(dir) == nullptr) {
+      fprintf(stderr, "cannot create a temporary directory\n");
+      exit(-1);
+    }
+    workDir = dir;
+  }
+
+  // Checks run on every trace, in order
+  std::vector<std::pair<std::string, std::function<std::string(const ReferenceDecode&)>>> checks = {
+    {"trace cache", [&](const ReferenceDecode& ref) { return CheckTraceCache(ref, workDir); }},
+    {"seek index",  [&](const ReferenceDecode& ref) { return CheckSeekIndex(ref, workDir); }},
+  };
+
+  ReferenceDecode expected;
+  if (!expectedTrace.empty()) {
+    try {
+      expected = DecodeReference(expectedTrace);
+    }
+    catch (const bt9::TraceError& ex) {
+      fprintf(stderr, "%s\n", ex.what());
+      exit(-1);
+    }
+    if (renumbered) {
+      checks.emplace_back("renumbers " + expectedTrace, [&](const ReferenceDecode& ref) { return CheckRenumbered(ref, expected); });
+    }
+    else {
+      checks.emplace_back("replays " + expectedTrace, [&](const ReferenceDecode& ref) { return CheckReplays(ref, expected); });
+    }
+  }
+
+  int failed = 0;
+  for (int i = optind; i < argc; i++) {
+    try {
+      const ReferenceDecode ref = DecodeReference(argv[i]);
+      printf("%s: %llu branches\n", argv[i], (unsigned long long)ref.edgeIds.size());
+      for (const auto& [name, check] : checks) {
+        const std::string error = check(ref);
+        if (error.empty()) {
+          printf("%s: %s OK\n", argv[i], name.c_str());
+        }
+        else {
+          fprintf(stderr, "%s: %s: %s\n", argv[i], name.c_str(), error.c_str());
+          failed++;
+        }
+      }
+    }
+    catch (const bt9::TraceError& ex) {
+      fprintf(stderr, "%s\n", ex.what());
+      failed++;
+    }
+  }
+
+  if (tempWorkDir) {
+    std::error_code ec;
+    std::filesystem::remove_all(workDir, ec);
+  }
+
+  return (failed == 0) ? 0 : -1;
+}
@@ -0,0 +1,320 @@
+/*!
+ * \file    trace_columnar.cc
+ * \brief   Converts BT9 traces to the columnar trace format (.bt9c).
+ *
+ * usage: trace_columnar [options] <input> <output>
+ *        trace_columnar [options] -o <dir> <input>...
+ *
+ * The edge sequence list is split into a node id column, a bit-packed direction column and
+ * a target column holding only the targets of indirect branches (see columnar_trace.h). The
+ * header, node and edge tables are kept, so BT9Reader opens the output like any other trace.
+ *
+ * The output is checked branch by branch against the input, then the size of every column
+ * and the decode time of both traces are reported.
+ */
+
+#include <span>
+#include <vector>
+
+#include <getopt.h>
+
+#include "bt9_reader.h"
+#include "columnar_trace.h"
+
+void PrintUsage(const char* prog)
+{
+  printf("usage: %s [options] <input> <output>\n", prog);
+  printf("       %s [options] -o <dir> <input>...\n", prog);
+  printf("  -o, --output-dir DIR   write every input to DIR, named after it with a .bt9c extension\n");
+  printf("  -L, --level N          zstd compression level of the columns (default: %d)\n", TRACE_WRITER_DEFAULT_LEVEL);
+}
+
+// Compressed and uncompressed size of every column, for the report
+struct ColumnSizes {
+  bt9::ColumnarSection nodeIds;
+  bt9::ColumnarSection directions;
+  bt9::ColumnarSection targets;
+  uint64_t numTargets = 0;
+};
+
+// Append a finished column as the next section of the output
+bt9::ColumnarSection WriteSection(FILE* fout, const bt9::ColumnWriter& column)
+{
+  bt9::ColumnarSection section;
+  section.offset = ftell(fout);
+  section.size = column.compressed().size();
+  section.raw_size = column.rawSize();
+  fwrite(column.compressed().data(), 1, section.size, fout);
+  return section;
+}
+
+bool WriteColumnarTrace(bt9::BT9Reader& reader, const std::string& output, int level, ColumnSizes& sizes)
+{
+  const bt9::BT9LoadStats& tables = reader.loadStats();
+  std::vector<bt9::TraceCacheEdge> edges;
+  edges.reserve(tables.num_edges);
+  for (uint32_t id = 0; id < tables.num_edges; id++) {
+    edges.push_back(reader.edgeRecord_(id));
+  }
+
+  const uint64_t numNodes = tables.num_nodes;
+  bt9::ColumnarEdgeIndex index;
+  if (!index.build(numNodes, edges)) {
+    fprintf(stderr, "%s: edges cannot be told apart by source, direction, destination and target\n", output.c_str());
+    return false;
+  }
+
+  bt9::ColumnarTraceHeader h = {};
+  h.version = bt9::COLUMNAR_TRACE_VERSION;
+  h.node_record_size = sizeof(bt9::TraceCacheNode);
+  h.edge_record_size = sizeof(bt9::TraceCacheEdge);
+  h.node_id_bytes = bt9::columnarNodeIdBytes(numNodes);
+  h.num_nodes = numNodes;
+  h.num_edges = edges.size();
+
+  // The node id of a branch is the destination of the previous one, so every branch is
+  // written once the next one is known
+  bt9::ColumnWriter nodeIds(level);
+  bt9::BitColumnWriter directions(level);
+  bt9::ColumnWriter targets(level);
+  const bt9::TraceCacheEdge* prev = nullptr;
+
+  auto writeBranch = [&](const bt9::TraceCacheEdge& edge, uint32_t dest) {
+    nodeIds.write(&edge.src_node_id, h.node_id_bytes);
+    if (index.needsDirection(edge.src_node_id)) {
+      directions.write(edge.is_taken_path);
+    }
+    auto [first, last] = index.candidates(edge.src_node_id, edge.is_taken_path, dest);
+    if (last - first > 1) {
+      targets.write(&edge.br_virtual_tgt, sizeof(edge.br_virtual_tgt));
+      sizes.numTargets++;
+    }
+  };
+
+  std::vector<bt9::BT9HotEdge> block(BRANCH_BLOCK_SIZE);
+  while (const uint64_t blockSize = reader.readBranchBlock(block)) {
+    for (const bt9::BT9HotEdge& br : std::span(block).first(blockSize)) {
+      const bt9::TraceCacheEdge& edge = edges[br.edge_id];
+      if (prev != nullptr) {
+        if (prev->dest_node_id != edge.src_node_id) {
+          fprintf(stderr, "%s: branch %llu does not start where the previous one ends\n",
+                  output.c_str(), (unsigned long long)h.num_branches);
+          return false;
+        }
+        writeBranch(*prev, edge.src_node_id);
+      }
+      prev = &edge;
+      h.num_branches++;
+    }
+  }
+  if (prev != nullptr) {
+    writeBranch(*prev, prev->dest_node_id);
+    h.last_dest_node_id = prev->dest_node_id;
+  }
+
+  nodeIds.finish();
+  directions.finish();
+  targets.finish();
+
+  bt9::ColumnWriter headerText(level);
+  headerText.write(reader.header_text_.data(), reader.header_text_.size());
+  headerText.finish();
+
+  bt9::ColumnWriter nodes(level);
+  for (uint32_t id = 0; id < numNodes; id++) {
+    const bt9::TraceCacheNode rec = reader.nodeRecord_(id);
+    nodes.write(&rec, sizeof(rec));
+  }
+  nodes.finish();
+
+  bt9::ColumnWriter edgeRecords(level);
+  edgeRecords.write(edges.data(), edges.size() * sizeof(bt9::TraceCacheEdge));
+  edgeRecords.finish();
+
+  FILE* fout = fopen(output.c_str(), "wb");
+  if (fout == nullptr) {
+    fprintf(stderr, "Failed to create \'%s\'\n", output.c_str());
+    return false;
+  }
+
+  // The header is written last, so an interrupted conversion leaves no valid signature
+  fwrite(&h, sizeof(h), 1, fout);
+  h.header_text = WriteSection(fout, headerText);
+  h.nodes = WriteSection(fout, nodes);
+  h.edges = WriteSection(fout, edgeRecords);
+  h.node_ids = WriteSection(fout, nodeIds);
+  h.directions = WriteSection(fout, directions.column());
+  h.targets = WriteSection(fout, targets);
+
+  fflush(fout);
+  memcpy(h.magic, bt9::COLUMNAR_TRACE_MAGIC, sizeof(h.magic));
+  fseek(fout, 0, SEEK_SET);
+  fwrite(&h, sizeof(h), 1, fout);
+
+  const bool ok = !ferror(fout);
+  if ((fclose(fout) != 0) || !ok) {
+    fprintf(stderr, "Failed to write \'%s\'\n", output.c_str());
+    return false;
+  }
+
+  sizes.nodeIds = h.node_ids;
+  sizes.directions = h.directions;
+  sizes.targets = h.targets;
+
+  return true;
+}
+
+// Check that the output replays the input branch by branch
+bool VerifyTrace(const std::string& input, const std::string& output)
+{
+  bt9::BT9Reader in(input);
+  bt9::BT9Reader out(output);
+  std::vector<bt9::BT9HotEdge> inBlock(BRANCH_BLOCK_SIZE);
+  std::vector<bt9::BT9HotEdge> outBlock(BRANCH_BLOCK_SIZE);
+
+  while (true) {
+    const uint64_t inSize = in.readBranchBlock(inBlock);
+    const uint64_t outSize = out.readBranchBlock(outBlock);
+    if (inSize != outSize) {
+      return false;
+    }
+    if (inSize == 0) {
+      return true;
+    }
+
+    for (uint64_t i = 0; i < inSize; i++) {
+      if (inBlock[i].edge_id != outBlock[i].edge_id) {
+        return false;
+      }
+    }
+  }
+}
+
+// Wall time to load a trace and decode its whole edge sequence
+double TimeDecode(const std::string& trace)
+{
+  const auto start = std::chrono::steady_clock::now();
+  bt9::BT9Reader reader(trace);
+  reader.skipBranches(UINT64_MAX);
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Size of a file in bytes, 0 if it does not exist
+uint64_t FileSize(const std::string& name)
+{
+  struct stat st;
+  return (stat(name.c_str(), &st) == 0) ? st.st_size : 0;
+}
+
+bool ConvertTrace(const std::string& input, const std::string& output, int level)
+{
+  struct stat inStat, outStat;
+  if ((stat(input.c_str(), &inStat) == 0) && (stat(output.c_str(), &outStat) == 0) &&
+      (inStat.st_dev == outStat.st_dev) && (inStat.st_ino == outStat.st_ino)) {
+    fprintf(stderr, "%s: refusing to overwrite the input trace\n", input.c_str());
+    return false;
+  }
+
+  ColumnSizes sizes;
+  uint64_t numBranches = 0;
+  {
+    bt9::BT9Reader reader(input);
+    if (!WriteColumnarTrace(reader, output, level, sizes)) {
+      return false;
+    }
+    numBranches = sizes.nodeIds.raw_size / bt9::columnarNodeIdBytes(reader.loadStats().num_nodes);
+  }
+
+  if (!VerifyTrace(input, output)) {
+    fprintf(stderr, "%s: %s does not replay the input trace\n", input.c_str(), output.c_str());
+    return false;
+  }
+
+  const double MB = 1024.0 * 1024.0;
+  const double inBytes = (double)FileSize(input);
+  const double outBytes = (double)FileSize(output);
+  const double inSeconds = TimeDecode(input);
+  const double outSeconds = TimeDecode(output);
+  const double branches = std::max<double>(numBranches, 1);
+
+  printf("%s: %llu branches, %llu indirect targets\n", input.c_str(),
+         (unsigned long long)numBranches, (unsigned long long)sizes.numTargets);
+  printf("  node ids    %9.2f MB  %6.3f bits/branch\n", sizes.nodeIds.size / MB, 8.0 * sizes.nodeIds.size / branches);
+  printf("  directions  %9.2f MB  %6.3f bits/branch\n", sizes.directions.size / MB, 8.0 * sizes.directions.size / branches);
+  printf("  targets     %9.2f MB  %6.3f bits/branch\n", sizes.targets.size / MB, 8.0 * sizes.targets.size / branches);
+  printf("  input       %9.2f MB  decode %.3f s\n", inBytes / MB, inSeconds);
+  printf("  output      %9.2f MB  decode %.3f s  (size %+.1f%%, decode %+.1f%%)\n",
+         outBytes / MB, outSeconds, 100.0 * (outBytes - inBytes) / inBytes, 100.0 * (outSeconds - inSeconds) / inSeconds);
+
+  return true;
+}
+
+// Output name for an input written to a directory: its file name without the .bt9.trace.zst suffixes, plus .bt9c
+std::string OutputName(const std::string& outputDir, const std::string& input)
+{
+  std::string name = input.substr(input.find_last_of('/') + 1);
+  for (const char* suffix : {".zst", ".trace", ".bt9"}) {
+    const size_t n = strlen(suffix);
+    if ((name.size() > n) && (name.compare(name.size() - n, n, suffix) == 0)) {
+      name.resize(name.size() - n);
+    }
+  }
+  return outputDir + "/" + name + ".bt9c";
+}
+
+int main(int argc, char* argv[])
+{
+  std::string outputDir;
+  int level = TRACE_WRITER_DEFAULT_LEVEL;
+
+  static const struct option longOptions[] = {
+    {"output-dir", required_argument, nullptr, 'o'},
+    {"level",      required_argument, nullptr, 'L'},
+    {"help",       no_argument,       nullptr, 'h'},
+    {nullptr,      0,                 nullptr,  0 }
+  };
+
+  int opt;
+  while ((opt = getopt_long(argc, argv, "o:L:h", longOptions, nullptr)) != -1) {
+    switch (opt) {
+      case 'o':
+        outputDir = optarg;
+        break;
+      case 'L':
+        level = atoi(optarg);
+        break;
+      default:
+        PrintUsage(argv[0]);
+        exit(-1);
+    }
+  }
+
+  std::vector<std::pair<std::string, std::string>> jobs;
+  if (!outputDir.empty()) {
+    mkdir(outputDir.c_str(), 0777);
+    for (int i = optind; i < argc; i++) {
+      jobs.emplace_back(argv[i], OutputName(outputDir, argv[i]));
+    }
+  }
+  else if (argc - optind == 2) {
+    jobs.emplace_back(argv[optind], argv[optind + 1]);
+  }
+
+  if (jobs.empty()) {
+    PrintUsage(argv[0]);
+    exit(-1);
+  }
+
+  int failed = 0;
+  for (const auto& [input, output] : jobs) {
+    try {
+      failed += !ConvertTrace(input, output, level);
+    }
+    catch (const bt9::TraceError& ex) {
+      fprintf(stderr, "%s\n", ex.what());
+      failed++;
+    }
+  }
+
+  return (failed == 0) ? 0 : -1;
+}
@@ -0,0 +1,25 @@
+/*!
+ * \file    trace_error.h
+ * \brief   Exception thrown by the trace reader on malformed or unreadable traces.
+ */
+
+#pragma once
+
+#include <stdexcept>
+#include <string>
+
+namespace bt9 {
+
+    /*!
+     * \class TraceError
+     * \brief Raised instead of exiting when a trace cannot be read, so callers such as the fuzz
+     *        harness can carry on with the next input
+     * \note The reader is left in an unspecified state and must be destroyed, not read further
+     */
+    class TraceError : public std::runtime_error
+    {
+    public:
+        using std::runtime_error::runtime_error;
+    };
+
+}
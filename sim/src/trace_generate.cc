@@ -0,0 +1,579 @@
+/*!
+ * \file    trace_generate.cc
+ * \brief   Generates deterministic synthetic BT9 traces for benchmarking without the CBP traces.
+ *
+ * usage: trace_generate [options] <output>
+ *
+ * The trace is a walk over a synthetic program made of functions. A function is a run of
+ * branch sites, each ending a basic block; the last site of a function returns (function 0
+ * jumps back to its start instead). A site is one of
+ *   - a loop branch, taken back to an earlier site a fixed number of times before exiting,
+ *   - a correlated branch, the XOR of two earlier outcomes in the global history,
+ *   - a random branch, taken with a fixed probability,
+ *   - an unconditional jump to the next site,
+ *   - a direct call or an indirect call (round-robin or random over its callees), always to
+ *     a function with a higher number so the call depth stays bounded.
+ *
+ * The program and the walk depend on the seed only, so a seed and a set of options always
+ * give the same trace. The walk is run twice: the first pass counts the traversals for the
+ * header, node and edge tables, the second streams the BT10 edge sequence, so traces of
+ * billions of branches need no memory beyond the program. Edges are numbered hottest first
+ * like trace_reencode does. The output is zstd compressed when its name ends with ".zst".
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <limits>
+#include <numeric>
+#include <vector>
+
+#include <getopt.h>
+
+#include "bt9_reader.h"
+#include "trace_writer.h"
+
+struct GenerateOptions {
+  uint64_t branches = 10000000;   // branches after the leading dummy edge
+  uint64_t seed = 1;
+  uint32_t functions = 64;
+  uint32_t sites = 24;            // average branch sites per function
+  double loops = 0.3;             // relative weights of the conditional branch kinds
+  double correlated = 0.4;
+  double random = 0.3;
+  double calls = 0.15;            // share of sites that are calls
+  double indirect = 0.25;         // share of calls that are indirect
+  uint32_t maxTrip = 16;          // loop trip counts are drawn from [2, maxTrip]
+  uint32_t maxTargets = 8;        // callees of an indirect call are drawn from [2, maxTargets]
+  uint32_t maxBlock = 12;         // non-branch instructions before a branch are drawn from [0, maxBlock]
+  int level = 3;                  // TRACE_WRITER_DEFAULT_LEVEL is too slow for billions of branches
+};
+
+void PrintUsage(const char* prog)
+{
+  const GenerateOptions d;
+  printf("usage: %s [options] <output>\n", prog);
+  printf("  -n, --branches N      branches to generate, k/M/G suffixes allowed (default: %llu)\n", (unsigned long long)d.branches);
+  printf("  -s, --seed N          seed of the program and of the walk (default: %llu)\n", (unsigned long long)d.seed);
+  printf("  -F, --functions N     functions in the program (default: %u)\n", d.functions);
+  printf("  -S, --sites N         average branch sites per function (default: %u)\n", d.sites);
+  printf("  -l, --loops W         weight of loop branches among conditional ones (default: %.2f)\n", d.loops);
+  printf("  -c, --correlated W    weight of history correlated branches (default: %.2f)\n", d.correlated);
+  printf("  -r, --random W        weight of random branches (default: %.2f)\n", d.random);
+  printf("  -C, --calls P         share of sites that are calls (default: %.2f)\n", d.calls);
+  printf("  -i, --indirect P      share of calls that are indirect (default: %.2f)\n", d.indirect);
+  printf("  -t, --max-trip N      largest loop trip count (default: %u)\n", d.maxTrip);
+  printf("  -T, --max-targets N   largest number of indirect call targets (default: %u)\n", d.maxTargets);
+  printf("  -L, --level N         zstd compression level for .zst outputs (default: %d)\n", d.level);
+}
+
+// xorshift64* generator; the standard distributions are implementation defined, this gives
+// the same trace for a seed on every platform
+class Rng {
+public:
+  explicit Rng(uint64_t seed) : state_(seed * 0x9e3779b97f4a7c15ull + 0x2545f4914f6cdd1dull) {}
+
+  uint64_t next()
+  {
+    state_ ^= state_ >> 12;
+    state_ ^= state_ << 25;
+    state_ ^= state_ >> 27;
+    return state_ * 0x2545f4914f6cdd1dull;
+  }
+
+  // Uniform in [0, n)
+  uint32_t below(uint32_t n) { return static_cast<uint32_t>(((next() >> 32) * n) >> 32); }
+
+  // Uniform in [lo, hi]
+  uint32_t between(uint32_t lo, uint32_t hi) { return lo + below(hi - lo + 1); }
+
+  // Uniform in [0, 1)
+  double uniform() { return static_cast<double>(next() >> 11) * 0x1.0p-53; }
+
+private:
+  uint64_t state_;
+};
+
+enum class SiteKind : uint8_t { LOOP, CORRELATED, RANDOM, JUMP, CALL, INDIRECT_CALL, RETURN };
+
+// A branch site; site s is node s + 1 of the trace, node 0 is the dummy source of the first edge
+struct Site {
+  SiteKind kind = SiteKind::JUMP;
+  uint64_t pc = 0;
+  uint64_t blockStart = 0;        // address of the basic block ending with this branch
+  uint32_t blockLen = 0;          // non-branch instructions in the basic block
+  uint32_t takenDest = 0;         // site reached when taken (conditionals and jumps)
+  uint32_t edges[2] = {0, 0};     // not-taken and taken edge (conditionals and jumps)
+
+  uint32_t tripCount = 0;         // LOOP
+  double bias = 0.0;              // RANDOM
+  uint8_t histA = 0;              // CORRELATED: outcome = hist[histA] ^ hist[histB] ^ invert
+  uint8_t histB = 0;
+  bool invert = false;
+
+  bool roundRobin = false;        // INDIRECT_CALL
+  std::vector<uint32_t> callees;  // CALL, INDIRECT_CALL: entry site of each callee
+  std::vector<uint32_t> callEdges;
+  std::vector<uint32_t> returnEdges;  // edge from the return of each callee back to the next site
+};
+
+struct GeneratedEdge {
+  uint32_t src = 0;               // node ids
+  uint32_t dest = 0;
+  bool taken = false;
+  uint64_t target = 0;
+  uint32_t instCnt = 0;
+};
+
+// The synthetic program: its sites and every edge a walk over it can traverse
+struct Program {
+  std::vector<Site> sites;
+  std::vector<GeneratedEdge> edges;
+  std::vector<uint32_t> functionEntry;
+  std::vector<uint32_t> functionReturn;
+
+  uint32_t addEdge(uint32_t src, uint32_t dest, bool taken)
+  {
+    GeneratedEdge& edge = edges.emplace_back();
+    edge.src = src + 1;
+    edge.dest = dest + 1;
+    edge.taken = taken;
+    edge.target = taken ? sites[dest].blockStart : sites[src].pc + 4;
+    edge.instCnt = sites[dest].blockLen;
+    return static_cast<uint32_t>(edges.size() - 1);
+  }
+};
+
+Program BuildProgram(const GenerateOptions& opt)
+{
+  Rng rng(opt.seed);
+  Program prog;
+  const uint32_t numFunctions = std::max<uint32_t>(opt.functions, 1);
+  const double condWeight = std::max(opt.loops + opt.correlated + opt.random, 1e-9);
+
+  // Lay out the functions: every site is a basic block followed by a 4-byte branch
+  uint64_t addr = 0x400000;
+  for (uint32_t f = 0; f < numFunctions; f++) {
+    const uint32_t numSites = std::max<uint32_t>(rng.between(opt.sites / 2, opt.sites + opt.sites / 2), 2);
+    prog.functionEntry.push_back(static_cast<uint32_t>(prog.sites.size()));
+    for (uint32_t i = 0; i < numSites; i++) {
+      Site& site = prog.sites.emplace_back();
+      site.blockLen = rng.between(0, opt.maxBlock);
+      site.blockStart = addr;
+      site.pc = addr + 4ull * site.blockLen;
+      addr = site.pc + 4;
+    }
+    prog.functionReturn.push_back(static_cast<uint32_t>(prog.sites.size() - 1));
+    addr = (addr + 0xff) & ~0xffull;
+  }
+
+  for (uint32_t f = 0; f < numFunctions; f++) {
+    const uint32_t first = prog.functionEntry[f];
+    const uint32_t last = prog.functionReturn[f];
+
+    for (uint32_t s = first; s <= last; s++) {
+      Site& site = prog.sites[s];
+
+      if (s == last) {
+        // Function 0 is the outermost loop of the program and never returns
+        site.kind = (f == 0) ? SiteKind::JUMP : SiteKind::RETURN;
+        site.takenDest = first;
+      }
+      else if ((f + 1 < numFunctions) && (rng.uniform() < opt.calls)) {
+        site.kind = (rng.uniform() < opt.indirect) ? SiteKind::INDIRECT_CALL : SiteKind::CALL;
+        const uint32_t numCallees = (site.kind == SiteKind::CALL) ? 1 : rng.between(2, std::max<uint32_t>(opt.maxTargets, 2));
+        for (uint32_t k = 0; k < numCallees; k++) {
+          const uint32_t callee = prog.functionEntry[rng.between(f + 1, numFunctions - 1)];
+          if (std::find(site.callees.begin(), site.callees.end(), callee) == site.callees.end()) {
+            site.callees.push_back(callee);
+          }
+        }
+        site.roundRobin = (rng.uniform() < 0.5);
+      }
+      else if (rng.uniform() < 0.1) {
+        site.kind = SiteKind::JUMP;
+        site.takenDest = s + 1;
+      }
+      else {
+        const double kind = rng.uniform() * condWeight;
+        if (kind < opt.loops) {
+          site.kind = SiteKind::LOOP;
+          site.takenDest = rng.between(std::max<uint32_t>(first, s - std::min<uint32_t>(s, 6)), s);
+          site.tripCount = rng.between(2, std::max<uint32_t>(opt.maxTrip, 2));
+        }
+        else {
+          site.kind = (kind < opt.loops + opt.correlated) ? SiteKind::CORRELATED : SiteKind::RANDOM;
+          site.takenDest = std::min(s + 2, last);
+          site.histA = static_cast<uint8_t>(rng.between(1, 16));
+          site.histB = static_cast<uint8_t>(rng.between(1, 16));
+          site.invert = (rng.uniform() < 0.5);
+          static const double biases[] = {0.5, 0.1, 0.9, 0.02, 0.98};
+          site.bias = biases[rng.below(5)];
+        }
+      }
+    }
+  }
+
+  // Edge 0 is the dummy edge entering the program
+  prog.edges.push_back({0, 1, true, prog.sites[0].blockStart, prog.sites[0].blockLen});
+
+  for (uint32_t s = 0; s < prog.sites.size(); s++) {
+    Site& site = prog.sites[s];
+    switch (site.kind) {
+      case SiteKind::LOOP:
+      case SiteKind::CORRELATED:
+      case SiteKind::RANDOM:
+        site.edges[0] = prog.addEdge(s, s + 1, false);
+        site.edges[1] = prog.addEdge(s, site.takenDest, true);
+        break;
+      case SiteKind::JUMP:
+        site.edges[1] = prog.addEdge(s, site.takenDest, true);
+        break;
+      case SiteKind::CALL:
+      case SiteKind::INDIRECT_CALL:
+        for (const uint32_t callee : site.callees) {
+          site.callEdges.push_back(prog.addEdge(s, callee, true));
+        }
+        break;
+      case SiteKind::RETURN:
+        break;
+    }
+  }
+
+  // Returns lead back to the site after each call
+  for (uint32_t s = 0; s < prog.sites.size(); s++) {
+    Site& site = prog.sites[s];
+    for (const uint32_t callee : site.callees) {
+      const uint32_t ret = prog.functionReturn[std::upper_bound(prog.functionEntry.begin(), prog.functionEntry.end(), callee) -
+                                               prog.functionEntry.begin() - 1];
+      site.returnEdges.push_back(prog.addEdge(ret, s + 1, true));
+    }
+  }
+
+  return prog;
+}
+
+// One walk over the program, the same sequence of edges for the same program and seed
+class Walk {
+public:
+  Walk(const Program& prog, uint64_t seed) :
+    prog_(prog),
+    rng_(seed ^ 0x5bd1e9955bd1e995ull),
+    loopCount_(prog.sites.size(), 0),
+    nextCallee_(prog.sites.size(), 0)
+  {}
+
+  // Take the branch at the current site and return the id of the edge traversed
+  uint32_t step()
+  {
+    const Site& site = prog_.sites[site_];
+    uint32_t edge = 0;
+
+    switch (site.kind) {
+      case SiteKind::LOOP:
+      case SiteKind::CORRELATED:
+      case SiteKind::RANDOM: {
+        bool taken;
+        if (site.kind == SiteKind::LOOP) {
+          taken = (++loopCount_[site_] < site.tripCount);
+          loopCount_[site_] = taken ? loopCount_[site_] : 0;
+        }
+        else if (site.kind == SiteKind::CORRELATED) {
+          taken = (((history_ >> site.histA) ^ (history_ >> site.histB)) & 1) ^ site.invert;
+        }
+        else {
+          taken = (rng_.uniform() < site.bias);
+        }
+        history_ = (history_ << 1) | taken;
+        edge = site.edges[taken];
+        site_ = taken ? site.takenDest : site_ + 1;
+        break;
+      }
+      case SiteKind::JUMP:
+        edge = site.edges[1];
+        site_ = site.takenDest;
+        break;
+      case SiteKind::CALL:
+      case SiteKind::INDIRECT_CALL: {
+        const uint32_t n = static_cast<uint32_t>(site.callees.size());
+        const uint32_t k = site.roundRobin ? (nextCallee_[site_]++ % n) : rng_.below(n);
+        stack_.push_back({site.returnEdges[k], site_ + 1});
+        edge = site.callEdges[k];
+        site_ = site.callees[k];
+        break;
+      }
+      case SiteKind::RETURN:
+        edge = stack_.back().first;
+        site_ = stack_.back().second;
+        stack_.pop_back();
+        break;
+    }
+
+    return edge;
+  }
+
+private:
+  const Program& prog_;
+  Rng rng_;
+  uint32_t site_ = 0;
+  uint64_t history_ = 0;
+  std::vector<uint32_t> loopCount_;
+  std::vector<uint32_t> nextCallee_;
+  std::vector<std::pair<uint32_t, uint32_t>> stack_;  // return edge and the site it leads to
+};
+
+// Node and edge tables in BT9 text, edges renumbered by newId and counts from the first pass
+void WriteTables(const GenerateOptions& opt, const Program& prog, const std::vector<uint64_t>& counts,
+                 const std::vector<uint32_t>& order, uint64_t instructions, bt9::TraceWriter& writer)
+{
+  char line[512];
+  auto emit = [&](int n) { writer.write(std::string_view(line, std::min<size_t>(n, sizeof(line) - 1))); };
+
+  emit(snprintf(line, sizeof(line),
+                "BT9_SPA_TRACE_FORMAT\n"
+                "bt9_minor_version: 0\n"
+                "has_physical_address: 0\n"
+                "md5_checksum: 0\n"
+                "conversion_date: 0\n"
+                "original_stf_input_file: synthetic\n"
+                "total_instruction_count: %llu\n"
+                "branch_instruction_count: %llu\n",
+                (unsigned long long)instructions, (unsigned long long)(opt.branches + 1)));
+  emit(snprintf(line, sizeof(line),
+                "# trace_generate -n %llu -s %llu -F %u -S %u -l %g -c %g -r %g -C %g -i %g -t %u -T %u\n",
+                (unsigned long long)opt.branches, (unsigned long long)opt.seed, opt.functions, opt.sites,
+                opt.loops, opt.correlated, opt.random, opt.calls, opt.indirect, opt.maxTrip, opt.maxTargets));
+
+  // Observed per node direction and target counts
+  std::vector<uint64_t> takenCnt(prog.sites.size() + 1, 0);
+  std::vector<uint64_t> notTakenCnt(prog.sites.size() + 1, 0);
+  std::vector<uint32_t> tgtCnt(prog.sites.size() + 1, 0);
+  for (uint32_t e = 1; e < prog.edges.size(); e++) {
+    const GeneratedEdge& edge = prog.edges[e];
+    (edge.taken ? takenCnt : notTakenCnt)[edge.src] += counts[e];
+    tgtCnt[edge.src] += (edge.taken && (counts[e] != 0));
+  }
+
+  writer.write("BT9_NODES\n#NODE id virtual_address physical_address opcode size\nNODE 0 0 - 0 0\n");
+  const uint64_t maxCnt = std::numeric_limits<uint32_t>::max();
+  for (uint32_t s = 0; s < prog.sites.size(); s++) {
+    const Site& site = prog.sites[s];
+    const uint32_t node = s + 1;
+    const char* cls = "JMP+DIR+CND";
+    const char* direction = "DYN";
+    const char* indirectness = "DIR";
+    uint32_t opcode = 0x74;
+
+    switch (site.kind) {
+      case SiteKind::LOOP:
+      case SiteKind::CORRELATED:
+      case SiteKind::RANDOM:
+        direction = (notTakenCnt[node] == 0) ? ((takenCnt[node] == 0) ? "DYN" : "AT") : ((takenCnt[node] == 0) ? "ANT" : "DYN");
+        break;
+      case SiteKind::JUMP:
+        cls = "JMP+DIR+UCD";
+        direction = "AT";
+        opcode = 0xe9;
+        break;
+      case SiteKind::CALL:
+        cls = "CALL+DIR+UCD";
+        direction = "AT";
+        opcode = 0xe8;
+        break;
+      case SiteKind::INDIRECT_CALL:
+        cls = "CALL+IND+UCD";
+        direction = "AT";
+        indirectness = "IND";
+        opcode = 0xff;
+        break;
+      case SiteKind::RETURN:
+        cls = "RET+UCD";
+        direction = "AT";
+        indirectness = "IND";
+        opcode = 0xc3;
+        break;
+    }
+
+    emit(snprintf(line, sizeof(line),
+                  "NODE %u 0x%llx - 0x%x 4 class: %s behavior: %s+%s taken_cnt: %llu not_taken_cnt: %llu tgt_cnt: %u\n",
+                  node, (unsigned long long)site.pc, opcode, cls, direction, indirectness,
+                  (unsigned long long)std::min(takenCnt[node], maxCnt), (unsigned long long)std::min(notTakenCnt[node], maxCnt),
+                  tgtCnt[node]));
+  }
+
+  writer.write("BT9_EDGES\n#EDGE id src_id dest_id taken br_virt_target br_phy_target inst_cnt\n");
+  for (uint32_t id = 0; id < order.size(); id++) {
+    const GeneratedEdge& edge = prog.edges[order[id]];
+    emit(snprintf(line, sizeof(line), "EDGE %u %u %u %c 0x%llx - %u traverse_cnt: %llu\n",
+                  id, edge.src, edge.dest, edge.taken ? 'T' : 'N', (unsigned long long)edge.target,
+                  edge.instCnt, (unsigned long long)counts[order[id]]));
+  }
+
+  writer.write("BT10_SMALL_INDEX_SIZE_8\nBT10_BIG_INDEX_SIZE_32\n");
+}
+
+// Parse a count with an optional k, M or G suffix
+uint64_t ParseCount(const char* str)
+{
+  char* end = nullptr;
+  uint64_t value = strtoull(str, &end, 0);
+  switch (*end) {
+    case 'k': case 'K': value *= 1000ull; break;
+    case 'm': case 'M': value *= 1000000ull; break;
+    case 'g': case 'G': value *= 1000000000ull; break;
+    default: break;
+  }
+  return value;
+}
+
+bool GenerateTrace(const GenerateOptions& opt, const std::string& output)
+{
+  const auto start = std::chrono::steady_clock::now();
+  const Program prog = BuildProgram(opt);
+
+  // First pass: traversal counts and instruction count for the tables and the header
+  std::vector<uint64_t> counts(prog.edges.size(), 0);
+  counts[0] = 1;
+  uint64_t instructions = prog.edges[0].instCnt + 1;
+  {
+    Walk walk(prog, opt.seed);
+    for (uint64_t i = 0; i < opt.branches; i++) {
+      const uint32_t e = walk.step();
+      counts[e]++;
+      instructions += prog.edges[e].instCnt + 1;
+    }
+  }
+
+  // Hottest first; equally hot edges keep their relative order
+  std::vector<uint32_t> order(prog.edges.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return counts[a] > counts[b]; });
+  std::vector<uint32_t> newId(order.size());
+  for (uint32_t i = 0; i < order.size(); i++) {
+    newId[order[i]] = i;
+  }
+
+  // Second pass: the same walk, written out
+  bt9::TraceWriter writer(output, opt.level);
+  WriteTables(opt, prog, counts, order, instructions, writer);
+  {
+    Walk walk(prog, opt.seed);
+    writer.writeEdgeId(newId[0]);
+    for (uint64_t i = 0; i < opt.branches; i++) {
+      writer.writeEdgeId(newId[walk.step()]);
+    }
+  }
+  writer.writeEdgeSequenceEnd();
+
+  if (!writer.close()) {
+    fprintf(stderr, "Failed to write \'%s\'\n", output.c_str());
+    return false;
+  }
+  const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  // The reader has to see every branch
+  bt9::BT9Reader reader(output);
+  const uint64_t numBranches = reader.skipBranches(UINT64_MAX);
+  if (numBranches != opt.branches + 1) {
+    fprintf(stderr, "%s: read back %llu branches, expected %llu\n", output.c_str(),
+            (unsigned long long)numBranches, (unsigned long long)(opt.branches + 1));
+    return false;
+  }
+
+  uint64_t conditional = 0;
+  uint64_t taken = 0;
+  for (uint32_t e = 1; e < prog.edges.size(); e++) {
+    const Site& site = prog.sites[prog.edges[e].src - 1];
+    const bool isConditional = (site.kind == SiteKind::LOOP) || (site.kind == SiteKind::CORRELATED) || (site.kind == SiteKind::RANDOM);
+    conditional += isConditional ? counts[e] : 0;
+    taken += (isConditional && prog.edges[e].taken) ? counts[e] : 0;
+  }
+
+  const double MB = 1024.0 * 1024.0;
+  printf("%s: %llu branches, %llu instructions, %zu nodes, %zu edges\n", output.c_str(),
+         (unsigned long long)opt.branches, (unsigned long long)instructions, prog.sites.size() + 1, prog.edges.size());
+  printf("  %.1f%% conditional (%.1f%% of them taken), %.2f MB written in %.3f s (%.1f M branches/s)\n",
+         100.0 * conditional / std::max<uint64_t>(opt.branches, 1), 100.0 * taken / std::max<uint64_t>(conditional, 1),
+         writer.fileBytes() / MB, seconds, 2.0 * opt.branches / seconds / 1e6);
+
+  return true;
+}
+
+int main(int argc, char* argv[])
+{
+  GenerateOptions opt;
+
+  static const struct option longOptions[] = {
+    {"branches",    required_argument, nullptr, 'n'},
+    {"seed",        required_argument, nullptr, 's'},
+    {"functions",   required_argument, nullptr, 'F'},
+    {"sites",       required_argument, nullptr, 'S'},
+    {"loops",       required_argument, nullptr, 'l'},
+    {"correlated",  required_argument, nullptr, 'c'},
+    {"random",      required_argument, nullptr, 'r'},
+    {"calls",       required_argument, nullptr, 'C'},
+    {"indirect",    required_argument, nullptr, 'i'},
+    {"max-trip",    required_argument, nullptr, 't'},
+    {"max-targets", required_argument, nullptr, 'T'},
+    {"level",       required_argument, nullptr, 'L'},
+    {"help",        no_argument,       nullptr, 'h'},
+    {nullptr,       0,                 nullptr,  0 }
+  };
+
+  int opt_char;
+  while ((opt_char = getopt_long(argc, argv, "n:s:F:S:l:c:r:C:i:t:T:L:h", longOptions, nullptr)) != -1) {
+    switch (opt_char) {
+      case 'n':
+        opt.branches = ParseCount(optarg);
+        break;
+      case 's':
+        opt.seed = strtoull(optarg, nullptr, 0);
+        break;
+      case 'F':
+        opt.functions = atoi(optarg);
+        break;
+      case 'S':
+        opt.sites = atoi(optarg);
+        break;
+      case 'l':
+        opt.loops = atof(optarg);
+        break;
+      case 'c':
+        opt.correlated = atof(optarg);
+        break;
+      case 'r':
+        opt.random = atof(optarg);
+        break;
+      case 'C':
+        opt.calls = atof(optarg);
+        break;
+      case 'i':
+        opt.indirect = atof(optarg);
+        break;
+      case 't':
+        opt.maxTrip = atoi(optarg);
+        break;
+      case 'T':
+        opt.maxTargets = atoi(optarg);
+        break;
+      case 'L':
+        opt.level = atoi(optarg);
+        break;
+      default:
+        PrintUsage(argv[0]);
+        exit(-1);
+    }
+  }
+
+  if (optind != argc - 1) {
+    PrintUsage(argv[0]);
+    exit(-1);
+  }
+
+  try {
+    return GenerateTrace(opt, argv[optind]) ? 0 : -1;
+  }
+  catch (const bt9::TraceError& ex) {
+    fprintf(stderr, "%s\n", ex.what());
+    return -1;
+  }
+}
@@ -0,0 +1,81 @@
+/*!
+ * \file    trace_info.cc
+ * \brief   Summarizes traces from their header and tables, cached in a sidecar next to each trace.
+ *
+ * usage: trace_info [options] <trace>...
+ *
+ * Only the header, node and edge tables are read. The summary holds the header instruction
+ * and branch counts, the node and edge counts, the size of the BT10 edge sequence (from the
+ * traverse counts of the edge table) and an estimate of the simulation time, so schedulers
+ * and samplers can order and partition work without running the simulator.
+ *
+ * Summaries are written as JSON to <trace>.info, stamped with the size and modification time
+ * of the trace, and reused until the trace changes. All summaries are printed to stdout as
+ * one JSON object keyed by trace name.
+ */
+
+#include <iostream>
+
+#include <getopt.h>
+
+#include <cereal/archives/json.hpp>
+
+#include "trace_info.h"
+
+void PrintUsage(const char* prog)
+{
+  printf("usage: %s [options] <trace>...\n", prog);
+  printf("  -f, --force    rebuild the summaries even if their .info files are up to date\n");
+}
+
+int main(int argc, char* argv[])
+{
+  bool force = false;
+
+  static const struct option longOptions[] = {
+    {"force", no_argument, nullptr, 'f'},
+    {"help",  no_argument, nullptr, 'h'},
+    {nullptr, 0,           nullptr,  0 }
+  };
+
+  int opt;
+  while ((opt = getopt_long(argc, argv, "fh", longOptions, nullptr)) != -1) {
+    switch (opt) {
+      case 'f':
+        force = true;
+        break;
+      default:
+        PrintUsage(argv[0]);
+        exit(-1);
+    }
+  }
+
+  if (optind == argc) {
+    PrintUsage(argv[0]);
+    exit(-1);
+  }
+
+  int failed = 0;
+  cereal::JSONOutputArchive archive(std::cout);
+  for (int i = optind; i < argc; i++) {
+    const std::string trace = argv[i];
+    TraceInfo info;
+    if (force || !ReadTraceInfo(trace, info)) {
+      // Unreadable traces are left out of the output
+      try {
+        info = BuildTraceInfo(trace);
+      }
+      catch (const bt9::TraceError& ex) {
+        std::cerr << ex.what() << '\n';
+        failed++;
+        continue;
+      }
+      if (!WriteTraceInfo(trace, info)) {
+        std::cerr << "Failed to write trace info \'" << TraceInfoPath(trace) << "\'\n";
+      }
+    }
+    archive(cereal::make_nvp(trace.c_str(), info));
+  }
+
+  return (failed == 0) ? 0 : -1;
+}
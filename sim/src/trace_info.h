@@ -0,0 +1,165 @@
+/*!
+ * \file    trace_info.h
+ * \brief   Per-trace summaries cached in a sidecar next to each trace, see trace_info.cc.
+ *
+ * Shared by the trace_info tool, which builds the summaries, and the simulator, which orders
+ * the traces of a batch run by their estimated simulation time.
+ */
+
+#pragma once
+
+#include <cstdio>
+#include <fstream>
+#include <string>
+
+#include <unistd.h>
+
+#include <cereal/archives/json.hpp>
+#include <cereal/types/string.hpp>
+
+#include "bt9_reader.h"
+
+// Bump whenever a field of TraceInfo is added, removed or changes meaning
+inline constexpr uint32_t TRACE_INFO_VERSION = 1;
+
+struct TraceInfo {
+  uint32_t version = TRACE_INFO_VERSION;
+  uint64_t sourceSize = 0;
+  int64_t sourceMtimeNs = 0;
+  std::string format;                   // "bt9", "bt9.zst" or "bt9c"
+  uint64_t totalInstructionCount = 0;   // header fields, 0 when missing
+  uint64_t branchInstructionCount = 0;
+  uint64_t numNodes = 0;
+  uint64_t numEdges = 0;
+  uint64_t staticBranches = 0;          // nodes other than the dummy node 0
+  uint64_t staticConditionalBranches = 0;
+  uint64_t edgeSequenceBytes = 0;       // BT10 bytes of the edge sequence, estimated for columnar traces
+  double loadSeconds = 0.0;             // measured while building the summary
+  double estDecodeSeconds = 0.0;
+  double estSimSeconds = 0.0;           // load, decode and a TRACE_INFO_SIM_NS_PER_BRANCH predictor
+
+  template <class Archive>
+  void serialize(Archive& archive)
+  {
+    archive(cereal::make_nvp("version", version),
+            cereal::make_nvp("source_size", sourceSize),
+            cereal::make_nvp("source_mtime_ns", sourceMtimeNs),
+            cereal::make_nvp("format", format),
+            cereal::make_nvp("total_instruction_count", totalInstructionCount),
+            cereal::make_nvp("branch_instruction_count", branchInstructionCount),
+            cereal::make_nvp("num_nodes", numNodes),
+            cereal::make_nvp("num_edges", numEdges),
+            cereal::make_nvp("static_branches", staticBranches),
+            cereal::make_nvp("static_conditional_branches", staticConditionalBranches),
+            cereal::make_nvp("edge_sequence_bytes", edgeSequenceBytes),
+            cereal::make_nvp("load_seconds", loadSeconds),
+            cereal::make_nvp("est_decode_seconds", estDecodeSeconds),
+            cereal::make_nvp("est_sim_seconds", estSimSeconds));
+  }
+};
+
+// Sidecar name of a trace
+inline std::string TraceInfoPath(const std::string& trace)
+{
+  return trace + ".info";
+}
+
+// Integer header field, 0 when missing or malformed
+inline uint64_t HeaderCount(const bt9::BT9Reader& reader, const std::string& key)
+{
+  std::string value;
+  if (!reader.header.getFieldValueStr(key, value)) {
+    return 0;
+  }
+  try {
+    return std::stoull(value, nullptr, 0);
+  }
+  catch (const std::exception&) {
+    return 0;
+  }
+}
+
+inline TraceInfo BuildTraceInfo(const std::string& trace)
+{
+  TraceInfo info;
+  bt9::traceFileStamp(trace, info.sourceSize, info.sourceMtimeNs);
+
+  const bt9::BT9Reader reader(trace);
+  const bt9::BT9LoadStats& tables = reader.loadStats();
+
+  info.format = bt9::isColumnarTrace(trace) ? "bt9c" : (trace.find(".zst") != std::string::npos) ? "bt9.zst" : "bt9";
+  info.totalInstructionCount = HeaderCount(reader, "total_instruction_count:");
+  info.branchInstructionCount = HeaderCount(reader, "branch_instruction_count:");
+  info.numNodes = tables.num_nodes;
+  info.numEdges = tables.num_edges;
+  info.staticBranches = (tables.num_nodes > 0) ? tables.num_nodes - 1 : 0;
+  info.loadSeconds = tables.load_seconds;
+
+  for (uint32_t id = 1; id < tables.num_nodes; id++) {
+    const bt9::BrClass_BrBehavior cls = reader.nodeRecord_(id).br_class_br_behavior;
+    info.staticConditionalBranches += (cls.conditionality == bt9::BrClass::Conditionality::CONDITIONAL);
+  }
+
+  // Ids below 255 take one byte of the edge sequence and the others five
+  uint64_t traversals = 0;
+  uint64_t escaped = 0;
+  for (uint32_t id = 0; id < tables.num_edges; id++) {
+    const uint64_t count = reader.edgeRecord_(id).observed_traverse_cnt;
+    traversals += count;
+    escaped += (id >= 255) ? count : 0;
+  }
+  if (traversals == 0) {
+    // No traverse counts in the edge table: assume every edge is as hot as the others
+    traversals = info.branchInstructionCount;
+    escaped = (tables.num_edges > 255) ? traversals * (tables.num_edges - 255) / tables.num_edges : 0;
+  }
+  info.edgeSequenceBytes = (info.format == "bt9c") ? info.branchInstructionCount : traversals + 4 * escaped + 5;
+
+  info.estDecodeSeconds = info.edgeSequenceBytes * TRACE_INFO_DECODE_NS_PER_BYTE * 1e-9;
+  info.estSimSeconds = info.loadSeconds + info.estDecodeSeconds + info.branchInstructionCount * TRACE_INFO_SIM_NS_PER_BRANCH * 1e-9;
+
+  return info;
+}
+
+// Load the summary of a trace from its sidecar if it is still valid
+inline bool ReadTraceInfo(const std::string& trace, TraceInfo& info)
+{
+  uint64_t size = 0;
+  int64_t mtimeNs = 0;
+  std::ifstream fin(TraceInfoPath(trace));
+  if (!fin || !bt9::traceFileStamp(trace, size, mtimeNs)) {
+    return false;
+  }
+
+  try {
+    cereal::JSONInputArchive archive(fin);
+    info.serialize(archive);
+  }
+  catch (const std::exception&) {
+    return false;
+  }
+
+  return (info.version == TRACE_INFO_VERSION) && (info.sourceSize == size) && (info.sourceMtimeNs == mtimeNs);
+}
+
+// Write the sidecar under a temporary name and rename it into place like the seek index
+inline bool WriteTraceInfo(const std::string& trace, TraceInfo info)
+{
+  const std::string path = TraceInfoPath(trace);
+  const std::string tmpPath = path + ".tmp." + std::to_string(getpid());
+  {
+    std::ofstream fout(tmpPath);
+    if (!fout) {
+      return false;
+    }
+    cereal::JSONOutputArchive archive(fout);
+    info.serialize(archive);
+  }
+
+  if (rename(tmpPath.c_str(), path.c_str()) != 0) {
+    remove(tmpPath.c_str());
+    return false;
+  }
+
+  return true;
+}
@@ -0,0 +1,277 @@
+/*!
+ * \file    trace_reencode.cc
+ * \brief   Rewrites traces with their edges renumbered hottest-first.
+ *
+ * usage: trace_reencode [options] <input> <output>
+ *        trace_reencode [options] -o <dir> <input>...
+ *
+ * BT10 stores edge ids below 255 in one byte and every other id in five. The original BT9
+ * numbering often puts hot edges above 254, so each trace is rewritten with its edges sorted
+ * by descending traversal count (the traverse_cnt field, or counted from the edge sequence
+ * when the trace lacks it): the 255 hottest edges get the 1-byte ids. Header and node table
+ * are copied verbatim and the output is zstd compressed when its name ends with ".zst".
+ *
+ * The output is checked branch by branch against the input, then the size and decode time
+ * of both are reported.
+ */
+
+#include <algorithm>
+#include <numeric>
+#include <span>
+#include <vector>
+
+#include <getopt.h>
+
+#include "bt9_reader.h"
+#include "trace_writer.h"
+
+void PrintUsage(const char* prog)
+{
+  printf("usage: %s [options] <input> <output>\n", prog);
+  printf("       %s [options] -o <dir> <input>...\n", prog);
+  printf("  -o, --output-dir DIR   write every input to DIR under its own file name\n");
+  printf("  -L, --level N          zstd compression level for .zst outputs (default: %d)\n", TRACE_WRITER_DEFAULT_LEVEL);
+  printf("  -f, --frame-mb N       start a new zstd frame every N MiB of trace, so seek indexes\n");
+  printf("                         can enter the trace mid-way (default: 0, a single frame)\n");
+}
+
+// Count how often every edge is traversed, from the edge table or else from the edge sequence
+std::vector<uint64_t> CountTraversals(bt9::BT9Reader& reader)
+{
+  std::vector<uint64_t> counts(reader.loadStats().num_edges);
+  for (uint32_t id = 0; id < counts.size(); id++) {
+    counts[id] = reader.edgeRecord_(id).observed_traverse_cnt;
+  }
+
+  if (std::accumulate(counts.begin(), counts.end(), uint64_t{0}) != 0) {
+    return counts;
+  }
+
+  std::vector<bt9::BT9HotEdge> block(BRANCH_BLOCK_SIZE);
+  while (const uint64_t blockSize = reader.readBranchBlock(block)) {
+    for (const bt9::BT9HotEdge& br : std::span(block).first(blockSize)) {
+      counts[br.edge_id]++;
+    }
+  }
+  reader.seekToBranch(0);
+
+  return counts;
+}
+
+// Copy the text sections of the input with every EDGE line renumbered and sorted by its new id
+void WriteTextSections(const std::string& input, const std::vector<uint32_t>& newId, bt9::TraceWriter& writer)
+{
+  bt9::TraceStreamBuf inbuf(input);
+  std::istream in(&inbuf);
+
+  std::vector<std::string> edgeLines(newId.size());
+  bool inEdges = false;
+
+  std::string line;
+  while (std::getline(in, line, '\n')) {
+    bt9::TextScanner ss(line);
+    std::string_view token;
+    ss.next(token);
+
+    if (inEdges && (token == "EDGE")) {
+      uint32_t id = 0;
+      if (!ss.next(token) || !bt9::parseInteger(token, id) || (id >= newId.size())) {
+        fprintf(stderr, "%s: invalid edge line \"%s\"\n", input.c_str(), line.c_str());
+        exit(-1);
+      }
+      edgeLines[newId[id]] = "EDGE " + std::to_string(newId[id]) + std::string(ss.rest());
+      continue;
+    }
+
+    if (token == "BT9_EDGES") {
+      inEdges = true;
+    }
+    else if (token == "BT10_SMALL_INDEX_SIZE_8") {
+      for (const std::string& edgeLine : edgeLines) {
+        writer.write(edgeLine);
+        writer.write("\n");
+      }
+    }
+
+    writer.write(line);
+    writer.write("\n");
+
+    if (token == "BT10_BIG_INDEX_SIZE_32") {
+      break;
+    }
+  }
+}
+
+// Check that the output replays the input branch by branch under the new numbering
+bool VerifyTrace(const std::string& input, const std::string& output, const std::vector<uint32_t>& newId)
+{
+  bt9::BT9Reader in(input);
+  bt9::BT9Reader out(output);
+  std::vector<bt9::BT9HotEdge> inBlock(BRANCH_BLOCK_SIZE);
+  std::vector<bt9::BT9HotEdge> outBlock(BRANCH_BLOCK_SIZE);
+
+  while (true) {
+    const uint64_t inSize = in.readBranchBlock(inBlock);
+    const uint64_t outSize = out.readBranchBlock(outBlock);
+    if (inSize != outSize) {
+      return false;
+    }
+    if (inSize == 0) {
+      return true;
+    }
+
+    for (uint64_t i = 0; i < inSize; i++) {
+      const bt9::BT9HotEdge& a = inBlock[i];
+      const bt9::BT9HotEdge& b = outBlock[i];
+      if ((newId[a.edge_id] != b.edge_id) || (a.pc != b.pc) || (a.target != b.target) || (a.inst_cnt != b.inst_cnt) ||
+          (a.src_node_id != b.src_node_id) || (a.op_type != b.op_type) || (a.conditional != b.conditional) || (a.taken != b.taken)) {
+        return false;
+      }
+    }
+  }
+}
+
+// Wall time to load a trace and decode its whole edge sequence
+double TimeDecode(const std::string& trace)
+{
+  const auto start = std::chrono::steady_clock::now();
+  bt9::BT9Reader reader(trace);
+  reader.skipBranches(UINT64_MAX);
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Size of a file in bytes, 0 if it does not exist
+uint64_t FileSize(const std::string& name)
+{
+  struct stat st;
+  return (stat(name.c_str(), &st) == 0) ? st.st_size : 0;
+}
+
+bool ReencodeTrace(const std::string& input, const std::string& output, int level, uint64_t frameSize)
+{
+  struct stat inStat, outStat;
+  if ((stat(input.c_str(), &inStat) == 0) && (stat(output.c_str(), &outStat) == 0) &&
+      (inStat.st_dev == outStat.st_dev) && (inStat.st_ino == outStat.st_ino)) {
+    fprintf(stderr, "%s: refusing to overwrite the input trace\n", input.c_str());
+    return false;
+  }
+
+  bt9::BT9Reader reader(input);
+
+  // Hottest first; equally hot edges keep their relative order
+  const std::vector<uint64_t> counts = CountTraversals(reader);
+  std::vector<uint32_t> order(counts.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return counts[a] > counts[b]; });
+
+  std::vector<uint32_t> newId(order.size());
+  for (uint32_t i = 0; i < order.size(); i++) {
+    newId[order[i]] = i;
+  }
+
+  bt9::TraceWriter writer(output, level, frameSize);
+  WriteTextSections(input, newId, writer);
+
+  uint64_t numBranches = 0;
+  uint64_t inEscaped = 0;
+  uint64_t outEscaped = 0;
+  std::vector<bt9::BT9HotEdge> block(BRANCH_BLOCK_SIZE);
+  while (const uint64_t blockSize = reader.readBranchBlock(block)) {
+    for (const bt9::BT9HotEdge& br : std::span(block).first(blockSize)) {
+      const uint32_t id = newId[br.edge_id];
+      writer.writeEdgeId(id);
+      inEscaped += (br.edge_id >= 255);
+      outEscaped += (id >= 255);
+    }
+    numBranches += blockSize;
+  }
+  writer.writeEdgeSequenceEnd();
+
+  if (!writer.close()) {
+    fprintf(stderr, "%s: failed to write %s\n", input.c_str(), output.c_str());
+    return false;
+  }
+
+  if (!VerifyTrace(input, output, newId)) {
+    fprintf(stderr, "%s: %s does not replay the input trace\n", input.c_str(), output.c_str());
+    return false;
+  }
+
+  const double MB = 1024.0 * 1024.0;
+  const double inBytes = (double)FileSize(input);
+  const double outBytes = (double)FileSize(output);
+  const double inSeconds = TimeDecode(input);
+  const double outSeconds = TimeDecode(output);
+
+  printf("%s: %llu branches, %llu edges\n", input.c_str(), (unsigned long long)numBranches, (unsigned long long)counts.size());
+  printf("  input   %9.2f MB  %5.1f%% escaped ids  decode %.3f s\n",
+         inBytes / MB, 100.0 * inEscaped / numBranches, inSeconds);
+  printf("  output  %9.2f MB  %5.1f%% escaped ids  decode %.3f s  (size %+.1f%%, decode %+.1f%%)\n",
+         outBytes / MB, 100.0 * outEscaped / numBranches, outSeconds,
+         100.0 * (outBytes - inBytes) / inBytes, 100.0 * (outSeconds - inSeconds) / inSeconds);
+
+  return true;
+}
+
+int main(int argc, char* argv[])
+{
+  std::string outputDir;
+  int level = TRACE_WRITER_DEFAULT_LEVEL;
+  uint64_t frameSize = 0;
+
+  static const struct option longOptions[] = {
+    {"output-dir", required_argument, nullptr, 'o'},
+    {"level",      required_argument, nullptr, 'L'},
+    {"frame-mb",   required_argument, nullptr, 'f'},
+    {"help",       no_argument,       nullptr, 'h'},
+    {nullptr,      0,                 nullptr,  0 }
+  };
+
+  int opt;
+  while ((opt = getopt_long(argc, argv, "o:L:f:h", longOptions, nullptr)) != -1) {
+    switch (opt) {
+      case 'o':
+        outputDir = optarg;
+        break;
+      case 'L':
+        level = atoi(optarg);
+        break;
+      case 'f':
+        frameSize = strtoull(optarg, nullptr, 0) << 20;
+        break;
+      default:
+        PrintUsage(argv[0]);
+        exit(-1);
+    }
+  }
+
+  std::vector<std::pair<std::string, std::string>> jobs;
+  if (!outputDir.empty()) {
+    mkdir(outputDir.c_str(), 0777);
+    for (int i = optind; i < argc; i++) {
+      const std::string input = argv[i];
+      jobs.emplace_back(input, outputDir + "/" + input.substr(input.find_last_of('/') + 1));
+    }
+  }
+  else if (argc - optind == 2) {
+    jobs.emplace_back(argv[optind], argv[optind + 1]);
+  }
+
+  if (jobs.empty()) {
+    PrintUsage(argv[0]);
+    exit(-1);
+  }
+
+  int failed = 0;
+  for (const auto& [input, output] : jobs) {
+    try {
+      failed += !ReencodeTrace(input, output, level, frameSize);
+    }
+    catch (const bt9::TraceError& ex) {
+      fprintf(stderr, "%s\n", ex.what());
+      failed++;
+    }
+  }
+
+  return (failed == 0) ? 0 : -1;
+}
@@ -0,0 +1,198 @@
+/*!
+ * \file    trace_scheduler.h
+ * \brief   Work-stealing scheduler running one job per trace on a fixed number of worker threads.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <deque>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <regex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "trace_info.h"
+
+namespace bt9 {
+
+    /*!
+     * \brief List the traces of a directory, sorted by name
+     * \note Skips the sidecars written next to traces (seek index, SimPoint set, trace summary),
+     *       as scripts/utils.py list_traces() does
+     */
+    inline std::vector<std::string> listTraces(const std::string & dir)
+    {
+        static const std::regex sidecar(R"(\.(bt10i|simpt|info)(\.tmp\.\d+)?$)");
+
+        std::vector<std::string> traces;
+        for (const std::filesystem::directory_entry & entry : std::filesystem::directory_iterator(dir)) {
+            if (entry.is_regular_file() && !std::regex_search(entry.path().filename().string(), sidecar)) {
+                traces.push_back(entry.path().string());
+            }
+        }
+        std::sort(traces.begin(), traces.end());
+        return traces;
+    }
+
+    /*!
+     * \brief Estimate the relative simulation time of traces
+     * \return Returns the est_sim_seconds of their .info summaries (trace_info) when every trace
+     *         has an up to date one, otherwise the file sizes
+     */
+    inline std::vector<double> estimateTraceCosts(const std::vector<std::string> & traces)
+    {
+        std::vector<double> costs;
+        for (const std::string & trace : traces) {
+            TraceInfo info;
+            if (!ReadTraceInfo(trace, info)) {
+                break;
+            }
+            costs.push_back(info.estSimSeconds);
+        }
+        if (costs.size() == traces.size()) {
+            return costs;
+        }
+
+        costs.clear();
+        for (const std::string & trace : traces) {
+            std::error_code error;
+            const uintmax_t size = std::filesystem::file_size(trace, error);
+            costs.push_back(error ? 0.0 : static_cast<double>(size));
+        }
+        return costs;
+    }
+
+    /*!
+     * \class TraceScheduler
+     * \brief Runs a job per trace, longest first, on worker threads that steal from each other
+     *
+     * Jobs are dealt longest first to the worker with the least work so far, so the workers start
+     * with similar loads, and every worker runs its own jobs longest first. A worker that runs out
+     * steals the longest job left on the worker with the most work left, so the long jobs still
+     * start early and the end of a run keeps all workers busy.
+     *
+     * Every job runs on a thread of its own, started by its worker: predictors keep their state
+     * in thread_local globals, which a fresh thread initializes from scratch for every trace just
+     * like a fresh process did. The thread has the default stack, which also holds the static TLS,
+     * so large tables have to be allocated by the PREDICTOR instead. The PREDICTOR of a job is
+     * destroyed with it and has to free what it allocated; see "Adding a predictor" in readme.md.
+     */
+    class TraceScheduler
+    {
+    public:
+        /*!
+         * \brief Constructor
+         * \param costs Estimated cost of every job, in any unit
+         * \param num_threads Number of worker threads, clamped to 1 .. the number of jobs
+         */
+        TraceScheduler(const std::vector<double> & costs, unsigned num_threads)
+        {
+            const size_t num_workers = std::clamp<size_t>(num_threads, 1, std::max<size_t>(costs.size(), 1));
+            for (size_t i = 0; i < num_workers; i++) {
+                queues_.push_back(std::make_unique<Queue>());
+            }
+
+            std::vector<size_t> order(costs.size());
+            for (size_t i = 0; i < order.size(); i++) {
+                order[i] = i;
+            }
+            std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return costs[a] > costs[b]; });
+
+            for (size_t job : order) {
+                Queue & queue = **std::min_element(queues_.begin(), queues_.end(),
+                    [](const auto & a, const auto & b) { return a->remaining < b->remaining; });
+                queue.jobs.push_back({ job, costs[job] });
+                queue.remaining += costs[job];
+            }
+        }
+
+        TraceScheduler(const TraceScheduler &) = delete;
+        TraceScheduler & operator=(const TraceScheduler &) = delete;
+
+        /*!
+         * \brief Run all jobs and wait for them
+         * \param job Called with the index of a job, from a thread of its own; must not throw
+         */
+        void run(const std::function<void(size_t)> & job)
+        {
+            std::vector<std::thread> workers;
+            for (size_t i = 0; i < queues_.size(); i++) {
+                workers.emplace_back([this, i, &job] {
+                    size_t index;
+                    while (nextJob_(i, index)) {
+                        std::thread(job, index).join();
+                    }
+                });
+            }
+
+            for (std::thread & worker : workers) {
+                worker.join();
+            }
+        }
+
+    private:
+        struct Job {
+            size_t index;
+            double cost;
+        };
+
+        /*!
+         * \struct Queue
+         * \brief Jobs of one worker, longest first
+         */
+        struct Queue {
+            std::mutex mutex;
+            std::deque<Job> jobs;
+            double remaining = 0.0;     //!< Cost of the jobs not started yet
+        };
+
+        /// Take the longest job of a queue, false if it is empty
+        static bool take_(Queue & queue, size_t & index)
+        {
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            if (queue.jobs.empty()) {
+                return false;
+            }
+            index = queue.jobs.front().index;
+            queue.remaining -= queue.jobs.front().cost;
+            queue.jobs.pop_front();
+            return true;
+        }
+
+        /// Next job of a worker: its own longest one, or else the longest of the most loaded other worker
+        bool nextJob_(size_t worker, size_t & index)
+        {
+            if (take_(*queues_[worker], index)) {
+                return true;
+            }
+
+            // A victim may run dry between the scan and the steal, which only costs another scan
+            while (true) {
+                Queue * victim = nullptr;
+                double most = -1.0;
+                for (const std::unique_ptr<Queue> & queue : queues_) {
+                    std::lock_guard<std::mutex> lock(queue->mutex);
+                    if (!queue->jobs.empty() && (queue->remaining > most)) {
+                        victim = queue.get();
+                        most = queue->remaining;
+                    }
+                }
+
+                if (victim == nullptr) {
+                    return false;
+                }
+                if (take_(*victim, index)) {
+                    return true;
+                }
+            }
+        }
+
+        std::vector<std::unique_ptr<Queue>> queues_;
+    };
+
+}
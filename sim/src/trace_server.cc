@@ -0,0 +1,158 @@
+/*!
+ * \file    trace_server.cc
+ * \brief   Decodes traces once into POSIX shared memory for concurrent simulator processes.
+ *
+ * usage: trace_server [-j jobs] <trace>...
+ *
+ * Every trace is converted into a .bt10c image (see trace_cache.h) placed in the shared
+ * memory segment traceSegmentName(trace). BT9Reader attaches to that segment read-only
+ * whenever it exists, so simulator runs skip decompression and decoding entirely and fall
+ * back to the trace file once the server is gone, or once the trace file no longer has the
+ * size and modification time recorded in the image. The segments are removed on SIGINT/SIGTERM.
+ */
+
+#include <atomic>
+#include <csignal>
+#include <thread>
+#include <vector>
+
+#include <getopt.h>
+
+#include "bt9_reader.h"
+
+static volatile sig_atomic_t stopRequested = 0;
+
+void RequestStop(int)
+{
+  stopRequested = 1;
+}
+
+void PrintUsage(const char* prog)
+{
+  printf("usage: %s [options] <trace>...\n", prog);
+  printf("  -j, --jobs N        decode N traces in parallel (default: number of CPUs)\n");
+}
+
+// Decode one trace into a freshly created shared memory segment, returns false on failure
+bool PublishTrace(const std::string& trace, const std::string& segment)
+{
+  uint64_t hash = 0;
+  uint64_t size = 0;
+  int64_t mtimeNs = 0;
+  if (!bt9::traceFileStamp(trace, size, mtimeNs) || !bt9::hashTraceFile(trace, hash, size)) {
+    fprintf(stderr, "%s: cannot read trace\n", trace.c_str());
+    return false;
+  }
+
+  // Replace a segment left behind by a previous server
+  shm_unlink(segment.c_str());
+
+  const int fd = shm_open(segment.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+  FILE* fout = (fd >= 0) ? fdopen(fd, "w+b") : nullptr;
+  if (fout == nullptr) {
+    fprintf(stderr, "%s: cannot create shared memory segment %s\n", trace.c_str(), segment.c_str());
+    if (fd >= 0) {
+      close(fd);
+      shm_unlink(segment.c_str());
+    }
+    return false;
+  }
+
+  bool ok;
+  try {
+    bt9::BT9Reader reader(trace, true);
+    ok = reader.writeTraceImage(fout, hash, size, mtimeNs);
+  }
+  catch (const bt9::TraceError& ex) {
+    fprintf(stderr, "%s\n", ex.what());
+    ok = false;
+  }
+
+  if ((fclose(fout) != 0) || !ok) {
+    fprintf(stderr, "%s: failed to write shared memory segment %s\n", trace.c_str(), segment.c_str());
+    shm_unlink(segment.c_str());
+    return false;
+  }
+
+  fprintf(stderr, "%s -> %s\n", trace.c_str(), segment.c_str());
+  return true;
+}
+
+int main(int argc, char* argv[])
+{
+  unsigned jobs = std::max(1u, std::thread::hardware_concurrency());
+
+  static const struct option longOptions[] = {
+    {"jobs", required_argument, nullptr, 'j'},
+    {"help", no_argument,       nullptr, 'h'},
+    {nullptr, 0,                nullptr,  0 }
+  };
+
+  int opt;
+  while ((opt = getopt_long(argc, argv, "j:h", longOptions, nullptr)) != -1) {
+    switch (opt) {
+      case 'j':
+        jobs = std::max(1, atoi(optarg));
+        break;
+      default:
+        PrintUsage(argv[0]);
+        exit(-1);
+    }
+  }
+
+  if (optind == argc) {
+    PrintUsage(argv[0]);
+    exit(-1);
+  }
+
+  struct sigaction action = {};
+  action.sa_handler = RequestStop;
+  sigaction(SIGINT, &action, nullptr);
+  sigaction(SIGTERM, &action, nullptr);
+
+  std::vector<std::string> traces(argv + optind, argv + argc);
+  std::vector<std::string> segments(traces.size());
+  std::vector<char> published(traces.size(), 0);
+
+  // Each worker takes the next unclaimed trace; BT9Reader instances are independent
+  std::atomic<size_t> next{0};
+  std::vector<std::thread> workers;
+  for (unsigned i = 0; i < std::min<size_t>(jobs, traces.size()); i++) {
+    workers.emplace_back([&]() {
+      for (size_t t = next++; (t < traces.size()) && !stopRequested; t = next++) {
+        segments[t] = bt9::traceSegmentName(traces[t]);
+        published[t] = PublishTrace(traces[t], segments[t]);
+      }
+    });
+  }
+  for (auto& worker : workers) {
+    worker.join();
+  }
+
+  size_t numPublished = 0;
+  for (char p : published) {
+    numPublished += p;
+  }
+
+  if (!stopRequested) {
+    fprintf(stderr, "serving %zu of %zu traces, stop with Ctrl-C or SIGTERM\n", numPublished, traces.size());
+  }
+
+  // Block the stop signals while checking the flag so none slips in before sigsuspend()
+  sigset_t stopSignals, oldMask;
+  sigemptyset(&stopSignals);
+  sigaddset(&stopSignals, SIGINT);
+  sigaddset(&stopSignals, SIGTERM);
+  sigprocmask(SIG_BLOCK, &stopSignals, &oldMask);
+  while (!stopRequested) {
+    sigsuspend(&oldMask);
+  }
+
+  for (size_t t = 0; t < traces.size(); t++) {
+    if (published[t]) {
+      shm_unlink(segments[t].c_str());
+    }
+  }
+
+  return 0;
+}
@@ -0,0 +1,202 @@
+/*!
+ * \file    trace_writer.h
+ * \brief   Trace file output with in-process zstd compression and a BT10 edge sequence encoder.
+ */
+
+#pragma once
+
+#include "bt9_reader_defines.h"
+
+#include <zstd.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace bt9 {
+
+    /*!
+     * \class TraceWriter
+     * \brief Writes a trace file, compressed with zstd when its name ends with ".zst"
+     *
+     * The counterpart of TraceStreamBuf for the trace tools. Output can be split into
+     * independent zstd frames, which lets a seek index (see seek_index.h) enter the trace
+     * at the frame holding a checkpoint instead of decompressing it from the start.
+     */
+    class TraceWriter
+    {
+    public:
+        /*!
+         * \brief Constructor
+         * \param name Output file name, compressed with zstd if it contains ".zst"
+         * \param level zstd compression level
+         * \param frame_size Start a new zstd frame every frame_size uncompressed bytes, 0 for a single frame
+         */
+        TraceWriter(const std::string & name, int level = TRACE_WRITER_DEFAULT_LEVEL, uint64_t frame_size = 0) :
+            name_(name),
+            frame_size_(frame_size),
+            in_buf_(TRACE_STREAM_OUT_BUFFER_SIZE)
+        {
+            fout_ = fopen(name.c_str(), "wb");
+            if (fout_ == nullptr) {
+                std::cerr << "Failed to create trace file \'" << name << "\'\n";
+                exit(-1);
+            }
+
+            if (name.find(".zst") != std::string::npos) {
+                cctx_ = ZSTD_createCCtx();
+                if ((cctx_ == nullptr) || ZSTD_isError(ZSTD_CCtx_setParameter(cctx_, ZSTD_c_compressionLevel, level)) ||
+                    ZSTD_isError(ZSTD_CCtx_setParameter(cctx_, ZSTD_c_checksumFlag, 1))) {
+                    std::cerr << "Failed to set up zstd compression for \'" << name << "\'\n";
+                    exit(-1);
+                }
+                out_buf_.resize(ZSTD_CStreamOutSize());
+            }
+        }
+
+        TraceWriter(const TraceWriter &) = delete;
+        TraceWriter & operator=(const TraceWriter &) = delete;
+
+        ~TraceWriter()
+        {
+            close();
+            ZSTD_freeCCtx(cctx_);
+        }
+
+        /// Append raw bytes
+        void write(const void * data, size_t size)
+        {
+            const char * ptr = static_cast<const char *>(data);
+
+            while (size > 0) {
+                size_t n = std::min(size, in_buf_.size() - in_used_);
+                if (frame_size_ != 0) {
+                    n = std::min<uint64_t>(n, frame_size_ - frame_pos_);
+                }
+
+                memcpy(in_buf_.data() + in_used_, ptr, n);
+                in_used_ += n;
+                frame_pos_ += n;
+                stream_bytes_ += n;
+                ptr += n;
+                size -= n;
+
+                if ((frame_size_ != 0) && (frame_pos_ == frame_size_)) {
+                    flush_(ZSTD_e_end);
+                    frame_pos_ = 0;
+                }
+                else if (in_used_ == in_buf_.size()) {
+                    flush_(ZSTD_e_continue);
+                }
+            }
+        }
+
+        /// Append text
+        void write(std::string_view text) { write(text.data(), text.size()); }
+
+        /// Append one BT10 edge sequence record: ids below 255 take one byte, others are escaped
+        void writeEdgeId(uint32_t edge_id)
+        {
+            uint8_t record[5];
+            if (edge_id < 255) {
+                record[0] = static_cast<uint8_t>(edge_id);
+                write(record, 1);
+            }
+            else {
+                record[0] = 255;
+                memcpy(record + 1, &edge_id, 4);
+                write(record, 5);
+            }
+        }
+
+        /// Append the BT10 end of sequence marker (an escaped id 0)
+        void writeEdgeSequenceEnd()
+        {
+            const uint8_t record[5] = {255, 0, 0, 0, 0};
+            write(record, 5);
+        }
+
+        /*!
+         * \brief Flush everything, end the last zstd frame and close the file
+         * \return Returns false if anything failed to be written
+         */
+        bool close()
+        {
+            if (fout_ == nullptr) {
+                return !error_;
+            }
+
+            flush_(ZSTD_e_end);
+            error_ |= (ferror(fout_) != 0);
+            error_ |= (fclose(fout_) != 0);
+            fout_ = nullptr;
+
+            return !error_;
+        }
+
+        /// Bytes appended so far, before compression
+        uint64_t streamBytes() const { return stream_bytes_; }
+
+        /// Bytes written to the file so far
+        uint64_t fileBytes() const { return file_bytes_; }
+
+    private:
+        /// Hand the buffered input to the file, compressing it if needed
+        void flush_(ZSTD_EndDirective mode)
+        {
+            if (cctx_ == nullptr) {
+                file_bytes_ += fwrite(in_buf_.data(), 1, in_used_, fout_);
+                in_used_ = 0;
+                return;
+            }
+
+            ZSTD_inBuffer input = { in_buf_.data(), in_used_, 0 };
+            while (true) {
+                ZSTD_outBuffer output = { out_buf_.data(), out_buf_.size(), 0 };
+                const size_t remaining = ZSTD_compressStream2(cctx_, &output, &input, mode);
+                if (ZSTD_isError(remaining)) {
+                    std::cerr << "\'" << name_ << "\' zstd error: " << ZSTD_getErrorName(remaining) << '\n';
+                    error_ = true;
+                    break;
+                }
+
+                file_bytes_ += fwrite(out_buf_.data(), 1, output.pos, fout_);
+
+                const bool done = (mode == ZSTD_e_continue) ? (input.pos == input.size) : (remaining == 0);
+                if (done) {
+                    break;
+                }
+            }
+
+            in_used_ = 0;
+        }
+
+        /// Trace file name, for error messages
+        std::string name_;
+
+        /// Trace file handle, nullptr once closed
+        FILE * fout_ = nullptr;
+
+        /// zstd compression context, nullptr for uncompressed traces
+        ZSTD_CCtx * cctx_ = nullptr;
+
+        /// Uncompressed bytes per zstd frame (0: unlimited) and bytes in the current frame
+        uint64_t frame_size_ = 0;
+        uint64_t frame_pos_ = 0;
+
+        /// Pending uncompressed input and compressed output buffers
+        std::vector<char> in_buf_;
+        size_t in_used_ = 0;
+        std::vector<char> out_buf_;
+
+        uint64_t stream_bytes_ = 0;
+        uint64_t file_bytes_ = 0;
+        bool error_ = false;
+    };
+
+}